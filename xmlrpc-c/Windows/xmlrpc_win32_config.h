@@ -142,6 +142,12 @@
 */
 #define HAVE_PTHREAD 0
 
+#define HAVE_EPOLL 0
+
+#define HAVE_SENDFILE 0
+
+#define HAVE_SYNC_FETCH_AND_ADD 0
+
 /* Note that the return value of XMLRPC_VSNPRINTF is int on Windows,
    ssize_t on POSIX.
 */
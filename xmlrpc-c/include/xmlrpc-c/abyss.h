@@ -26,6 +26,7 @@ extern "C" {
 #endif
 
 #include <sys/types.h>
+#include <time.h>
 
 #include <xmlrpc-c/c_util.h>
 #include <xmlrpc-c/inttypes.h>
@@ -252,6 +253,36 @@ void
 ServerSetMaxConnBacklog(TServer *    const serverP,
                         unsigned int const maxConnBacklog);
 
+#define HAVE_SERVER_SET_WORKER_THREADS 1
+XMLRPC_ABYSS_EXPORTED
+void
+ServerSetWorkerThreads(TServer *    const serverP,
+                       unsigned int const workerThreads);
+
+#define HAVE_SERVER_SET_READ_BUFFER_SIZE 1
+XMLRPC_ABYSS_EXPORTED
+void
+ServerSetReadBufferSize(TServer *    const serverP,
+                        unsigned int const readBufferSize);
+
+#define HAVE_SERVER_SET_ACCEPTOR_THREADS 1
+XMLRPC_ABYSS_EXPORTED
+void
+ServerSetAcceptorThreads(TServer *    const serverP,
+                         unsigned int const acceptorThreads);
+
+#define HAVE_SERVER_SET_EVENT_DRIVEN 1
+XMLRPC_ABYSS_EXPORTED
+void
+ServerSetEventDriven(TServer *  const serverP,
+                     abyss_bool const eventDriven);
+
+#define HAVE_SERVER_SET_STATS_URI 1
+XMLRPC_ABYSS_EXPORTED
+void
+ServerSetStatsUri(TServer *    const serverP,
+                  const char * const statsUri);
+
 XMLRPC_ABYSS_EXPORTED
 void
 ServerInit2(TServer *     const serverP,
@@ -315,6 +346,46 @@ void
 ServerHandleSigchld(pid_t const pid);
 #endif
 
+/* A latency histogram in TServerStats has ABYSS_STATS_BUCKETS counts.
+   Count 0 is of times under 1 microsecond; count i is of times of at
+   least 2^(i-1) and under 2^i microseconds, except the last one counts
+   everything longer too.
+*/
+#define ABYSS_STATS_BUCKETS 24
+
+typedef struct {
+    time_t          startTime;
+        /* When the server was created, which is when counting started */
+    xmlrpc_uint64_t connectionsAccepted;
+    unsigned int    connectionsOpen;
+    unsigned int    connectionsActive;
+        /* Connections processing a request.  The rest of the open
+           connections are idle, waiting for a request.
+        */
+    xmlrpc_uint64_t requests;
+    xmlrpc_uint64_t requestsOnReusedConn;
+        /* Requests that came on a connection kept alive from an earlier
+           request
+        */
+    xmlrpc_uint64_t bytesIn;
+    xmlrpc_uint64_t bytesOut;
+    /* Where the time to process each request went: */
+    xmlrpc_uint64_t readTime[ABYSS_STATS_BUCKETS];
+        /* Waiting for and reading the request from the client */
+    xmlrpc_uint64_t parseTime[ABYSS_STATS_BUCKETS];
+        /* Parsing the request header */
+    xmlrpc_uint64_t handleTime[ABYSS_STATS_BUCKETS];
+        /* Running the request handler, except its reading and writing */
+    xmlrpc_uint64_t writeTime[ABYSS_STATS_BUCKETS];
+        /* Sending the response */
+} TServerStats;
+
+#define HAVE_SERVER_GET_STATS 1
+XMLRPC_ABYSS_EXPORTED
+void
+ServerGetStats(TServer *      const serverP,
+               TServerStats * const statsP);
+
 typedef abyss_bool (*URIHandler) (TSession *); /* deprecated */
 
 struct URIHandler2;
@@ -442,6 +513,14 @@ SessionGetReadData(TSession *    const sessionP,
                    const char ** const outStartP, 
                    size_t *      const outLenP);
 
+#define HAVE_SESSION_READ_BODY 1
+XMLRPC_ABYSS_EXPORTED
+abyss_bool
+SessionReadBody(TSession * const sessionP,
+                char *     const buffer,
+                size_t     const size,
+                size_t *   const bytesReadP);
+
 XMLRPC_ABYSS_EXPORTED
 void
 SessionGetRequestInfo(TSession *            const sessionP,
@@ -456,6 +535,15 @@ XMLRPC_ABYSS_EXPORTED
 void *
 SessionGetDefaultHandlerCtx(TSession * const sessionP);
 
+#define HAVE_SESSION_DEFER 1
+XMLRPC_ABYSS_EXPORTED
+abyss_bool
+SessionDefer(TSession * const sessionP);
+
+XMLRPC_ABYSS_EXPORTED
+void
+SessionComplete(TSession * const sessionP);
+
 XMLRPC_ABYSS_EXPORTED
 char *
 RequestHeaderValue(TSession *   const sessionP,
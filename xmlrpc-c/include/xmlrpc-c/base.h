@@ -707,13 +707,73 @@ xmlrpc_parse_value_va(xmlrpc_env *   const envP,
                       const char *   const format,
                       va_list        const args);
 
+/* A compiled format string: the format string of xmlrpc_build_value or
+   xmlrpc_decompose_value, parsed once so it can be used many times, by
+   any number of threads at once.
+*/
+typedef struct xmlrpc_builder xmlrpc_builder;
+
+typedef struct xmlrpc_decomposer xmlrpc_decomposer;
+
+XMLRPC_LIB_EXPORTED
+void
+xmlrpc_build_compile(xmlrpc_env *      const envP,
+                     const char *      const format,
+                     xmlrpc_builder ** const builderPP);
+
+XMLRPC_LIB_EXPORTED
+void
+xmlrpc_builder_destroy(xmlrpc_builder * const builderP);
+
+XMLRPC_LIB_EXPORTED
+xmlrpc_value *
+xmlrpc_build_compiled(xmlrpc_env *           const envP,
+                      const xmlrpc_builder * const builderP,
+                      ...);
+
+XMLRPC_LIB_EXPORTED
+void
+xmlrpc_build_compiled_va(xmlrpc_env *           const envP,
+                         const xmlrpc_builder * const builderP,
+                         va_list                const args,
+                         xmlrpc_value **        const valPP);
+
+XMLRPC_LIB_EXPORTED
+void
+xmlrpc_decompose_compile(xmlrpc_env *         const envP,
+                         const char *         const format,
+                         xmlrpc_decomposer ** const decomposerPP);
+
+XMLRPC_LIB_EXPORTED
+void
+xmlrpc_decomposer_destroy(xmlrpc_decomposer * const decomposerP);
+
+XMLRPC_LIB_EXPORTED
+void
+xmlrpc_decompose_compiled(xmlrpc_env *              const envP,
+                          xmlrpc_value *            const valueP,
+                          const xmlrpc_decomposer * const decomposerP,
+                          ...);
+
+XMLRPC_LIB_EXPORTED
+void
+xmlrpc_decompose_compiled_va(xmlrpc_env *              const envP,
+                             xmlrpc_value *            const valueP,
+                             const xmlrpc_decomposer * const decomposerP,
+                             va_list                   const args);
+
 /*=========================================================================
 **  Encoding XML
 **=======================================================================*/
 
 typedef enum xmlrpc_dialect {
     xmlrpc_dialect_i8,
-    xmlrpc_dialect_apache
+    xmlrpc_dialect_apache,
+    xmlrpc_dialect_compact
+        /* Same as xmlrpc_dialect_i8, but with no white space between
+           elements, no newlines in base64 data, and strings as plain
+           <value> content (no <string> element).
+        */
 } xmlrpc_dialect;
 
 XMLRPC_LIB_EXPORTED
@@ -723,6 +783,17 @@ xmlrpc_serialize_value2(xmlrpc_env *       const envP,
                         xmlrpc_value *     const valueP,
                         xmlrpc_dialect     const dialect);
 
+/* Same as xmlrpc_serialize_value2(), but large arrays and structures get
+   serialized by up to 'threadCount' threads at once.  The XML is the same.
+*/
+XMLRPC_LIB_EXPORTED
+void 
+xmlrpc_serialize_value_parallel(xmlrpc_env *       const envP,
+                                xmlrpc_mem_block * const outputP,
+                                xmlrpc_value *     const valueP,
+                                xmlrpc_dialect     const dialect,
+                                unsigned int       const threadCount);
+
 XMLRPC_LIB_EXPORTED
 void
 xmlrpc_serialize_value(xmlrpc_env *       const envP,
@@ -764,18 +835,104 @@ xmlrpc_serialize_response2(xmlrpc_env *       const envP,
                            xmlrpc_value *     const valueP,
                            xmlrpc_dialect     const dialect);
 
+XMLRPC_LIB_EXPORTED
+void 
+xmlrpc_serialize_response_parallel(xmlrpc_env *       const envP,
+                                   xmlrpc_mem_block * const outputP,
+                                   xmlrpc_value *     const valueP,
+                                   xmlrpc_dialect     const dialect,
+                                   unsigned int       const threadCount);
+
 XMLRPC_LIB_EXPORTED
 void
 xmlrpc_serialize_response(xmlrpc_env *       const envP,
                           xmlrpc_mem_block * const outputP,
                           xmlrpc_value *     const valueP);
 
+XMLRPC_LIB_EXPORTED
+void
+xmlrpc_serialize_fault2(xmlrpc_env *       const envP,
+                        xmlrpc_mem_block * const outputP,
+                        const xmlrpc_env * const faultP,
+                        xmlrpc_dialect     const dialect);
+
 XMLRPC_LIB_EXPORTED
 void
 xmlrpc_serialize_fault(xmlrpc_env *       const envP,
                        xmlrpc_mem_block * const outputP,
                        const xmlrpc_env * const faultP);
 
+/* Serialize 'valueP' now and keep the result with the value, so that
+   serializing it later (alone or as part of a larger value) just copies
+   those bytes.  The XML is for dialect 'dialect'; serializing in another
+   dialect ignores it.  'json' says to cache the JSON form as well.
+
+   This freezes the value and everything in it: any attempt to modify
+   them afterward fails.
+*/
+XMLRPC_LIB_EXPORTED
+void
+xmlrpc_value_cache_serialization(xmlrpc_env *   const envP,
+                                 xmlrpc_value * const valueP,
+                                 xmlrpc_dialect const dialect,
+                                 xmlrpc_bool    const json);
+
+/* A structure descriptor says how to find the members of an XML-RPC
+   structure value in a C structure, so we can generate XML straight from
+   the C structure, or fill it in straight from XML, without building an
+   xmlrpc_value.  It is an array of xmlrpc_struct_field, one per member,
+   ending with XMLRPC_STRUCT_FIELD_END.  E.g.
+
+     struct point { xmlrpc_int32 x; xmlrpc_int32 y; const char * label; };
+
+     static const xmlrpc_struct_field pointFields[] = {
+         XMLRPC_STRUCT_FIELD(struct point, x,     XMLRPC_TYPE_INT),
+         XMLRPC_STRUCT_FIELD(struct point, y,     XMLRPC_TYPE_INT),
+         XMLRPC_STRUCT_FIELD(struct point, label, XMLRPC_TYPE_STRING),
+         XMLRPC_STRUCT_FIELD_END
+     };
+
+   The C type of a member depends on its XML-RPC type:
+
+     XMLRPC_TYPE_INT     xmlrpc_int32
+     XMLRPC_TYPE_I8      xmlrpc_int64
+     XMLRPC_TYPE_BOOL    xmlrpc_bool
+     XMLRPC_TYPE_DOUBLE  double
+     XMLRPC_TYPE_STRING  const char *  (NUL-terminated UTF-8)
+
+   No other types are possible.
+*/
+typedef struct {
+    const char * name;
+    xmlrpc_type  type;
+    size_t       offset;
+} xmlrpc_struct_field;
+
+#define XMLRPC_STRUCT_FIELD_NAMED(name, structType, member, type) \
+    { name, type, offsetof(structType, member) }
+
+#define XMLRPC_STRUCT_FIELD(structType, member, type) \
+    XMLRPC_STRUCT_FIELD_NAMED(#member, structType, member, type)
+
+#define XMLRPC_STRUCT_FIELD_END { NULL, XMLRPC_TYPE_DEAD, 0 }
+
+XMLRPC_LIB_EXPORTED
+void
+xmlrpc_serialize_struct_direct(xmlrpc_env *                const envP,
+                               xmlrpc_mem_block *          const outputP,
+                               const xmlrpc_struct_field * const fields,
+                               const void *                const structP,
+                               xmlrpc_dialect              const dialect);
+
+XMLRPC_LIB_EXPORTED
+void
+xmlrpc_serialize_response_struct_direct(
+    xmlrpc_env *                const envP,
+    xmlrpc_mem_block *          const outputP,
+    const xmlrpc_struct_field * const fields,
+    const void *                const structP,
+    xmlrpc_dialect              const dialect);
+
 
 /*=========================================================================
 **  Decoding XML
@@ -788,6 +945,18 @@ xmlrpc_parse_value_xml(xmlrpc_env *    const envP,
                        size_t          const xmlDataLen,
                        xmlrpc_value ** const valuePP);
 
+/* Fill in C structure *structP from the XML document 'xmlData', which must
+   be a <value> element for a structure with (at least) the members that
+   'fields' describes.  Caller must free the strings we put in it.
+*/
+XMLRPC_LIB_EXPORTED
+void
+xmlrpc_parse_struct_direct(xmlrpc_env *                const envP,
+                           const char *                const xmlData,
+                           size_t                      const xmlDataLen,
+                           const xmlrpc_struct_field * const fields,
+                           void *                      const structP);
+
 XMLRPC_LIB_EXPORTED
 void 
 xmlrpc_parse_call(xmlrpc_env *    const envP,
@@ -101,6 +101,28 @@ struct _xmlrpc_value {
            This is essentially a cached value of the result of a
            xmlrpc_read_datetime_str_old().  NULL means nothing cached.
         */
+    struct xmlrpc_serialCache * _serialCacheP;
+        /* Pre-serialized forms of this value, made by
+           xmlrpc_value_cache_serialization().  NULL means nothing cached.
+           Only a frozen value ever has this.
+        */
+    bool _frozen;
+        /* The value may no longer be modified.  The value and everything it
+           contains are immutable, which is what makes it safe for
+           _serialCacheP to stand in for the value when we serialize it.
+        */
+};
+
+struct xmlrpc_serialCache {
+    xmlrpc_mem_block * xmlP;
+        /* The content of the <value> element that represents the value,
+           e.g. "<i4>42</i4>", in dialect 'xmlDialect'.  NULL if none.
+        */
+    xmlrpc_dialect xmlDialect;
+    xmlrpc_mem_block * jsonP;
+        /* The JSON that represents the value, as generated at nesting level
+           zero.  NULL if none.
+        */
 };
 
 #define XMLRPC_ASSERT_VALUE_OK(val) \
@@ -152,6 +174,10 @@ XMLRPC_LIBINT_EXPORTED
 void
 xmlrpc_destroyArrayContents(xmlrpc_value * const arrayP);
 
+XMLRPC_LIBINT_EXPORTED
+void
+xmlrpc_destroySerialCache(xmlrpc_value * const valueP);
+
 /*----------------------------------------------------------------------------
    The following are for use by the legacy xmlrpc_parse_value().  They don't
    do proper memory management, so they aren't appropriate for general use,
@@ -0,0 +1,44 @@
+#ifndef COUNTER_INT_H_INCLUDED
+#define COUNTER_INT_H_INCLUDED
+
+/*============================================================================
+   A 64 bit statistics counter that many threads update.
+
+   Where the compiler provides an atomic add (HAVE_SYNC_FETCH_AND_ADD), an
+   update or read of the counter is a single atomic operation.  Elsewhere, a
+   lock the user supplies protects it.
+============================================================================*/
+
+#include "xmlrpc_config.h"
+#include "xmlrpc-c/lock.h"
+#include "int.h"
+
+/*
+  XMLRPC_UTIL_EXPORTED marks a symbol in this file that is exported from
+  libxmlrpc_util.
+
+  XMLRPC_BUILDING_UTIL says this compilation is part of libxmlrpc_util, as
+  opposed to something that _uses_ libxmlrpc_util.
+*/
+#ifdef XMLRPC_BUILDING_UTIL
+#define XMLRPC_UTIL_EXPORTED XMLRPC_DLLEXPORT
+#else
+#define XMLRPC_UTIL_EXPORTED
+#endif
+
+typedef struct {
+    volatile uint64_t value;
+} xmlrpc_counter;
+
+XMLRPC_UTIL_EXPORTED
+void
+xmlrpc_counterAdd(xmlrpc_counter * const counterP,
+                  lock *           const lockP,
+                  int64_t          const delta);
+
+XMLRPC_UTIL_EXPORTED
+uint64_t
+xmlrpc_counterValue(xmlrpc_counter * const counterP,
+                    lock *           const lockP);
+
+#endif
@@ -14,6 +14,7 @@
 #include <sys/types.h>
 #include <string>
 #include <queue>
+#include <vector>
 
 #include <xmlrpc-c/c_util.h>
 #include <xmlrpc-c/girmem.hpp>
@@ -122,6 +123,9 @@ public:
     readWait(bool *      const eofP,
              packetPtr * const packetPP);
 
+    void
+    readBuffered(std::vector<packetPtr> * const packetsP);
+
 private:
     packetSocket_impl * implP;
 };
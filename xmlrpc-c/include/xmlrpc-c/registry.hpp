@@ -62,10 +62,18 @@ public:
 
     std::string signature() const { return _signature; };
     std::string help() const { return _help; };
+    bool idempotent() const { return _idempotent; };
+    xmlrpc_priority priority() const { return _priority; };
 
 protected:
     std::string _signature;
     std::string _help;
+    bool _idempotent;
+        // A call with given parameters always has the same response, so
+        // the registry may cache it.  See xmlrpc_registry_mark_idempotent().
+    xmlrpc_priority _priority;
+        // Priority of calls of the method under the registry's scheduler.
+        // See xmlrpc_registry_set_method_priority().
 };
 
 /* Example of a specific method class:
@@ -126,6 +134,56 @@ public:
 
 };
 
+class XMLRPC_SERVERPP_EXPORTED callCompletion {
+/*----------------------------------------------------------------------------
+   The means by which an asynchronous method (class 'methodAsync')
+   finishes a call.
+
+   This is a handle; copies refer to the same call.  Exactly one of them
+   must get exactly one complete() or fail(), from any thread.  The handle
+   is meaningless after that.
+-----------------------------------------------------------------------------*/
+public:
+    callCompletion(xmlrpc_call_completion * const completionP);
+
+    void
+    complete(xmlrpc_c::value const& result) const;
+
+    void
+    fail(xmlrpc_c::fault const& fault) const;
+
+private:
+    xmlrpc_call_completion * completionP;
+};
+
+class XMLRPC_SERVERPP_EXPORTED methodAsync : public method {
+/*----------------------------------------------------------------------------
+   An XML-RPC method that need not have the result when its execute()
+   method returns.
+
+   This base class is abstract.  You can't create an object in it.
+   Define a useful method with this as a base class, with an execute()
+   method that finishes the call through 'completion', now or later.  It
+   may instead throw an error, as for any other method, to fail the call
+   immediately; it must not use 'completion' then.
+
+   'callInfoP' is valid until the call completes.
+-----------------------------------------------------------------------------*/
+public:
+    methodAsync();
+
+    virtual ~methodAsync();
+
+    virtual void
+    execute(xmlrpc_c::paramList        const& paramList,
+            const xmlrpc_c::callInfo * const  callInfoP,
+            xmlrpc_c::callCompletion   const& completion) = 0;
+
+    void
+    execute(xmlrpc_c::paramList const& paramList,
+            xmlrpc_c::value *   const  resultP);
+};
+
 class XMLRPC_SERVERPP_EXPORTED methodPtr : public girmem::autoObjectPtr {
 
 public:
@@ -178,6 +236,13 @@ public:
     addMethod(std::string         const name,
               xmlrpc_c::methodPtr const methodP);
 
+    void
+    replaceMethod(std::string         const name,
+                  xmlrpc_c::methodPtr const methodP);
+
+    void
+    removeMethod(std::string const& name);
+
     void
     setDefaultMethod(xmlrpc_c::defaultMethodPtr const methodP);
 
@@ -197,6 +262,42 @@ public:
 
     void
     setDialect(xmlrpc_dialect const dialect);
+
+    void
+    setSerializeThreads(unsigned int const threadCount);
+
+    void
+    setMulticallThreads(unsigned int const threadCount);
+
+    void
+    enableStatsMethod();
+
+    xmlrpc_method_stats
+    methodStats(std::string const& methodName) const;
+
+    void
+    setResponseCache(size_t       const maxBytes,
+                     unsigned int const ttlSecs);
+
+    void
+    setMethodLimit(std::string  const& methodName,
+                   unsigned int const  maxRunning,
+                   unsigned int const  maxWaiting);
+
+    void
+    setAdaptiveLimit(unsigned int const minLimit,
+                     unsigned int const maxLimit);
+
+    void
+    setCheckParams(bool const check);
+
+    void
+    setScheduler(unsigned int              const  maxRunning,
+                 std::vector<unsigned int> const& weights =
+                     std::vector<unsigned int>());
+
+    xmlrpc_priority_stats
+    priorityStats(xmlrpc_priority const priority) const;
     
     void
     processCall(std::string   const& callXml,
@@ -4,6 +4,7 @@
 #define  XMLRPC_SERVER_H_INCLUDED
 
 #include <xmlrpc-c/c_util.h>
+#include <xmlrpc-c/inttypes.h>
 #include <xmlrpc-c/base.h>
 
 #ifdef __cplusplus
@@ -42,8 +43,20 @@ typedef xmlrpc_value *
                   void *         const serverInfo,
                   void *         const callInfo);
 
+typedef struct xmlrpc_call_completion xmlrpc_call_completion;
+
+typedef void
+(*xmlrpc_method_async)(xmlrpc_env *             const envP,
+                       xmlrpc_value *           const paramArrayP,
+                       void *                   const serverInfo,
+                       void *                   const callInfo,
+                       xmlrpc_call_completion * const completionP);
+
 typedef xmlrpc_method1 xmlrpc_method;  /* backward compatibility */
 
+typedef void
+(*xmlrpc_server_info_release)(void * const serverInfo);
+
 typedef xmlrpc_value *
 (*xmlrpc_default_method)(xmlrpc_env *   const envP,
                          const char *   const callInfoP,
@@ -122,6 +135,84 @@ xmlrpc_registry_add_method3(
     xmlrpc_registry *                  const registryP,
     const struct xmlrpc_method_info3 * const infoP);
 
+struct xmlrpc_method_info_async {
+    const char *        methodName;
+    xmlrpc_method_async methodFunction;
+    void *              serverInfo;
+    size_t              stackSize;
+    const char *        signatureString;
+    const char *        help;
+};
+
+XMLRPC_SERVER_EXPORTED
+void
+xmlrpc_registry_add_method_async(
+    xmlrpc_env *                            const envP,
+    xmlrpc_registry *                       const registryP,
+    const struct xmlrpc_method_info_async * const infoP);
+
+XMLRPC_SERVER_EXPORTED
+void
+xmlrpc_registry_replace_method3(
+    xmlrpc_env *                       const envP,
+    xmlrpc_registry *                  const registryP,
+    const struct xmlrpc_method_info3 * const infoP);
+
+XMLRPC_SERVER_EXPORTED
+void
+xmlrpc_registry_replace_method_async(
+    xmlrpc_env *                            const envP,
+    xmlrpc_registry *                       const registryP,
+    const struct xmlrpc_method_info_async * const infoP);
+
+XMLRPC_SERVER_EXPORTED
+void
+xmlrpc_registry_add_method3_w_release(
+    xmlrpc_env *                       const envP,
+    xmlrpc_registry *                  const registryP,
+    const struct xmlrpc_method_info3 * const infoP,
+    xmlrpc_server_info_release               releaseFn);
+
+XMLRPC_SERVER_EXPORTED
+void
+xmlrpc_registry_add_method_async_w_release(
+    xmlrpc_env *                            const envP,
+    xmlrpc_registry *                       const registryP,
+    const struct xmlrpc_method_info_async * const infoP,
+    xmlrpc_server_info_release                    releaseFn);
+
+XMLRPC_SERVER_EXPORTED
+void
+xmlrpc_registry_replace_method3_w_release(
+    xmlrpc_env *                       const envP,
+    xmlrpc_registry *                  const registryP,
+    const struct xmlrpc_method_info3 * const infoP,
+    xmlrpc_server_info_release               releaseFn);
+
+XMLRPC_SERVER_EXPORTED
+void
+xmlrpc_registry_replace_method_async_w_release(
+    xmlrpc_env *                            const envP,
+    xmlrpc_registry *                       const registryP,
+    const struct xmlrpc_method_info_async * const infoP,
+    xmlrpc_server_info_release                    releaseFn);
+
+XMLRPC_SERVER_EXPORTED
+void
+xmlrpc_registry_remove_method(xmlrpc_env *      const envP,
+                              xmlrpc_registry * const registryP,
+                              const char *      const methodName);
+
+XMLRPC_SERVER_EXPORTED
+void
+xmlrpc_call_complete(xmlrpc_call_completion * const completionP,
+                     xmlrpc_value *           const resultP);
+
+XMLRPC_SERVER_EXPORTED
+void
+xmlrpc_call_complete_fault(xmlrpc_call_completion * const completionP,
+                           const xmlrpc_env *       const faultP);
+
 XMLRPC_SERVER_EXPORTED
 void
 xmlrpc_registry_set_default_method(xmlrpc_env *          const envP,
@@ -154,6 +245,134 @@ xmlrpc_registry_set_dialect(xmlrpc_env *      const envP,
                             xmlrpc_registry * const registryP,
                             xmlrpc_dialect    const dialect);
 
+XMLRPC_SERVER_EXPORTED
+void
+xmlrpc_registry_set_serialize_threads(xmlrpc_registry * const registryP,
+                                      unsigned int      const threadCount);
+
+XMLRPC_SERVER_EXPORTED
+void
+xmlrpc_registry_set_multicall_threads(xmlrpc_registry * const registryP,
+                                      unsigned int      const threadCount);
+
+/* A latency histogram in xmlrpc_method_stats has
+   XMLRPC_METHOD_STATS_BUCKETS counts.  Count 0 is of calls that took under
+   1 microsecond; count i is of calls that took at least 2^(i-1) and under
+   2^i microseconds, except the last one counts everything longer too.
+*/
+#define XMLRPC_METHOD_STATS_BUCKETS 24
+
+typedef struct {
+    xmlrpc_uint64_t calls;
+    xmlrpc_uint64_t faults;
+        /* Calls whose response is a fault */
+    xmlrpc_uint64_t totalUsec;
+        /* Total time of the calls, in microseconds.  A call's time is
+           from when the method starts executing until the XML-RPC response
+           is ready.
+        */
+    xmlrpc_uint64_t latency[XMLRPC_METHOD_STATS_BUCKETS];
+        /* Histogram of the calls' times */
+    xmlrpc_uint64_t callBytes;
+        /* Total size of the calls' XML.  Calls within a system.multicall
+           have none of their own.
+        */
+    xmlrpc_uint64_t responseBytes;
+        /* Total size of the responses' XML, likewise */
+} xmlrpc_method_stats;
+
+XMLRPC_SERVER_EXPORTED
+void
+xmlrpc_registry_get_method_stats(xmlrpc_env *          const envP,
+                                 xmlrpc_registry *     const registryP,
+                                 const char *          const methodName,
+                                 xmlrpc_method_stats * const statsP);
+
+XMLRPC_SERVER_EXPORTED
+void
+xmlrpc_registry_enable_stats_method(xmlrpc_env *      const envP,
+                                    xmlrpc_registry * const registryP);
+
+XMLRPC_SERVER_EXPORTED
+void
+xmlrpc_registry_set_response_cache(xmlrpc_env *      const envP,
+                                   xmlrpc_registry * const registryP,
+                                   size_t            const maxBytes,
+                                   unsigned int      const ttlSecs);
+
+XMLRPC_SERVER_EXPORTED
+void
+xmlrpc_registry_mark_idempotent(xmlrpc_env *      const envP,
+                                xmlrpc_registry * const registryP,
+                                const char *      const methodName);
+
+XMLRPC_SERVER_EXPORTED
+void
+xmlrpc_registry_set_method_limit(xmlrpc_env *      const envP,
+                                 xmlrpc_registry * const registryP,
+                                 const char *      const methodName,
+                                 unsigned int      const maxRunning,
+                                 unsigned int      const maxWaiting);
+
+XMLRPC_SERVER_EXPORTED
+void
+xmlrpc_registry_set_adaptive_limit(xmlrpc_env *      const envP,
+                                   xmlrpc_registry * const registryP,
+                                   unsigned int      const minLimit,
+                                   unsigned int      const maxLimit);
+
+XMLRPC_SERVER_EXPORTED
+void
+xmlrpc_registry_set_check_params(xmlrpc_registry * const registryP,
+                                 xmlrpc_bool       const check);
+
+typedef enum {
+    xmlrpc_priority_high,
+        /* Latency-sensitive calls, e.g. from an interactive user */
+    xmlrpc_priority_normal,
+    xmlrpc_priority_low
+        /* Bulk calls, whose latency matters little */
+} xmlrpc_priority;
+
+#define XMLRPC_PRIORITY_COUNT 3
+
+typedef struct {
+    xmlrpc_uint64_t calls;
+        /* Calls the scheduler has started */
+    xmlrpc_uint64_t waited;
+        /* Of those, calls that had to wait for their turn */
+    xmlrpc_uint64_t totalWaitUsec;
+    xmlrpc_uint64_t maxWaitUsec;
+        /* Total and longest time calls waited, in microseconds */
+    xmlrpc_uint64_t wait[XMLRPC_METHOD_STATS_BUCKETS];
+        /* Histogram of the calls' waits, like the latency histogram in
+           xmlrpc_method_stats.  A call that didn't wait counts in bucket 0.
+        */
+    unsigned int waiting;
+        /* Number of calls waiting now */
+} xmlrpc_priority_stats;
+
+XMLRPC_SERVER_EXPORTED
+void
+xmlrpc_registry_set_method_priority(xmlrpc_env *      const envP,
+                                    xmlrpc_registry * const registryP,
+                                    const char *      const methodName,
+                                    xmlrpc_priority   const priority);
+
+XMLRPC_SERVER_EXPORTED
+void
+xmlrpc_registry_set_scheduler(xmlrpc_env *         const envP,
+                              xmlrpc_registry *    const registryP,
+                              unsigned int         const maxRunning,
+                              const unsigned int * const weights);
+
+XMLRPC_SERVER_EXPORTED
+void
+xmlrpc_registry_get_priority_stats(xmlrpc_env *            const envP,
+                                   xmlrpc_registry *       const registryP,
+                                   xmlrpc_priority         const priority,
+                                   xmlrpc_priority_stats * const statsP);
+
 /*----------------------------------------------------------------------------
    Lower interface -- services to be used by an HTTP request handler
 -----------------------------------------------------------------------------*/
@@ -167,6 +386,20 @@ xmlrpc_registry_process_call2(xmlrpc_env *        const envP,
                               void *              const callInfo,
                               xmlrpc_mem_block ** const outputPP);
 
+typedef void xmlrpc_call_response_fn(void *             const context,
+                                     const xmlrpc_env * const envP,
+                                     xmlrpc_mem_block * const responseXmlP);
+
+XMLRPC_SERVER_EXPORTED
+void
+xmlrpc_registry_process_call_async(
+    xmlrpc_registry *         const registryP,
+    const char *              const xmlData,
+    size_t                    const xmlLen,
+    void *                    const callInfo,
+    xmlrpc_call_response_fn * const responseFn,
+    void *                    const responseContext);
+
 XMLRPC_SERVER_EXPORTED
 xmlrpc_mem_block *
 xmlrpc_registry_process_call(xmlrpc_env *      const envP,
@@ -100,6 +100,11 @@ typedef struct {
     socklen_t         sockaddrlen;
     unsigned int      max_conn;
     unsigned int      max_conn_backlog;
+    xmlrpc_bool       event_driven;
+    unsigned int      worker_threads;
+    unsigned int      acceptor_threads;
+    unsigned int      read_buffer_size;
+    const char *      stats_uri;
 } xmlrpc_server_abyss_parms;
 
 
@@ -188,6 +193,18 @@ xmlrpc_call_processor(xmlrpc_env *        const envP,
                       TSession *          const abyssSessionP,
                       xmlrpc_mem_block ** const responseXmlPP);
 
+typedef void
+xmlrpc_call_processor_async(void *                    const processorArg,
+                            const char *              const callXml,
+                            size_t                    const callXmlLen,
+                            TSession *                const abyssSessionP,
+                            xmlrpc_call_response_fn * const responseFn,
+                            void *                    const responseContext);
+    /* Like xmlrpc_call_processor, except it gives the response to
+       'responseFn', exactly once, maybe after it returns and from another
+       thread.  E.g. xmlrpc_registry_process_call_async().
+    */
+
 typedef struct {
     xmlrpc_call_processor * xml_processor;
     void *                  xml_processor_arg;
@@ -198,6 +215,12 @@ typedef struct {
         /* NULL means don't answer HTTP access control query */
     xmlrpc_bool             access_ctl_expires;
     unsigned int            access_ctl_max_age;
+    xmlrpc_call_processor_async * xml_processor_async;
+        /* Processor to use, with 'xml_processor_arg', where the Abyss
+           server can leave a call pending with no thread waiting for it
+           (an event-driven server).  NULL means always use
+           'xml_processor'.
+        */
 } xmlrpc_server_abyss_handler_parms;
 
 #define XMLRPC_AHPSIZE(MBRNAME) \
@@ -73,6 +73,11 @@ public:
         constrOpt & logFileName       (std::string    const& arg);
         constrOpt & serverOwnsSignals (bool           const& arg);
         constrOpt & expectSigchld     (bool           const& arg);
+        constrOpt & eventDriven       (bool           const& arg);
+        constrOpt & workerThreads     (unsigned int   const& arg);
+        constrOpt & acceptorThreads   (unsigned int   const& arg);
+        constrOpt & readBufferSize    (unsigned int   const& arg);
+        constrOpt & statsUri          (std::string    const& arg);
 
     private:
         struct constrOpt_impl * implP;
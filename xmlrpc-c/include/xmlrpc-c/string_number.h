@@ -27,6 +27,20 @@ xmlrpc_parse_int64(xmlrpc_env *   const envP,
                    const char *   const str,
                    xmlrpc_int64 * const i64P);
 
+/* The most characters xmlrpc_format_int64() generates: 19 digits and a sign
+*/
+#define XMLRPC_INT64_DECIMAL_MAX 20
+
+XMLRPC_UTIL_EXPORTED
+size_t
+xmlrpc_format_int64(char *       const buffer,
+                    xmlrpc_int64 const value);
+
+XMLRPC_UTIL_EXPORTED
+void
+xmlrpc_format_2digits(char *       const buffer,
+                      unsigned int const value);
+
 #ifdef __cplusplus
 }
 #endif
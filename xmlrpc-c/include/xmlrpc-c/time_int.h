@@ -34,6 +34,16 @@ XMLRPC_UTIL_EXPORTED
 void
 xmlrpc_gettimeofday(xmlrpc_timespec * const todP);
 
+XMLRPC_UTIL_EXPORTED
+uint64_t
+xmlrpc_usecBetween(xmlrpc_timespec const start,
+                   xmlrpc_timespec const end);
+
+XMLRPC_UTIL_EXPORTED
+unsigned int
+xmlrpc_latencyBucket(uint64_t     const usec,
+                     unsigned int const bucketCount);
+
 XMLRPC_UTIL_EXPORTED
 void
 xmlrpc_timegm(const struct tm  * const brokenTime,
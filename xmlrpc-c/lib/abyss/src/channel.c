@@ -195,3 +195,24 @@ ChannelFormatPeerInfo(TChannel *    const channelP,
     (*channelP->vtbl.formatPeerInfo)(channelP, peerStringP);
 }
 
+
+
+void
+ChannelOsSocket(TChannel *  const channelP,
+                bool *      const haveSocketP,
+                TOsSocket * const osSocketP) {
+/*----------------------------------------------------------------------------
+   Return the OS socket underlying channel *channelP, if there is one
+   through which one can tell when data is waiting to be read from the
+   channel.  *haveSocketP says whether there is.
+
+   The caller may poll the socket, and may write to it directly (e.g. with
+   sendfile()) because a channel that has an OS socket doesn't buffer
+   output.  Reading still goes through the channel.
+-----------------------------------------------------------------------------*/
+    if (channelP->vtbl.osSocket)
+        (*channelP->vtbl.osSocket)(channelP, haveSocketP, osSocketP);
+    else
+        *haveSocketP = FALSE;
+}
+
@@ -50,6 +50,10 @@ typedef void ChannelInterruptImpl(TChannel * const channelP);
 typedef void ChannelFormatPeerInfoImpl(TChannel *    const channelP,
                                        const char ** const peerStringP);
 
+typedef void ChannelOsSocketImpl(TChannel *  const channelP,
+                                 bool *      const haveSocketP,
+                                 TOsSocket * const osSocketP);
+
 struct TChannelVtbl {
     ChannelDestroyImpl            * destroy;
     ChannelWriteImpl              * write;
@@ -57,6 +61,11 @@ struct TChannelVtbl {
     ChannelWaitImpl               * wait;
     ChannelInterruptImpl          * interrupt;
     ChannelFormatPeerInfoImpl     * formatPeerInfo;
+    ChannelOsSocketImpl           * osSocket;
+        /* Null if the channel has no OS socket one could watch for
+           readability outside of the channel (e.g. with epoll).  Channel
+           types that predate this member leave it null.
+        */
 };
 
 struct _TChannel {
@@ -109,4 +118,9 @@ void
 ChannelFormatPeerInfo(TChannel *    const channelP,
                       const char ** const peerStringP);
 
+void
+ChannelOsSocket(TChannel *  const channelP,
+                bool *      const haveSocketP,
+                TOsSocket * const osSocketP);
+
 #endif
@@ -14,6 +14,7 @@
 #include "int.h"
 #include "mallocvar.h"
 #include "xmlrpc-c/util_int.h"
+#include "xmlrpc-c/string_int.h"
 #include "xmlrpc-c/abyss.h"
 #ifdef _WIN32
   #include "socket_win.h"
@@ -166,3 +167,27 @@ ChanSwitchInterrupt(TChanSwitch * const chanSwitchP) {
 
     (*chanSwitchP->vtbl.interrupt)(chanSwitchP);
 }
+
+
+
+void
+ChanSwitchCreateSibling(TChanSwitch *  const chanSwitchP,
+                        TChanSwitch ** const siblingPP,
+                        const char **  const errorP) {
+/*----------------------------------------------------------------------------
+   Create a channel switch that accepts connections at the same address as
+   *chanSwitchP, with the OS dividing new connections between the two.
+   Each can then have its own thread accepting connections.
+
+   Neither switch may be listening yet.
+-----------------------------------------------------------------------------*/
+    if (chanSwitchP->vtbl.createSibling) {
+        (*chanSwitchP->vtbl.createSibling)(chanSwitchP, siblingPP, errorP);
+
+        if (SwitchTraceIsActive && !*errorP)
+            fprintf(stderr, "Created channel switch %p as a sibling of "
+                    "channel switch %p\n", *siblingPP, chanSwitchP);
+    } else
+        xmlrpc_asprintf(errorP, "This kind of channel switch cannot share "
+                        "its address with another");
+}
@@ -28,11 +28,19 @@ typedef void SwitchAcceptImpl(TChanSwitch * const chanSwitchP,
 
 typedef void SwitchInterruptImpl(TChanSwitch * const chanSwitchP);
 
+typedef void SwitchCreateSiblingImpl(TChanSwitch *  const chanSwitchP,
+                                     TChanSwitch ** const siblingPP,
+                                     const char **  const errorP);
+
 struct TChanSwitchVtbl {
-    SwitchDestroyImpl   * destroy;
-    SwitchListenImpl    * listen;
-    SwitchAcceptImpl    * accept;
-    SwitchInterruptImpl * interrupt;
+    SwitchDestroyImpl       * destroy;
+    SwitchListenImpl        * listen;
+    SwitchAcceptImpl        * accept;
+    SwitchInterruptImpl     * interrupt;
+    SwitchCreateSiblingImpl * createSibling;
+        /* Null if the switch can't create another switch that shares its
+           address.  Switch types that predate this member leave it null.
+        */
 };
 
 struct _TChanSwitch {
@@ -73,6 +81,11 @@ ChanSwitchAccept(TChanSwitch * const chanSwitchP,
 void
 ChanSwitchInterrupt(TChanSwitch * const chanSwitchP);
 
+void
+ChanSwitchCreateSibling(TChanSwitch *  const chanSwitchP,
+                        TChanSwitch ** const siblingPP,
+                        const char **  const errorP);
+
 #endif
 
 
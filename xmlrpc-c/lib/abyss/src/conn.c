@@ -1,22 +1,33 @@
 /* Copyright information is at the end of the file. */
 
+#include "xmlrpc_config.h"
+
 #include <time.h>
 #include <string.h>
 #include <stdlib.h>
 #include <stdio.h>
 #include <ctype.h>
+#include <errno.h>
 #include <assert.h>
+#ifndef _WIN32
+  #include <unistd.h>
+#endif
+#if HAVE_SENDFILE
+  #include <sys/sendfile.h>
+#endif
 
 #include "bool.h"
 #include "mallocvar.h"
 #include "xmlrpc-c/util_int.h"
 #include "xmlrpc-c/string_int.h"
 #include "xmlrpc-c/sleep_int.h"
+#include "xmlrpc-c/time_int.h"
 #include "xmlrpc-c/abyss.h"
 #include "channel.h"
 #include "server.h"
 #include "thread.h"
 #include "file.h"
+#include "stats.h"
 
 #include "conn.h"
 
@@ -24,6 +35,23 @@
 ** Conn
 *********************************************************************/
 
+static void
+noteClosed(TConn * const connectionP) {
+/*----------------------------------------------------------------------------
+   Stop counting the connection as open in the server's statistics, if we
+   haven't already.
+-----------------------------------------------------------------------------*/
+    if (connectionP->countedOpen) {
+        TStats * const statsP = &connectionP->server->srvP->stats;
+
+        StatsAdd(statsP, &statsP->connectionsOpen, -1);
+
+        connectionP->countedOpen = FALSE;
+    }
+}
+
+
+
 static TThreadProc connJob;
 
 static void
@@ -48,7 +76,7 @@ connJob(void * const userHandle) {
 
 
     /* Note that ThreadExit() runs a cleanup function, which in our
-       case is connDone().
+       case is ConnDone().
     */
     ThreadExit(connectionP->threadP, 0);
 }
@@ -63,15 +91,59 @@ connJob(void * const userHandle) {
 
 
 static void
-connDone(TConn * const connectionP) {
+releaseChannel(TConn * const connectionP) {
+/*----------------------------------------------------------------------------
+   Note that the connection is done with its channel, then call its "done"
+   function, which typically destroys the channel.
+
+   We note it under the server's channel lock, so a ConnInterrupt() that
+   is in progress finishes with the channel before we destroy it, and any
+   later one leaves the channel alone.
+
+   Except with fork threads: then we run in a SIGCHLD handler, where we
+   can't take a lock.  There are no other threads then, and ConnInterrupt()
+   blocks SIGCHLD instead of taking the lock.
+-----------------------------------------------------------------------------*/
+    if (ThreadForks())
+        connectionP->channelGone = TRUE;
+    else {
+        lock * const channelLockP = connectionP->server->srvP->channelLockP;
+
+        channelLockP->acquire(channelLockP);
+
+        connectionP->channelGone = TRUE;
+
+        channelLockP->release(channelLockP);
+    }
+
+    if (connectionP->done)
+        connectionP->done(connectionP);
+}
+
+
+
+void
+ConnDone(TConn * const connectionP) {
+/*----------------------------------------------------------------------------
+   Do what has to be done once all processing on the connection is
+   complete: mark it finished, call its "done" function, and let the
+   server know.
+
+   ConnProcess() arranges for this to happen, so you need to call it only
+   if you process the connection some other way, i.e. not by running its
+   job function.
+-----------------------------------------------------------------------------*/
 
     /* In the forked case, this is designed to run in the parent
        process after the child has terminated.
     */
     connectionP->finished = TRUE;
 
-    if (connectionP->done)
-        connectionP->done(connectionP);
+    noteClosed(connectionP);
+
+    releaseChannel(connectionP);
+
+    ServerNoteConnFinished(connectionP->server);
 }
 
 
@@ -83,7 +155,35 @@ threadDone(void * const userHandle) {
 
     TConn * const connectionP = userHandle;
     
-    connDone(connectionP);
+    ConnDone(connectionP);
+}
+
+
+
+static TWorkerJobFn poolJob;
+
+static void
+poolJob(void * const arg) {
+/*----------------------------------------------------------------------------
+   This is the job a worker pool thread runs to process a connection.
+
+   Unlike connJob(), we return to the pool's thread when we're done.
+-----------------------------------------------------------------------------*/
+    TConn *   const connectionP = arg;
+    TServer * const serverP     = connectionP->server;
+
+    (connectionP->job)(connectionP);
+
+    noteClosed(connectionP);
+
+    releaseChannel(connectionP);
+
+    /* The creator may release the connection as soon as it sees this, so
+       it must be the last thing we do with the connection.
+    */
+    connectionP->finished = TRUE;
+
+    ServerNoteConnFinished(serverP);
 }
 
 
@@ -92,28 +192,37 @@ static void
 makeThread(TConn *             const connectionP,
            enum abyss_foreback const foregroundBackground,
            bool                const useSigchld,
+           TWorkerPool *       const poolP,
            size_t              const jobStackSize,
            const char **       const errorP) {
            
+    connectionP->poolP = NULL;
+
     switch (foregroundBackground) {
     case ABYSS_FOREGROUND:
         connectionP->hasOwnThread = FALSE;
         *errorP = NULL;
         break;
-    case ABYSS_BACKGROUND: {
-        const char * error;
-        connectionP->hasOwnThread = TRUE;
-        ThreadCreate(&connectionP->threadP, connectionP,
-                     &connJob, &threadDone, useSigchld,
-                     CONNJOB_STACK + jobStackSize,
-                     &error);
-        if (error) {
-            xmlrpc_asprintf(errorP, "Unable to create thread to "
-                            "process connection.  %s", error);
-            xmlrpc_strfree(error);
-        } else
+    case ABYSS_BACKGROUND:
+        if (poolP) {
+            connectionP->hasOwnThread = FALSE;
+            connectionP->poolP = poolP;
             *errorP = NULL;
-    } break;
+        } else {
+            const char * error;
+            connectionP->hasOwnThread = TRUE;
+            ThreadCreate(&connectionP->threadP, connectionP,
+                         &connJob, &threadDone, useSigchld,
+                         CONNJOB_STACK + jobStackSize,
+                         &error);
+            if (error) {
+                xmlrpc_asprintf(errorP, "Unable to create thread to "
+                                "process connection.  %s", error);
+                xmlrpc_strfree(error);
+            } else
+                *errorP = NULL;
+        }
+        break;
     } /* switch */
 }
 
@@ -129,6 +238,7 @@ ConnCreate(TConn **            const connectionPP,
            TThreadDoneFn *     const done,
            enum abyss_foreback const foregroundBackground,
            bool                const useSigchld,
+           TWorkerPool *       const poolP,
            const char **       const errorP) {
 /*----------------------------------------------------------------------------
    Create an HTTP connection.
@@ -147,6 +257,9 @@ ConnCreate(TConn **            const connectionPP,
    connection asynchronously to the creator, in the background, via a
    TThread thread.  'foregroundBackground' determines which.
 
+   A background connection runs on a thread of worker pool *poolP if
+   'poolP' is non-null, and on a thread of its own otherwise.
+
    'job' calls methods of the connection to get requests and send
    responses.
 
@@ -163,21 +276,50 @@ ConnCreate(TConn **            const connectionPP,
         xmlrpc_asprintf(errorP, "Unable to allocate memory for a connection "
                         "descriptor.");
     else {
-        connectionP->server       = serverP;
-        connectionP->channelP     = channelP;
-        connectionP->channelInfoP = channelInfoP;
-        connectionP->buffer.b[0]  = '\0';
-        connectionP->buffersize   = 0;
-        connectionP->bufferpos    = 0;
-        connectionP->finished     = FALSE;
-        connectionP->job          = job;
-        connectionP->done         = done;
-        connectionP->inbytes      = 0;
-        connectionP->outbytes     = 0;
-        connectionP->trace        = getenv("ABYSS_TRACE_CONN");
-
-        makeThread(connectionP, foregroundBackground, useSigchld,
-                   jobStackSize, errorP);
+        uint32_t const bufferSize = serverP->srvP->readBufferSize;
+
+        MALLOCARRAY(connectionP->buffer.b, bufferSize);
+
+        if (connectionP->buffer.b == NULL)
+            xmlrpc_asprintf(errorP, "Unable to allocate a %u-byte "
+                            "connection buffer", bufferSize);
+        else {
+            connectionP->server       = serverP;
+            connectionP->channelP     = channelP;
+            connectionP->channelInfoP = channelInfoP;
+            connectionP->buffer.b[0]  = '\0';
+            connectionP->buffersize   = 0;
+            connectionP->bufferpos    = 0;
+            connectionP->bufferAllocSize = bufferSize;
+            connectionP->bufferHeld   = 0;
+            connectionP->heldBuffer   = NULL;
+            connectionP->finished     = FALSE;
+            connectionP->job          = job;
+            connectionP->done         = done;
+            connectionP->channelGone  = FALSE;
+            connectionP->inbytes      = 0;
+            connectionP->outbytes     = 0;
+            connectionP->readTime     = 0;
+            connectionP->writeTime    = 0;
+            connectionP->countedOpen  = FALSE;
+            connectionP->eventConnP   = NULL;
+            connectionP->trace        = getenv("ABYSS_TRACE_CONN");
+
+            makeThread(connectionP, foregroundBackground, useSigchld, poolP,
+                       jobStackSize, errorP);
+
+            if (*errorP)
+                free(connectionP->buffer.b);
+            else {
+                TStats * const statsP = &serverP->srvP->stats;
+
+                StatsAdd(statsP, &statsP->connectionsOpen, 1);
+
+                connectionP->countedOpen = TRUE;
+            }
+        }
+        if (*errorP)
+            free(connectionP);
     }
     *connectionPP = connectionP;
 }
@@ -204,10 +346,14 @@ ConnProcess(TConn * const connectionP) {
         */
         assert(connectionP->threadP);
         retval = ThreadRun(connectionP->threadP);
+    } else if (connectionP->poolP) {
+        /* A worker pool thread will handle it, once one is free */
+        WorkerPoolSubmit(connectionP->poolP, &poolJob, connectionP);
+        retval = TRUE;
     } else {
         /* No background thread.  We just handle it here while Caller waits. */
         (connectionP->job)(connectionP);
-        connDone(connectionP);
+        ConnDone(connectionP);
         retval = TRUE;
     }
     return retval;
@@ -222,11 +368,46 @@ ConnWaitAndRelease(TConn * const connectionP) {
         assert(connectionP->threadP);
         ThreadWaitAndRelease(connectionP->threadP);
     }
+    noteClosed(connectionP);
+    ConnReleaseBuffer(connectionP);
+    free(connectionP->buffer.b);
     free(connectionP);
 }
 
 
 
+void
+ConnInterrupt(TConn * const connectionP) {
+/*----------------------------------------------------------------------------
+   Make the thread processing the connection stop waiting to read from or
+   write to its channel, if it is, and fail any later wait.
+
+   Any thread may call this, any time before the connection is released.
+   If the connection is already done with its channel, we do nothing,
+   since the channel may not exist anymore.
+
+   With fork threads, the connection releases its channel in a SIGCHLD
+   handler (see releaseChannel()), so we hold that off instead of taking
+   the channel lock, which the handler could find us holding.
+-----------------------------------------------------------------------------*/
+    lock * const channelLockP = connectionP->server->srvP->channelLockP;
+
+    if (ThreadForks())
+        ThreadHoldDone();
+    else
+        channelLockP->acquire(channelLockP);
+
+    if (!connectionP->channelGone)
+        ChannelInterrupt(connectionP->channelP);
+
+    if (ThreadForks())
+        ThreadReleaseDone();
+    else
+        channelLockP->release(channelLockP);
+}
+
+
+
 bool
 ConnKill(TConn * const connectionP) {
     connectionP->finished = TRUE;
@@ -237,15 +418,25 @@ ConnKill(TConn * const connectionP) {
 
 void
 ConnReadInit(TConn * const connectionP) {
+/*----------------------------------------------------------------------------
+   Discard what has been delivered from the connection buffer, except any
+   held part (see ConnHoldBuffer()), to make room for more.
+-----------------------------------------------------------------------------*/
+    uint32_t const held = connectionP->bufferHeld;
+
+    assert(connectionP->bufferpos >= held);
 
     if (connectionP->buffersize > connectionP->bufferpos) {
-        connectionP->buffersize -= connectionP->bufferpos;
-        memmove(connectionP->buffer.b,
+        uint32_t const unreadSize =
+            connectionP->buffersize - connectionP->bufferpos;
+
+        memmove(connectionP->buffer.b + held,
                 connectionP->buffer.b + connectionP->bufferpos,
-                connectionP->buffersize);
-        connectionP->bufferpos = 0;
+                unreadSize);
+        connectionP->buffersize = held + unreadSize;
+        connectionP->bufferpos  = held;
     } else
-        connectionP->buffersize = connectionP->bufferpos = 0;
+        connectionP->buffersize = connectionP->bufferpos = held;
 
     connectionP->buffer.b[connectionP->buffersize] = '\0';
 
@@ -356,14 +547,99 @@ traceChannelWrite(TConn *      const connectionP,
 
 
 
+static void
+countBytesIn(TConn *  const connectionP,
+             uint32_t const bytesRead) {
+
+    TStats * const statsP = &connectionP->server->srvP->stats;
+
+    connectionP->inbytes += bytesRead;
+
+    StatsAdd(statsP, &statsP->bytesIn, bytesRead);
+}
+
+
+
+static void
+countBytesOut(TConn *  const connectionP,
+              uint64_t const bytesWritten) {
+
+    TStats * const statsP = &connectionP->server->srvP->stats;
+
+    connectionP->outbytes += bytesWritten;
+
+    StatsAdd(statsP, &statsP->bytesOut, bytesWritten);
+}
+
+
+
+static void
+addTimeSince(uint64_t *      const totalP,
+             xmlrpc_timespec const startTime) {
+/*----------------------------------------------------------------------------
+   Add to *totalP the microseconds since 'startTime'.
+-----------------------------------------------------------------------------*/
+    xmlrpc_timespec now;
+
+    xmlrpc_gettimeofday(&now);
+
+    *totalP += xmlrpc_usecBetween(startTime, now);
+}
+
+
+
 static uint32_t
 bufferSpace(TConn * const connectionP) {
     
-    return BUFFER_SIZE - connectionP->buffersize;
+    return connectionP->bufferAllocSize - connectionP->buffersize;
 }
                     
 
 
+static void
+growBuffer(TConn *       const connectionP,
+           const char ** const errorP) {
+/*----------------------------------------------------------------------------
+   Make the connection buffer bigger, because it is full.
+-----------------------------------------------------------------------------*/
+    uint32_t const newSize =
+        MIN(connectionP->bufferAllocSize * 2, BUFFER_SIZE_MAX);
+
+    if (newSize <= connectionP->bufferAllocSize)
+        xmlrpc_asprintf(errorP, "Connection buffer is full (%u bytes)",
+                        connectionP->bufferAllocSize);
+    else {
+        unsigned char * newBuffer;
+
+        if (connectionP->bufferHeld > 0 && !connectionP->heldBuffer) {
+            /* There may be pointers into the held part of the buffer, so
+               it must stay where it is.
+            */
+            newBuffer = malloc(newSize);
+            if (newBuffer) {
+                memcpy(newBuffer, connectionP->buffer.b,
+                       connectionP->buffersize + 1);
+                connectionP->heldBuffer = connectionP->buffer.b;
+            }
+        } else {
+            /* Not REALLOCARRAY, because we keep the old buffer if we can't
+               get a new one.
+            */
+            newBuffer = realloc(connectionP->buffer.b, newSize);
+        }
+        if (newBuffer == NULL)
+            xmlrpc_asprintf(errorP, "Unable to allocate a %u-byte "
+                            "connection buffer", newSize);
+        else {
+            connectionP->buffer.b        = newBuffer;
+            connectionP->bufferAllocSize = newSize;
+            *errorP = NULL;
+        }
+    }
+}
+
+
+
 static void
 readFromChannel(TConn *       const connectionP,
                 bool *        const eofP,
@@ -372,23 +648,35 @@ readFromChannel(TConn *       const connectionP,
    Read some data from the channel of Connection *connectionP.
 
    Iff there is none available to read, return *eofP == true.
+
+   If the buffer is full, we make it bigger first, which may move it.
 -----------------------------------------------------------------------------*/
     uint32_t bytesRead;
     bool readError;
 
-    ChannelRead(connectionP->channelP,
-                connectionP->buffer.b + connectionP->buffersize,
-                bufferSpace(connectionP) - 1,
-                &bytesRead, &readError);
+    if (bufferSpace(connectionP) <= 1)
+        growBuffer(connectionP, errorP);
+    else
+        *errorP = NULL;
 
-    if (readError)
+    if (*errorP)
+        readError = TRUE;
+    else
+        ChannelRead(connectionP->channelP,
+                    connectionP->buffer.b + connectionP->buffersize,
+                    bufferSpace(connectionP) - 1,
+                    &bytesRead, &readError);
+
+    if (*errorP) {
+        /* Already failed */
+    } else if (readError)
         xmlrpc_asprintf(errorP, "Error reading from channel");
     else {
         *errorP = NULL;
         if (bytesRead > 0) {
             *eofP = FALSE;
             traceChannelRead(connectionP, bytesRead);
-            connectionP->inbytes += bytesRead;
+            countBytesIn(connectionP, bytesRead);
             connectionP->buffersize += bytesRead;
             connectionP->buffer.t[connectionP->buffersize] = '\0';
         } else
@@ -467,9 +755,12 @@ ConnRead(TConn *       const connectionP,
         bool const waitForRead  = TRUE;
         bool const waitForWrite = FALSE;
 
+        xmlrpc_timespec startTime;
         bool readyForRead;
         bool failed;
-            
+
+        xmlrpc_gettimeofday(&startTime);
+
         ChannelWait(connectionP->channelP, waitForRead, waitForWrite,
                     timeoutMs, &readyForRead, NULL, &failed);
             
@@ -493,6 +784,136 @@ ConnRead(TConn *       const connectionP,
             if (!*errorP)
                 dealWithReadEof(eofP, eof, errorP);
         }
+        addTimeSince(&connectionP->readTime, startTime);
+    }
+}
+
+
+
+void
+ConnReadAvailable(TConn *       const connectionP,
+                  bool *        const eofP,
+                  const char ** const errorP) {
+/*----------------------------------------------------------------------------
+   Read into the connection's buffer what has arrived on its channel, for
+   a caller that knows something has (data or end of file), so this
+   doesn't wait.
+
+   Return *eofP true iff the client has closed the connection.
+-----------------------------------------------------------------------------*/
+    xmlrpc_timespec startTime;
+
+    xmlrpc_gettimeofday(&startTime);
+
+    *eofP = FALSE;  /* In case we fail */
+
+    readFromChannel(connectionP, eofP, errorP);
+
+    addTimeSince(&connectionP->readTime, startTime);
+}
+
+
+            
+void
+ConnHoldBuffer(TConn *       const connectionP,
+               const char ** const heldP) {
+/*----------------------------------------------------------------------------
+   Keep everything in the connection buffer that has been delivered so far
+   (e.g. the header of an HTTP request, which has been parsed in place)
+   until ConnReleaseBuffer(), instead of letting ConnReadInit() discard it.
+
+   Return as *heldP a pointer to the held data.  It stays valid until
+   ConnReleaseBuffer(), even if the buffer grows in the meantime.
+-----------------------------------------------------------------------------*/
+    assert(connectionP->bufferHeld == 0);
+    assert(!connectionP->heldBuffer);
+
+    connectionP->bufferHeld = connectionP->bufferpos;
+
+    *heldP = connectionP->buffer.t;
+}
+
+
+
+void
+ConnReleaseBuffer(TConn * const connectionP) {
+/*----------------------------------------------------------------------------
+   Undo ConnHoldBuffer().
+-----------------------------------------------------------------------------*/
+    if (connectionP->heldBuffer) {
+        free(connectionP->heldBuffer);
+        connectionP->heldBuffer = NULL;
+    }
+    connectionP->bufferHeld = 0;
+}
+
+
+
+void
+ConnReadDirect(TConn *       const connectionP,
+               uint32_t      const timeout,
+               void *        const buffer,
+               uint32_t      const size,
+               uint32_t *    const bytesReadP,
+               const char ** const errorP) {
+/*----------------------------------------------------------------------------
+   Same as ConnRead() with null 'eofP' and 'timedOutP', except read into
+   'buffer', which is 'size' bytes, instead of into the connection's buffer,
+   and return the number of bytes read as *bytesReadP.
+
+   This is for reading a large request body in large pieces without copying
+   it through the connection's buffer.  The connection's buffer must be
+   empty, since what's in it precedes what we read.
+-----------------------------------------------------------------------------*/
+    uint32_t const timeoutMs = timeout * 1000;
+
+    assert(connectionP->bufferpos == connectionP->buffersize);
+
+    if (timeoutMs < timeout)
+        /* Arithmetic overflow */
+        xmlrpc_asprintf(errorP, "Timeout value is too large");
+    else {
+        bool const waitForRead  = TRUE;
+        bool const waitForWrite = FALSE;
+
+        xmlrpc_timespec startTime;
+        bool readyForRead;
+        bool failed;
+
+        xmlrpc_gettimeofday(&startTime);
+
+        ChannelWait(connectionP->channelP, waitForRead, waitForWrite,
+                    timeoutMs, &readyForRead, NULL, &failed);
+            
+        if (failed)
+            xmlrpc_asprintf(errorP,
+                            "Wait for stuff to arrive from client failed.");
+        else if (!readyForRead) {
+            traceReadTimeout(connectionP, timeout);
+            xmlrpc_asprintf(errorP, "Read from Abyss client "
+                            "connection timed out after %u seconds "
+                            "or was interrupted",
+                            timeout);
+        } else {
+            bool readError;
+
+            ChannelRead(connectionP->channelP, buffer, size,
+                        bytesReadP, &readError);
+
+            if (readError)
+                xmlrpc_asprintf(errorP, "Error reading from channel");
+            else if (*bytesReadP == 0)
+                xmlrpc_asprintf(errorP, "Read from Abyss client "
+                                "connection failed because client closed the "
+                                "connection");
+            else {
+                *errorP = NULL;
+                if (connectionP->trace)
+                    traceBuffer("READ FROM CHANNEL", buffer, *bytesReadP);
+                countBytesIn(connectionP, *bytesReadP);
+            }
+        }
+        addTimeSince(&connectionP->readTime, startTime);
     }
 }
 
@@ -503,54 +924,44 @@ ConnWrite(TConn *      const connectionP,
           const void * const buffer,
           uint32_t     const size) {
 
+    xmlrpc_timespec startTime;
     bool failed;
 
+    xmlrpc_gettimeofday(&startTime);
+
     ChannelWrite(connectionP->channelP, buffer, size, &failed);
 
+    addTimeSince(&connectionP->writeTime, startTime);
+
     traceChannelWrite(connectionP, buffer, size, failed);
 
     if (!failed)
-        connectionP->outbytes += size;
+        countBytesOut(connectionP, size);
 
     return !failed;
 }
 
 
 
-bool
-ConnWriteFromFile(TConn *       const connectionP,
-                  const TFile * const fileP,
-                  uint64_t      const start,
-                  uint64_t      const last,
-                  void *        const buffer,
-                  uint32_t      const buffersize,
-                  uint32_t      const rate) {
+static void
+writeFromFileByRead(TConn *       const connectionP,
+                    const TFile * const fileP,
+                    uint64_t      const start,
+                    uint64_t      const totalBytesToRead,
+                    void *        const buffer,
+                    uint32_t      const readChunkSize,
+                    uint32_t      const waittime,
+                    bool *        const successP) {
 /*----------------------------------------------------------------------------
-   Write the contents of the file stream *fileP, from offset 'start'
-   up through 'last', to the HTTP connection *connectionP.
-
-   Meter the reading so as not to read more than 'rate' bytes per second.
-
-   Use the 'bufferSize' bytes at 'buffer' as an internal buffer for this.
+   Do ConnWriteFromFile() the plain way: read the file into 'buffer' a
+   chunk at a time and write each chunk to the connection.
 -----------------------------------------------------------------------------*/
-    bool retval;
-    uint32_t waittime;
     bool success;
-    uint32_t readChunkSize;
-
-    if (rate > 0) {
-        readChunkSize = MIN(buffersize, rate);  /* One second's worth */
-        waittime = (1000 * buffersize) / rate;
-    } else {
-        readChunkSize = buffersize;
-        waittime = 0;
-    }
 
     success = FileSeek(fileP, start, SEEK_SET);
     if (!success)
-        retval = FALSE;
+        *successP = FALSE;
     else {
-        uint64_t const totalBytesToRead = last - start + 1;
         uint64_t bytesread;
 
         bytesread = 0;  /* initial value */
@@ -575,8 +986,149 @@ ConnWriteFromFile(TConn *       const connectionP,
             if (waittime > 0)
                 xmlrpc_millisecond_sleep(waittime);
         }
-        retval = (bytesread >= totalBytesToRead);
+        *successP = (bytesread >= totalBytesToRead);
+    }
+}
+
+
+
+#if HAVE_SENDFILE
+
+static void
+writeFromFileBySendfile(TConn *       const connectionP,
+                        TOsSocket     const osSocket,
+                        const TFile * const fileP,
+                        uint64_t      const start,
+                        uint64_t      const totalBytesToSend,
+                        uint32_t      const chunkSize,
+                        uint32_t      const waittime,
+                        bool *        const doneP,
+                        bool *        const successP) {
+/*----------------------------------------------------------------------------
+   Do ConnWriteFromFile() with sendfile(), which has the kernel copy file
+   pages straight to the socket 'osSocket' underlying the connection's
+   channel, so the data never passes through our memory.
+
+   'chunkSize' == 0 means no limit on how much to send at a time.
+
+   Return *doneP false if the kernel can't sendfile() this file (so we
+   have sent nothing and the caller should do it another way).
+-----------------------------------------------------------------------------*/
+    size_t const maxSend = 0x7ffff000;
+        /* The most Linux sendfile() transfers in one call */
+
+    off_t offset;
+    uint64_t bytesSent;
+    bool failed;
+    bool unsupported;
+
+    offset      = start;
+    bytesSent   = 0;
+    failed      = FALSE;
+    unsupported = FALSE;
+
+    while (bytesSent < totalBytesToSend && !failed && !unsupported) {
+        uint64_t const bytesLeft = totalBytesToSend - bytesSent;
+        size_t const bytesToSend =
+            (size_t)MIN(chunkSize > 0 ? chunkSize : maxSend, bytesLeft);
+
+        xmlrpc_timespec startTime;
+        ssize_t rc;
+
+        xmlrpc_gettimeofday(&startTime);
+
+        rc = sendfile(osSocket, fileP->fd, &offset, bytesToSend);
+
+        addTimeSince(&connectionP->writeTime, startTime);
+
+        if (rc < 0) {
+            if (errno == EINTR) {
+                /* Just try again */
+            } else if (bytesSent == 0 && (errno == EINVAL || errno == ENOSYS))
+                unsupported = TRUE;
+            else
+                failed = TRUE;
+        } else if (rc == 0)
+            failed = TRUE;  /* File is shorter than caller said */
+        else {
+            bytesSent += rc;
+            countBytesOut(connectionP, rc);
+
+            if (waittime > 0)
+                xmlrpc_millisecond_sleep(waittime);
+        }
     }
+    *doneP    = !unsupported;
+    *successP = !failed && !unsupported;
+}
+
+#endif  /* HAVE_SENDFILE */
+
+
+
+bool
+ConnWriteFromFile(TConn *       const connectionP,
+                  const TFile * const fileP,
+                  uint64_t      const start,
+                  uint64_t      const last,
+                  void *        const buffer,
+                  uint32_t      const buffersize,
+                  uint32_t      const rate) {
+/*----------------------------------------------------------------------------
+   Write the contents of the file stream *fileP, from offset 'start'
+   up through 'last', to the HTTP connection *connectionP.
+
+   Meter the reading so as not to read more than 'rate' bytes per second.
+
+   Use the 'bufferSize' bytes at 'buffer' as an internal buffer for this.
+
+   Where we can, we don't copy the file through 'buffer': on a plain
+   channel with an OS socket under it (not, for example, an SSL
+   connection), we use sendfile().  If the file is shorter than the caller
+   says, because it shrank while we worked, we fail.
+-----------------------------------------------------------------------------*/
+    uint64_t const totalBytesToRead = last - start + 1;
+
+    bool retval;
+    uint32_t waittime;
+    uint32_t readChunkSize;
+    uint32_t sendfileChunkSize;
+        /* How much to send at a time with sendfile(); zero means no limit */
+    bool done;
+
+    if (rate > 0) {
+        readChunkSize = MIN(buffersize, rate);  /* One second's worth */
+        waittime = (1000 * buffersize) / rate;
+        sendfileChunkSize = readChunkSize;
+    } else {
+        readChunkSize = buffersize;
+        waittime = 0;
+        sendfileChunkSize = 0;
+    }
+
+    done = FALSE;
+
+#if HAVE_SENDFILE
+    if (!connectionP->trace) {
+        /* With sendfile(), the data never passes through us, so we couldn't
+           trace it.
+        */
+        bool haveOsSocket;
+        TOsSocket osSocket;
+
+        ChannelOsSocket(connectionP->channelP, &haveOsSocket, &osSocket);
+
+        if (haveOsSocket)
+            writeFromFileBySendfile(connectionP, osSocket, fileP,
+                                    start, totalBytesToRead,
+                                    sendfileChunkSize, waittime,
+                                    &done, &retval);
+    }
+#endif
+    if (!done)
+        writeFromFileByRead(connectionP, fileP, start, totalBytesToRead,
+                            buffer, readChunkSize, waittime, &retval);
+
     return retval;
 }
 
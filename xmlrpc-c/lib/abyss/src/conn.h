@@ -4,10 +4,19 @@
 #include "bool.h"
 #include "xmlrpc-c/abyss.h"
 #include "thread.h"
+#include "workerpool.h"
 
 struct TFile;
+struct eventConn;
 
 #define BUFFER_SIZE 4096 
+    /* The default size of a connection's read buffer */
+
+#define BUFFER_SIZE_MAX (64*1024)
+    /* The size to which we will grow a connection's read buffer when it
+       fills up, e.g. with a long HTTP header.  We don't grow one that
+       starts out at least this big.
+    */
 
 struct _TConn {
     struct _TConn * nextOutstandingP;
@@ -19,11 +28,35 @@ struct _TConn {
         /* Index into the connection buffer (buffer[], below) where
            the next byte read on the connection will go.
         */
+    uint32_t bufferAllocSize;
+        /* Size of the connection buffer (buffer[], below).  It may grow
+           while the connection is in use, so don't keep pointers into it
+           across reads.
+        */
     uint32_t bufferpos;
         /* Index into the connection buffer (buffer[], below) where
            the next byte to be delivered to the user is.
         */
+    uint32_t bufferHeld;
+        /* The first 'bufferHeld' bytes of the connection buffer are in
+           use, e.g. as the header of the HTTP request being processed, so
+           ConnReadInit() must not discard them.  See ConnHoldBuffer().
+        */
+    unsigned char * heldBuffer;
+        /* The connection buffer as it was when ConnHoldBuffer() was
+           called, if it has since been replaced by a bigger one; otherwise
+           NULL.  We keep it until ConnReleaseBuffer() because there may be
+           pointers into its held part.
+        */
     uint32_t inbytes,outbytes;  
+    uint64_t readTime;
+    uint64_t writeTime;
+        /* Microseconds spent waiting for and reading data from the channel
+           and writing data to it since someone last zeroed these.  The
+           server does at the start of each request.
+        */
+    bool countedOpen;
+        /* The connection counts as open in the server's statistics */
     TChannel * channelP;
     void * channelInfoP;
         /* Information about the channel, such as who is on the other end.
@@ -35,6 +68,15 @@ struct _TConn {
         */
     bool hasOwnThread;
     TThread * threadP;
+        /* Meaningful only if 'hasOwnThread' */
+    TWorkerPool * poolP;
+        /* The worker pool that runs the connection's job in the
+           background.  NULL if it isn't run by a worker pool.
+        */
+    struct eventConn * eventConnP;
+        /* The event loop's descriptor of the connection, if an event loop
+           serves it.  The event loop sets this.
+        */
     bool finished;
         /* We have done all the processing there is to do on this
            connection, other than possibly notifying someone that we're
@@ -52,9 +94,14 @@ struct _TConn {
            is done with the connection, exits.
         */
     TThreadDoneFn * done;
+    bool channelGone;
+        /* The connection is done with its channel; its 'done' function may
+           have destroyed it.  Protected by the server's 'channelLockP',
+           or with fork threads, by ThreadHoldDone().
+        */
     union {
-        unsigned char b[BUFFER_SIZE];  /* Just bytes */
-        char          t[BUFFER_SIZE];  /* Taken as text */
+        unsigned char * b;  /* Just bytes */
+        char *          t;  /* Taken as text */
     } buffer;
 };
 
@@ -74,6 +121,7 @@ ConnCreate(TConn **            const connectionPP,
            TThreadDoneFn *     const done,
            enum abyss_foreback const foregroundBackground,
            bool                const useSigchld,
+           TWorkerPool *       const poolP,
            const char **       const errorP);
 
 bool
@@ -82,6 +130,12 @@ ConnProcess(TConn * const connectionP);
 bool
 ConnKill(TConn * const connectionP);
 
+void
+ConnDone(TConn * const connectionP);
+
+void
+ConnInterrupt(TConn * const connectionP);
+
 void
 ConnWaitAndRelease(TConn * const connectionP);
 
@@ -97,9 +151,29 @@ ConnRead(TConn *       const connectionP,
          bool *        const timedOutP,
          const char ** const errorP);
 
+void
+ConnReadAvailable(TConn *       const connectionP,
+                  bool *        const eofP,
+                  const char ** const errorP);
+
 void
 ConnReadInit(TConn * const connectionP);
 
+void
+ConnHoldBuffer(TConn *       const connectionP,
+               const char ** const heldP);
+
+void
+ConnReleaseBuffer(TConn * const connectionP);
+
+void
+ConnReadDirect(TConn *       const connectionP,
+               uint32_t      const timeout,
+               void *        const buffer,
+               uint32_t      const size,
+               uint32_t *    const bytesReadP,
+               const char ** const errorP);
+
 bool
 ConnWriteFromFile(TConn *              const connectionP,
                   const struct TFile * const fileP,
@@ -148,7 +148,12 @@ ListRemove(TList * const sl) {
 bool
 ListAddFromString(TList *      const list,
                   const char * const stringArg) {
+/*----------------------------------------------------------------------------
+   Add to the list each of the comma-separated tokens of 'stringArg'.
 
+   The items are newly malloc'ed copies of the tokens, so the list should
+   be one that frees its items.
+-----------------------------------------------------------------------------*/
     bool retval;
     
     if (!stringArg)
@@ -183,11 +188,19 @@ ListAddFromString(TList *      const list,
                         *p = '\0';
                     
                     if (t[0] != '\0') {
-                        bool added;
-                        added = ListAdd(list, (void*)t);
-                        
-                        if (!added)
+                        char * const item = strdup(t);
+
+                        if (!item)
                             error = TRUE;
+                        else {
+                            bool added;
+                            added = ListAdd(list, item);
+
+                            if (!added) {
+                                free(item);
+                                error = TRUE;
+                            }
+                        }
                     }
                 }
             }
@@ -317,11 +330,12 @@ StringAlloc(TString * const stringP) {
 
 
 bool
-StringConcat(TString *    const stringP,
-             const char * const string2) {
-
-    uint32_t const len = strlen(string2);
-
+StringConcatN(TString *       const stringP,
+              const char *    const string2,
+              xmlrpc_uint32_t const len) {
+/*----------------------------------------------------------------------------
+   Append the 'len' characters at 'string2' to *stringP.
+-----------------------------------------------------------------------------*/
     if (len + stringP->size + 1 > stringP->buffer.size) {
         bool succeeded;
         succeeded = BufferRealloc(
@@ -330,13 +344,23 @@ StringConcat(TString *    const stringP,
         if (!succeeded)
             return FALSE;
     }
-    strcat((char *)(stringP->buffer.data), string2);
+    memcpy((char *)(stringP->buffer.data) + stringP->size, string2, len);
     stringP->size += len;
+    ((char *)(stringP->buffer.data))[stringP->size] = '\0';
     return TRUE;
 }
 
 
 
+bool
+StringConcat(TString *    const stringP,
+             const char * const string2) {
+
+    return StringConcatN(stringP, string2, strlen(string2));
+}
+
+
+
 bool
 StringBlockConcat(TString *    const stringP,
                   const char * const string2,
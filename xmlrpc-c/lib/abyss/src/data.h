@@ -46,6 +46,11 @@ bool
 StringConcat(TString *    const stringP,
              const char * const string2);
 
+bool
+StringConcatN(TString *       const stringP,
+              const char *    const string2,
+              xmlrpc_uint32_t const len);
+
 bool
 StringBlockConcat(TString *    const stringP,
                   const char * const string2,
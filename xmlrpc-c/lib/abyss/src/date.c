@@ -30,24 +30,47 @@ static char *_DateMonth[12]=
 
 
 void
-DateToString(time_t        const datetime,
-             const char ** const dateStringP) {
-
+DateFormat(time_t const datetime,
+           char * const buffer,
+           bool * const validP) {
+/*----------------------------------------------------------------------------
+   Format 'datetime' as for an HTTP header, in the DATE_STRING_SIZE bytes
+   at 'buffer'.  Return *validP false if it can't be formatted.
+-----------------------------------------------------------------------------*/
     struct tm brokenTime;
 
     xmlrpc_gmtime(datetime, &brokenTime);
 
     if (mktime(&brokenTime) == (time_t)-1)
-        *dateStringP = NULL;
+        *validP = FALSE;
+    else {
+        sprintf(buffer, "%s, %02u %s %04u %02u:%02u:%02u UTC",
+                _DateDay[brokenTime.tm_wday],
+                brokenTime.tm_mday,
+                _DateMonth[brokenTime.tm_mon],
+                1900 + brokenTime.tm_year,
+                brokenTime.tm_hour,
+                brokenTime.tm_min,
+                brokenTime.tm_sec);
+        *validP = TRUE;
+    }
+}
+
+
+
+void
+DateToString(time_t        const datetime,
+             const char ** const dateStringP) {
+
+    char buffer[DATE_STRING_SIZE];
+    bool valid;
+
+    DateFormat(datetime, buffer, &valid);
+
+    if (valid)
+        *dateStringP = xmlrpc_strdupsol(buffer);
     else
-        xmlrpc_asprintf(dateStringP, "%s, %02u %s %04u %02u:%02u:%02u UTC",
-                        _DateDay[brokenTime.tm_wday],
-                        brokenTime.tm_mday,
-                        _DateMonth[brokenTime.tm_mon],
-                        1900 + brokenTime.tm_year,
-                        brokenTime.tm_hour,
-                        brokenTime.tm_min,
-                        brokenTime.tm_sec);
+        *dateStringP = NULL;
 }
 
 
@@ -5,6 +5,14 @@
 
 #include "bool.h"
 
+#define DATE_STRING_SIZE 40
+    /* Enough for any DateFormat() result, including the terminating NUL */
+
+void
+DateFormat(time_t const datetime,
+           char * const buffer,
+           bool * const validP);
+
 void
 DateToString(time_t        const datetime,
              const char ** const dateStringP);
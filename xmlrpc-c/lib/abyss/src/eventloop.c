@@ -0,0 +1,1203 @@
+/*=============================================================================
+                                  eventloop.c
+===============================================================================
+  This is the event loop with which an Abyss server can serve a great many
+  mostly idle connections with a few threads.  See eventloop.h.
+
+  There is one watcher thread and a fixed set of worker threads.  Each
+  connection the event loop owns is in one of six states:
+
+    idle:     Waiting for a request to start arriving.  It is in the idle
+              list and its socket is armed in the epoll set.
+    reading:  Part of a request has arrived.  It is in the reading list and
+              its socket is armed in the epoll set.
+    ready:    A whole request has arrived.  It is in the ready queue
+              waiting for a worker.
+    busy:     A worker is processing requests on it.
+    deferred: A request handler deferred its response, and no thread is
+              working on the connection until the response is complete
+              and someone calls EventLoopResumeConn().
+    abandoned: Still deferred when the event loop was destroyed and gave
+              up waiting for it.  EventLoopResumeConn() just closes it.
+
+  The watcher reads what arrives on idle and reading connections into the
+  connection buffer, and only when a whole request is there (see
+  RequestIsBuffered()) does it queue the connection for a worker.  So a
+  worker never waits for a client that sends its request slowly.
+
+  The socket is registered for one-shot notification, so once epoll
+  reports it, nothing but the watcher, then the worker that gets the
+  connection, touches it until the worker arms it again.  That way no two
+  threads ever read from the same connection.
+
+  The watcher also closes connections that have been idle longer than the
+  idle timeout, or have been sending a request for longer than the request
+  timeout.
+=============================================================================*/
+
+#include "xmlrpc_config.h"
+
+#include <stdlib.h>
+#include <time.h>
+#include <assert.h>
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+#if HAVE_EPOLL
+  #include <sys/epoll.h>
+  #include <sys/eventfd.h>
+#endif
+
+#include "bool.h"
+#include "int.h"
+#include "c_util.h"
+#include "girmath.h"
+#include "mallocvar.h"
+#include "xmlrpc-c/string_int.h"
+#include "xmlrpc-c/sleep_int.h"
+#include "xmlrpc-c/lock.h"
+#include "xmlrpc-c/lock_platform.h"
+#include "xmlrpc-c/abyss.h"
+
+#include "trace.h"
+#include "thread.h"
+#include "channel.h"
+#include "conn.h"
+#include "http.h"
+
+#include "eventloop.h"
+
+
+
+#if HAVE_EPOLL
+
+enum connState {CONN_IDLE, CONN_READING, CONN_READY, CONN_BUSY,
+                CONN_DEFERRED, CONN_ABANDONED};
+
+struct eventConn {
+    struct eventLoop * eventLoopP;
+    TConn * connectionP;
+    TOsSocket fd;
+    enum connState state;
+    unsigned int requestCount;
+        /* Number of requests processed on this connection so far */
+    time_t waitingSince;
+        /* Meaningful only in idle and reading state: when the connection
+           entered that state
+        */
+    bool resumed;
+        /* Meaningful only in busy state: someone called
+           EventLoopResumeConn() before the worker that parked the
+           connection had a chance to put it in deferred state, so the
+           worker should act on that instead.
+        */
+    bool resumeDone;
+    bool resumeBuffered;
+        /* Meaningful only if 'resumed': the arguments of that
+           EventLoopResumeConn()
+        */
+    struct eventConn * prevP;
+    struct eventConn * nextP;
+        /* Links in the list of all connections */
+    struct eventConn * prevIdleP;
+    struct eventConn * nextIdleP;
+        /* Links in the idle or reading list (idle or reading state) or ready
+           queue (ready state; 'prevIdleP' is unused)
+        */
+};
+
+struct waitList {
+/*----------------------------------------------------------------------------
+   A list of connections waiting for something to arrive, in the order they
+   started waiting.
+-----------------------------------------------------------------------------*/
+    struct eventConn * headP;
+    struct eventConn * tailP;
+};
+
+struct eventLoop {
+    int epollFd;
+    int stopFd;
+        /* An eventfd in the epoll set that tells the watcher to quit */
+    int readyFd;
+        /* An eventfd semaphore with a count for every connection added to
+           the ready queue and one for every worker when we're stopping.
+           The workers wait on it.
+        */
+    lock * lockP;
+        /* Protects everything below */
+    bool terminating;
+    bool destroyed;
+        /* EventLoopDestroy() is through, except for the connections it
+           abandoned.  The last of those to be resumed destroys the lock
+           and frees the event loop descriptor.
+        */
+    unsigned int abandonedCount;
+        /* Number of connections in abandoned state */
+    struct eventConn * firstP;
+        /* List of all the connections the event loop owns */
+    struct waitList idle;
+        /* The idle connections */
+    struct waitList reading;
+        /* The connections on which part of a request has arrived */
+    struct eventConn * readyHeadP;
+    struct eventConn * readyTailP;
+        /* The ready connections, in the order they became ready */
+
+    uint32_t idleTimeout;
+    uint32_t requestTimeout;
+    TEventLoopServeFn * serveFn;
+    TThread * watcherP;
+    TThread ** workers;
+    unsigned int workerCount;
+        /* Number of entries of workers[] that are running threads */
+};
+
+
+
+static void
+addToList(struct eventLoop * const eventLoopP,
+          struct eventConn * const connP) {
+
+    connP->prevP = NULL;
+    connP->nextP = eventLoopP->firstP;
+    if (eventLoopP->firstP)
+        eventLoopP->firstP->prevP = connP;
+    eventLoopP->firstP = connP;
+}
+
+
+
+static void
+removeFromList(struct eventLoop * const eventLoopP,
+               struct eventConn * const connP) {
+
+    if (connP->prevP)
+        connP->prevP->nextP = connP->nextP;
+    else
+        eventLoopP->firstP = connP->nextP;
+    if (connP->nextP)
+        connP->nextP->prevP = connP->prevP;
+}
+
+
+
+static void
+addToWaitList(struct waitList *  const listP,
+              struct eventConn * const connP) {
+
+    connP->waitingSince = time(NULL);
+    connP->nextIdleP = NULL;
+    connP->prevIdleP = listP->tailP;
+    if (listP->tailP)
+        listP->tailP->nextIdleP = connP;
+    else
+        listP->headP = connP;
+    listP->tailP = connP;
+}
+
+
+
+static void
+removeFromWaitList(struct waitList *  const listP,
+                   struct eventConn * const connP) {
+
+    if (connP->prevIdleP)
+        connP->prevIdleP->nextIdleP = connP->nextIdleP;
+    else
+        listP->headP = connP->nextIdleP;
+    if (connP->nextIdleP)
+        connP->nextIdleP->prevIdleP = connP->prevIdleP;
+    else
+        listP->tailP = connP->prevIdleP;
+}
+
+
+
+static void
+addToIdle(struct eventLoop * const eventLoopP,
+          struct eventConn * const connP) {
+
+    connP->state = CONN_IDLE;
+
+    addToWaitList(&eventLoopP->idle, connP);
+}
+
+
+
+static void
+addToReading(struct eventLoop * const eventLoopP,
+             struct eventConn * const connP) {
+
+    connP->state = CONN_READING;
+
+    addToWaitList(&eventLoopP->reading, connP);
+}
+
+
+
+static void
+removeFromWaiting(struct eventLoop * const eventLoopP,
+                  struct eventConn * const connP) {
+/*----------------------------------------------------------------------------
+   Take connection *connP, which is idle or reading, out of its list.
+-----------------------------------------------------------------------------*/
+    assert(connP->state == CONN_IDLE || connP->state == CONN_READING);
+
+    removeFromWaitList(connP->state == CONN_IDLE ?
+                       &eventLoopP->idle : &eventLoopP->reading,
+                       connP);
+}
+
+
+
+static void
+addToReady(struct eventLoop * const eventLoopP,
+           struct eventConn * const connP) {
+
+    connP->state     = CONN_READY;
+    connP->nextIdleP = NULL;
+    if (eventLoopP->readyTailP)
+        eventLoopP->readyTailP->nextIdleP = connP;
+    else
+        eventLoopP->readyHeadP = connP;
+    eventLoopP->readyTailP = connP;
+}
+
+
+
+static struct eventConn *
+takeFromReady(struct eventLoop * const eventLoopP) {
+
+    struct eventConn * const connP = eventLoopP->readyHeadP;
+
+    if (connP) {
+        eventLoopP->readyHeadP = connP->nextIdleP;
+        if (!eventLoopP->readyHeadP)
+            eventLoopP->readyTailP = NULL;
+        connP->state   = CONN_BUSY;
+        connP->resumed = FALSE;
+    }
+    return connP;
+}
+
+
+
+static void
+armConn(struct eventLoop * const eventLoopP,
+        struct eventConn * const connP,
+        int                const op,
+        const char **      const errorP) {
+/*----------------------------------------------------------------------------
+   Have epoll tell the watcher, once, when connection *connP has something
+   to read.  'op' is EPOLL_CTL_ADD for a connection not yet in the epoll set
+   and EPOLL_CTL_MOD for one already there.
+-----------------------------------------------------------------------------*/
+    struct epoll_event event;
+    int rc;
+
+    event.events   = EPOLLIN | EPOLLONESHOT;
+    event.data.ptr = connP;
+
+    rc = epoll_ctl(eventLoopP->epollFd, op, connP->fd, &event);
+
+    if (rc != 0)
+        xmlrpc_asprintf(errorP, "epoll_ctl() failed.  errno=%d (%s)",
+                        errno, strerror(errno));
+    else
+        *errorP = NULL;
+}
+
+
+
+static void
+closeConn(struct eventConn * const connP) {
+/*----------------------------------------------------------------------------
+   Close a connection that is no longer in any of the event loop's lists.
+-----------------------------------------------------------------------------*/
+    ConnDone(connP->connectionP);
+
+    ConnWaitAndRelease(connP->connectionP);
+
+    free(connP);
+}
+
+
+
+static void
+signalReady(int      const fd,
+            uint64_t const count) {
+
+    ssize_t rc;
+
+    rc = write(fd, &count, sizeof(count));
+
+    /* The only way this can fail is overflowing a 64 bit counter */
+    if (rc != sizeof(count))
+        TraceMsg("Write to eventfd failed.  errno=%d (%s)",
+                 errno, strerror(errno));
+}
+
+
+
+static void
+gatherRequest(struct eventLoop * const eventLoopP,
+              struct eventConn * const connP,
+              bool *             const readyP) {
+/*----------------------------------------------------------------------------
+   Read what has arrived on connection *connP, which is idle or reading and
+   for which epoll just reported something to read.  If that completes a
+   request, move the connection to the ready queue.  Otherwise, put it in
+   reading state and have epoll watch it again.
+
+   If the client closed the connection or the read failed, move the
+   connection to the ready queue too; the worker discovers what happened
+   and closes it.
+
+   Return *readyP true iff we moved the connection to the ready queue.
+
+   Only the watcher thread touches an idle or reading connection, so we
+   can read from it without holding the lock.
+-----------------------------------------------------------------------------*/
+    TConn * const connectionP = connP->connectionP;
+
+    const char * error;
+    bool eof;
+    bool ready;
+
+    ConnReadAvailable(connectionP, &eof, &error);
+
+    if (error) {
+        xmlrpc_strfree(error);
+        ready = TRUE;
+    } else
+        ready = eof || RequestIsBuffered(connectionP);
+
+    eventLoopP->lockP->acquire(eventLoopP->lockP);
+
+    if (!ready) {
+        const char * armError;
+
+        if (connP->state == CONN_IDLE) {
+            /* The request timeout starts now */
+            removeFromWaiting(eventLoopP, connP);
+            addToReading(eventLoopP, connP);
+        }
+        armConn(eventLoopP, connP, EPOLL_CTL_MOD, &armError);
+
+        if (armError) {
+            /* We can't wait for the rest, so let a worker do it */
+            xmlrpc_strfree(armError);
+            ready = TRUE;
+        }
+    }
+    if (ready) {
+        removeFromWaiting(eventLoopP, connP);
+        addToReady(eventLoopP, connP);
+    }
+    eventLoopP->lockP->release(eventLoopP->lockP);
+
+    *readyP = ready;
+}
+
+
+
+static void
+dispatchEvents(struct eventLoop *         const eventLoopP,
+               const struct epoll_event * const events,
+               int                        const eventCount,
+               bool *                     const stopP) {
+/*----------------------------------------------------------------------------
+   Gather what has arrived on the connections for which epoll reported
+   something to read, and wake a worker for each on which a whole request
+   is now here.
+
+   Return *stopP true if one of the events is a request to stop.
+-----------------------------------------------------------------------------*/
+    unsigned int readyCount;
+    int i;
+
+    for (i = 0, readyCount = 0; i < eventCount; ++i) {
+        struct eventConn * const connP = events[i].data.ptr;
+
+        if (connP == NULL)
+            *stopP = TRUE;
+        else {
+            bool ready;
+
+            gatherRequest(eventLoopP, connP, &ready);
+
+            if (ready)
+                ++readyCount;
+        }
+    }
+    if (readyCount > 0)
+        signalReady(eventLoopP->readyFd, readyCount);
+}
+
+
+
+static void
+takeExpired(struct eventLoop *   const eventLoopP,
+            struct waitList *    const listP,
+            time_t               const limit,
+            struct eventConn **  const expiredPP) {
+/*----------------------------------------------------------------------------
+   Take every connection that has been waiting in list *listP since
+   'limit' or before out of the event loop, and add it to the list
+   *expiredPP, through 'nextIdleP'.
+-----------------------------------------------------------------------------*/
+    while (listP->headP && listP->headP->waitingSince <= limit) {
+
+        struct eventConn * const connP = listP->headP;
+
+        removeFromWaitList(listP, connP);
+        removeFromList(eventLoopP, connP);
+
+        epoll_ctl(eventLoopP->epollFd, EPOLL_CTL_DEL, connP->fd, NULL);
+
+        connP->nextIdleP = *expiredPP;
+        *expiredPP = connP;
+    }
+}
+
+
+
+static void
+closeExpiredConns(struct eventLoop * const eventLoopP,
+                  time_t             const now) {
+/*----------------------------------------------------------------------------
+   Close every connection that has been idle longer than the idle timeout
+   or has been sending a request for longer than the request timeout.
+-----------------------------------------------------------------------------*/
+    struct eventConn * expiredP;
+        /* List, through 'nextIdleP', of connections to close */
+
+    expiredP = NULL;
+
+    eventLoopP->lockP->acquire(eventLoopP->lockP);
+
+    takeExpired(eventLoopP, &eventLoopP->idle,
+                now - eventLoopP->idleTimeout, &expiredP);
+
+    takeExpired(eventLoopP, &eventLoopP->reading,
+                now - eventLoopP->requestTimeout, &expiredP);
+
+    eventLoopP->lockP->release(eventLoopP->lockP);
+
+    while (expiredP) {
+        struct eventConn * const connP = expiredP;
+
+        expiredP = connP->nextIdleP;
+
+        closeConn(connP);
+    }
+}
+
+
+
+static TThreadProc watch;
+
+static void
+watch(void * const userHandle) {
+/*----------------------------------------------------------------------------
+   This is the whole life of the watcher thread.
+
+   We wake up at least once a second to check for timeouts, so a
+   connection may stay idle, or keep sending its request, up to a second
+   longer than the timeout.
+-----------------------------------------------------------------------------*/
+    struct eventLoop * const eventLoopP = userHandle;
+
+    bool stop;
+
+    stop = FALSE;
+
+    while (!stop) {
+        struct epoll_event events[64];
+        int rc;
+
+        rc = epoll_wait(eventLoopP->epollFd, events, ARRAY_SIZE(events),
+                        1000);
+
+        if (rc > 0)
+            dispatchEvents(eventLoopP, events, rc, &stop);
+
+        closeExpiredConns(eventLoopP, time(NULL));
+    }
+}
+
+
+
+static void
+finishServing(struct eventLoop * const eventLoopP,
+              struct eventConn * const connP,
+              bool               const connectionDone,
+              bool               const haveBufferedData) {
+/*----------------------------------------------------------------------------
+   Dispose of connection *connP, which a worker (or whoever finished a
+   deferred request) has just finished serving: close it, give it back to
+   the watcher, or, if the client has already sent another whole request
+   ('haveBufferedData'), queue it for a worker again.
+
+   If the client has sent part of another request, the watcher gets the
+   rest before a worker sees it, as for any request.
+-----------------------------------------------------------------------------*/
+    bool mustClose;
+    bool isReady;
+
+    isReady = FALSE;
+
+    eventLoopP->lockP->acquire(eventLoopP->lockP);
+
+    if (connectionDone || eventLoopP->terminating)
+        mustClose = TRUE;
+    else if (haveBufferedData) {
+        addToReady(eventLoopP, connP);
+        isReady   = TRUE;
+        mustClose = FALSE;
+    } else {
+        TConn * const connectionP = connP->connectionP;
+
+        const char * error;
+
+        if (connectionP->buffersize > connectionP->bufferpos)
+            addToReading(eventLoopP, connP);
+        else
+            addToIdle(eventLoopP, connP);
+
+        armConn(eventLoopP, connP, EPOLL_CTL_MOD, &error);
+
+        if (error) {
+            removeFromWaiting(eventLoopP, connP);
+            xmlrpc_strfree(error);
+            mustClose = TRUE;
+        } else
+            mustClose = FALSE;
+    }
+    if (mustClose)
+        removeFromList(eventLoopP, connP);
+
+    eventLoopP->lockP->release(eventLoopP->lockP);
+
+    if (isReady)
+        signalReady(eventLoopP->readyFd, 1);
+
+    if (mustClose)
+        closeConn(connP);
+}
+
+
+
+static void
+parkConn(struct eventLoop * const eventLoopP,
+         struct eventConn * const connP) {
+/*----------------------------------------------------------------------------
+   Put connection *connP, which a worker has just parked, in deferred
+   state -- unless it has already been resumed, in which case finish
+   serving it as the resumer asked.
+-----------------------------------------------------------------------------*/
+    bool resumed;
+
+    eventLoopP->lockP->acquire(eventLoopP->lockP);
+
+    assert(connP->state == CONN_BUSY);
+
+    resumed = connP->resumed;
+
+    if (!resumed)
+        connP->state = CONN_DEFERRED;
+
+    eventLoopP->lockP->release(eventLoopP->lockP);
+
+    if (resumed)
+        finishServing(eventLoopP, connP, connP->resumeDone,
+                      connP->resumeBuffered);
+}
+
+
+
+static TThreadProc work;
+
+static void
+work(void * const userHandle) {
+/*----------------------------------------------------------------------------
+   This is the whole life of a worker thread.
+-----------------------------------------------------------------------------*/
+    struct eventLoop * const eventLoopP = userHandle;
+
+    bool stop;
+
+    stop = FALSE;
+
+    while (!stop) {
+        uint64_t count;
+        ssize_t rc;
+
+        rc = read(eventLoopP->readyFd, &count, sizeof(count));
+
+        if (rc == sizeof(count)) {
+            struct eventConn * connP;
+
+            eventLoopP->lockP->acquire(eventLoopP->lockP);
+
+            if (eventLoopP->terminating) {
+                stop = TRUE;
+                connP = NULL;
+            } else
+                connP = takeFromReady(eventLoopP);
+
+            eventLoopP->lockP->release(eventLoopP->lockP);
+
+            if (connP) {
+                bool connectionDone;
+                bool parked;
+
+                eventLoopP->serveFn(connP->connectionP, &connP->requestCount,
+                                    &connectionDone, &parked);
+
+                if (parked)
+                    parkConn(eventLoopP, connP);
+                else
+                    finishServing(eventLoopP, connP, connectionDone, FALSE);
+            }
+        } else {
+            /* Interrupted by a signal; just wait again */
+        }
+    }
+}
+
+
+
+static TThreadDoneFn threadDone;
+
+static void
+threadDone(void * const userHandle ATTR_UNUSED) {
+
+}
+
+
+
+static void
+startThread(struct eventLoop * const eventLoopP,
+            TThreadProc *      const func,
+            size_t             const stackSize,
+            TThread **         const threadPP,
+            const char **      const errorP) {
+
+    TThread * threadP;
+
+    ThreadCreate(&threadP, eventLoopP, func, &threadDone, FALSE,
+                 stackSize, errorP);
+
+    if (!*errorP) {
+        bool const success = ThreadRun(threadP);
+
+        if (!success) {
+            xmlrpc_asprintf(errorP, "Failed to start thread");
+            ThreadRelease(threadP);
+        } else
+            *threadPP = threadP;
+    }
+}
+
+
+
+static void
+stopThreads(struct eventLoop * const eventLoopP) {
+/*----------------------------------------------------------------------------
+   Make the watcher and all the workers quit, and wait for them to do so.
+   Interrupt any worker that is waiting to read a request or write a
+   response.
+-----------------------------------------------------------------------------*/
+    struct eventConn * connP;
+
+    eventLoopP->lockP->acquire(eventLoopP->lockP);
+
+    eventLoopP->terminating = TRUE;
+
+    for (connP = eventLoopP->firstP; connP; connP = connP->nextP) {
+        if (connP->state == CONN_BUSY)
+            ChannelInterrupt(connP->connectionP->channelP);
+    }
+    eventLoopP->lockP->release(eventLoopP->lockP);
+
+    signalReady(eventLoopP->stopFd, 1);
+
+    if (eventLoopP->workerCount > 0)
+        signalReady(eventLoopP->readyFd, eventLoopP->workerCount);
+
+    if (eventLoopP->watcherP)
+        ThreadWaitAndRelease(eventLoopP->watcherP);
+
+    while (eventLoopP->workerCount > 0)
+        ThreadWaitAndRelease(eventLoopP->workers[--eventLoopP->workerCount]);
+}
+
+
+
+static void
+startThreads(struct eventLoop * const eventLoopP,
+             unsigned int       const workerCount,
+             size_t             const workerStackSize,
+             const char **      const errorP) {
+
+    MALLOCARRAY(eventLoopP->workers, workerCount);
+
+    if (eventLoopP->workers == NULL)
+        xmlrpc_asprintf(errorP, "Unable to allocate memory for %u "
+                        "worker thread descriptors", workerCount);
+    else {
+        eventLoopP->workerCount = 0;
+        eventLoopP->watcherP = NULL;
+
+        startThread(eventLoopP, &watch, 0, &eventLoopP->watcherP, errorP);
+
+        while (!*errorP && eventLoopP->workerCount < workerCount) {
+            startThread(eventLoopP, &work, workerStackSize,
+                        &eventLoopP->workers[eventLoopP->workerCount],
+                        errorP);
+            if (!*errorP)
+                ++eventLoopP->workerCount;
+        }
+        if (*errorP) {
+            stopThreads(eventLoopP);
+            free(eventLoopP->workers);
+        }
+    }
+}
+
+
+
+static void
+createEventFds(struct eventLoop * const eventLoopP,
+               const char **      const errorP) {
+
+    eventLoopP->epollFd = epoll_create1(EPOLL_CLOEXEC);
+
+    if (eventLoopP->epollFd < 0)
+        xmlrpc_asprintf(errorP, "epoll_create1() failed.  errno=%d (%s)",
+                        errno, strerror(errno));
+    else {
+        eventLoopP->stopFd = eventfd(0, EFD_CLOEXEC);
+
+        if (eventLoopP->stopFd < 0)
+            xmlrpc_asprintf(errorP, "eventfd() failed.  errno=%d (%s)",
+                            errno, strerror(errno));
+        else {
+            struct epoll_event event;
+            int rc;
+
+            event.events   = EPOLLIN;
+            event.data.ptr = NULL;
+
+            rc = epoll_ctl(eventLoopP->epollFd, EPOLL_CTL_ADD,
+                           eventLoopP->stopFd, &event);
+
+            if (rc != 0)
+                xmlrpc_asprintf(errorP, "epoll_ctl() failed.  errno=%d (%s)",
+                                errno, strerror(errno));
+            else {
+                eventLoopP->readyFd = eventfd(0, EFD_CLOEXEC | EFD_SEMAPHORE);
+
+                if (eventLoopP->readyFd < 0)
+                    xmlrpc_asprintf(errorP, "eventfd() failed.  "
+                                    "errno=%d (%s)", errno, strerror(errno));
+                else
+                    *errorP = NULL;
+            }
+            if (*errorP)
+                close(eventLoopP->stopFd);
+        }
+        if (*errorP)
+            close(eventLoopP->epollFd);
+    }
+}
+
+
+
+static void
+destroyEventFds(struct eventLoop * const eventLoopP) {
+
+    close(eventLoopP->readyFd);
+    close(eventLoopP->stopFd);
+    close(eventLoopP->epollFd);
+}
+
+
+
+void
+EventLoopCreate(TEventLoop **       const eventLoopPP,
+                unsigned int        const workerCount,
+                size_t              const workerStackSize,
+                uint32_t            const idleTimeout,
+                uint32_t            const requestTimeout,
+                TEventLoopServeFn * const serveFn,
+                const char **       const errorP) {
+/*----------------------------------------------------------------------------
+   Create an event loop, with 'workerCount' worker threads, which will
+   process requests by calling 'serveFn'.  'workerStackSize' is how much
+   stack 'serveFn' needs.
+
+   The event loop closes a connection if a request doesn't start arriving
+   on it within 'idleTimeout' seconds of it going idle, or doesn't finish
+   arriving within 'requestTimeout' seconds of starting.
+-----------------------------------------------------------------------------*/
+    struct eventLoop * eventLoopP;
+
+    MALLOCVAR(eventLoopP);
+
+    if (eventLoopP == NULL)
+        xmlrpc_asprintf(errorP, "Unable to allocate memory for "
+                        "event loop descriptor");
+    else {
+        eventLoopP->terminating = FALSE;
+        eventLoopP->destroyed   = FALSE;
+        eventLoopP->abandonedCount = 0;
+        eventLoopP->firstP      = NULL;
+        eventLoopP->idle.headP    = NULL;
+        eventLoopP->idle.tailP    = NULL;
+        eventLoopP->reading.headP = NULL;
+        eventLoopP->reading.tailP = NULL;
+        eventLoopP->readyHeadP  = NULL;
+        eventLoopP->readyTailP  = NULL;
+        eventLoopP->idleTimeout = idleTimeout;
+        eventLoopP->requestTimeout = requestTimeout;
+        eventLoopP->serveFn     = serveFn;
+
+        eventLoopP->lockP = xmlrpc_lock_create();
+
+        if (eventLoopP->lockP == NULL)
+            xmlrpc_asprintf(errorP, "Unable to create lock");
+        else {
+            createEventFds(eventLoopP, errorP);
+
+            if (!*errorP) {
+                startThreads(eventLoopP, MAX(1, workerCount),
+                             workerStackSize, errorP);
+
+                if (*errorP)
+                    destroyEventFds(eventLoopP);
+            }
+            if (*errorP)
+                eventLoopP->lockP->destroy(eventLoopP->lockP);
+        }
+        if (*errorP)
+            free(eventLoopP);
+    }
+    *eventLoopPP = eventLoopP;
+}
+
+
+
+static void
+abandonDeferredConns(struct eventLoop * const eventLoopP) {
+/*----------------------------------------------------------------------------
+   Stop waiting for the deferred responses: put every connection still
+   waiting for one in abandoned state.  Interrupt its channel, and that of
+   any connection that is being disposed of, so nothing waits long on the
+   client anymore.
+
+   Caller must hold the lock.
+-----------------------------------------------------------------------------*/
+    struct eventConn * connP;
+
+    for (connP = eventLoopP->firstP; connP; connP = connP->nextP) {
+        if (connP->state == CONN_DEFERRED) {
+            connP->state = CONN_ABANDONED;
+            ++eventLoopP->abandonedCount;
+            ConnInterrupt(connP->connectionP);
+        } else if (connP->state == CONN_BUSY)
+            ConnInterrupt(connP->connectionP);
+    }
+}
+
+
+
+static void
+waitForParkedConns(struct eventLoop * const eventLoopP) {
+/*----------------------------------------------------------------------------
+   Wait until no connection is waiting for a deferred response or being
+   disposed of by whoever completed one.  We're terminating, so each of
+   them gets closed when its response is complete.
+
+   We wait for the deferred responses only up to the request timeout; then
+   we abandon the connections that are still waiting.
+-----------------------------------------------------------------------------*/
+    time_t const deadline = time(NULL) + eventLoopP->requestTimeout;
+
+    bool haveParked;
+    bool abandoned;
+
+    for (haveParked = TRUE, abandoned = FALSE; haveParked; ) {
+        struct eventConn * connP;
+
+        eventLoopP->lockP->acquire(eventLoopP->lockP);
+
+        if (!abandoned && time(NULL) >= deadline) {
+            abandonDeferredConns(eventLoopP);
+            abandoned = TRUE;
+        }
+        for (connP = eventLoopP->firstP, haveParked = FALSE;
+             connP && !haveParked;
+             connP = connP->nextP) {
+            if (connP->state == CONN_DEFERRED || connP->state == CONN_BUSY)
+                haveParked = TRUE;
+        }
+        eventLoopP->lockP->release(eventLoopP->lockP);
+
+        if (haveParked)
+            xmlrpc_millisecond_sleep(10);
+    }
+}
+
+
+
+static void
+freeEventLoop(struct eventLoop * const eventLoopP) {
+
+    eventLoopP->lockP->destroy(eventLoopP->lockP);
+
+    free(eventLoopP);
+}
+
+
+
+void
+EventLoopDestroy(TEventLoop * const eventLoopP) {
+/*----------------------------------------------------------------------------
+   Stop the event loop and close all its connections.
+
+   A worker that is in the middle of a request gets interrupted the same as
+   by ChannelInterrupt(), so the request most likely fails.  We wait for
+   it to finish either way.  We also wait for every deferred response to
+   complete, but only up to the request timeout.
+
+   A connection still waiting for a deferred response after that stays
+   open, with its channel interrupted, until the response completes, and
+   what is left of the event loop stays with it.  So whoever is completing
+   the response must still call SessionComplete(), and must do it before
+   the server is freed.
+-----------------------------------------------------------------------------*/
+    struct eventConn * closeListP;
+        /* List, through 'nextIdleP', of the connections to close */
+    bool haveAbandoned;
+
+    stopThreads(eventLoopP);
+
+    waitForParkedConns(eventLoopP);
+
+    /* Now the only connections left are idle, reading, ready, or
+       abandoned ones
+    */
+    eventLoopP->lockP->acquire(eventLoopP->lockP);
+
+    closeListP = NULL;
+
+    {
+        struct eventConn * connP;
+        struct eventConn * nextP;
+
+        for (connP = eventLoopP->firstP; connP; connP = nextP) {
+            nextP = connP->nextP;
+
+            assert(connP->state != CONN_BUSY);
+
+            if (connP->state != CONN_ABANDONED) {
+                removeFromList(eventLoopP, connP);
+
+                connP->nextIdleP = closeListP;
+                closeListP = connP;
+            }
+        }
+    }
+    eventLoopP->destroyed = TRUE;
+
+    haveAbandoned = eventLoopP->abandonedCount > 0;
+
+    eventLoopP->lockP->release(eventLoopP->lockP);
+
+    while (closeListP) {
+        struct eventConn * const connP = closeListP;
+
+        closeListP = connP->nextIdleP;
+
+        closeConn(connP);
+    }
+    free(eventLoopP->workers);
+
+    destroyEventFds(eventLoopP);
+
+    if (!haveAbandoned)
+        freeEventLoop(eventLoopP);
+}
+
+
+
+void
+EventLoopAddConn(TEventLoop *  const eventLoopP,
+                 TConn *       const connectionP,
+                 const char ** const errorP) {
+/*----------------------------------------------------------------------------
+   Have the event loop serve connection *connectionP from now on, starting
+   with waiting for a request.  We fail if the connection's channel does not
+   have an OS socket that epoll can watch.
+
+   The event loop closes the connection (calls its "done" function and
+   releases it) when it is through with it.  If we fail, we don't.
+-----------------------------------------------------------------------------*/
+    bool haveSocket;
+    TOsSocket fd;
+
+    ChannelOsSocket(connectionP->channelP, &haveSocket, &fd);
+
+    if (!haveSocket)
+        xmlrpc_asprintf(errorP, "Channel has no OS socket to watch");
+    else {
+        struct eventConn * connP;
+
+        MALLOCVAR(connP);
+
+        if (connP == NULL)
+            xmlrpc_asprintf(errorP, "Unable to allocate memory for "
+                            "event loop connection descriptor");
+        else {
+            connP->eventLoopP   = eventLoopP;
+            connP->connectionP  = connectionP;
+            connP->fd           = fd;
+            connP->requestCount = 0;
+            connP->resumed      = FALSE;
+
+            connectionP->eventConnP = connP;
+
+            eventLoopP->lockP->acquire(eventLoopP->lockP);
+
+            addToList(eventLoopP, connP);
+            addToIdle(eventLoopP, connP);
+
+            armConn(eventLoopP, connP, EPOLL_CTL_ADD, errorP);
+
+            if (*errorP) {
+                removeFromWaiting(eventLoopP, connP);
+                removeFromList(eventLoopP, connP);
+            }
+            eventLoopP->lockP->release(eventLoopP->lockP);
+
+            if (*errorP) {
+                connectionP->eventConnP = NULL;
+                free(connP);
+            }
+        }
+    }
+}
+
+
+
+void
+EventLoopResumeConn(TConn * const connectionP,
+                    bool    const connectionDone,
+                    bool    const haveBufferedData) {
+/*----------------------------------------------------------------------------
+   Take back connection *connectionP, which a serve function parked, now
+   that the request that was in progress on it is finished.
+
+   'connectionDone' and 'haveBufferedData' say what to do with it next, as
+   for finishServing().
+
+   If the event loop has abandoned the connection, we just close it.
+-----------------------------------------------------------------------------*/
+    struct eventConn * const connP = connectionP->eventConnP;
+    struct eventLoop * const eventLoopP = connP->eventLoopP;
+
+    bool wasDeferred;
+    bool wasAbandoned;
+    bool wasLast;
+        /* It was the last abandoned connection of a destroyed event loop */
+
+    eventLoopP->lockP->acquire(eventLoopP->lockP);
+
+    wasAbandoned = FALSE;
+    wasLast      = FALSE;
+
+    if (connP->state == CONN_ABANDONED) {
+        removeFromList(eventLoopP, connP);
+
+        --eventLoopP->abandonedCount;
+
+        wasAbandoned = TRUE;
+        wasLast = eventLoopP->destroyed && eventLoopP->abandonedCount == 0;
+        wasDeferred = FALSE;
+    } else if (connP->state == CONN_BUSY) {
+        /* The worker that parked it hasn't gotten around to noting that;
+           it will act on this when it does.
+        */
+        connP->resumed        = TRUE;
+        connP->resumeDone     = connectionDone;
+        connP->resumeBuffered = haveBufferedData;
+        wasDeferred = FALSE;
+    } else {
+        assert(connP->state == CONN_DEFERRED);
+        connP->state = CONN_BUSY;
+        wasDeferred = TRUE;
+    }
+    eventLoopP->lockP->release(eventLoopP->lockP);
+
+    if (wasAbandoned) {
+        closeConn(connP);
+
+        if (wasLast)
+            freeEventLoop(eventLoopP);
+    }
+    if (wasDeferred)
+        finishServing(eventLoopP, connP, connectionDone, haveBufferedData);
+}
+
+
+
+#else  /* HAVE_EPOLL */
+
+/* There is no epoll, so there can't be an event loop. */
+
+void
+EventLoopCreate(TEventLoop **       const eventLoopPP,
+                unsigned int        const workerCount ATTR_UNUSED,
+                size_t              const workerStackSize ATTR_UNUSED,
+                uint32_t            const idleTimeout ATTR_UNUSED,
+                uint32_t            const requestTimeout ATTR_UNUSED,
+                TEventLoopServeFn * const serveFn ATTR_UNUSED,
+                const char **       const errorP) {
+
+    *eventLoopPP = NULL;
+
+    xmlrpc_asprintf(errorP, "This platform has no epoll");
+}
+
+
+
+void
+EventLoopDestroy(TEventLoop * const eventLoopP ATTR_UNUSED) {
+
+    assert(FALSE);
+}
+
+
+
+void
+EventLoopAddConn(TEventLoop *  const eventLoopP ATTR_UNUSED,
+                 TConn *       const connectionP ATTR_UNUSED,
+                 const char ** const errorP) {
+
+    xmlrpc_asprintf(errorP, "This platform has no epoll");
+}
+
+
+
+void
+EventLoopResumeConn(TConn * const connectionP ATTR_UNUSED,
+                    bool    const connectionDone ATTR_UNUSED,
+                    bool    const haveBufferedData ATTR_UNUSED) {
+
+    assert(FALSE);
+}
+
+#endif  /* HAVE_EPOLL */
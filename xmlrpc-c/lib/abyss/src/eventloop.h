@@ -0,0 +1,66 @@
+#ifndef EVENTLOOP_H_INCLUDED
+#define EVENTLOOP_H_INCLUDED
+
+/*============================================================================
+   An event loop serves many HTTP connections with a few threads.
+
+   A thread watches all the connections that are waiting for their next
+   request, with epoll, and reads what arrives.  When a whole request has
+   arrived on one, the connection goes to one of a fixed number of worker
+   threads, which processes requests on it until it has no whole request
+   left to process, then gives it back to the watcher.  So an idle
+   keepalive connection ties up no thread, and neither does a client that
+   sends its request slowly.  Neither does one whose request handler has
+   deferred the response; the connection just waits, parked, for it.
+
+   This exists only where the OS has epoll.  Elsewhere, EventLoopCreate()
+   just fails.
+============================================================================*/
+
+#include "bool.h"
+#include "int.h"
+#include "conn.h"
+
+typedef struct eventLoop TEventLoop;
+
+typedef void TEventLoopServeFn(TConn *        const connectionP,
+                               unsigned int * const requestCountP,
+                               bool *         const connectionDoneP,
+                               bool *         const parkedP);
+    /* Process requests on connection *connectionP, whose buffer holds at
+       least one whole request (or whose channel is at end of file or
+       failed).  Return when the buffer no longer holds a whole request,
+       leaving any part of one there, instead of waiting for the rest.
+       *requestCountP is how many requests have been processed on the
+       connection before; the function updates it.  Return
+       *connectionDoneP true if the connection should be closed, as
+       opposed to watched for another request.
+
+       Return *parkedP true to say that a request is still in progress,
+       with no thread working on it.  Whoever finishes it calls
+       EventLoopResumeConn() then.
+    */
+
+void
+EventLoopCreate(TEventLoop **       const eventLoopPP,
+                unsigned int        const workerCount,
+                size_t              const workerStackSize,
+                uint32_t            const idleTimeout,
+                uint32_t            const requestTimeout,
+                TEventLoopServeFn * const serveFn,
+                const char **       const errorP);
+
+void
+EventLoopDestroy(TEventLoop * const eventLoopP);
+
+void
+EventLoopAddConn(TEventLoop *  const eventLoopP,
+                 TConn *       const connectionP,
+                 const char ** const errorP);
+
+void
+EventLoopResumeConn(TConn * const connectionP,
+                    bool    const connectionDone,
+                    bool    const haveBufferedData);
+
+#endif
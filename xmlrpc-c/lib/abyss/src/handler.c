@@ -755,6 +755,130 @@ HandlerDefaultBuiltin(TSession * const sessionP) {
 size_t const HandlerDefaultBuiltinStack = 1024;
 
 
+
+static void
+addHistogram(TString *             const textP,
+             const char *          const name,
+             const xmlrpc_uint64_t       histogram[],
+             bool *                const okP) {
+/*----------------------------------------------------------------------------
+   Add to *textP a line for each nonempty bucket of latency histogram
+   'histogram' (see TServerStats), e.g. "read_usec_under_8 12".
+-----------------------------------------------------------------------------*/
+    unsigned int i;
+
+    for (i = 0; i < ABYSS_STATS_BUCKETS; ++i) {
+        if (histogram[i] > 0 && *okP) {
+            char line[80];
+
+            if (i < ABYSS_STATS_BUCKETS - 1)
+                sprintf(line, "%s_usec_under_%lu %" PRIu64 "\n",
+                        name, 1ul << i, (uint64_t)histogram[i]);
+            else
+                sprintf(line, "%s_usec_at_least_%lu %" PRIu64 "\n",
+                        name, 1ul << (i - 1), (uint64_t)histogram[i]);
+
+            *okP = StringConcat(textP, line);
+        }
+    }
+}
+
+
+
+static void
+formatStats(const TServerStats * const statsP,
+            time_t               const now,
+            TString *            const textP,
+            bool *               const okP) {
+/*----------------------------------------------------------------------------
+   Add *statsP to *textP, as "name value" lines.
+-----------------------------------------------------------------------------*/
+    unsigned long const uptime =
+        now > statsP->startTime ? (unsigned long)(now - statsP->startTime) : 0;
+    unsigned int const idle =
+        statsP->connectionsOpen > statsP->connectionsActive ?
+        statsP->connectionsOpen - statsP->connectionsActive : 0;
+
+    char line[2048];
+
+    sprintf(line,
+            "uptime_seconds %lu\n"
+            "connections_accepted %" PRIu64 "\n"
+            "connections_accepted_per_second %.3f\n"
+            "connections_open %u\n"
+            "connections_active %u\n"
+            "connections_idle %u\n"
+            "requests %" PRIu64 "\n"
+            "requests_on_reused_connection %" PRIu64 "\n"
+            "keepalive_reuse_ratio %.3f\n"
+            "bytes_in %" PRIu64 "\n"
+            "bytes_out %" PRIu64 "\n",
+            uptime,
+            (uint64_t)statsP->connectionsAccepted,
+            (double)statsP->connectionsAccepted / MAX(uptime, 1),
+            statsP->connectionsOpen,
+            statsP->connectionsActive,
+            idle,
+            (uint64_t)statsP->requests,
+            (uint64_t)statsP->requestsOnReusedConn,
+            statsP->requests > 0 ?
+            (double)statsP->requestsOnReusedConn / statsP->requests : 0.0,
+            (uint64_t)statsP->bytesIn,
+            (uint64_t)statsP->bytesOut);
+
+    *okP = StringConcat(textP, line);
+
+    addHistogram(textP, "read",   statsP->readTime,   okP);
+    addHistogram(textP, "parse",  statsP->parseTime,  okP);
+    addHistogram(textP, "handle", statsP->handleTime, okP);
+    addHistogram(textP, "write",  statsP->writeTime,  okP);
+}
+
+
+
+abyss_bool
+HandlerStats(TSession * const sessionP) {
+/*----------------------------------------------------------------------------
+   Respond to a request for the server's statistics (see ServerGetStats())
+   with them as plain text.  The server calls this for its statistics URI
+   (see ServerSetStatsUri()).
+-----------------------------------------------------------------------------*/
+    if ((sessionP->requestInfo.method != m_get) &&
+        (sessionP->requestInfo.method != m_head)) {
+        ResponseAddField(sessionP, "Allow", "GET, HEAD");
+        ResponseStatus(sessionP, 405);
+    } else {
+        TServerStats stats;
+        TString text;
+        bool ok;
+
+        ServerGetStats(ConnServer(sessionP->connP), &stats);
+
+        ok = StringAlloc(&text);
+
+        if (ok) {
+            formatStats(&stats, time(NULL), &text, &ok);
+
+            if (ok) {
+                ResponseStatus(sessionP, 200);
+                ResponseContentType(sessionP, "text/plain");
+                ResponseContentLength(sessionP, text.size);
+                ResponseAddField(sessionP, "Cache-Control", "no-cache");
+
+                ResponseWriteStart(sessionP);
+                if (sessionP->requestInfo.method != m_head)
+                    ResponseWriteBody(sessionP, StringData(&text), text.size);
+                ResponseWriteEnd(sessionP);
+            }
+            StringFree(&text);
+        }
+        if (!ok)
+            ResponseStatus(sessionP, 500);
+    }
+    return TRUE;
+}
+
+
 /******************************************************************************
 **
 ** server.c
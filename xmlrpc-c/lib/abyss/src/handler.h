@@ -30,4 +30,7 @@ HandlerDefaultBuiltin(TSession * const sessionP);
 
 extern size_t const HandlerDefaultBuiltinStack;
 
+abyss_bool
+HandlerStats(TSession * const sessionP);
+
 #endif
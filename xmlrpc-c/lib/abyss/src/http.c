@@ -104,11 +104,24 @@ RequestInit(TSession * const sessionP,
 
     sessionP->continueRequired = FALSE;
 
-    ListInit(&sessionP->cookies);
-    ListInit(&sessionP->ranges);
-    TableInit(&sessionP->requestHeaderFields);
+    sessionP->bodyBytesRead = 0;
+
+    sessionP->deferralP = NULL;
+
+    ListInitAutoFree(&sessionP->cookies);
+    ListInitAutoFree(&sessionP->ranges);
     TableInit(&sessionP->responseHeaderFields);
 
+    sessionP->headerBuffer      = NULL;
+    sessionP->requestFields     = sessionP->requestFieldSlot;
+    sessionP->requestFieldCount = 0;
+    sessionP->requestFieldAlloc = REQUEST_FIELD_SLOTS;
+    {
+        unsigned int i;
+        for (i = 0; i < RF_COUNT; ++i)
+            sessionP->knownRequestField[i] = NO_FIELD;
+    }
+
     sessionP->status = 0;  /* No status from handler yet */
 
     StringAlloc(&(sessionP->header));
@@ -124,43 +137,48 @@ RequestFree(TSession * const sessionP) {
 
     ListFree(&sessionP->cookies);
     ListFree(&sessionP->ranges);
-    TableFree(&sessionP->requestHeaderFields);
     TableFree(&sessionP->responseHeaderFields);
+
+    if (sessionP->requestFields != sessionP->requestFieldSlot)
+        free(sessionP->requestFields);
+
+    if (sessionP->headerBuffer)
+        ConnReleaseBuffer(sessionP->connP);
     StringFree(&(sessionP->header));
 }
 
 
 
-static char *
-firstLfPos(TConn * const connectionP,
-           char *  const lineStart) {
+static void
+findLf(TConn *  const connectionP,
+       size_t   const lineStart,
+       bool *   const foundP,
+       size_t * const lfPosP) {
 /*----------------------------------------------------------------------------
-   Return a pointer in the connection's receive buffer to the first
-   LF (linefeed aka newline) character in the buffer at or after 'lineStart'.
+   Find the first LF (linefeed aka newline) character in the connection's
+   receive buffer at or after position 'lineStart'.
 
-   If there is no LF in the buffer at or after 'lineStart', return NULL.
+   Return *foundP == false if there is no LF in the buffer at or after
+   'lineStart'; otherwise, return its position as *lfPosP.
 -----------------------------------------------------------------------------*/
-    const char * const bufferEnd =
-        connectionP->buffer.t + connectionP->buffersize;
+    const char * const buffer = connectionP->buffer.t;
 
-    char * p;
+    size_t p;
 
-    for (p = lineStart; p < bufferEnd && *p != LF; ++p);
+    for (p = lineStart; p < connectionP->buffersize && buffer[p] != LF; ++p);
 
-    if (p < bufferEnd)
-        return p;
-    else
-        return NULL;
+    *foundP = (p < connectionP->buffersize);
+    *lfPosP = p;
 }
 
 
 
 static void
-getLineInBuffer(TConn * const connectionP,
-                char *  const lineStart,
-                time_t  const deadline,
-                char ** const lineEndP,
-                bool *  const errorP) {
+getLineInBuffer(TConn *  const connectionP,
+                size_t   const lineStart,
+                time_t   const deadline,
+                size_t * const lineEndP,
+                bool *   const errorP) {
 /*----------------------------------------------------------------------------
    Get a line into the connection's read buffer, starting at position
    'lineStart', if there isn't one already there.   'lineStart' is either
@@ -168,22 +186,27 @@ getLineInBuffer(TConn * const connectionP,
 
    Read the channel until we get a full line, except fail if we don't get
    one by 'deadline'.
+
+   We deal in positions in the buffer rather than pointers because reading
+   may move the buffer to make it bigger.
 -----------------------------------------------------------------------------*/
     bool error;
-    char * lfPos;
+    bool foundLf;
+    size_t lfPos;
 
-    assert(lineStart <= connectionP->buffer.t + connectionP->buffersize);
+    assert(lineStart <= connectionP->buffersize);
 
-    error = FALSE;  /* initial value */
-    lfPos = NULL;  /* initial value */
+    error   = FALSE;  /* initial value */
+    foundLf = FALSE;  /* initial value */
+    lfPos   = 0;      /* quiet compiler warning */
 
-    while (!error && !lfPos) {
+    while (!error && !foundLf) {
         int const timeLeft = (int)(deadline - time(NULL));
         if (timeLeft <= 0)
             error = TRUE;
         else {
-            lfPos = firstLfPos(connectionP, lineStart);
-            if (!lfPos) {
+            findLf(connectionP, lineStart, &foundLf, &lfPos);
+            if (!foundLf) {
                 const char * readError;
                 ConnRead(connectionP, timeLeft, NULL, NULL, &readError);
                 if (readError) {
@@ -237,11 +260,11 @@ convertLineEnd(char * const lineStart,
 
 
 static void
-getRestOfField(TConn *       const connectionP,
-               char *        const lineEnd,
-               time_t        const deadline,
-               const char ** const fieldEndP,
-               bool *        const errorP) {
+getRestOfField(TConn *  const connectionP,
+               size_t   const lineEnd,
+               time_t   const deadline,
+               size_t * const fieldEndP,
+               bool *   const errorP) {
 /*----------------------------------------------------------------------------
    Given that the read buffer for connection *connectionP contains (at
    its current read position) the first line of an HTTP header field, which
@@ -251,14 +274,14 @@ getRestOfField(TConn *       const connectionP,
    we read more from the connection as necessary, but not if it takes past
    'deadline'.  In the latter case, we fail.
 
-   We return the location of the end of the whole field as *headerEndP.
+   We return the position of the end of the whole field as *fieldEndP.
    We do not remove the field from the buffer, but we do modify the
    buffer so as to join the multiple lines of the field into a single
    line, and to NUL-terminate the field.
 -----------------------------------------------------------------------------*/
-    char * const fieldStart = connectionP->buffer.t + connectionP->bufferpos;
+    size_t const fieldStart = connectionP->bufferpos;
 
-    char * fieldEnd;
+    size_t fieldEnd;
         /* End of the field lines we've seen at so far */
     bool gotWholeField;
     bool error;
@@ -268,7 +291,7 @@ getRestOfField(TConn *       const connectionP,
     for (gotWholeField = FALSE, error = FALSE;
          !gotWholeField && !error;) {
 
-        char * nextLineEnd;
+        size_t nextLineEnd;
 
         /* Note that we are guaranteed, assuming the HTTP stream is
            valid, that there is at least one more line in it.  Worst
@@ -277,16 +300,18 @@ getRestOfField(TConn *       const connectionP,
         getLineInBuffer(connectionP, fieldEnd, deadline,
                         &nextLineEnd, &error);
         if (!error) {
-            if (isContinuationLine(fieldEnd)) {
+            char * const buffer = connectionP->buffer.t;
+
+            if (isContinuationLine(&buffer[fieldEnd])) {
                 /* Join previous line to this one */
-                convertLineEnd(fieldEnd, fieldStart, ' ');
+                convertLineEnd(&buffer[fieldEnd], &buffer[fieldStart], ' ');
                 /* Add this line to the header */
                 fieldEnd = nextLineEnd;
             } else {
                 gotWholeField = TRUE;
 
                 /* NUL-terminate the whole field */
-                convertLineEnd(fieldEnd, fieldStart, '\0');
+                convertLineEnd(&buffer[fieldEnd], &buffer[fieldStart], '\0');
             }
         }
     }
@@ -328,27 +353,28 @@ readField(TConn * const connectionP,
 
    We return as *fieldP the next field as an ASCIIZ string, with no
    line delimiter.  That string is stored in the "unused" portion of
-   the connection's internal buffer.  Iff there is no next field, we
-   return *endOfHeaderP == true and nothing meaningful as *fieldP.
+   the connection's internal buffer, and is valid until the next read
+   from the connection.  Iff there is no next field, we return
+   *endOfHeaderP == true and nothing meaningful as *fieldP.
 -----------------------------------------------------------------------------*/
-    char * const bufferStart = connectionP->buffer.t + connectionP->bufferpos;
+    size_t const bufferStart = connectionP->bufferpos;
 
     bool error;
-    char * lineEnd;
+    size_t lineEnd;
 
     getLineInBuffer(connectionP, bufferStart, deadline, &lineEnd, &error);
 
     if (!error) {
-        if (isContinuationLine(bufferStart))
+        if (isContinuationLine(&connectionP->buffer.t[bufferStart]))
             error = TRUE;
-        else if (isEmptyLine(bufferStart)) {
+        else if (isEmptyLine(&connectionP->buffer.t[bufferStart])) {
             /* Consume the EOH mark from the buffer */
-            connectionP->bufferpos = lineEnd - connectionP->buffer.t;
+            connectionP->bufferpos = lineEnd;
             *endOfHeaderP = TRUE;
         } else {
             /* We have the first line of a field; there may be more. */
 
-            const char * fieldEnd;
+            size_t fieldEnd;
 
             *endOfHeaderP = FALSE;
 
@@ -356,13 +382,13 @@ readField(TConn * const connectionP,
                            &fieldEnd, &error);
 
             if (!error) {
-                *fieldP = bufferStart;
+                *fieldP = &connectionP->buffer.t[bufferStart];
 
                 /* Consume the header from the buffer (but be careful --
                    you can't reuse that part of the buffer because the
                    string we will return is in it!
                 */
-                connectionP->bufferpos = fieldEnd - connectionP->buffer.t;
+                connectionP->bufferpos = fieldEnd;
             }
         }
     }
@@ -376,23 +402,21 @@ skipToNonemptyLine(TConn * const connectionP,
                    time_t  const deadline,
                    bool *  const errorP) {
 
-    char * const bufferStart = connectionP->buffer.t + connectionP->bufferpos;
-
     bool gotNonEmptyLine;
     bool error;
-    char * lineStart;
+    size_t lineStart;
     
-    lineStart       = bufferStart;  /* initial value */
-    gotNonEmptyLine = FALSE;        /* initial value */
-    error           = FALSE;        /* initial value */          
+    lineStart       = connectionP->bufferpos;  /* initial value */
+    gotNonEmptyLine = FALSE;                   /* initial value */
+    error           = FALSE;                   /* initial value */
 
     while (!gotNonEmptyLine && !error) {
-        char * lineEnd;
+        size_t lineEnd;
 
         getLineInBuffer(connectionP, lineStart, deadline, &lineEnd, &error);
 
         if (!error) {
-            if (!isEmptyLine(lineStart))
+            if (!isEmptyLine(&connectionP->buffer.t[lineStart]))
                 gotNonEmptyLine = TRUE;
             else
                 lineStart = lineEnd;
@@ -402,7 +426,7 @@ skipToNonemptyLine(TConn * const connectionP,
         /* Consume all the empty lines; advance buffer pointer to first
            non-empty line.
         */
-        connectionP->bufferpos = lineStart - connectionP->buffer.t;
+        connectionP->bufferpos = lineStart;
     }
     *errorP = error;
 }
@@ -988,40 +1012,141 @@ getFieldNameToken(char **       const pP,
 
 
 
+static enum requestField
+knownFieldOf(const char * const fieldName) {
+/*----------------------------------------------------------------------------
+   Return the kind of the header field named 'fieldName' (in lower case),
+   or RF_COUNT if it isn't one we know.
+
+   We use a perfect hash of the name: for the known field names, the
+   function below gives each a different value, so one string compare
+   tells us whether a name is known.
+-----------------------------------------------------------------------------*/
+    static enum requestField const fieldOfHash[22] = {
+        RF_IF_MODIFIED_SINCE, RF_CONTENT_LENGTH, RF_HOST, RF_RANGE,
+        RF_COUNT, RF_CONNECTION, RF_REFERER, RF_USER_AGENT,
+        RF_CONTENT_TYPE, RF_COUNT, RF_COUNT, RF_EXPECT,
+        RF_COUNT, RF_COUNT, RF_COOKIES, RF_FROM,
+        RF_COOKIE, RF_COUNT, RF_COUNT, RF_COUNT,
+        RF_COUNT, RF_AUTHORIZATION
+    };
+    static const char * const nameOfField[RF_COUNT] = {
+        "authorization", "connection", "content-length", "content-type",
+        "cookie", "cookies", "expect", "from", "host", "if-modified-since",
+        "range", "referer", "user-agent"
+    };
+
+    size_t const len = strlen(fieldName);
+
+    enum requestField retval;
+
+    if (len == 0)
+        retval = RF_COUNT;
+    else {
+        unsigned int const hash =
+            (6 * len + (unsigned char)fieldName[0] +
+             (unsigned char)fieldName[len-1]) % 22;
+
+        enum requestField const candidate = fieldOfHash[hash];
+
+        if (candidate != RF_COUNT &&
+            xmlrpc_streq(fieldName, nameOfField[candidate]))
+            retval = candidate;
+        else
+            retval = RF_COUNT;
+    }
+    return retval;
+}
+
+
+
 static void
-processField(const char *  const fieldName,
-             char *        const fieldValue,
-             TSession *    const sessionP,
-             const char ** const errorP,
-             uint16_t *    const httpErrorCodeP) {
+addFieldSlice(TSession *        const sessionP,
+              uint32_t          const namePos,
+              uint32_t          const valuePos,
+              enum requestField const knownField,
+              const char **     const errorP,
+              uint16_t *        const httpErrorCodeP) {
 /*----------------------------------------------------------------------------
-   We may modify *fieldValue, and we put pointers to *fieldValue and
-   *fieldName into *sessionP.
+   Record in *sessionP that there is a request header field whose name
+   and value are at positions 'namePos' and 'valuePos' in the connection
+   buffer.
+-----------------------------------------------------------------------------*/
+    if (sessionP->requestFieldCount >= sessionP->requestFieldAlloc) {
+        unsigned int const newAlloc = sessionP->requestFieldAlloc * 2;
 
-   We must fix this some day.  *sessionP should point to individual
-   malloc'ed strings.
+        fieldSlice * newFields;
+
+        if (sessionP->requestFields == sessionP->requestFieldSlot) {
+            MALLOCARRAY(newFields, newAlloc);
+            if (newFields)
+                memcpy(newFields, sessionP->requestFields,
+                       sessionP->requestFieldCount * sizeof(newFields[0]));
+        } else {
+            /* Not REALLOCARRAY, because we keep the old array if we can't
+               get a new one.
+            */
+            newFields = realloc(sessionP->requestFields,
+                                newAlloc * sizeof(newFields[0]));
+        }
+        if (newFields) {
+            sessionP->requestFields     = newFields;
+            sessionP->requestFieldAlloc = newAlloc;
+        }
+    }
+    if (sessionP->requestFieldCount >= sessionP->requestFieldAlloc) {
+        xmlrpc_asprintf(errorP, "Unable to allocate memory for %u "
+                        "request header fields",
+                        sessionP->requestFieldCount + 1);
+        *httpErrorCodeP = 500;  /* Internal Server Error */
+    } else {
+        unsigned int const index = sessionP->requestFieldCount++;
+
+        sessionP->requestFields[index].name  = namePos;
+        sessionP->requestFields[index].value = valuePos;
+
+        if (knownField != RF_COUNT &&
+            sessionP->knownRequestField[knownField] == NO_FIELD)
+            sessionP->knownRequestField[knownField] = index;
+
+        *errorP = NULL;
+    }
+}
+
+
+
+static void
+processField(enum requestField const knownField,
+             char *            const fieldValue,
+             TSession *        const sessionP,
+             const char **     const errorP,
+             uint16_t *        const httpErrorCodeP) {
+/*----------------------------------------------------------------------------
+   Update *sessionP for a request header field of kind 'knownField' whose
+   value is 'fieldValue'.
+
+   We may modify *fieldValue.  Fields that the request info just points
+   to (e.g. From) we deal with after we have the whole header, because
+   the connection buffer may move until then.
 -----------------------------------------------------------------------------*/
     *errorP = NULL;  /* initial assumption */
 
-    if (xmlrpc_streq(fieldName, "connection")) {
+    switch (knownField) {
+    case RF_CONNECTION:
         if (xmlrpc_strcaseeq(fieldValue, "keep-alive"))
             sessionP->requestInfo.keepalive = TRUE;
         else
             sessionP->requestInfo.keepalive = FALSE;
-    } else if (xmlrpc_streq(fieldName, "host")) {
+        break;
+    case RF_HOST:
         if (sessionP->requestInfo.host) {
             xmlrpc_strfree(sessionP->requestInfo.host);
             sessionP->requestInfo.host = NULL;
         }
         parseHostPort(fieldValue, &sessionP->requestInfo.host,
                       &sessionP->requestInfo.port, errorP);
-    } else if (xmlrpc_streq(fieldName, "from"))
-        sessionP->requestInfo.from = fieldValue;
-    else if (xmlrpc_streq(fieldName, "user-agent"))
-        sessionP->requestInfo.useragent = fieldValue;
-    else if (xmlrpc_streq(fieldName, "referer"))
-        sessionP->requestInfo.referer = fieldValue;
-    else if (xmlrpc_streq(fieldName, "range")) {
+        break;
+    case RF_RANGE:
         if (xmlrpc_strneq(fieldValue, "bytes=", 6)) {
             bool succeeded;
             succeeded = ListAddFromString(&sessionP->ranges, &fieldValue[6]);
@@ -1032,7 +1157,8 @@ processField(const char *  const fieldName,
                 *httpErrorCodeP = 400;
             }
         }
-    } else if (xmlrpc_streq(fieldName, "cookies")) {
+        break;
+    case RF_COOKIES: {
         bool succeeded;
         succeeded = ListAddFromString(&sessionP->cookies, fieldValue);
         if (!succeeded) {
@@ -1040,14 +1166,51 @@ processField(const char *  const fieldName,
                             "cookies: header value '%s'", fieldValue);
             *httpErrorCodeP = 400;
         }
-    } else if (xmlrpc_streq(fieldName, "expect")) {
+    } break;
+    case RF_EXPECT:
         if (xmlrpc_strcaseeq(fieldValue, "100-continue"))
             sessionP->continueRequired = TRUE;
+        break;
+    default:
+        break;
     }
 }
 
 
 
+static const char *
+knownFieldValue(TSession *        const sessionP,
+                enum requestField const knownField) {
+/*----------------------------------------------------------------------------
+   The value of the first request header field of kind 'knownField';
+   NULL if there is none.  Valid only once we have the whole header.
+-----------------------------------------------------------------------------*/
+    unsigned int const index = sessionP->knownRequestField[knownField];
+
+    assert(sessionP->headerBuffer);
+
+    return index == NO_FIELD ? NULL :
+        &sessionP->headerBuffer[sessionP->requestFields[index].value];
+}
+
+
+
+static void
+holdHeader(TSession * const sessionP) {
+/*----------------------------------------------------------------------------
+   Having read and parsed the whole request header, in place in the
+   connection buffer, keep it there for the life of the session and point
+   the request info into it.
+-----------------------------------------------------------------------------*/
+    ConnHoldBuffer(sessionP->connP, &sessionP->headerBuffer);
+
+    sessionP->requestInfo.from      = knownFieldValue(sessionP, RF_FROM);
+    sessionP->requestInfo.useragent = knownFieldValue(sessionP, RF_USER_AGENT);
+    sessionP->requestInfo.referer   = knownFieldValue(sessionP, RF_REFERER);
+}
+
+
+
 static void
 readAndProcessHeaderFields(TSession *    const sessionP,
                            time_t        const deadline,
@@ -1081,23 +1244,33 @@ readAndProcessHeaderFields(TSession *    const sessionP,
             *httpErrorCodeP = 408;  /* Request Timeout */
         } else {
             if (!endOfHeader) {
+                const char * const buffer = sessionP->connP->buffer.t;
+
                 char * p;
                 char * fieldName;
 
                 p = &field[0];
                 getFieldNameToken(&p, &fieldName, errorP, httpErrorCodeP);
                 if (!*errorP) {
+                    enum requestField const knownField =
+                        knownFieldOf(fieldName);
+
                     char * fieldValue;
                     
                     NextToken((const char **)&p);
                     
                     fieldValue = p;
 
-                    TableAdd(&sessionP->requestHeaderFields,
-                             fieldName, fieldValue);
+                    /* The field stays where it is, in the connection
+                       buffer; we just note where.
+                    */
+                    addFieldSlice(sessionP, fieldName - buffer,
+                                  fieldValue - buffer, knownField,
+                                  errorP, httpErrorCodeP);
                     
-                    processField(fieldName, fieldValue, sessionP, errorP,
-                                 httpErrorCodeP);
+                    if (!*errorP)
+                        processField(knownField, fieldValue, sessionP,
+                                     errorP, httpErrorCodeP);
                 }
             }
         }
@@ -1157,8 +1330,10 @@ RequestRead(TSession *    const sessionP,
             } else
                 *errorP = NULL;
 
-            if (!*errorP)
+            if (!*errorP) {
+                holdHeader(sessionP);
                 sessionP->validRequest = true;
+            }
 
             xmlrpc_strfreenull(host);
             xmlrpc_strfree(path);
@@ -1172,8 +1347,192 @@ RequestRead(TSession *    const sessionP,
 char *
 RequestHeaderValue(TSession *   const sessionP,
                    const char * const name) {
+/*----------------------------------------------------------------------------
+   The value of the first field of the request header named 'name' (in
+   lower case); NULL if there is none.
+-----------------------------------------------------------------------------*/
+    char * retval;
+
+    if (!sessionP->headerBuffer)
+        retval = NULL;
+    else {
+        enum requestField const knownField = knownFieldOf(name);
+
+        unsigned int index;
+
+        if (knownField != RF_COUNT)
+            index = sessionP->knownRequestField[knownField];
+        else {
+            unsigned int i;
+
+            for (i = 0, index = NO_FIELD;
+                 i < sessionP->requestFieldCount && index == NO_FIELD;
+                 ++i) {
+                const char * const fieldName =
+                    &sessionP->headerBuffer[sessionP->requestFields[i].name];
+
+                if (xmlrpc_streq(fieldName, name))
+                    index = i;
+            }
+        }
+        retval = index == NO_FIELD ? NULL :
+            (char *)&sessionP->headerBuffer[
+                sessionP->requestFields[index].value];
+    }
+    return retval;
+}
+
+
+
+bool
+RequestBodyRemains(TSession * const sessionP) {
+/*----------------------------------------------------------------------------
+   The request has a body (per its Content-Length) which the handler has
+   not read all of, so the rest of it is still coming on the connection.
+-----------------------------------------------------------------------------*/
+    bool retval;
+
+    if (!sessionP->headerBuffer)
+        retval = FALSE;
+    else {
+        const char * const contentLength =
+            knownFieldValue(sessionP, RF_CONTENT_LENGTH);
+
+        if (!contentLength)
+            retval = FALSE;
+        else {
+            char * tail;
+            uint64_t const bodySize = XMLRPC_STRTOULL(contentLength, &tail, 10);
+
+            if (tail == contentLength || *tail != '\0')
+                /* We can't tell where the body ends */
+                retval = TRUE;
+            else
+                retval = sessionP->bodyBytesRead < bodySize;
+        }
+    }
+    return retval;
+}
+
+
 
-    return (TableFind(&sessionP->requestHeaderFields, name));
+/* The most request body RequestIsBuffered() waits for along with the
+   header.  A handler reads a bigger one as it goes.
+*/
+static uint64_t const bufferedBodyMax = 16 * 1024;
+
+
+
+static unsigned int
+tokenCount(const char * const line,
+           size_t       const lineLen) {
+/*----------------------------------------------------------------------------
+   The number of blank-separated tokens in the 'lineLen' characters at
+   'line'.
+-----------------------------------------------------------------------------*/
+    unsigned int count;
+    size_t i;
+
+    for (i = 0, count = 0; i < lineLen; ++i) {
+        bool const isBlank = (line[i] == ' ' || line[i] == '\t');
+
+        if (!isBlank && (i == 0 || line[i-1] == ' ' || line[i-1] == '\t'))
+            ++count;
+    }
+    return count;
+}
+
+
+
+static bool
+lineIsField(const char * const line,
+            size_t       const lineLen,
+            const char * const name) {
+/*----------------------------------------------------------------------------
+   The header line 'line', 'lineLen' characters, is a field named 'name'
+   (which is in lower case).
+-----------------------------------------------------------------------------*/
+    size_t const nameLen = strlen(name);
+
+    bool matches;
+    size_t i;
+
+    for (i = 0, matches = (lineLen > nameLen && line[nameLen] == ':');
+         i < nameLen && matches;
+         ++i)
+        matches = (tolower((unsigned char)line[i]) == name[i]);
+
+    return matches;
+}
+
+
+
+bool
+RequestIsBuffered(TConn * const connectionP) {
+/*----------------------------------------------------------------------------
+   The connection buffer of *connectionP holds, from its current read
+   position, a whole HTTP request header -- and the body too, if the
+   header says how long it is and that is at most 'bufferedBodyMax'.  So
+   RequestRead() and a handler that reads the body can get the request
+   without waiting on the client.
+
+   If the client expects a 100 Continue response before it sends the body,
+   the header alone is enough.
+
+   We just find the lines; we leave parsing them to RequestRead().
+-----------------------------------------------------------------------------*/
+    const char * const buffer = connectionP->buffer.t;
+    size_t       const end    = connectionP->buffersize;
+
+    size_t pos;
+    bool sawRequestLine;
+    bool endOfHeader;
+    bool expectContinue;
+    bool haveLength;
+    uint64_t contentLength;
+
+    sawRequestLine = FALSE;
+    endOfHeader    = FALSE;
+    expectContinue = FALSE;
+    haveLength     = FALSE;
+    contentLength  = 0;
+
+    for (pos = connectionP->bufferpos; pos < end && !endOfHeader; ) {
+        const char * const lf = memchr(&buffer[pos], '\n', end - pos);
+
+        if (!lf)
+            pos = end;
+        else {
+            const char * const line = &buffer[pos];
+            size_t const lineLen =
+                lf - line > 0 && *(lf - 1) == '\r' ? lf - line - 1 : lf - line;
+
+            if (lineLen == 0) {
+                /* RequestRead() skips empty lines before the request line */
+                endOfHeader = sawRequestLine;
+            } else if (!sawRequestLine) {
+                sawRequestLine = TRUE;
+
+                /* A request line with no protocol version (HTTP 0.9) is
+                   the whole header.
+                */
+                endOfHeader = tokenCount(line, lineLen) < 3;
+            } else if (lineIsField(line, lineLen, "content-length")) {
+                char * tail;
+                contentLength = XMLRPC_STRTOULL(&line[15], &tail, 10);
+                haveLength = (tail != &line[15]);
+            } else if (lineIsField(line, lineLen, "expect"))
+                expectContinue = TRUE;
+
+            pos = lf - buffer + 1;
+        }
+    }
+    if (!endOfHeader)
+        return FALSE;
+    else if (!haveLength || expectContinue || contentLength > bufferedBodyMax)
+        return TRUE;
+    else
+        return end - pos >= contentLength;
 }
 
 
@@ -23,6 +23,12 @@ RequestRead(TSession *    const sessionP,
 void RequestInit(TSession * const r,TConn * const c);
 void RequestFree(TSession * const r);
 
+bool
+RequestBodyRemains(TSession * const sessionP);
+
+bool
+RequestIsBuffered(TConn * const connectionP);
+
 /*********************************************************************
 ** HTTP
 *********************************************************************/
@@ -21,6 +21,7 @@
 #include "int.h"
 #include "version.h"
 #include "mallocvar.h"
+#include "girmath.h"
 #include "xmlrpc-c/string_int.h"
 #include "xmlrpc-c/abyss.h"
 
@@ -180,141 +181,217 @@ ResponseAddField(TSession *   const sessionP,
 
 
 
-static void
-addConnectionHeaderFld(TSession * const sessionP) {
+static unsigned int
+leadingWsCt(const char * const arg) {
 
-    struct _TServer * const srvP = ConnServer(sessionP->connP)->srvP;
+    unsigned int i;
 
-    if (HTTPKeepalive(sessionP)) {
-        const char * keepaliveValue;
-        
-        ResponseAddField(sessionP, "Connection", "Keep-Alive");
+    for (i = 0; arg[i] && isspace(arg[i]); ++i);
 
-        xmlrpc_asprintf(&keepaliveValue, "timeout=%u, max=%u",
-                        srvP->keepalivetimeout, srvP->keepalivemaxconn);
+    return i;
+}
 
-        ResponseAddField(sessionP, "Keep-Alive", keepaliveValue);
 
-        xmlrpc_strfree(keepaliveValue);
-    } else
-        ResponseAddField(sessionP, "Connection", "close");
+
+static unsigned int
+trailingWsPos(const char * const arg) {
+
+    unsigned int i;
+
+    for (i = strlen(arg); i > 0 && isspace(arg[i-1]); --i);
+
+    return i;
 }
-    
+
 
 
 static void
-addDateHeaderFld(TSession * const sessionP) {
+addField(TString *    const headerP,
+         const char * const name,
+         const char * const value,
+         bool *       const succeededP) {
+/*----------------------------------------------------------------------------
+   Add the header field line for field 'name' with basic value 'value'
+   to the header *headerP.
 
-    if (sessionP->status >= 200) {
-        const char * dateValue;
+   An HTTP header field value may not have leading or trailing white
+   space, so we leave that out.
+-----------------------------------------------------------------------------*/
+    unsigned int const lead  = leadingWsCt(value);
+    unsigned int const trail = MAX(lead, trailingWsPos(value));
 
-        DateToString(sessionP->date, &dateValue);
+    *succeededP =
+        StringConcat(headerP, name) &&
+        StringConcat(headerP, ": ") &&
+        StringConcatN(headerP, &value[lead], trail - lead) &&
+        StringConcat(headerP, "\r\n");
+}
 
-        if (dateValue) {
-            ResponseAddField(sessionP, "Date", dateValue);
-            xmlrpc_strfree(dateValue);
-        }
+
+
+static void
+addFields(TString * const headerP,
+          TTable    const fields,
+          bool *    const succeededP) {
+/*----------------------------------------------------------------------------
+   Add the header field lines for fields[] to the header *headerP.
+
+   fields[] contains syntactically valid HTTP header field names and values.
+   But to the extent that int contains undefined field names or semantically
+   invalid values, the header we send is invalid.
+-----------------------------------------------------------------------------*/
+    unsigned int i;
+
+    for (i = 0, *succeededP = TRUE; i < fields.size && *succeededP; ++i) {
+        TTableItem * const fieldP = &fields.item[i];
+
+        addField(headerP, fieldP->name, fieldP->value, succeededP);
     }
 }
 
 
 
 static void
-addServerHeaderFld(TSession * const sessionP) {
+addConnectionHeaderFld(TString *  const headerP,
+                       TSession * const sessionP,
+                       bool *     const succeededP) {
 
-    const char * serverValue;
+    struct _TServer * const srvP = ConnServer(sessionP->connP)->srvP;
 
-    xmlrpc_asprintf(&serverValue, "Xmlrpc-c_Abyss/%s", XMLRPC_C_VERSION);
+    if (HTTPKeepalive(sessionP))
+        *succeededP = StringConcat(headerP, srvP->keepaliveFields);
+    else
+        *succeededP = StringConcat(headerP, "Connection: close\r\n");
+}
+    
 
-    ResponseAddField(sessionP, "Server", serverValue);
 
-    xmlrpc_strfree(serverValue);
-}
+static void
+getDateString(struct _TServer * const srvP,
+              time_t            const datetime,
+              char *            const buffer,
+              bool *            const validP) {
+/*----------------------------------------------------------------------------
+   Return in the DATE_STRING_SIZE bytes at 'buffer' the value of the HTTP
+   Date header field for time 'datetime'.
 
+   We format the date only the first time in a given second; after that,
+   we copy it from the server's cache.
+-----------------------------------------------------------------------------*/
+    srvP->dateLockP->acquire(srvP->dateLockP);
 
+    if (datetime != srvP->dateTime || srvP->dateString[0] == '\0') {
+        bool valid;
 
-static unsigned int
-leadingWsCt(const char * const arg) {
+        DateFormat(datetime, srvP->dateString, &valid);
 
-    unsigned int i;
+        if (valid)
+            srvP->dateTime = datetime;
+        else
+            srvP->dateString[0] = '\0';
+    }
+    strcpy(buffer, srvP->dateString);
 
-    for (i = 0; arg[i] && isspace(arg[i]); ++i);
+    srvP->dateLockP->release(srvP->dateLockP);
 
-    return i;
+    *validP = (buffer[0] != '\0');
 }
 
 
 
-static unsigned int
-trailingWsPos(const char * const arg) {
+static void
+addDateHeaderFld(TString *  const headerP,
+                 TSession * const sessionP,
+                 bool *     const succeededP) {
 
-    unsigned int i;
+    struct _TServer * const srvP = ConnServer(sessionP->connP)->srvP;
 
-    for (i = strlen(arg); i > 0 && isspace(arg[i-1]); --i);
+    if (sessionP->status >= 200) {
+        char dateValue[DATE_STRING_SIZE];
+        bool valid;
 
-    return i;
+        getDateString(srvP, sessionP->date, dateValue, &valid);
+
+        if (valid)
+            addField(headerP, "Date", dateValue, succeededP);
+        else
+            *succeededP = TRUE;
+    } else
+        *succeededP = TRUE;
 }
 
 
 
-static const char *
-formatFieldValue(const char * const unformatted) {
-/*----------------------------------------------------------------------------
-   Return the string of characters that goes after the colon on the
-   HTTP header field line, given that 'unformatted' is its basic value.
------------------------------------------------------------------------------*/
-    const char * retval;
+static void
+addServerHeaderFld(TString * const headerP,
+                   bool *    const succeededP) {
 
-    /* An HTTP header field value may not have leading or trailing white
-       space.
-    */
-    char * buffer;
-
-    buffer = malloc(strlen(unformatted) + 1);
-
-    if (buffer == NULL)
-        retval = xmlrpc_strnomemval();
-    else {
-        unsigned int const lead  = leadingWsCt(unformatted);
-        unsigned int const trail = trailingWsPos(unformatted);
-        assert(trail >= lead);
-        strncpy(buffer, &unformatted[lead], trail - lead);
-        buffer[trail - lead] = '\0';
-        retval = buffer;
-    }
-    return retval;
+    *succeededP = StringConcat(headerP,
+                               "Server: Xmlrpc-c_Abyss/" XMLRPC_C_VERSION
+                               "\r\n");
 }
 
 
 
 static void
-sendHeader(TConn * const connP,
-           TTable  const fields) {
-/*----------------------------------------------------------------------------
-   Send the HTTP response header whose fields are fields[].
+addStatusLine(TString * const headerP,
+              uint16_t  const status,
+              bool *    const succeededP) {
 
-   Don't include the blank line that separates the header from the body.
+    char statusValue[16];
 
-   fields[] contains syntactically valid HTTP header field names and values.
-   But to the extent that int contains undefined field names or semantically
-   invalid values, the header we send is invalid.
+    sprintf(statusValue, "%u ", status);
+
+    *succeededP =
+        StringConcat(headerP, "HTTP/1.1 ") &&
+        StringConcat(headerP, statusValue) &&
+        StringConcat(headerP, HTTPReasonByStatus(status)) &&
+        StringConcat(headerP, "\r\n");
+}
+
+
+
+static void
+buildHeader(TString *  const headerP,
+            TSession * const sessionP,
+            bool *     const succeededP) {
+/*----------------------------------------------------------------------------
+   Put the whole HTTP response header for session *sessionP, including the
+   blank line that ends it, in *headerP.
 -----------------------------------------------------------------------------*/
-    unsigned int i;
+    struct _TServer * const srvP = ConnServer(sessionP->connP)->srvP;
 
-    for (i = 0; i < fields.size; ++i) {
-        TTableItem * const fieldP = &fields.item[i];
-        const char * const fieldValue = formatFieldValue(fieldP->value);
+    bool succeeded;
 
-        const char * line;
+    addStatusLine(headerP, sessionP->status, &succeeded);
 
-        xmlrpc_asprintf(&line, "%s: %s\r\n", fieldP->name, fieldValue);
-        ConnWrite(connP, line, strlen(line));
-        xmlrpc_strfree(line);
-        xmlrpc_strfree(fieldValue);
-    }
+    /* Note that sessionP->responseHeaderFields is defined to contain
+       syntactically but not necessarily semantically valid header
+       field names and values.
+    */
+    if (succeeded)
+        addFields(headerP, sessionP->responseHeaderFields, &succeeded);
+
+    if (succeeded)
+        addConnectionHeaderFld(headerP, sessionP, &succeeded);
+
+    if (succeeded && sessionP->chunkedwrite && sessionP->chunkedwritemode)
+        addField(headerP, "Transfer-Encoding", "chunked", &succeeded);
+
+    if (succeeded)
+        addDateHeaderFld(headerP, sessionP, &succeeded);
+
+    if (succeeded && srvP->advertise)
+        addServerHeaderFld(headerP, &succeeded);
+
+    if (succeeded)
+        succeeded = StringConcat(headerP, "\r\n");
+
+    *succeededP = succeeded;
 }
 
 
+
 void
 ResponseWriteStart(TSession * const sessionP) {
 /*----------------------------------------------------------------------------
@@ -322,8 +399,11 @@ ResponseWriteStart(TSession * const sessionP) {
    (i.e. Abyss session).
 
    As part of this, send the entire HTTP header for the response.
+
+   We build the header in memory and send it with one write, so it
+   normally goes to the client in one packet.
 -----------------------------------------------------------------------------*/
-    struct _TServer * const srvP = ConnServer(sessionP->connP)->srvP;
+    bool succeeded;
 
     assert(!sessionP->responseStarted);
 
@@ -337,31 +417,14 @@ ResponseWriteStart(TSession * const sessionP) {
 
     sessionP->responseStarted = TRUE;
 
-    {
-        const char * const reason = HTTPReasonByStatus(sessionP->status);
-        const char * line;
-        xmlrpc_asprintf(&line,"HTTP/1.1 %u %s\r\n", sessionP->status, reason);
-        ConnWrite(sessionP->connP, line, strlen(line));
-        xmlrpc_strfree(line);
-    }
-
-    addConnectionHeaderFld(sessionP);
-
-    if (sessionP->chunkedwrite && sessionP->chunkedwritemode)
-        ResponseAddField(sessionP, "Transfer-Encoding", "chunked");
-
-    addDateHeaderFld(sessionP);
+    buildHeader(&sessionP->header, sessionP, &succeeded);
 
-    if (srvP->advertise)
-        addServerHeaderFld(sessionP);
-
-    /* Note that sessionP->responseHeaderFields is defined to contain
-       syntactically but not necessarily semantically valid header
-       field names and values.
-    */
-    sendHeader(sessionP->connP, sessionP->responseHeaderFields);
-
-    ConnWrite(sessionP->connP, "\r\n", 2);  
+    if (succeeded)
+        ConnWrite(sessionP->connP,
+                  StringData(&sessionP->header), sessionP->header.size);
+    else
+        TraceMsg("Abyss: unable to get memory to build the HTTP "
+                 "response header");
 }
 
 
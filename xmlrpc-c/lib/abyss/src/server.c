@@ -11,6 +11,9 @@
 #include <errno.h>
 #ifndef _WIN32
   #include <grp.h>
+  #include <unistd.h>
+  #include <fcntl.h>
+  #include <poll.h>
 #endif
 
 #include "xmlrpc_config.h"
@@ -19,6 +22,7 @@
 #include "mallocvar.h"
 #include "xmlrpc-c/string_int.h"
 #include "xmlrpc-c/sleep_int.h"
+#include "xmlrpc-c/time_int.h"
 #include "xmlrpc-c/lock.h"
 #include "xmlrpc-c/lock_platform.h"
 
@@ -38,6 +42,8 @@
 #endif
 #include "http.h"
 #include "handler.h"
+#include "eventloop.h"
+#include "workerpool.h"
 
 #include "server.h"
 
@@ -58,10 +64,15 @@ ServerTerminate(TServer * const serverP) {
 
     struct _TServer * const srvP = serverP->srvP;
 
+    unsigned int i;
+
     srvP->terminationRequested = true;
 
     if (srvP->chanSwitchP)
         ChanSwitchInterrupt(srvP->chanSwitchP);
+
+    for (i = 0; i < srvP->siblingSwitchCount; ++i)
+        ChanSwitchInterrupt(srvP->siblingSwitches[i]);
 }
 
 
@@ -186,6 +197,21 @@ initChanSwitchStuff(struct _TServer * const srvP,
         srvP->weCreatedChanSwitch = FALSE;
         srvP->port = port;
     }
+    srvP->siblingSwitches    = NULL;
+    srvP->siblingSwitchCount = 0;
+    srvP->acceptors          = NULL;
+    srvP->acceptorCount      = 0;
+}
+
+
+
+static void
+renderKeepaliveFields(struct _TServer * const srvP) {
+
+    sprintf(srvP->keepaliveFields,
+            "Connection: Keep-Alive\r\nKeep-Alive: timeout=%u, max=%u\r\n",
+            (unsigned)srvP->keepalivetimeout,
+            (unsigned)srvP->keepalivemaxconn);
 }
 
 
@@ -229,7 +255,12 @@ createServer(struct _TServer ** const srvPP,
                 srvP->timeout          = 15;
                 srvP->advertise        = TRUE;
                 srvP->useSigchld       = FALSE;
+                srvP->eventDriven      = FALSE;
+                srvP->workerThreads    = 0;
+                srvP->acceptorThreads  = 1;
+                srvP->readBufferSize   = BUFFER_SIZE;
                 srvP->uriHandlerStackSize = 0;
+                srvP->statsUri         = NULL;
                 srvP->maxConn          = 15;
                 srvP->maxConnBacklog   = 15;
             
@@ -238,9 +269,31 @@ createServer(struct _TServer ** const srvPP,
                 ListInitAutoFree(&srvP->handlers);
 
                 srvP->logfileisopen = FALSE;
-                
-                *errorP = NULL;
 
+                renderKeepaliveFields(srvP);
+
+                srvP->dateTime      = 0;
+                srvP->dateString[0] = '\0';
+                srvP->dateLockP     = xmlrpc_lock_create();
+
+                if (srvP->dateLockP == NULL)
+                    xmlrpc_asprintf(errorP, "Unable to create lock for "
+                                    "the date cache");
+                else {
+                    srvP->channelLockP = xmlrpc_lock_create();
+
+                    if (srvP->channelLockP == NULL)
+                        xmlrpc_asprintf(errorP, "Unable to create lock for "
+                                        "connection channels");
+                    else {
+                        StatsInit(&srvP->stats, errorP);
+
+                        if (*errorP)
+                            srvP->channelLockP->destroy(srvP->channelLockP);
+                    }
+                    if (*errorP)
+                        srvP->dateLockP->destroy(srvP->dateLockP);
+                }
                 if (*errorP)
                     HandlerDestroy(srvP->builtinHandlerP);
             }
@@ -476,6 +529,12 @@ ServerFree(TServer * const serverP) {
 
     struct _TServer * const srvP = serverP->srvP;
 
+    while (srvP->siblingSwitchCount > 0)
+        ChanSwitchDestroy(srvP->siblingSwitches[--srvP->siblingSwitchCount]);
+
+    if (srvP->siblingSwitches)
+        free(srvP->siblingSwitches);
+
     if (srvP->weCreatedChanSwitch)
         ChanSwitchDestroy(srvP->chanSwitchP);
 
@@ -489,6 +548,15 @@ ServerFree(TServer * const serverP) {
     
     logClose(srvP);
 
+    srvP->dateLockP->destroy(srvP->dateLockP);
+
+    srvP->channelLockP->destroy(srvP->channelLockP);
+
+    StatsTerm(&srvP->stats);
+
+    if (srvP->statsUri)
+        xmlrpc_strfree(srvP->statsUri);
+
     if (srvP->logfilename)
         xmlrpc_strfree(srvP->logfilename);
 
@@ -536,6 +604,8 @@ ServerSetKeepaliveTimeout(TServer *       const serverP,
                           xmlrpc_uint32_t const keepaliveTimeout) {
 
     serverP->srvP->keepalivetimeout = MAX(keepaliveTimeout, 1);
+
+    renderKeepaliveFields(serverP->srvP);
 }
 
 
@@ -545,6 +615,8 @@ ServerSetKeepaliveMaxConn(TServer *       const serverP,
                           xmlrpc_uint32_t const keepaliveMaxConn) {
 
     serverP->srvP->keepalivemaxconn = MAX(keepaliveMaxConn, 1);
+
+    renderKeepaliveFields(serverP->srvP);
 }
 
 
@@ -598,6 +670,76 @@ ServerSetMaxConnBacklog(TServer *    const serverP,
 
 
 
+void
+ServerSetWorkerThreads(TServer *    const serverP,
+                       unsigned int const workerThreads) {
+
+    serverP->srvP->workerThreads = workerThreads;
+}
+
+
+
+void
+ServerSetReadBufferSize(TServer *    const serverP,
+                        unsigned int const readBufferSize) {
+
+    if (readBufferSize > 0)
+        serverP->srvP->readBufferSize = readBufferSize;
+}
+
+
+
+void
+ServerSetAcceptorThreads(TServer *    const serverP,
+                         unsigned int const acceptorThreads) {
+
+    if (acceptorThreads > 0)
+        serverP->srvP->acceptorThreads = acceptorThreads;
+}
+
+
+
+void
+ServerSetEventDriven(TServer *  const serverP,
+                     abyss_bool const eventDriven) {
+
+    serverP->srvP->eventDriven = eventDriven;
+}
+
+
+
+void
+ServerSetStatsUri(TServer *    const serverP,
+                  const char * const statsUri) {
+/*----------------------------------------------------------------------------
+   Have the server answer a GET of URI 'statsUri' with its statistics (see
+   ServerGetStats()), ahead of any handler.  NULL means don't.
+-----------------------------------------------------------------------------*/
+    struct _TServer * const srvP = serverP->srvP;
+
+    if (srvP->statsUri)
+        xmlrpc_strfree(srvP->statsUri);
+
+    srvP->statsUri = statsUri ? strdup(statsUri) : NULL;
+}
+
+
+
+void
+ServerGetStats(TServer *      const serverP,
+               TServerStats * const statsP) {
+/*----------------------------------------------------------------------------
+   Return statistics about the connections and requests server *serverP
+   has served since it was created.
+
+   You can call this any time, from any thread, including while the server
+   is running.
+-----------------------------------------------------------------------------*/
+    StatsRead(&serverP->srvP->stats, statsP);
+}
+
+
+
 static URIHandler2
 makeUriHandler2(const struct uriHandler * const handlerP) {
 
@@ -620,10 +762,14 @@ runUserHandler(TSession *        const sessionP,
 
     abyss_bool handled;
     int i;
+
+    if (srvP->statsUri &&
+        xmlrpc_streq(sessionP->requestInfo.uri, srvP->statsUri))
+        handled = HandlerStats(sessionP);
+    else
+        handled = FALSE;
     
-    for (i = srvP->handlers.size-1, handled = FALSE;
-         i >= 0 && !handled;
-         --i) {
+    for (i = srvP->handlers.size-1; i >= 0 && !handled; --i) {
         const struct uriHandler * const handlerP = srvP->handlers.item[i];
         
         if (handlerP->handleReq3)
@@ -672,10 +818,130 @@ handleReqInvalidURI(TSession * const sessionP) {
 
 
 static void
-processRequestFromClient(TConn *  const connectionP,
-                         bool     const lastReqOnConn,
-                         uint32_t const timeout,
-                         bool *   const keepAliveP) {
+countRequestTimes(TStats *        const statsP,
+                  TConn *         const connectionP,
+                  xmlrpc_timespec const startTime,
+                  xmlrpc_timespec const headerTime,
+                  uint64_t        const headerReadTime,
+                  xmlrpc_timespec const endTime) {
+/*----------------------------------------------------------------------------
+   Add to the latency histograms the times of a request that began at
+   'startTime', whose header we had read and parsed at 'headerTime', and
+   whose response was complete at 'endTime'.  Reading the header took
+   'headerReadTime' microseconds of that.  The connection's read and write
+   times are the totals for the request.
+-----------------------------------------------------------------------------*/
+    uint64_t const headerTotal = xmlrpc_usecBetween(startTime, headerTime);
+    uint64_t const restTotal   = xmlrpc_usecBetween(headerTime, endTime);
+    uint64_t const restIoTime  =
+        (connectionP->readTime - headerReadTime) + connectionP->writeTime;
+
+    StatsAddTime(statsP, statsP->readTime, connectionP->readTime);
+    StatsAddTime(statsP, statsP->parseTime,
+                 headerTotal > headerReadTime ?
+                 headerTotal - headerReadTime : 0);
+    StatsAddTime(statsP, statsP->handleTime,
+                 restTotal > restIoTime ? restTotal - restIoTime : 0);
+    StatsAddTime(statsP, statsP->writeTime, connectionP->writeTime);
+}
+
+
+
+struct sessionDeferral {
+/*----------------------------------------------------------------------------
+   The state of a request whose handler has deferred the response (see
+   SessionDefer()).  The handler's thread and the thread that completes the
+   response use this to agree on which of them finishes the request.
+-----------------------------------------------------------------------------*/
+    lock * lockP;
+        /* Protects everything below */
+    bool handlerReturned;
+        /* The handler has returned, and the request is parked: no thread is
+           working on it.
+        */
+    bool completed;
+        /* The handler has completed the response (SessionComplete()) */
+};
+
+
+
+static void
+finishRequest(TSession * const sessionP,
+              bool *     const keepAliveP) {
+/*----------------------------------------------------------------------------
+   Finish the request of session *sessionP, whose handler is through with
+   it, and destroy the session.
+
+   Return as *keepAliveP whether the connection can carry another request.
+-----------------------------------------------------------------------------*/
+    TConn *  const connectionP = sessionP->connP;
+    TStats * const statsP = &connectionP->server->srvP->stats;
+
+    xmlrpc_timespec endTime;
+
+    assert(sessionP->status != 0);
+
+    if (sessionP->responseStarted)
+        HTTPWriteEndChunk(sessionP);
+    else
+        ResponseError(sessionP);
+
+    xmlrpc_gettimeofday(&endTime);
+
+    countRequestTimes(statsP, connectionP, sessionP->startTime,
+                      sessionP->headerTime, sessionP->headerReadTime,
+                      endTime);
+
+    /* If the handler didn't read the whole request body, the rest of it
+       is where the next request should be, so we can't go on.
+    */
+    *keepAliveP = HTTPKeepalive(sessionP) && !RequestBodyRemains(sessionP);
+
+    SessionLog(sessionP);
+
+    RequestFree(sessionP);
+
+    if (sessionP->deferralP) {
+        sessionP->deferralP->lockP->destroy(sessionP->deferralP->lockP);
+        free(sessionP->deferralP);
+    }
+    free(sessionP);
+}
+
+
+
+static void
+parkIfDeferred(TSession * const sessionP,
+               bool *     const parkedP) {
+/*----------------------------------------------------------------------------
+   The handler of session *sessionP has just returned.  If it deferred the
+   response and hasn't completed it yet, leave the request for
+   SessionComplete() to finish and return *parkedP true.
+-----------------------------------------------------------------------------*/
+    struct sessionDeferral * const deferralP = sessionP->deferralP;
+
+    if (deferralP) {
+        deferralP->lockP->acquire(deferralP->lockP);
+
+        deferralP->handlerReturned = TRUE;
+
+        *parkedP = !deferralP->completed;
+
+        deferralP->lockP->release(deferralP->lockP);
+    } else
+        *parkedP = FALSE;
+}
+
+
+
+static void
+processRequestFromClient(TConn *        const connectionP,
+                         bool           const lastReqOnConn,
+                         uint32_t       const timeout,
+                         bool           const mayPark,
+                         unsigned int * const requestCountP,
+                         bool *         const parkedP,
+                         bool *         const keepAliveP) {
 /*----------------------------------------------------------------------------
    Get and execute one HTTP request from client connection *connectionP,
    through the connection buffer.  I.e. Some of the request may already be in
@@ -699,42 +965,273 @@ processRequestFromClient(TConn *  const connectionP,
    (GET, POST, etc) and URL etc, and that response may be either to
    execute the request and send the response or refuse the request and let
    us call the next one in the list.
+
+   'mayPark' means a handler may defer the response (SessionDefer()).  If
+   one does, and hasn't completed the response by the time it returns, we
+   return *parkedP true and leave the rest of the request, including
+   disposing of the connection and updating *requestCountP, to
+   SessionComplete().  *keepAliveP is meaningless then.
 -----------------------------------------------------------------------------*/
-    TSession session;
-    const char * error;
-    uint16_t httpErrorCode;
+    TSession * sessionP;
+
+    MALLOCVAR(sessionP);
+
+    if (sessionP == NULL) {
+        TraceMsg("Unable to allocate memory for an HTTP session");
+        *parkedP    = FALSE;
+        *keepAliveP = FALSE;
+    } else {
+        const char * error;
+        uint16_t httpErrorCode;
+
+        xmlrpc_gettimeofday(&sessionP->startTime);
+
+        connectionP->readTime  = 0;
+        connectionP->writeTime = 0;
 
-    RequestInit(&session, connectionP);
+        RequestInit(sessionP, connectionP);
 
-    session.serverDeniesKeepalive = lastReqOnConn;
+        sessionP->serverDeniesKeepalive = lastReqOnConn;
+        sessionP->mayPark               = mayPark;
+        sessionP->requestCountP         = requestCountP;
         
-    RequestRead(&session, timeout, &error, &httpErrorCode);
+        RequestRead(sessionP, timeout, &error, &httpErrorCode);
 
-    if (error) {
-        ResponseStatus(&session, httpErrorCode);
-        ResponseError2(&session, error);
-        xmlrpc_strfree(error);
+        xmlrpc_gettimeofday(&sessionP->headerTime);
+
+        sessionP->headerReadTime = connectionP->readTime;
+
+        if (error) {
+            ResponseStatus(sessionP, httpErrorCode);
+            ResponseError2(sessionP, error);
+            xmlrpc_strfree(error);
+        } else {
+            if (sessionP->version.major >= 2)
+                handleReqTooNewHttpVersion(sessionP);
+            else if (!RequestValidURI(sessionP))
+                handleReqInvalidURI(sessionP);
+            else
+                runUserHandler(sessionP, connectionP->server->srvP);
+        }
+
+        parkIfDeferred(sessionP, parkedP);
+
+        if (!*parkedP)
+            finishRequest(sessionP, keepAliveP);
+    }
+}
+
+
+
+static void
+endRequest(TConn *        const connectionP,
+           bool           const keepalive,
+           unsigned int * const requestCountP,
+           bool *         const connectionDoneP) {
+/*----------------------------------------------------------------------------
+   Account for the end of a request on connection *connectionP and get
+   ready for the next one, if 'keepalive' says there can be one.
+-----------------------------------------------------------------------------*/
+    struct _TServer * const srvP = connectionP->server->srvP;
+    TStats *          const statsP = &srvP->stats;
+
+    StatsAdd(statsP, &statsP->connectionsActive, -1);
+
+    trace(srvP, "Done processing the HTTP request.  Keepalive = %s",
+          keepalive ? "YES" : "NO");
+            
+    ++*requestCountP;
+
+    *connectionDoneP = !keepalive;
+            
+    /**************** Must adjust the read buffer *****************/
+    ConnReadInit(connectionP);
+}
+
+
+
+static void
+serveNextRequest(TConn *        const connectionP,
+                 uint32_t       const waitTimeout,
+                 bool           const mayPark,
+                 unsigned int * const requestCountP,
+                 bool *         const connectionDoneP,
+                 bool *         const parkedP) {
+/*----------------------------------------------------------------------------
+   Wait up to 'waitTimeout' seconds for the next HTTP request to start
+   arriving on connection *connectionP, then get the rest of it and
+   execute it.
+
+   If the request has already started arriving, e.g. because the client
+   sent it right behind the previous one without waiting for the response
+   (HTTP pipelining), it's in the connection buffer and we don't wait.
+
+   *requestCountP is the number of requests we've handled so far on this
+   connection; we update it.
+
+   Return *connectionDoneP true iff there is no more need for the
+   connection: the client closed it, the wait timed out or failed, or the
+   request says not to keep the connection alive.
+
+   'mayPark' and *parkedP are as for processRequestFromClient().  When we
+   return *parkedP true, the connection belongs to SessionComplete() and
+   *connectionDoneP is meaningless.
+-----------------------------------------------------------------------------*/
+    struct _TServer * const srvP = connectionP->server->srvP;
+    TStats *          const statsP = &srvP->stats;
+
+    bool timedOut, eof;
+    const char * readError;
+        
+    *parkedP = FALSE;
+
+    if (connectionP->buffersize > connectionP->bufferpos) {
+        /* We already have the beginning of the next request */
+        readError = NULL;
+        timedOut  = FALSE;
+        eof       = FALSE;
+    } else {
+        /* Wait for and get beginning (at least ) of next request.  We do
+           this separately from getting the rest of the request because we
+           treat dead time between requests differently from dead time in
+           the middle of a request.
+        */
+        ConnRead(connectionP, waitTimeout, &eof, &timedOut, &readError);
+    }
+
+    if (srvP->terminationRequested) {
+        *connectionDoneP = TRUE;
+    } else if (readError) {
+        TraceMsg("Failed to read from Abyss connection.  %s", readError);
+        xmlrpc_strfree(readError);
+        *connectionDoneP = TRUE;
+    } else if (timedOut) {
+        *connectionDoneP = TRUE;
+    } else if (eof) {
+        *connectionDoneP = TRUE;
     } else {
-        if (session.version.major >= 2)
-            handleReqTooNewHttpVersion(&session);
-        else if (!RequestValidURI(&session))
-            handleReqInvalidURI(&session);
+        bool const lastReqOnConn =
+            *requestCountP + 1 >= srvP->keepalivemaxconn;
+
+        bool keepalive;
+
+        trace(srvP, "HTTP request %u at least partially received.  "
+              "Receiving the rest and processing", *requestCountP);
+            
+        StatsAdd(statsP, &statsP->requests, 1);
+        if (*requestCountP > 0)
+            StatsAdd(statsP, &statsP->requestsOnReusedConn, 1);
+
+        StatsAdd(statsP, &statsP->connectionsActive, 1);
+
+        processRequestFromClient(connectionP, lastReqOnConn, srvP->timeout,
+                                 mayPark, requestCountP, parkedP,
+                                 &keepalive);
+
+        if (*parkedP)
+            trace(srvP, "HTTP request handler deferred the response");
         else
-            runUserHandler(&session, connectionP->server->srvP);
+            endRequest(connectionP, keepalive, requestCountP,
+                       connectionDoneP);
     }
+}
 
-    assert(session.status != 0);
 
-    if (session.responseStarted)
-        HTTPWriteEndChunk(&session);
-    else
-        ResponseError(&session);
 
-    *keepAliveP = HTTPKeepalive(&session);
+abyss_bool
+SessionDefer(TSession * const sessionP) {
+/*----------------------------------------------------------------------------
+   Tell the server that the handler for session *sessionP will send the
+   response later, maybe after it returns, and from any thread.  When it
+   has, it must call SessionComplete(), after which the session no longer
+   exists.
+
+   Return true iff the server can do that without keeping a thread waiting
+   for the response, which is the only reason to defer it.  Otherwise, we
+   don't do anything and the handler must respond before it returns, as
+   usual.  An event-driven server (ServerSetEventDriven()) can.
+
+   A server that is terminating waits for a deferred response only as long
+   as its request timeout (ServerSetTimeout()).  Even if ServerRun()
+   returns before the response is complete, the handler must call
+   SessionComplete(), before anyone frees the server.
+-----------------------------------------------------------------------------*/
+    bool success;
+
+    assert(sessionP->deferralP == NULL);
+
+    if (!sessionP->mayPark)
+        success = FALSE;
+    else {
+        struct sessionDeferral * deferralP;
+
+        MALLOCVAR(deferralP);
+
+        if (deferralP == NULL)
+            success = FALSE;
+        else {
+            deferralP->lockP = xmlrpc_lock_create();
+
+            if (deferralP->lockP == NULL) {
+                free(deferralP);
+                success = FALSE;
+            } else {
+                deferralP->handlerReturned = FALSE;
+                deferralP->completed       = FALSE;
+
+                sessionP->deferralP = deferralP;
+
+                success = TRUE;
+            }
+        }
+    }
+    return success;
+}
+
+
+
+void
+SessionComplete(TSession * const sessionP) {
+/*----------------------------------------------------------------------------
+   Tell the server that the handler for session *sessionP, which deferred
+   the response, has now sent all of it.
+
+   If the handler has returned, we finish the request ourselves (so this
+   may take as long as sending whatever is left of the response takes) and
+   give the connection back to the server.  Otherwise, the handler's
+   thread does that when the handler returns.
+-----------------------------------------------------------------------------*/
+    struct sessionDeferral * const deferralP = sessionP->deferralP;
+
+    bool handlerReturned;
+
+    assert(deferralP);
+
+    deferralP->lockP->acquire(deferralP->lockP);
+
+    assert(!deferralP->completed);
+
+    deferralP->completed = TRUE;
+
+    handlerReturned = deferralP->handlerReturned;
+
+    deferralP->lockP->release(deferralP->lockP);
+
+    if (handlerReturned) {
+        /* The request is parked; nobody but us is working on it */
+        TConn *        const connectionP   = sessionP->connP;
+        unsigned int * const requestCountP = sessionP->requestCountP;
+
+        bool keepalive;
+        bool connectionDone;
 
-    SessionLog(&session);
+        finishRequest(sessionP, &keepalive);
 
-    RequestFree(&session);
+        endRequest(connectionP, keepalive, requestCountP, &connectionDone);
+
+        EventLoopResumeConn(connectionP, connectionDone,
+                            RequestIsBuffered(connectionP));
+    }
 }
 
 
@@ -762,59 +1259,52 @@ serverFunc(void * const userHandle) {
     connectionDone = FALSE;
 
     while (!connectionDone) {
-        bool timedOut, eof;
-        const char * readError;
-        
-        /* Wait for and get beginning (at least ) of next request.  We do
-           this separately from getting the rest of the request because we
-           treat dead time between requests differently from dead time in
-           the middle of a request.
-        */
-        ConnRead(connectionP, srvP->keepalivetimeout,
-                 &timedOut, &eof, &readError);
-
-        if (srvP->terminationRequested) {
-            connectionDone = TRUE;
-        } else if (readError) {
-            TraceMsg("Failed to read from Abyss connection.  %s", readError);
-            xmlrpc_strfree(readError);
-            connectionDone = TRUE;
-        } else if (timedOut) {
-            connectionDone = TRUE;
-        } else if (eof) {
-            connectionDone = TRUE;
-        } else {
-            bool const lastReqOnConn =
-                requestCount + 1 >= srvP->keepalivemaxconn;
-
-            bool keepalive;
-
-            trace(srvP, "HTTP request %u at least partially received.  "
-                  "Receiving the rest and processing", requestCount);
-            
-            processRequestFromClient(connectionP, lastReqOnConn, srvP->timeout,
-                                     &keepalive);
+        bool parked;
 
-            trace(srvP, "Done processing the HTTP request.  Keepalive = %s",
-                  keepalive ? "YES" : "NO");
-            
-            ++requestCount;
+        serveNextRequest(connectionP, srvP->keepalivetimeout, FALSE,
+                         &requestCount, &connectionDone, &parked);
 
-            if (!keepalive)
-                connectionDone = TRUE;
-            
-            /**************** Must adjust the read buffer *****************/
-            ConnReadInit(connectionP);
-        }
+        assert(!parked);
     }
     trace(srvP, "PID %d done with connection", getpid());
 }
 
 
 
+static TEventLoopServeFn serveReadyConn;
+
+static void
+serveReadyConn(TConn *        const connectionP,
+               unsigned int * const requestCountP,
+               bool *         const connectionDoneP,
+               bool *         const parkedP) {
+/*----------------------------------------------------------------------------
+   This is what serverFunc() does each time a request starts to arrive,
+   for an event-driven server, where the event loop does the waiting
+   between requests.
+
+   We don't return until we've processed every whole request the client
+   has sent so far, because the event loop won't tell us about data that
+   is already in the connection buffer -- unless a handler defers its
+   response, in which case we return *parkedP true right away and
+   SessionComplete() takes it from there.  We leave part of a request in
+   the buffer for the event loop to get the rest of, rather than wait for
+   it ourselves.
+-----------------------------------------------------------------------------*/
+    struct _TServer * const srvP = connectionP->server->srvP;
+
+    do {
+        serveNextRequest(connectionP, srvP->timeout, TRUE,
+                         requestCountP, connectionDoneP, parkedP);
+    } while (!*parkedP && !*connectionDoneP &&
+             RequestIsBuffered(connectionP));
+}
+
+
+
 /* This is the maximum amount of stack space, in bytes, serverFunc()
-   itself requires -- not counting what the user's request handler
-   (which serverFunc() calls) requires.
+   (or serveReadyConn()) itself requires -- not counting what the user's
+   request handler (which serverFunc() calls) requires.
 */
 #define SERVER_FUNC_STACK 1024
 
@@ -860,52 +1350,115 @@ createChanSwitch(struct _TServer * const srvP,
 
 
 
-void
-ServerInit2(TServer *     const serverP,
-            const char ** const errorP) {
+static void
+createSiblingSwitches(struct _TServer * const srvP) {
 /*----------------------------------------------------------------------------
-   Initialize a server to accept connections.
-
-   Do not confuse this with creating the server -- ServerCreate().
+   Create the channel switches that, along with 'chanSwitchP', give each of
+   'acceptorThreads' threads a switch of its own, so they can accept
+   connections in parallel.
 
-   Not necessary or valid with a server that doesn't accept connections (i.e.
-   user supplies the channels (TCP connections)).
+   If we can't create them all, we settle for fewer, down to none (i.e.
+   one thread accepting connections, as if the user didn't ask for more).
 -----------------------------------------------------------------------------*/
-    struct _TServer * const srvP = serverP->srvP;
-    
-    if (!srvP->serverAcceptsConnections)
-        xmlrpc_asprintf(errorP,
-                        "ServerInit() is not valid on a server that doesn't "
-                        "accept connections "
-                        "(i.e. created with ServerCreateNoAccept)");
+    unsigned int const siblingCount = srvP->acceptorThreads - 1;
+
+    if (ThreadForks())
+        trace(srvP, "Can't have multiple threads accepting connections "
+              "because Abyss 'threads' are processes");
     else {
-        *errorP = NULL;  /* initial value */
+        MALLOCARRAY(srvP->siblingSwitches, siblingCount);
 
-        if (!srvP->chanSwitchP) {
+        if (srvP->siblingSwitches == NULL)
+            trace(srvP, "Can't allocate memory for %u channel switches",
+                  siblingCount);
+        else {
             const char * error;
-            createChanSwitch(srvP, &error);
 
-            if (error) {
-                xmlrpc_asprintf(errorP, "Unable to create a channel switch "
-                                "for the server.  %s", error);
-                xmlrpc_strfree(error);
+            for (error = NULL;
+                 srvP->siblingSwitchCount < siblingCount && !error; ) {
+
+                ChanSwitchCreateSibling(
+                    srvP->chanSwitchP,
+                    &srvP->siblingSwitches[srvP->siblingSwitchCount],
+                    &error);
+
+                if (error) {
+                    trace(srvP, "Can't create channel switch %u to accept "
+                          "connections at the same address.  %s",
+                          srvP->siblingSwitchCount + 2, error);
+                    xmlrpc_strfree(error);
+                } else
+                    ++srvP->siblingSwitchCount;
             }
         }
+    }
+}
 
-        if (!*errorP) {
-            const char * error;
 
-            assert(srvP->chanSwitchP);
 
-            ChanSwitchListen(srvP->chanSwitchP, srvP->maxConnBacklog, &error);
+static void
+listenAll(struct _TServer * const srvP,
+          const char **     const errorP) {
+
+    const char * error;
+    unsigned int i;
+
+    ChanSwitchListen(srvP->chanSwitchP, srvP->maxConnBacklog, &error);
+
+    for (i = 0; i < srvP->siblingSwitchCount && !error; ++i)
+        ChanSwitchListen(srvP->siblingSwitches[i], srvP->maxConnBacklog,
+                         &error);
+
+    if (error) {
+        xmlrpc_asprintf(errorP,
+                        "Failed to listen on bound socket.  %s", error);
+        xmlrpc_strfree(error);
+    } else
+        *errorP = NULL;
+}
+
+
+
+void
+ServerInit2(TServer *     const serverP,
+            const char ** const errorP) {
+/*----------------------------------------------------------------------------
+   Initialize a server to accept connections.
+
+   Do not confuse this with creating the server -- ServerCreate().
+
+   Not necessary or valid with a server that doesn't accept connections (i.e.
+   user supplies the channels (TCP connections)).
+-----------------------------------------------------------------------------*/
+    struct _TServer * const srvP = serverP->srvP;
+    
+    if (!srvP->serverAcceptsConnections)
+        xmlrpc_asprintf(errorP,
+                        "ServerInit() is not valid on a server that doesn't "
+                        "accept connections "
+                        "(i.e. created with ServerCreateNoAccept)");
+    else {
+        *errorP = NULL;  /* initial value */
+
+        if (!srvP->chanSwitchP) {
+            const char * error;
+            createChanSwitch(srvP, &error);
 
             if (error) {
-                xmlrpc_asprintf(errorP,
-                                "Failed to listen on bound socket.  %s",
-                                error);
+                xmlrpc_asprintf(errorP, "Unable to create a channel switch "
+                                "for the server.  %s", error);
                 xmlrpc_strfree(error);
             }
         }
+
+        if (!*errorP) {
+            assert(srvP->chanSwitchP);
+
+            if (srvP->acceptorThreads > 1 && srvP->siblingSwitchCount == 0)
+                createSiblingSwitches(srvP);
+
+            listenAll(srvP, errorP);
+        }
     }
 }
 
@@ -996,7 +1549,8 @@ freeFinishedConns(outstandingConnList * const listP) {
     while (*pp) {
         TConn * const connectionP = (*pp);
 
-        ThreadUpdateStatus(connectionP->threadP);
+        if (connectionP->hasOwnThread)
+            ThreadUpdateStatus(connectionP->threadP);
         
         if (connectionP->finished) {
             /* Take it out of the list */
@@ -1013,49 +1567,207 @@ freeFinishedConns(outstandingConnList * const listP) {
 
 
 
+struct acceptor {
+/*----------------------------------------------------------------------------
+   A thread accepting connections from one channel switch of a running
+   server, and what it knows about the connections it accepted.
+-----------------------------------------------------------------------------*/
+    TServer * serverP;
+    TChanSwitch * chanSwitchP;
+    outstandingConnList * outstandingConnListP;
+        /* The connections this acceptor gave threads of their own (or of
+           the worker pool), which it has not yet seen finish.
+        */
+    TEventLoop * eventLoopP;
+        /* The server's event loop, shared by all its acceptors.  Null if
+           the server isn't event-driven.
+        */
+    TWorkerPool * workerPoolP;
+        /* The server's worker pool, shared by all its acceptors.  Null if
+           connections get threads of their own.
+        */
+#ifndef _WIN32
+    int connFinishedPipe[2];
+        /* A pipe through which connections tell this acceptor they are
+           finished (see ServerNoteConnFinished()), so it need not poll while
+           waiting for a connection to finish.  [0] is the read end.  -1 if
+           we couldn't make a pipe.
+        */
+#endif
+    TThread * threadP;
+        /* The thread running this acceptor.  Null for the one that runs
+           in ServerRun()'s own thread.
+        */
+    const char * error;
+        /* Why the acceptor stopped accepting, if not because the server
+           was told to terminate.
+        */
+};
+
+
+
+#ifndef _WIN32
+static void
+createConnFinishedPipe(struct acceptor * const acceptorP) {
+/*----------------------------------------------------------------------------
+   Create the pipe through which connections tell us they are finished.  If
+   we can't, we just do without it.
+-----------------------------------------------------------------------------*/
+    struct _TServer * const srvP = acceptorP->serverP->srvP;
+
+    int pipeFd[2];
+    int rc;
+
+    rc = pipe(pipeFd);
+
+    if (rc != 0) {
+        trace(srvP, "Unable to create a pipe for connections to report "
+              "finishing.  errno=%d (%s)", errno, strerror(errno));
+        acceptorP->connFinishedPipe[0] = acceptorP->connFinishedPipe[1] = -1;
+    } else {
+        /* Neither the reader nor the writer should ever wait for the
+           other: a full pipe is as good as one more byte in it.
+        */
+        fcntl(pipeFd[0], F_SETFL, O_NONBLOCK);
+        fcntl(pipeFd[1], F_SETFL, O_NONBLOCK);
+        fcntl(pipeFd[0], F_SETFD, FD_CLOEXEC);
+        fcntl(pipeFd[1], F_SETFD, FD_CLOEXEC);
+
+        acceptorP->connFinishedPipe[0] = pipeFd[0];
+        acceptorP->connFinishedPipe[1] = pipeFd[1];
+    }
+}
+
+
+
+static void
+destroyConnFinishedPipe(struct acceptor * const acceptorP) {
+
+    if (acceptorP->connFinishedPipe[0] >= 0) {
+        close(acceptorP->connFinishedPipe[0]);
+        close(acceptorP->connFinishedPipe[1]);
+    }
+}
+#endif
+
+
+
+void
+ServerNoteConnFinished(TServer * const serverP) {
+/*----------------------------------------------------------------------------
+   Note that a connection of server *serverP has finished, so that the
+   server can stop waiting for one to finish.
+
+   Connections call this from their own threads, and with fork threads,
+   from a SIGCHLD handler in the server's process.  That's why all we do is
+   write to a pipe.
+
+   We don't know which acceptor accepted the connection, so we tell them
+   all.
+-----------------------------------------------------------------------------*/
+#ifndef _WIN32
+    struct _TServer * const srvP = serverP->srvP;
+
+    unsigned int i;
+
+    for (i = 0; i < srvP->acceptorCount; ++i) {
+        int const fd = srvP->acceptors[i].connFinishedPipe[1];
+
+        if (fd >= 0) {
+            unsigned char const zero[1] = {0u};
+
+            /* If this fails, it's because the pipe is full, which means
+               the acceptor will notice anyway.
+            */
+            write(fd, &zero, sizeof(zero));
+        }
+    }
+#endif
+}
+
+
+
 static void
-waitForConnectionFreed(outstandingConnList * const outstandingConnListP
-                       ATTR_UNUSED) {
+clearConnFinishedNotes(struct acceptor * const acceptorP) {
+/*----------------------------------------------------------------------------
+   Forget about connections that have finished so far.  Call this before
+   looking for finished connections, so that a connection that finishes
+   after we looked gets noticed by waitForConnectionFreed().
+-----------------------------------------------------------------------------*/
+#ifndef _WIN32
+    if (acceptorP->connFinishedPipe[0] >= 0) {
+        unsigned char buffer[256];
+
+        while (read(acceptorP->connFinishedPipe[0],
+                    buffer, sizeof(buffer)) > 0);
+    }
+#endif
+}
+
+
+
+static void
+waitForConnectionFreed(struct acceptor * const acceptorP) {
 /*----------------------------------------------------------------------------
   Wait for a connection descriptor in 'connectionPool' to be probably
-  freed.
+  freed, i.e. until a connection reports it has finished since the last
+  clearConnFinishedNotes().
+
+  Where a connection can't report that (fork threads without a SIGCHLD
+  handler, or no pipe), we just wait a while; the caller polls.
 -----------------------------------------------------------------------------*/
+    unsigned int const pollInterval = 2000;
 
-    /* TODO: We should do something more sophisticated here.  For pthreads,
-       we can have a thread signal us by semaphore when it terminates.
-       For fork, we might be able to use the "done" handler argument
-       to ConnCreate() to get interrupted when the death of a child
-       signal happens.
-    */
+#ifndef _WIN32
+    if (acceptorP->connFinishedPipe[0] >= 0) {
+        struct pollfd pollfd;
+
+        pollfd.fd      = acceptorP->connFinishedPipe[0];
+        pollfd.events  = POLLIN;
+        pollfd.revents = 0;
 
-    xmlrpc_millisecond_sleep(2000);
+        poll(&pollfd, 1, pollInterval);
+    } else
+#endif
+        xmlrpc_millisecond_sleep(pollInterval);
 }
 
 
 
 static void
-waitForNoConnections(outstandingConnList * const outstandingConnListP) {
+waitForNoConnections(struct acceptor * const acceptorP) {
+
+    outstandingConnList * const outstandingConnListP =
+        acceptorP->outstandingConnListP;
 
     while (outstandingConnListP->firstP) {
+        clearConnFinishedNotes(acceptorP);
+
         freeFinishedConns(outstandingConnListP);
     
         if (outstandingConnListP->firstP)
-            waitForConnectionFreed(outstandingConnListP);
+            waitForConnectionFreed(acceptorP);
     }
 }
 
 
 
 static void
-waitForConnectionCapacity(outstandingConnList * const outstandingConnListP,
-                          unsigned int          const maxConn) {
+waitForConnectionCapacity(struct acceptor * const acceptorP,
+                          unsigned int      const maxConn) {
 /*----------------------------------------------------------------------------
    Wait until there are fewer than 'maxConn' connections in progress.
 -----------------------------------------------------------------------------*/
+    outstandingConnList * const outstandingConnListP =
+        acceptorP->outstandingConnListP;
+
     while (outstandingConnListP->count >= maxConn) {
+        clearConnFinishedNotes(acceptorP);
+
         freeFinishedConns(outstandingConnListP);
-        if (outstandingConnListP->firstP)
-            waitForConnectionFreed(outstandingConnListP);
+
+        if (outstandingConnListP->count >= maxConn)
+            waitForConnectionFreed(acceptorP);
     }
 }
 
@@ -1072,12 +1784,7 @@ interruptChannels(outstandingConnList * const outstandingConnListP) {
     for (connP = outstandingConnListP->firstP;
          connP; connP = connP->nextOutstandingP) {
 
-        if (connP->finished) {
-            /* The connection couldn't be waiting on the channel, and the
-               channel probably doesn't even exit anymore.
-            */
-        } else 
-            ChannelInterrupt(connP->channelP);
+        ConnInterrupt(connP);
     }
 }
 
@@ -1127,33 +1834,73 @@ destroyChannel(void * const userHandle) {
 
 
 static void
-processNewChannel(TServer *             const serverP,
-                  TChannel *            const channelP,
-                  void *                const channelInfoP,
-                  outstandingConnList * const outstandingConnListP,
-                  const char **         const errorP) {
+giveChannelToEventLoop(TServer *     const serverP,
+                       TChannel *    const channelP,
+                       void *        const channelInfoP,
+                       TEventLoop *  const eventLoopP,
+                       const char ** const errorP) {
+
+    struct _TServer * const srvP = serverP->srvP;
+
+    TConn * connectionP;
+    const char * error;
+
+    /* The connection has no job to run; the event loop processes it
+       piecemeal with serveReadyConn().
+    */
+    ConnCreate(&connectionP, serverP, channelP, channelInfoP,
+               NULL, 0, &destroyChannel, ABYSS_FOREGROUND,
+               srvP->useSigchld, NULL,
+               &error);
+    if (!error) {
+        EventLoopAddConn(eventLoopP, connectionP, &error);
+
+        if (error)
+            ConnWaitAndRelease(connectionP);
+    }
+    if (error) {
+        xmlrpc_asprintf(
+            errorP, "Failed to create an Abyss connection.  %s", error);
+        xmlrpc_strfree(error);
+    } else
+        *errorP = NULL;
+}
+
+
+
+static void
+giveChannelToThread(TServer *         const serverP,
+                    TChannel *        const channelP,
+                    void *            const channelInfoP,
+                    struct acceptor * const acceptorP,
+                    const char **     const errorP) {
+/*----------------------------------------------------------------------------
+   Have a background thread serve channel *channelP: a thread of the
+   acceptor's worker pool, or a new one if it has none.
+-----------------------------------------------------------------------------*/
 
     struct _TServer * const srvP = serverP->srvP;
                       
     TConn * connectionP;
     const char * error;
 
-    freeFinishedConns(outstandingConnListP);
+    freeFinishedConns(acceptorP->outstandingConnListP);
             
     trace(srvP, "Waiting for there to be fewer than the maximum "
           "%u sessions in progress",
           srvP->maxConn);
 
-    waitForConnectionCapacity(outstandingConnListP, srvP->maxConn);
+    waitForConnectionCapacity(acceptorP, srvP->maxConn);
             
     ConnCreate(&connectionP, serverP, channelP, channelInfoP,
                &serverFunc,
                SERVER_FUNC_STACK + srvP->uriHandlerStackSize,
                &destroyChannel, ABYSS_BACKGROUND,
-               srvP->useSigchld,
+               srvP->useSigchld, acceptorP->workerPoolP,
                &error);
     if (!error) {
-        addToOutstandingConnList(outstandingConnListP, connectionP);
+        addToOutstandingConnList(acceptorP->outstandingConnListP,
+                                 connectionP);
         ConnProcess(connectionP);
         /* When connection is done (which could be later, courtesy of a
            background thread), destroyChannel() will destroy *channelP.
@@ -1169,11 +1916,42 @@ processNewChannel(TServer *             const serverP,
 
 
 static void
-acceptAndProcessNextConnection(
-    TServer *             const serverP,
-    outstandingConnList * const outstandingConnListP,
-    const char **         const errorP) {
+processNewChannel(TServer *         const serverP,
+                  TChannel *        const channelP,
+                  void *            const channelInfoP,
+                  struct acceptor * const acceptorP,
+                  const char **     const errorP) {
+/*----------------------------------------------------------------------------
+   Start serving HTTP requests on new channel *channelP.
+
+   If the server has an event loop, we let it serve the channel, except for
+   a channel the event loop can't watch, which gets a thread like on a
+   server without an event loop.
+-----------------------------------------------------------------------------*/
+    bool haveOsSocket;
+
+    if (acceptorP->eventLoopP) {
+        TOsSocket osSocket;
+
+        ChannelOsSocket(channelP, &haveOsSocket, &osSocket);
+    } else
+        haveOsSocket = FALSE;
+
+    if (haveOsSocket)
+        giveChannelToEventLoop(serverP, channelP, channelInfoP,
+                               acceptorP->eventLoopP, errorP);
+    else
+        giveChannelToThread(serverP, channelP, channelInfoP, acceptorP,
+                            errorP);
+}
+
+
+
+static void
+acceptAndProcessNextConnection(struct acceptor * const acceptorP,
+                               const char **     const errorP) {
 
+    TServer * const serverP = acceptorP->serverP;
     struct _TServer * const srvP = serverP->srvP;
 
     const char * error;
@@ -1182,7 +1960,8 @@ acceptAndProcessNextConnection(
 
     trace(srvP, "Waiting for a new channel from channel switch");
         
-    ChanSwitchAccept(srvP->chanSwitchP, &channelP, &channelInfoP, &error);
+    ChanSwitchAccept(acceptorP->chanSwitchP, &channelP, &channelInfoP,
+                     &error);
     
     if (error) {
         xmlrpc_asprintf(errorP,
@@ -1195,8 +1974,10 @@ acceptAndProcessNextConnection(
 
             trace(srvP, "Got a new channel from channel switch");
 
-            processNewChannel(serverP, channelP, channelInfoP,
-                              outstandingConnListP, &error);
+            StatsAdd(&srvP->stats, &srvP->stats.connectionsAccepted, 1);
+
+            processNewChannel(serverP, channelP, channelInfoP, acceptorP,
+                              &error);
 
             if (error) {
                 xmlrpc_asprintf(errorP, "Failed to use new channel %lx",
@@ -1219,37 +2000,282 @@ acceptAndProcessNextConnection(
 
 
 
-static void 
-serverRun2(TServer *     const serverP,
-           const char ** const errorP) {
+static void
+createEventLoop(struct _TServer * const srvP,
+                TEventLoop **     const eventLoopPP) {
+/*----------------------------------------------------------------------------
+   Create the event loop for server *srvP, if it is supposed to be
+   event-driven.  Return *eventLoopPP == NULL if it isn't, or if it can't
+   be here, in which case it works with a thread per connection instead.
+-----------------------------------------------------------------------------*/
+    *eventLoopPP = NULL;
 
-    struct _TServer * const srvP = serverP->srvP;
-    outstandingConnList * outstandingConnListP;
+    if (srvP->eventDriven) {
+        if (ThreadForks())
+            trace(srvP, "Can't be event-driven because Abyss 'threads' "
+                  "are processes");
+        else {
+            const char * error;
 
-    createOutstandingConnList(&outstandingConnListP);
+            EventLoopCreate(eventLoopPP, srvP->maxConn,
+                            SERVER_FUNC_STACK + srvP->uriHandlerStackSize,
+                            srvP->keepalivetimeout, srvP->timeout,
+                            &serveReadyConn, &error);
+
+            if (error) {
+                trace(srvP, "Can't be event-driven.  %s", error);
+                xmlrpc_strfree(error);
+                *eventLoopPP = NULL;
+            }
+        }
+    }
+}
+
+
+
+static void
+createWorkerPool(struct _TServer * const srvP,
+                 TWorkerPool **    const workerPoolPP) {
+/*----------------------------------------------------------------------------
+   Create the pool of threads that serve connections for server *srvP, if
+   it is supposed to have one.  Return *workerPoolPP == NULL if it isn't,
+   or if it can't have one here, in which case each connection gets a
+   thread of its own instead.
+
+   Because each of the server's acceptors never has more than 'maxConn'
+   connections in progress, submitting one to the pool never has to wait
+   for queue space.
+-----------------------------------------------------------------------------*/
+    unsigned int const acceptorCount = 1 + srvP->siblingSwitchCount;
+
+    *workerPoolPP = NULL;
+
+    if (srvP->workerThreads > 0) {
+        if (ThreadForks())
+            trace(srvP, "Can't have a worker pool because Abyss 'threads' "
+                  "are processes");
+        else {
+            const char * error;
+
+            WorkerPoolCreate(workerPoolPP, srvP->workerThreads,
+                             srvP->maxConn * acceptorCount,
+                             SERVER_FUNC_STACK + srvP->uriHandlerStackSize,
+                             &error);
+
+            if (error) {
+                trace(srvP, "Can't have a worker pool.  %s", error);
+                xmlrpc_strfree(error);
+                *workerPoolPP = NULL;
+            }
+        }
+    }
+}
 
-    *errorP = NULL;  /* initial value */
+
+
+static void
+acceptConnections(struct acceptor * const acceptorP) {
+/*----------------------------------------------------------------------------
+   Accept connections from the acceptor's channel switch and start serving
+   them, until the server is told to terminate or we fail.  Then wait for
+   the connections we gave threads to finish.
+
+   If we fail, we tell the server's other acceptors to stop too.
+-----------------------------------------------------------------------------*/
+    TServer * const serverP = acceptorP->serverP;
+    struct _TServer * const srvP = serverP->srvP;
+
+    acceptorP->error = NULL;  /* initial value */
 
     trace(srvP, "Starting main connection accepting loop");
     
-    while (!srvP->terminationRequested && !*errorP)
-        acceptAndProcessNextConnection(serverP, outstandingConnListP, errorP);
+    while (!srvP->terminationRequested && !acceptorP->error)
+        acceptAndProcessNextConnection(acceptorP, &acceptorP->error);
 
     trace(srvP, "Main connection accepting loop is done");
 
-    if (!*errorP) {
-        trace(srvP, "Interrupting and waiting for %u existing connections "
-              "to finish",
-              outstandingConnListP->count);
+    if (acceptorP->error)
+        ServerTerminate(serverP);
+
+    trace(srvP, "Interrupting and waiting for %u existing connections "
+          "to finish",
+          acceptorP->outstandingConnListP->count);
 
-        interruptChannels(outstandingConnListP);
+    interruptChannels(acceptorP->outstandingConnListP);
 
-        waitForNoConnections(outstandingConnListP);
+    waitForNoConnections(acceptorP);
     
-        trace(srvP, "No connections left");
+    trace(srvP, "No connections left");
+}
+
+
+
+static TThreadProc acceptorThread;
+
+static void
+acceptorThread(void * const userHandle) {
+
+    acceptConnections((struct acceptor *)userHandle);
+}
+
 
-        destroyOutstandingConnList(outstandingConnListP);
+
+static TThreadDoneFn acceptorThreadDone;
+
+static void
+acceptorThreadDone(void * const userHandle ATTR_UNUSED) {
+
+}
+
+
+
+static void
+startAcceptorThread(struct acceptor * const acceptorP,
+                    const char **     const errorP) {
+
+    ThreadCreate(&acceptorP->threadP, acceptorP, &acceptorThread,
+                 &acceptorThreadDone, FALSE, 0, errorP);
+
+    if (!*errorP) {
+        if (!ThreadRun(acceptorP->threadP)) {
+            xmlrpc_asprintf(errorP, "Failed to start thread");
+            ThreadRelease(acceptorP->threadP);
+        }
+    }
+    if (*errorP)
+        acceptorP->threadP = NULL;
+}
+
+
+
+static void
+createAcceptors(TServer *     const serverP,
+                TEventLoop *  const eventLoopP,
+                TWorkerPool * const workerPoolP) {
+/*----------------------------------------------------------------------------
+   Create the server's acceptors: one for its channel switch and one for
+   each of its sibling switches.  Don't start their threads.
+-----------------------------------------------------------------------------*/
+    struct _TServer * const srvP = serverP->srvP;
+    unsigned int const acceptorCount = 1 + srvP->siblingSwitchCount;
+
+    struct acceptor * acceptors;
+    unsigned int i;
+
+    MALLOCARRAY_NOFAIL(acceptors, acceptorCount);
+
+    for (i = 0; i < acceptorCount; ++i) {
+        struct acceptor * const acceptorP = &acceptors[i];
+
+        acceptorP->serverP     = serverP;
+        acceptorP->chanSwitchP =
+            i == 0 ? srvP->chanSwitchP : srvP->siblingSwitches[i-1];
+        acceptorP->eventLoopP  = eventLoopP;
+        acceptorP->workerPoolP = workerPoolP;
+        acceptorP->threadP     = NULL;
+        acceptorP->error       = NULL;
+
+        createOutstandingConnList(&acceptorP->outstandingConnListP);
+#ifndef _WIN32
+        createConnFinishedPipe(acceptorP);
+#endif
     }
+    srvP->acceptors     = acceptors;
+    srvP->acceptorCount = acceptorCount;
+}
+
+
+
+static void
+destroyAcceptors(struct _TServer * const srvP) {
+
+    struct acceptor * const acceptors = srvP->acceptors;
+    unsigned int const acceptorCount = srvP->acceptorCount;
+
+    unsigned int i;
+
+    /* Connections no longer report to the acceptors */
+    srvP->acceptorCount = 0;
+    srvP->acceptors     = NULL;
+
+    for (i = 0; i < acceptorCount; ++i) {
+#ifndef _WIN32
+        destroyConnFinishedPipe(&acceptors[i]);
+#endif
+        destroyOutstandingConnList(acceptors[i].outstandingConnListP);
+
+        if (acceptors[i].error)
+            xmlrpc_strfree(acceptors[i].error);
+    }
+    free(acceptors);
+}
+
+
+
+static void
+runAcceptors(struct _TServer * const srvP,
+             const char **     const errorP) {
+/*----------------------------------------------------------------------------
+   Run the server's acceptors until they stop: all but the first in
+   threads of their own, the first in this thread.
+-----------------------------------------------------------------------------*/
+    const char * error;
+    unsigned int i;
+
+    for (i = 1, error = NULL; i < srvP->acceptorCount && !error; ++i)
+        startAcceptorThread(&srvP->acceptors[i], &error);
+
+    if (error) {
+        /* Can't leave a switch with no one to accept from it */
+        xmlrpc_asprintf(errorP, "Unable to create a thread to accept "
+                        "connections.  %s", error);
+        xmlrpc_strfree(error);
+        ServerTerminate(srvP->acceptors[0].serverP);
+    } else
+        *errorP = NULL;
+
+    acceptConnections(&srvP->acceptors[0]);
+
+    for (i = 1; i < srvP->acceptorCount; ++i) {
+        if (srvP->acceptors[i].threadP)
+            ThreadWaitAndRelease(srvP->acceptors[i].threadP);
+    }
+    for (i = 0; i < srvP->acceptorCount && !*errorP; ++i) {
+        if (srvP->acceptors[i].error)
+            xmlrpc_asprintf(errorP, "%s", srvP->acceptors[i].error);
+    }
+}
+
+
+
+static void 
+serverRun2(TServer *     const serverP,
+           const char ** const errorP) {
+
+    struct _TServer * const srvP = serverP->srvP;
+    TEventLoop * eventLoopP;
+    TWorkerPool * workerPoolP;
+
+    createEventLoop(srvP, &eventLoopP);
+
+    if (eventLoopP)
+        workerPoolP = NULL;
+    else
+        createWorkerPool(srvP, &workerPoolP);
+
+    createAcceptors(serverP, eventLoopP, workerPoolP);
+
+    runAcceptors(srvP, errorP);
+
+    if (eventLoopP) {
+        trace(srvP, "Stopping the event loop and closing its connections");
+
+        EventLoopDestroy(eventLoopP);
+    }
+    if (workerPoolP)
+        WorkerPoolDestroy(workerPoolP);
+
+    destroyAcceptors(srvP);
 }
 
 
@@ -1301,11 +2327,12 @@ serverRunChannel(TServer *     const serverP,
     trace(srvP, "%s entered", __FUNCTION__);
 
     srvP->keepalivemaxconn = 1;
+    renderKeepaliveFields(srvP);
 
     ConnCreate(&connectionP, 
                serverP, channelP, channelInfoP,
                &serverFunc, SERVER_FUNC_STACK + srvP->uriHandlerStackSize,
-               NULL, ABYSS_FOREGROUND, srvP->useSigchld,
+               NULL, ABYSS_FOREGROUND, srvP->useSigchld, NULL,
                &error);
     if (error) {
         xmlrpc_asprintf(errorP, "Couldn't create HTTP connection out of "
@@ -1428,6 +2455,7 @@ ServerRunOnce(TServer * const serverP) {
         void *       channelInfoP;
     
         srvP->keepalivemaxconn = 1;
+        renderKeepaliveFields(srvP);
 
         ChanSwitchAccept(srvP->chanSwitchP, &channelP, &channelInfoP, &error);
         if (error) {
@@ -8,6 +8,8 @@
 #include "xmlrpc-c/abyss.h"
 
 #include "data.h"
+#include "date.h"
+#include "stats.h"
 
 struct TFile;
 
@@ -32,6 +34,22 @@ struct _TServer {
         /* We created the channel switch 'chanSwitchP', as
            opposed to 1) User supplied it; or 2) there isn't one.
         */
+    TChanSwitch ** siblingSwitches;
+        /* Channel switches we created that accept connections at the same
+           address as 'chanSwitchP' (see ChanSwitchCreateSibling()).  There
+           are 'siblingSwitchCount' of them.
+        */
+    unsigned int siblingSwitchCount;
+    unsigned int acceptorThreads;
+        /* Number of threads that should accept connections, each from a
+           channel switch of its own: 'chanSwitchP' and its siblings.
+        */
+    struct acceptor * acceptors;
+        /* While the server is running (ServerRun()), the accepting threads,
+           one per channel switch.  There are 'acceptorCount' of them.
+           Otherwise, 'acceptorCount' is zero.
+        */
+    unsigned int acceptorCount;
     const char * logfilename;
     bool logfileisopen;
     struct TFile * logfileP;
@@ -48,6 +66,11 @@ struct _TServer {
         */
     uint32_t keepalivetimeout;
     uint32_t keepalivemaxconn;
+    char keepaliveFields[96];
+        /* The HTTP Connection and Keep-Alive header field lines for a
+           response on a connection we keep alive, pre-rendered from
+           'keepalivetimeout' and 'keepalivemaxconn'.
+        */
     uint32_t timeout;
         /* Maximum time in seconds the server will wait to read a header
            or a data chunk from the channel.
@@ -81,6 +104,20 @@ struct _TServer {
         */
     void * builtinHandlerP;
     bool advertise;
+    lock * dateLockP;
+        /* Protects 'dateTime' and 'dateString' */
+    lock * channelLockP;
+        /* Protects the 'channelGone' member of the connections, so that a
+           connection doesn't destroy its channel while another thread is
+           interrupting it.  See ConnInterrupt().
+        */
+    time_t dateTime;
+    char dateString[DATE_STRING_SIZE];
+        /* The value of the HTTP Date header field for time 'dateTime'.
+           Responses within the same second share it instead of each
+           formatting the date.  Empty if no response has had a Date field
+           yet.
+        */
     bool useSigchld;
         /* Meaningless if not using forking for threads.
            TRUE means user will call ServerHandleSigchld to indicate that
@@ -89,6 +126,27 @@ struct _TServer {
            be aware of SIGCHLD and will instead poll for existence of PIDs
            to determine if a child has died.
         */
+    unsigned int workerThreads;
+        /* Number of threads in the worker pool that processes connections.
+           Zero means there is no pool; each connection gets a thread of its
+           own.  Meaningless if 'eventDriven'.
+        */
+    bool eventDriven;
+        /* Serve connections with an event loop (see eventloop.h) instead of
+           a thread per connection, where we can.  'maxConn' is then the
+           number of worker threads, and there is no limit on the number of
+           connections.
+        */
+    uint32_t readBufferSize;
+        /* Size of the buffer each connection gets for reading requests.
+           It grows if a request header doesn't fit.
+        */
+    const char * statsUri;
+        /* The URI at which the built-in statistics handler serves the
+           statistics in 'stats' (see HandlerStats()).  NULL means it
+           doesn't.
+        */
+    TStats stats;
     size_t uriHandlerStackSize;
         /* The maximum amount of stack any URI handler request handler
            function will use.  Note that this is just the requirement
@@ -102,4 +160,7 @@ struct _TServer {
     struct TFile * pidfileP;
 };
 
+void
+ServerNoteConnFinished(TServer * const serverP);
+
 #endif
@@ -1,4 +1,5 @@
 #include <assert.h>
+#include <limits.h>
 #include <sys/types.h>
 #include <string.h>
 #include <stdio.h>
@@ -90,11 +91,79 @@ SessionGetReadData(TSession *    const sessionP,
     /* move pointer past the bytes we are returning */
     sessionP->connP->bufferpos += *outLenP;
 
+    sessionP->bodyBytesRead += *outLenP;
+
     assert(sessionP->connP->bufferpos <= sessionP->connP->buffersize);
 }
 
 
 
+abyss_bool
+SessionReadBody(TSession * const sessionP,
+                char *     const buffer,
+                size_t     const size,
+                size_t *   const bytesReadP) {
+/*----------------------------------------------------------------------------
+   Get up to 'size' (which is positive) bytes of HTTP request body into
+   'buffer', and return how many as *bytesReadP.
+
+   If the server has already read and buffered some of the body, we get
+   that.  Otherwise, we read the channel straight into 'buffer', so a
+   large body arrives in large pieces, without being copied through the
+   session's buffer.  We wait for data to arrive, but no longer than the
+   server's timeout.
+
+   Return false if we can't get any data.
+-----------------------------------------------------------------------------*/
+    bool failed;
+
+    assert(size > 0);
+
+    if (SessionReadDataAvail(sessionP) > 0) {
+        const char * chunk;
+        size_t chunkLen;
+
+        SessionGetReadData(sessionP, size, &chunk, &chunkLen);
+
+        memcpy(buffer, chunk, chunkLen);
+
+        *bytesReadP = chunkLen;
+
+        failed = FALSE;
+    } else {
+        struct _TServer * const srvP = sessionP->connP->server->srvP;
+
+        /* Empty our read buffer, since we won't be using it */
+        ConnReadInit(sessionP->connP);
+
+        if (sessionP->continueRequired)
+            failed = !HTTPWriteContinue(sessionP);
+        else
+            failed = FALSE;
+
+        if (!failed) {
+            uint32_t bytesRead;
+            const char * readError;
+
+            sessionP->continueRequired = FALSE;
+
+            ConnReadDirect(sessionP->connP, srvP->timeout,
+                           buffer, (uint32_t)MIN(size, INT_MAX),
+                           &bytesRead, &readError);
+            if (readError) {
+                failed = TRUE;
+                xmlrpc_strfree(readError);
+            } else {
+                *bytesReadP = bytesRead;
+                sessionP->bodyBytesRead += bytesRead;
+            }
+        }
+    }
+    return !failed;
+}
+
+
+
 void
 SessionGetRequestInfo(TSession *            const sessionP,
                       const TRequestInfo ** const requestInfoPP) {
@@ -2,6 +2,7 @@
 #define SESSION_H_INCLUDED
 
 #include "xmlrpc-c/abyss.h"
+#include "xmlrpc-c/time_int.h"
 #include "bool.h"
 #include "date.h"
 #include "data.h"
@@ -11,6 +12,41 @@ typedef struct {
     uint8_t minor;
 } httpVersion;
 
+enum requestField {
+    /* HTTP request header fields Abyss knows by name.  For these, a session
+       remembers where the field is, so finding it takes no search.
+    */
+    RF_AUTHORIZATION,
+    RF_CONNECTION,
+    RF_CONTENT_LENGTH,
+    RF_CONTENT_TYPE,
+    RF_COOKIE,
+    RF_COOKIES,
+    RF_EXPECT,
+    RF_FROM,
+    RF_HOST,
+    RF_IF_MODIFIED_SINCE,
+    RF_RANGE,
+    RF_REFERER,
+    RF_USER_AGENT,
+    RF_COUNT
+};
+
+typedef struct {
+    uint32_t name;
+    uint32_t value;
+        /* Positions in the session's header buffer of the field name (in
+           lower case) and value, each NUL-terminated.
+        */
+} fieldSlice;
+
+#define REQUEST_FIELD_SLOTS 32
+    /* Number of request header fields a session can hold without
+       allocating memory
+    */
+
+#define NO_FIELD (~0u)
+
 struct _TSession {
     bool validRequest;
         /* Client has sent, and server has recognized, a valid HTTP request.
@@ -51,10 +87,24 @@ struct _TSession {
 
     httpVersion version;
 
-    TTable requestHeaderFields;
-        /* All the fields of the header of the HTTP request.  The key is the
-           field name in lower case.  The value is the verbatim value from
-           the field.
+    const char * headerBuffer;
+        /* The connection buffer that holds the header of the HTTP
+           request, which the connection keeps for the life of the session
+           (see ConnHoldBuffer()).  NULL until we have read the whole
+           header.
+        */
+    fieldSlice * requestFields;
+        /* All the fields of the header of the HTTP request, in order, as
+           positions in the header buffer.  There are 'requestFieldCount' of
+           them.  This is 'requestFieldSlot' unless there are more fields
+           than fit there, in which case it is malloc'ed.
+        */
+    unsigned int requestFieldCount;
+    unsigned int requestFieldAlloc;
+    fieldSlice requestFieldSlot[REQUEST_FIELD_SLOTS];
+    unsigned int knownRequestField[RF_COUNT];
+        /* knownRequestField[X] is the index in requestFields[] of the
+           first field of known kind X, or NO_FIELD if there is none.
         */
 
     TTable responseHeaderFields;
@@ -76,10 +126,34 @@ struct _TSession {
     bool chunkedwrite;
     bool chunkedwritemode;
 
+    uint64_t bodyBytesRead;
+        /* How much of the request body the handler has read */
+
     bool continueRequired;
         /* This client must receive 100 (continue) status before it will
            send more of the body of the request.
         */
+
+    xmlrpc_timespec startTime;
+    xmlrpc_timespec headerTime;
+    uint64_t headerReadTime;
+        /* When the server started on the request and when it had read and
+           parsed the header, and how many microseconds of that it spent
+           reading.  For statistics.
+        */
+
+    unsigned int * requestCountP;
+        /* The server's count of requests processed on the connection,
+           which it updates when it is through with this one.
+        */
+    bool mayPark;
+        /* If the handler defers the response (SessionDefer()), the server
+           need not keep a thread waiting for it.
+        */
+    struct sessionDeferral * deferralP;
+        /* How the handler's deferred response is going.  NULL if the
+           handler has not deferred it.
+        */
 };
 
 
@@ -499,6 +499,21 @@ channelFormatPeerInfo(TChannel *    const channelP,
 
 
 
+static ChannelOsSocketImpl channelOsSocket;
+
+static void
+channelOsSocket(TChannel *  const channelP,
+                bool *      const haveSocketP,
+                TOsSocket * const osSocketP) {
+
+    struct socketUnix * const socketUnixP = channelP->implP;
+
+    *haveSocketP = TRUE;
+    *osSocketP   = socketUnixP->fd;
+}
+
+
+
 static struct TChannelVtbl const channelVtbl = {
     &channelDestroy,
     &channelWrite,
@@ -506,6 +521,7 @@ static struct TChannelVtbl const channelVtbl = {
     &channelWait,
     &channelInterrupt,
     &channelFormatPeerInfo,
+    &channelOsSocket,
 };
 
 
@@ -844,11 +860,15 @@ chanSwitchInterrupt(TChanSwitch * const chanSwitchP) {
 
 
 
+static SwitchCreateSiblingImpl chanSwitchCreateSibling;
+    /* Defined below, with the other switch creation functions */
+
 static struct TChanSwitchVtbl const chanSwitchVtbl = {
     &chanSwitchDestroy,
     &chanSwitchListen,
     &chanSwitchAccept,
     &chanSwitchInterrupt,
+    &chanSwitchCreateSibling,
 };
 
 
@@ -1017,6 +1037,87 @@ bindSocketToPortInet6(int                     const fd,
 
 
 
+static void
+setReusePort(int           const fd,
+             const char ** const errorP) {
+/*----------------------------------------------------------------------------
+   Let other sockets bind to the same address as socket 'fd', and have the
+   OS divide incoming connections among all of them.
+-----------------------------------------------------------------------------*/
+#ifdef SO_REUSEPORT
+    int32_t n = 1;
+    int rc;
+
+    rc = setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, (char*)&n, sizeof(n));
+
+    if (rc < 0)
+        xmlrpc_asprintf(errorP, "Failed to set SO_REUSEPORT socket option.  "
+                        "setsockopt() failed with errno %d (%s)",
+                        errno, strerror(errno));
+    else
+        *errorP = NULL;
+#else
+    xmlrpc_asprintf(errorP, "This system has no SO_REUSEPORT socket option");
+#endif
+}
+
+
+
+static void
+chanSwitchCreateSibling(TChanSwitch *  const chanSwitchP,
+                        TChanSwitch ** const siblingPP,
+                        const char **  const errorP) {
+/*----------------------------------------------------------------------------
+   Create a switch with a socket bound to the same address as that of
+   *chanSwitchP.  We set SO_REUSEPORT on both sockets, which is what makes
+   that possible.
+-----------------------------------------------------------------------------*/
+    struct socketUnix * const socketUnixP = chanSwitchP->implP;
+
+    struct sockaddr_storage sockAddr;
+    socklen_t sockAddrLen;
+    int rc;
+
+    sockAddrLen = sizeof(sockAddr);
+
+    rc = getsockname(socketUnixP->fd, (struct sockaddr *)&sockAddr,
+                     &sockAddrLen);
+
+    if (rc != 0)
+        xmlrpc_asprintf(errorP, "Unable to get the address of the socket.  "
+                        "getsockname() failed with errno %d (%s)",
+                        errno, strerror(errno));
+    else {
+        setReusePort(socketUnixP->fd, errorP);
+
+        if (!*errorP) {
+            rc = socket(sockAddr.ss_family, SOCK_STREAM, 0);
+            if (rc < 0)
+                xmlrpc_asprintf(errorP, "socket() failed with errno %d (%s)",
+                                errno, strerror(errno));
+            else {
+                int const socketFd = rc;
+
+                setSocketOptions(socketFd, errorP);
+                if (!*errorP)
+                    setReusePort(socketFd, errorP);
+                if (!*errorP)
+                    bindSocketToPort(socketFd, (struct sockaddr *)&sockAddr,
+                                     sockAddrLen, errorP);
+                if (!*errorP) {
+                    bool const userSupplied = false;
+                    createChanSwitch(socketFd, userSupplied, siblingPP,
+                                     errorP);
+                }
+                if (*errorP)
+                    close(socketFd);
+            }
+        }
+    }
+}
+
+
+
 static void
 switchCreateIpV4Port(unsigned short          const portNumber,
                      TChanSwitch **          const chanSwitchPP,
@@ -0,0 +1,133 @@
+/*=============================================================================
+                                  stats.c
+===============================================================================
+  Server statistics.  See stats.h.
+=============================================================================*/
+
+#include "xmlrpc_config.h"
+
+#include <string.h>
+#include <time.h>
+
+#include "bool.h"
+#include "int.h"
+#include "xmlrpc-c/string_int.h"
+#include "xmlrpc-c/time_int.h"
+#include "xmlrpc-c/counter_int.h"
+#include "xmlrpc-c/lock_platform.h"
+#include "xmlrpc-c/abyss.h"
+
+#include "stats.h"
+
+
+
+void
+StatsInit(TStats *      const statsP,
+          const char ** const errorP) {
+
+    memset(statsP, 0, sizeof(*statsP));
+
+    statsP->startTime = time(NULL);
+
+#if HAVE_SYNC_FETCH_AND_ADD
+    statsP->lockP = NULL;
+    *errorP = NULL;
+#else
+    statsP->lockP = xmlrpc_lock_create();
+
+    if (statsP->lockP == NULL)
+        xmlrpc_asprintf(errorP, "Unable to create lock for statistics");
+    else
+        *errorP = NULL;
+#endif
+}
+
+
+
+void
+StatsTerm(TStats * const statsP) {
+
+    if (statsP->lockP)
+        statsP->lockP->destroy(statsP->lockP);
+}
+
+
+
+void
+StatsAdd(TStats *        const statsP,
+         TStatsCounter * const counterP,
+         int64_t         const delta) {
+/*----------------------------------------------------------------------------
+   Add 'delta', which may be negative, to counter *counterP, which is in
+   *statsP.
+-----------------------------------------------------------------------------*/
+    xmlrpc_counterAdd(counterP, statsP->lockP, delta);
+}
+
+
+
+static uint64_t
+counterValue(TStats *        const statsP,
+             TStatsCounter * const counterP) {
+
+    return xmlrpc_counterValue(counterP, statsP->lockP);
+}
+
+
+
+void
+StatsAddTime(TStats *        const statsP,
+             TStatsCounter * const histogram,
+             uint64_t        const usec) {
+/*----------------------------------------------------------------------------
+   Count a time of 'usec' microseconds in latency histogram 'histogram',
+   which has ABYSS_STATS_BUCKETS counters.
+-----------------------------------------------------------------------------*/
+    StatsAdd(statsP,
+             &histogram[xmlrpc_latencyBucket(usec, ABYSS_STATS_BUCKETS)], 1);
+}
+
+
+
+static void
+readHistogram(TStats *        const statsP,
+              TStatsCounter * const histogram,
+              uint64_t *      const result) {
+
+    unsigned int i;
+
+    for (i = 0; i < ABYSS_STATS_BUCKETS; ++i)
+        result[i] = counterValue(statsP, &histogram[i]);
+}
+
+
+
+void
+StatsRead(TStats *       const statsP,
+          TServerStats * const resultP) {
+/*----------------------------------------------------------------------------
+   Return the current statistics as *resultP.
+
+   Other threads may be updating the counters while we read them, so the
+   result need not be a consistent snapshot; e.g. a request may show in
+   'requests' but not yet in 'bytesOut'.
+-----------------------------------------------------------------------------*/
+    resultP->startTime = statsP->startTime;
+    resultP->connectionsAccepted =
+        counterValue(statsP, &statsP->connectionsAccepted);
+    resultP->connectionsOpen =
+        (unsigned int)counterValue(statsP, &statsP->connectionsOpen);
+    resultP->connectionsActive =
+        (unsigned int)counterValue(statsP, &statsP->connectionsActive);
+    resultP->requests = counterValue(statsP, &statsP->requests);
+    resultP->requestsOnReusedConn =
+        counterValue(statsP, &statsP->requestsOnReusedConn);
+    resultP->bytesIn  = counterValue(statsP, &statsP->bytesIn);
+    resultP->bytesOut = counterValue(statsP, &statsP->bytesOut);
+
+    readHistogram(statsP, statsP->readTime,   resultP->readTime);
+    readHistogram(statsP, statsP->parseTime,  resultP->parseTime);
+    readHistogram(statsP, statsP->handleTime, resultP->handleTime);
+    readHistogram(statsP, statsP->writeTime,  resultP->writeTime);
+}
+
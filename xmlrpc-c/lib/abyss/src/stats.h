@@ -0,0 +1,65 @@
+#ifndef STATS_H_INCLUDED
+#define STATS_H_INCLUDED
+
+/*============================================================================
+   Statistics about the connections and requests a server has served, for
+   ServerGetStats().
+
+   Every connection thread updates them, so an update is a single atomic
+   operation where the compiler provides one (HAVE_SYNC_FETCH_AND_ADD);
+   counting never makes one thread wait for another.  Elsewhere, a lock
+   protects the counters.
+
+   With fork threads (thread_fork.c), each connection counts in its own
+   process, so the server sees only what the acceptor counts.
+============================================================================*/
+
+#include "xmlrpc-c/time_int.h"
+#include "xmlrpc-c/counter_int.h"
+#include "xmlrpc-c/lock.h"
+#include "xmlrpc-c/abyss.h"
+
+#include "bool.h"
+#include "int.h"
+
+typedef xmlrpc_counter TStatsCounter;
+
+typedef struct {
+    lock * lockP;
+        /* Protects the counters.  NULL if updates are atomic. */
+    time_t startTime;
+    TStatsCounter connectionsAccepted;
+    TStatsCounter connectionsOpen;
+    TStatsCounter connectionsActive;
+    TStatsCounter requests;
+    TStatsCounter requestsOnReusedConn;
+    TStatsCounter bytesIn;
+    TStatsCounter bytesOut;
+    TStatsCounter readTime[ABYSS_STATS_BUCKETS];
+    TStatsCounter parseTime[ABYSS_STATS_BUCKETS];
+    TStatsCounter handleTime[ABYSS_STATS_BUCKETS];
+    TStatsCounter writeTime[ABYSS_STATS_BUCKETS];
+} TStats;
+
+void
+StatsInit(TStats *      const statsP,
+          const char ** const errorP);
+
+void
+StatsTerm(TStats * const statsP);
+
+void
+StatsAdd(TStats *        const statsP,
+         TStatsCounter * const counterP,
+         int64_t         const delta);
+
+void
+StatsAddTime(TStats *        const statsP,
+             TStatsCounter * const histogram,
+             uint64_t        const usec);
+
+void
+StatsRead(TStats *       const statsP,
+          TServerStats * const resultP);
+
+#endif
@@ -46,6 +46,12 @@ ThreadRelease(TThread * const threadP);
 bool
 ThreadForks(void);
 
+void
+ThreadHoldDone(void);
+
+void
+ThreadReleaseDone(void);
+
 void
 ThreadUpdateStatus(TThread * const threadP);
 
@@ -290,3 +290,30 @@ ThreadForks(void) {
 
 
 
+static sigset_t heldBlockedSet;
+    /* The signal mask to restore in ThreadReleaseDone() */
+
+
+
+void
+ThreadHoldDone(void) {
+/*----------------------------------------------------------------------------
+   Keep any thread's done function from running until ThreadReleaseDone().
+
+   We run a done function from the SIGCHLD handler, so we just block
+   SIGCHLD; a process that uses fork threads has no other threads to
+   worry about.  Don't nest this.
+-----------------------------------------------------------------------------*/
+    blockSignalClass(SIGCHLD, &heldBlockedSet);
+}
+
+
+
+void
+ThreadReleaseDone(void) {
+
+    sigprocmask(SIG_SETMASK, &heldBlockedSet, NULL);
+}
+
+
+
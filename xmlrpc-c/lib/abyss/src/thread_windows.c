@@ -159,6 +159,23 @@ ThreadForks(void) {
 
 
 
+void
+ThreadHoldDone(void) {
+
+    /* A thread's done function runs in that thread, not in a signal
+       handler, so there's nothing to hold off here.
+    */
+}
+
+
+
+void
+ThreadReleaseDone(void) {
+
+}
+
+
+
 void
 ThreadUpdateStatus(TThread * const threadP ATTR_UNUSED) {
 
@@ -0,0 +1,304 @@
+/*=============================================================================
+                                  workerpool.c
+===============================================================================
+  This is a pool of worker threads that run jobs from a bounded queue.
+  See workerpool.h.
+
+  The threads are ordinary Abyss threads (see thread.h); only the queue
+  needs POSIX thread synchronization.
+=============================================================================*/
+
+#include "xmlrpc_config.h"
+
+#include <stdlib.h>
+#include <assert.h>
+
+#include "bool.h"
+#include "girmath.h"
+#include "mallocvar.h"
+#include "xmlrpc-c/string_int.h"
+#include "pthreadx.h"
+#include "xmlrpc-c/abyss.h"
+
+#include "thread.h"
+
+#include "workerpool.h"
+
+
+
+#if HAVE_PTHREAD
+
+struct job {
+    TWorkerJobFn * fn;
+    void * arg;
+};
+
+struct workerPool {
+    pthread_mutex_t mutex;
+        /* Protects everything below except 'threads' and 'threadCount' */
+    pthread_cond_t jobAvailable;
+        /* Signalled when a job is added to the queue or the pool is
+           stopping
+        */
+    pthread_cond_t spaceAvailable;
+        /* Signalled when a job is removed from the queue */
+    struct job * queue;
+        /* The queue of jobs not yet started: a ring buffer of 'queueSize'
+           entries, of which 'jobCount' entries starting at 'head' are
+           in use.
+        */
+    unsigned int queueSize;
+    unsigned int head;
+    unsigned int jobCount;
+    bool stopping;
+        /* Threads should quit once the queue is empty */
+    TThread ** threads;
+    unsigned int threadCount;
+        /* Number of entries of threads[] that are running threads */
+};
+
+
+
+static TThreadProc work;
+
+static void
+work(void * const userHandle) {
+/*----------------------------------------------------------------------------
+   This is the whole life of a pool thread: run jobs from the queue until
+   the pool stops and the queue is empty.
+-----------------------------------------------------------------------------*/
+    struct workerPool * const poolP = userHandle;
+
+    bool stop;
+
+    stop = FALSE;
+
+    pthread_mutex_lock(&poolP->mutex);
+
+    while (!stop) {
+        if (poolP->jobCount > 0) {
+            struct job const job = poolP->queue[poolP->head];
+
+            poolP->head = (poolP->head + 1) % poolP->queueSize;
+            --poolP->jobCount;
+
+            pthread_cond_signal(&poolP->spaceAvailable);
+
+            pthread_mutex_unlock(&poolP->mutex);
+
+            job.fn(job.arg);
+
+            pthread_mutex_lock(&poolP->mutex);
+        } else if (poolP->stopping)
+            stop = TRUE;
+        else
+            pthread_cond_wait(&poolP->jobAvailable, &poolP->mutex);
+    }
+    pthread_mutex_unlock(&poolP->mutex);
+}
+
+
+
+static TThreadDoneFn threadDone;
+
+static void
+threadDone(void * const userHandle ATTR_UNUSED) {
+
+}
+
+
+
+static void
+stopThreads(struct workerPool * const poolP) {
+
+    pthread_mutex_lock(&poolP->mutex);
+
+    poolP->stopping = TRUE;
+
+    pthread_cond_broadcast(&poolP->jobAvailable);
+
+    pthread_mutex_unlock(&poolP->mutex);
+
+    while (poolP->threadCount > 0)
+        ThreadWaitAndRelease(poolP->threads[--poolP->threadCount]);
+}
+
+
+
+static void
+startThreads(struct workerPool * const poolP,
+             unsigned int        const threadCount,
+             size_t              const jobStackSize,
+             const char **       const errorP) {
+
+    MALLOCARRAY(poolP->threads, threadCount);
+
+    if (poolP->threads == NULL)
+        xmlrpc_asprintf(errorP, "Unable to allocate memory for %u "
+                        "thread descriptors", threadCount);
+    else {
+        *errorP = NULL;  /* initial value */
+
+        for (poolP->threadCount = 0;
+             poolP->threadCount < threadCount && !*errorP; ) {
+
+            TThread ** const threadPP = &poolP->threads[poolP->threadCount];
+
+            ThreadCreate(threadPP, poolP, &work, &threadDone, FALSE,
+                         jobStackSize, errorP);
+
+            if (!*errorP) {
+                if (ThreadRun(*threadPP))
+                    ++poolP->threadCount;
+                else {
+                    xmlrpc_asprintf(errorP, "Failed to start thread");
+                    ThreadRelease(*threadPP);
+                }
+            }
+        }
+        if (*errorP) {
+            stopThreads(poolP);
+            free(poolP->threads);
+        }
+    }
+}
+
+
+
+void
+WorkerPoolCreate(TWorkerPool ** const poolPP,
+                 unsigned int   const threadCount,
+                 unsigned int   const queueSize,
+                 size_t         const jobStackSize,
+                 const char **  const errorP) {
+/*----------------------------------------------------------------------------
+   Create a pool of 'threadCount' threads, which will run jobs that need
+   'jobStackSize' bytes of stack.  Up to 'queueSize' jobs can wait for a
+   thread; WorkerPoolSubmit() blocks when that many are waiting.
+-----------------------------------------------------------------------------*/
+    struct workerPool * poolP;
+
+    MALLOCVAR(poolP);
+
+    if (poolP == NULL)
+        xmlrpc_asprintf(errorP, "Unable to allocate memory for "
+                        "worker pool descriptor");
+    else {
+        poolP->queueSize = MAX(1, queueSize);
+        poolP->head      = 0;
+        poolP->jobCount  = 0;
+        poolP->stopping  = FALSE;
+
+        MALLOCARRAY(poolP->queue, poolP->queueSize);
+
+        if (poolP->queue == NULL)
+            xmlrpc_asprintf(errorP, "Unable to allocate memory for "
+                            "a queue of %u jobs", poolP->queueSize);
+        else {
+            pthread_mutex_init(&poolP->mutex, NULL);
+            pthread_cond_init(&poolP->jobAvailable, NULL);
+            pthread_cond_init(&poolP->spaceAvailable, NULL);
+
+            startThreads(poolP, MAX(1, threadCount), jobStackSize, errorP);
+
+            if (*errorP) {
+                pthread_cond_destroy(&poolP->spaceAvailable);
+                pthread_cond_destroy(&poolP->jobAvailable);
+                pthread_mutex_destroy(&poolP->mutex);
+                free(poolP->queue);
+            }
+        }
+        if (*errorP)
+            free(poolP);
+    }
+    *poolPP = poolP;
+}
+
+
+
+void
+WorkerPoolDestroy(TWorkerPool * const poolP) {
+/*----------------------------------------------------------------------------
+   Run every job already submitted, then destroy the pool.
+-----------------------------------------------------------------------------*/
+    stopThreads(poolP);
+
+    assert(poolP->jobCount == 0);
+
+    free(poolP->threads);
+    pthread_cond_destroy(&poolP->spaceAvailable);
+    pthread_cond_destroy(&poolP->jobAvailable);
+    pthread_mutex_destroy(&poolP->mutex);
+    free(poolP->queue);
+    free(poolP);
+}
+
+
+
+void
+WorkerPoolSubmit(TWorkerPool *  const poolP,
+                 TWorkerJobFn * const jobFn,
+                 void *         const arg) {
+/*----------------------------------------------------------------------------
+   Have a pool thread run jobFn(arg) as soon as one is free.
+
+   If the queue is full, wait for space in it.
+-----------------------------------------------------------------------------*/
+    pthread_mutex_lock(&poolP->mutex);
+
+    assert(!poolP->stopping);
+
+    while (poolP->jobCount >= poolP->queueSize)
+        pthread_cond_wait(&poolP->spaceAvailable, &poolP->mutex);
+
+    {
+        struct job * const jobP =
+            &poolP->queue[(poolP->head + poolP->jobCount) % poolP->queueSize];
+
+        jobP->fn  = jobFn;
+        jobP->arg = arg;
+    }
+    ++poolP->jobCount;
+
+    pthread_cond_signal(&poolP->jobAvailable);
+
+    pthread_mutex_unlock(&poolP->mutex);
+}
+
+
+
+#else  /* HAVE_PTHREAD */
+
+/* Without POSIX threads, there can't be a worker pool. */
+
+void
+WorkerPoolCreate(TWorkerPool ** const poolPP,
+                 unsigned int   const threadCount ATTR_UNUSED,
+                 unsigned int   const queueSize ATTR_UNUSED,
+                 size_t         const jobStackSize ATTR_UNUSED,
+                 const char **  const errorP) {
+
+    *poolPP = NULL;
+
+    xmlrpc_asprintf(errorP, "This platform has no POSIX threads");
+}
+
+
+
+void
+WorkerPoolDestroy(TWorkerPool * const poolP ATTR_UNUSED) {
+
+    assert(FALSE);
+}
+
+
+
+void
+WorkerPoolSubmit(TWorkerPool *  const poolP ATTR_UNUSED,
+                 TWorkerJobFn * const jobFn ATTR_UNUSED,
+                 void *         const arg ATTR_UNUSED) {
+
+    assert(FALSE);
+}
+
+#endif  /* HAVE_PTHREAD */
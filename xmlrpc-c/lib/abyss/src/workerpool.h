@@ -0,0 +1,35 @@
+#ifndef WORKERPOOL_H_INCLUDED
+#define WORKERPOOL_H_INCLUDED
+
+/*============================================================================
+   A worker pool is a fixed set of threads that run jobs from a bounded
+   queue.  It saves creating and destroying a thread for every job, which
+   is significant when the jobs are short, e.g. an HTTP connection that
+   carries one small request.
+
+   This exists only where there are POSIX threads.  Elsewhere,
+   WorkerPoolCreate() just fails.
+============================================================================*/
+
+#include "bool.h"
+
+typedef struct workerPool TWorkerPool;
+
+typedef void TWorkerJobFn(void * const arg);
+
+void
+WorkerPoolCreate(TWorkerPool ** const poolPP,
+                 unsigned int   const threadCount,
+                 unsigned int   const queueSize,
+                 size_t         const jobStackSize,
+                 const char **  const errorP);
+
+void
+WorkerPoolDestroy(TWorkerPool * const poolP);
+
+void
+WorkerPoolSubmit(TWorkerPool *  const poolP,
+                 TWorkerJobFn * const jobFn,
+                 void *         const arg);
+
+#endif
@@ -0,0 +1,69 @@
+/*=============================================================================
+                                  counter
+===============================================================================
+  Statistics counters.  See counter_int.h.
+=============================================================================*/
+
+#include "xmlrpc_config.h"
+
+#include <stdlib.h>
+
+#include "int.h"
+#include "xmlrpc-c/lock.h"
+
+#include "xmlrpc-c/counter_int.h"
+
+
+
+void
+xmlrpc_counterAdd(xmlrpc_counter * const counterP,
+                  lock *           const lockP ATTR_UNUSED,
+                  int64_t          const delta) {
+/*----------------------------------------------------------------------------
+   Add 'delta', which may be negative, to counter *counterP.
+
+   'lockP' is the lock that protects the counter where updates aren't
+   atomic; NULL means the caller already holds it.  We don't use it where
+   they are.
+-----------------------------------------------------------------------------*/
+#if HAVE_SYNC_FETCH_AND_ADD
+    __sync_fetch_and_add(&counterP->value, (uint64_t)delta);
+#else
+    if (lockP)
+        lockP->acquire(lockP);
+
+    counterP->value += (uint64_t)delta;
+
+    if (lockP)
+        lockP->release(lockP);
+#endif
+}
+
+
+
+uint64_t
+xmlrpc_counterValue(xmlrpc_counter * const counterP,
+                    lock *           const lockP ATTR_UNUSED) {
+/*----------------------------------------------------------------------------
+   The current value of counter *counterP.  'lockP' is as for
+   xmlrpc_counterAdd().
+-----------------------------------------------------------------------------*/
+    uint64_t retval;
+
+#if HAVE_SYNC_FETCH_AND_ADD
+    /* An ordinary read of a 64 bit value isn't atomic on some 32 bit
+       machines.
+    */
+    retval = __sync_fetch_and_add(&counterP->value, 0);
+#else
+    if (lockP)
+        lockP->acquire(lockP);
+
+    retval = counterP->value;
+
+    if (lockP)
+        lockP->release(lockP);
+#endif
+
+    return retval;
+}
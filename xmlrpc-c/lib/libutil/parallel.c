@@ -0,0 +1,153 @@
+/*=============================================================================
+                                  parallel
+===============================================================================
+
+  This module runs a set of independent jobs on a few threads at once and
+  returns when they are all done.  It is for breaking up a big piece of CPU
+  work, such as serializing a huge array, so it uses more than one core.
+
+  There is no thread pool that outlives a call; the threads are created for
+  the call and gone when it returns.  That is cheap compared to the work we
+  expect to be divided this way.
+
+  On a platform without POSIX threads, we just run the jobs one after
+  another in the calling thread.
+
+============================================================================*/
+
+#include "xmlrpc_config.h"
+
+#include <stdlib.h>
+#if HAVE_PTHREAD
+#include <pthread.h>
+#endif
+
+#include "bool.h"
+#include "girmath.h"
+#include "mallocvar.h"
+
+#include "xmlrpc-c/parallel_int.h"
+
+
+#if HAVE_PTHREAD
+
+struct jobQueue {
+    pthread_mutex_t        mutex;
+    unsigned int           nextJob;
+        /* Index of the next job nobody has started yet */
+    unsigned int           jobCount;
+    xmlrpc_parallelJobFn * jobFn;
+    void *                 contextP;
+};
+
+
+
+static void *
+runJobs(void * const arg) {
+/*----------------------------------------------------------------------------
+   Run jobs from the queue until there aren't any more.  This is the whole
+   life of a worker thread, and the calling thread does it too.
+-----------------------------------------------------------------------------*/
+    struct jobQueue * const queueP = arg;
+
+    bool done;
+
+    done = false;
+
+    while (!done) {
+        unsigned int jobIndex;
+
+        pthread_mutex_lock(&queueP->mutex);
+
+        if (queueP->nextJob < queueP->jobCount) {
+            jobIndex = queueP->nextJob++;
+        } else
+            done = true;
+
+        pthread_mutex_unlock(&queueP->mutex);
+
+        if (!done)
+            queueP->jobFn(queueP->contextP, jobIndex);
+    }
+    return NULL;
+}
+
+
+
+static void
+runParallel(unsigned int           const threadCount,
+            unsigned int           const jobCount,
+            xmlrpc_parallelJobFn *       jobFn,
+            void *                 const contextP) {
+
+    struct jobQueue queue;
+    pthread_t * threads;
+        /* threads[0] is unused; that one is the calling thread */
+
+    queue.nextJob  = 0;
+    queue.jobCount = jobCount;
+    queue.jobFn    = jobFn;
+    queue.contextP = contextP;
+
+    pthread_mutex_init(&queue.mutex, NULL);
+
+    MALLOCARRAY(threads, threadCount);
+
+    if (threads == NULL)
+        runJobs(&queue);
+    else {
+        unsigned int threadsStarted;
+        unsigned int i;
+
+        /* If we can't create as many threads as asked, we just run the jobs
+           on fewer.  There is always at least the calling thread.
+        */
+        for (threadsStarted = 1; threadsStarted < threadCount; ) {
+            int const rc = pthread_create(&threads[threadsStarted], NULL,
+                                          &runJobs, &queue);
+            if (rc == 0)
+                ++threadsStarted;
+            else
+                break;
+        }
+        runJobs(&queue);
+
+        for (i = 1; i < threadsStarted; ++i)
+            pthread_join(threads[i], NULL);
+
+        free(threads);
+    }
+    pthread_mutex_destroy(&queue.mutex);
+}
+
+#endif  /* HAVE_PTHREAD */
+
+
+
+void
+xmlrpc_parallel_run(unsigned int           const threadCount,
+                    unsigned int           const jobCount,
+                    xmlrpc_parallelJobFn *       jobFn,
+                    void *                 const contextP) {
+/*----------------------------------------------------------------------------
+   Run jobs 0 through 'jobCount' - 1, calling jobFn(contextP, jobIndex) for
+   each, using up to 'threadCount' threads, including the calling one.
+   Return when every job has finished.
+
+   The jobs may run in any order and at the same time as each other, so
+   jobFn must not touch anything another job touches, except to read it.
+   Jobs cannot fail as far as we're concerned; if one can, jobFn must
+   record that somewhere in *contextP.
+-----------------------------------------------------------------------------*/
+#if HAVE_PTHREAD
+    if (threadCount > 1 && jobCount > 1)
+        runParallel(MIN(threadCount, jobCount), jobCount, jobFn, contextP);
+    else
+#endif
+    {
+        unsigned int i;
+
+        for (i = 0; i < jobCount; ++i)
+            jobFn(contextP, i);
+    }
+}
@@ -44,3 +44,82 @@ xmlrpc_parse_int64(xmlrpc_env *   const envP,
     else
         *i64P = i64val;
 }
+
+
+
+/* The decimal representations of 00 through 99, back to back, so that we
+   can generate a number two digits at a time.
+*/
+static char const digitPairs[] =
+    "00010203040506070809"
+    "10111213141516171819"
+    "20212223242526272829"
+    "30313233343536373839"
+    "40414243444546474849"
+    "50515253545556575859"
+    "60616263646566676869"
+    "70717273747576777879"
+    "80818283848586878889"
+    "90919293949596979899";
+
+
+
+void
+xmlrpc_format_2digits(char *       const buffer,
+                      unsigned int const value) {
+/*----------------------------------------------------------------------------
+   Write 'value', which is less than 100, as exactly two decimal digits at
+   'buffer', e.g. "07".  Don't NUL-terminate it.
+-----------------------------------------------------------------------------*/
+    XMLRPC_ASSERT(value < 100);
+
+    buffer[0] = digitPairs[value * 2];
+    buffer[1] = digitPairs[value * 2 + 1];
+}
+
+
+
+size_t
+xmlrpc_format_int64(char *       const buffer,
+                    xmlrpc_int64 const value) {
+/*----------------------------------------------------------------------------
+   Write the decimal representation of 'value' at 'buffer', the same as
+   printf("%lld") would, but without the overhead of printf.  Don't
+   NUL-terminate it.
+
+   'buffer' must have room for XMLRPC_INT64_DECIMAL_MAX characters.
+
+   Return the number of characters written.
+-----------------------------------------------------------------------------*/
+    char digits[XMLRPC_INT64_DECIMAL_MAX];
+    char * p;
+    uint64_t magnitude;
+    size_t len;
+
+    /* We negate in unsigned arithmetic so that XMLRPC_INT64_MIN works */
+    magnitude = value < 0 ? 0 - (uint64_t)value : (uint64_t)value;
+
+    /* We generate the digits backward, from the end of 'digits' */
+    p = &digits[sizeof(digits)];
+
+    while (magnitude >= 100) {
+        unsigned int const pair = (unsigned int)(magnitude % 100);
+        magnitude /= 100;
+        p -= 2;
+        xmlrpc_format_2digits(p, pair);
+    }
+    if (magnitude >= 10) {
+        p -= 2;
+        xmlrpc_format_2digits(p, (unsigned int)magnitude);
+    } else
+        *--p = '0' + (char)magnitude;
+
+    if (value < 0)
+        *--p = '-';
+
+    len = &digits[sizeof(digits)] - p;
+
+    memcpy(buffer, p, len);
+
+    return len;
+}
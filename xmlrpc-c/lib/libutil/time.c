@@ -78,6 +78,48 @@ xmlrpc_gettimeofday(xmlrpc_timespec * const todP) {
 
 
 
+uint64_t
+xmlrpc_usecBetween(xmlrpc_timespec const start,
+                   xmlrpc_timespec const end) {
+/*----------------------------------------------------------------------------
+   The number of microseconds from 'start' to 'end'; zero if 'end' is
+   earlier, which can happen when someone sets the clock.
+-----------------------------------------------------------------------------*/
+    int64_t const nsec =
+        ((int64_t)end.tv_sec - (int64_t)start.tv_sec) * 1000000000 +
+        ((int64_t)end.tv_nsec - (int64_t)start.tv_nsec);
+
+    return nsec > 0 ? (uint64_t)nsec / 1000 : 0;
+}
+
+
+
+unsigned int
+xmlrpc_latencyBucket(uint64_t     const usec,
+                     unsigned int const bucketCount) {
+/*----------------------------------------------------------------------------
+   The bucket in which a time of 'usec' microseconds counts in a latency
+   histogram of 'bucketCount' buckets.
+
+   Bucket 0 is for times under 1 microsecond; bucket i is for times of at
+   least 2^(i-1) and under 2^i microseconds, except the last bucket is for
+   everything longer too.  The histograms of Abyss server statistics and
+   of registry method statistics are like this.
+-----------------------------------------------------------------------------*/
+    unsigned int bucket;
+    uint64_t limit;
+
+    assert(bucketCount > 0);
+
+    for (bucket = 0, limit = 1;
+         bucket < bucketCount - 1 && usec >= limit;
+         ++bucket, limit <<= 1);
+
+    return bucket;
+}
+
+
+
 static bool
 isLeapYear(unsigned int const yearOfAd) {
 
@@ -152,33 +152,19 @@ sendError(TSession *   const abyssSessionP,
 
 
 static void
-traceChunkRead(TSession * const abyssSessionP) {
-
-    fprintf(stderr, "XML-RPC handler got a chunk of %u bytes\n",
-            (unsigned int)SessionReadDataAvail(abyssSessionP));
-}
-
-
-
-static void
-refillBufferFromConnection(xmlrpc_env * const envP,
-                           TSession *   const abyssSessionP,
-                           const char * const trace) {
+sendFault(TSession *         const abyssSessionP,
+          const xmlrpc_env * const faultP) {
 /*----------------------------------------------------------------------------
-   Get the next chunk of data from the connection into the buffer.
+  Send an error response for a call that failed as described by *faultP.
 -----------------------------------------------------------------------------*/
-    bool succeeded;
+    uint16_t httpResponseStatus;
 
-    succeeded = SessionRefillBuffer(abyssSessionP);
+    if (faultP->fault_code == XMLRPC_TIMEOUT_ERROR)
+        httpResponseStatus = 408;  /* Request Timeout */
+    else
+        httpResponseStatus = 500;  /* Internal Server Error */
 
-    if (!succeeded)
-        xmlrpc_env_set_fault_formatted(
-            envP, XMLRPC_TIMEOUT_ERROR, "Timed out waiting for "
-            "client to send its POST data");
-    else {
-        if (trace)
-            traceChunkRead(abyssSessionP);
-    }
+    sendError(abyssSessionP, httpResponseStatus, faultP->fault_string);
 }
 
 
@@ -193,8 +179,8 @@ getBody(xmlrpc_env *        const envP,
    Get the entire body, which is of size 'contentSize' bytes, from the
    Abyss session and return it as the new memblock *bodyP.
 
-   The first chunk of the body may already be in Abyss's buffer.  We
-   retrieve that before reading more.
+   The first chunk of the body may already be in Abyss's buffer.  After
+   that, we have Abyss read the rest straight into the memblock.
 -----------------------------------------------------------------------------*/
     xmlrpc_mem_block * body;
 
@@ -202,24 +188,33 @@ getBody(xmlrpc_env *        const envP,
         fprintf(stderr, "XML-RPC handler processing body.  "
                 "Content Size = %u bytes\n", (unsigned)contentSize);
 
-    body = xmlrpc_mem_block_new(envP, 0);
+    body = xmlrpc_mem_block_new(envP, contentSize);
     if (!envP->fault_occurred) {
+        char * const contents = XMLRPC_MEMBLOCK_CONTENTS(char, body);
+
         size_t bytesRead;
-        const char * chunkPtr;
-        size_t chunkLen;
 
         bytesRead = 0;
 
         while (!envP->fault_occurred && bytesRead < contentSize) {
-            SessionGetReadData(abyssSessionP, contentSize - bytesRead, 
-                               &chunkPtr, &chunkLen);
-            bytesRead += chunkLen;
+            size_t chunkLen;
+            bool succeeded;
+
+            succeeded = SessionReadBody(abyssSessionP, &contents[bytesRead],
+                                        contentSize - bytesRead, &chunkLen);
+            if (!succeeded)
+                xmlrpc_env_set_fault_formatted(
+                    envP, XMLRPC_TIMEOUT_ERROR, "Timed out waiting for "
+                    "client to send its POST data");
+            else {
+                if (trace)
+                    fprintf(stderr, "XML-RPC handler got a chunk of "
+                            "%u bytes\n", (unsigned int)chunkLen);
 
-            assert(bytesRead <= contentSize);
+                bytesRead += chunkLen;
 
-            XMLRPC_MEMBLOCK_APPEND(char, envP, body, chunkPtr, chunkLen);
-            if (bytesRead < contentSize)
-                refillBufferFromConnection(envP, abyssSessionP, trace);
+                assert(bytesRead <= contentSize);
+            }
         }
         if (envP->fault_occurred)
             xmlrpc_mem_block_free(body);
@@ -341,14 +336,113 @@ traceHandlerCalled(TSession * const abyssSessionP) {
 
 
 
+struct asyncCall {
+/*----------------------------------------------------------------------------
+   What we need to send the response to an RPC whose processor gives us
+   the response asynchronously.
+-----------------------------------------------------------------------------*/
+    TSession *        abyssSessionP;
+    bool              wantChunk;
+    ResponseAccessCtl accessControl;
+};
+
+
+
+static xmlrpc_call_response_fn respondAsync;
+
+static void
+respondAsync(void *             const context,
+             const xmlrpc_env * const envP,
+             xmlrpc_mem_block * const responseXmlP) {
+/*----------------------------------------------------------------------------
+   Send the response to a call we gave to an asynchronous processor.  The
+   processor calls this, from any thread, when it has the response.
+
+   The response is in *responseXmlP, unless *envP says the processor
+   failed to produce one.
+-----------------------------------------------------------------------------*/
+    struct asyncCall * const callP = context;
+    TSession *         const abyssSessionP = callP->abyssSessionP;
+
+    if (envP->fault_occurred)
+        sendFault(abyssSessionP, envP);
+    else {
+        xmlrpc_env env;
+
+        xmlrpc_env_init(&env);
+
+        sendResponse(&env, abyssSessionP, 
+                     XMLRPC_MEMBLOCK_CONTENTS(char, responseXmlP),
+                     XMLRPC_MEMBLOCK_SIZE(char, responseXmlP),
+                     callP->wantChunk, callP->accessControl);
+
+        if (env.fault_occurred)
+            sendFault(abyssSessionP, &env);
+
+        XMLRPC_MEMBLOCK_FREE(char, responseXmlP);
+
+        xmlrpc_env_clean(&env);
+    }
+    free(callP);
+
+    /* The session may cease to exist now */
+    SessionComplete(abyssSessionP);
+}
+
+
+
+static void
+startAsyncCall(TSession *                    const abyssSessionP,
+               xmlrpc_mem_block *            const body,
+               xmlrpc_call_processor_async *       xmlProcessorAsync,
+               void *                        const xmlProcessorArg,
+               bool                          const wantChunk,
+               ResponseAccessCtl             const accessControl,
+               bool *                        const startedP) {
+/*----------------------------------------------------------------------------
+   Give the call 'body' to 'xmlProcessorAsync', with the response deferred,
+   so this thread doesn't have to wait for the method to execute.
+
+   Return *startedP false if the Abyss server can't defer the response;
+   we don't do anything then.
+-----------------------------------------------------------------------------*/
+    struct asyncCall * callP;
+
+    MALLOCVAR(callP);
+
+    if (callP == NULL)
+        *startedP = false;
+    else {
+        if (!SessionDefer(abyssSessionP)) {
+            free(callP);
+            *startedP = false;
+        } else {
+            callP->abyssSessionP = abyssSessionP;
+            callP->wantChunk     = wantChunk;
+            callP->accessControl = accessControl;
+
+            xmlProcessorAsync(xmlProcessorArg,
+                              XMLRPC_MEMBLOCK_CONTENTS(char, body),
+                              XMLRPC_MEMBLOCK_SIZE(char, body),
+                              abyssSessionP,
+                              &respondAsync, callP);
+
+            *startedP = true;
+        }
+    }
+}
+
+
+
 static void
-processCall(TSession *            const abyssSessionP,
-            size_t                const contentSize,
-            xmlrpc_call_processor       xmlProcessor,
-            void *                const xmlProcessorArg,
-            bool                  const wantChunk,
-            ResponseAccessCtl     const accessControl,
-            const char *          const trace) {
+processCall(TSession *                    const abyssSessionP,
+            size_t                        const contentSize,
+            xmlrpc_call_processor               xmlProcessor,
+            xmlrpc_call_processor_async *       xmlProcessorAsync,
+            void *                        const xmlProcessorArg,
+            bool                          const wantChunk,
+            ResponseAccessCtl             const accessControl,
+            const char *                  const trace) {
 /*----------------------------------------------------------------------------
    Handle an RPC request.  This is an HTTP request that has the proper form
    to be an XML-RPC call.
@@ -357,6 +451,9 @@ processCall(TSession *            const abyssSessionP,
    'abyssSessionP'.
 
    Its content length is 'contentSize' bytes.
+
+   If there is an asynchronous processor 'xmlProcessorAsync' and the server
+   lets us, we defer the response and may return before sending it.
 -----------------------------------------------------------------------------*/
     xmlrpc_env env;
 
@@ -375,36 +472,40 @@ processCall(TSession *            const abyssSessionP,
         /* Read XML data off the wire. */
         getBody(&env, abyssSessionP, contentSize, trace, &body);
         if (!env.fault_occurred) {
-            xmlrpc_mem_block * output;
-
-            /* Process the RPC. */
-            xmlProcessor(
-                &env, xmlProcessorArg,
-                XMLRPC_MEMBLOCK_CONTENTS(char, body),
-                XMLRPC_MEMBLOCK_SIZE(char, body),
-                abyssSessionP,
-                &output);
-            if (!env.fault_occurred) {
-                /* Send out the result. */
-                sendResponse(&env, abyssSessionP, 
-                             XMLRPC_MEMBLOCK_CONTENTS(char, output),
-                             XMLRPC_MEMBLOCK_SIZE(char, output),
-                             wantChunk, accessControl);
+            bool started;
+
+            if (xmlProcessorAsync)
+                startAsyncCall(abyssSessionP, body,
+                               xmlProcessorAsync, xmlProcessorArg,
+                               wantChunk, accessControl, &started);
+            else
+                started = false;
+
+            if (!started) {
+                xmlrpc_mem_block * output;
+
+                /* Process the RPC. */
+                xmlProcessor(
+                    &env, xmlProcessorArg,
+                    XMLRPC_MEMBLOCK_CONTENTS(char, body),
+                    XMLRPC_MEMBLOCK_SIZE(char, body),
+                    abyssSessionP,
+                    &output);
+                if (!env.fault_occurred) {
+                    /* Send out the result. */
+                    sendResponse(&env, abyssSessionP, 
+                                 XMLRPC_MEMBLOCK_CONTENTS(char, output),
+                                 XMLRPC_MEMBLOCK_SIZE(char, output),
+                                 wantChunk, accessControl);
                 
-                XMLRPC_MEMBLOCK_FREE(char, output);
+                    XMLRPC_MEMBLOCK_FREE(char, output);
+                }
             }
             XMLRPC_MEMBLOCK_FREE(char, body);
         }
     }
-    if (env.fault_occurred) {
-        uint16_t httpResponseStatus;
-        if (env.fault_code == XMLRPC_TIMEOUT_ERROR)
-            httpResponseStatus = 408;  /* Request Timeout */
-        else
-            httpResponseStatus = 500;  /* Internal Server Error */
-
-        sendError(abyssSessionP, httpResponseStatus, env.fault_string);
-    }
+    if (env.fault_occurred)
+        sendFault(abyssSessionP, &env);
 
     xmlrpc_env_clean(&env);
 }
@@ -454,6 +555,7 @@ static void
 handleXmlRpcCallReq(TSession *           const abyssSessionP,
                     const TRequestInfo * const requestInfoP ATTR_UNUSED,
                     xmlrpc_call_processor      xmlProcessor,
+                    xmlrpc_call_processor_async * xmlProcessorAsync,
                     void *               const xmlProcessorArg,
                     bool                 const wantChunk,
                     ResponseAccessCtl    const accessControl) {
@@ -496,7 +598,7 @@ handleXmlRpcCallReq(TSession *           const abyssSessionP,
                           "XML-RPC call.");
             else
                 processCall(abyssSessionP, contentSize,
-                            xmlProcessor, xmlProcessorArg,
+                            xmlProcessor, xmlProcessorAsync, xmlProcessorArg,
                             wantChunk, accessControl,
                             trace_abyss);
         }
@@ -561,6 +663,7 @@ xmlrpc_handleIfXmlrpcReq(void *        const handlerArg,
         case m_post:
             handleXmlRpcCallReq(abyssSessionP, requestInfoP,
                                 uriHandlerXmlrpcP->xmlProcessor,
+                                uriHandlerXmlrpcP->xmlProcessorAsync,
                                 uriHandlerXmlrpcP->xmlProcessorArg,
                                 uriHandlerXmlrpcP->chunkResponse,
                                 uriHandlerXmlrpcP->accessControl);
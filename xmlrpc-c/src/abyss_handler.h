@@ -15,6 +15,8 @@ struct uriHandlerXmlrpc {
     bool                    chunkResponse;
         /* The handler should chunk its response whenever possible */
     xmlrpc_call_processor * xmlProcessor;
+    xmlrpc_call_processor_async * xmlProcessorAsync;
+        /* NULL if there is none */
     void *                  xmlProcessorArg;
     ResponseAccessCtl       accessControl;
 };
@@ -0,0 +1,494 @@
+/*=============================================================================
+                                  admission
+===============================================================================
+  Limits on the calls a registry executes at once.  See admission.h.
+
+  On a platform without POSIX threads, a call that waits for its turn
+  under a method limit polls for it.
+=============================================================================*/
+
+#include "xmlrpc_config.h"
+
+#include <stdlib.h>
+#include <assert.h>
+#if HAVE_PTHREAD
+#include <pthread.h>
+#endif
+
+#include "bool.h"
+#include "girmath.h"
+#include "mallocvar.h"
+#include "xmlrpc-c/base_int.h"
+#include "xmlrpc-c/lock.h"
+#include "xmlrpc-c/lock_platform.h"
+#include "xmlrpc-c/sleep_int.h"
+#include "xmlrpc-c/time_int.h"
+#include "xmlrpc-c/base.h"
+
+#include "admission.h"
+
+
+/* The adaptive limit keeps two moving averages of call latency: a short
+   one, which follows the latest calls, and a long one, which is what a call
+   usually takes.  SHORT_WEIGHT and LONG_WEIGHT are how much the latest call
+   counts in each.
+*/
+#define SHORT_WEIGHT 0.1
+#define LONG_WEIGHT  0.01
+
+/* Recent calls may take this many times as long as usual before we
+   consider them to be queueing.
+*/
+#define TOLERANCE 2.0
+
+/* The most we lower the adaptive limit for one slow call, as a fraction of
+   the limit.
+*/
+#define MAX_DECREASE 0.1
+
+
+
+struct xmlrpc_methodLimit {
+    unsigned int maxRunning;
+        /* The most calls that may execute at once; at least 1 */
+    unsigned int maxWaiting;
+        /* The most calls that may wait for one of those to finish */
+#if HAVE_PTHREAD
+    pthread_mutex_t mutex;
+        /* Protects everything below */
+    pthread_cond_t finishCond;
+        /* Signalled when a call finishes */
+#else
+    lock * lockP;
+        /* Protects everything below */
+#endif
+    unsigned int running;
+        /* Number of calls executing */
+    unsigned int waiting;
+        /* Number of calls waiting to execute */
+    unsigned int refCount;
+        /* Number of methods that have this limit.  A method that replaces
+           another with only different attributes shares its limit (see
+           xmlrpc_methodCopy()).
+        */
+};
+
+
+
+struct xmlrpc_adaptiveLimit {
+    unsigned int minLimit;
+    unsigned int maxLimit;
+        /* Bounds of 'limit'; 1 <= minLimit <= maxLimit */
+    lock * lockP;
+        /* Protects everything below */
+    double limit;
+        /* The most calls that may execute at once, not counting a
+           fraction.  It has a fraction so that a raise can be gradual.
+        */
+    unsigned int running;
+        /* Number of calls executing */
+    bool haveLatency;
+        /* Some call has finished, so there are latency averages */
+    double shortUsec;
+    double longUsec;
+        /* The moving averages of call latency, in microseconds */
+};
+
+
+
+void
+xmlrpc_methodLimitCreate(xmlrpc_env *          const envP,
+                         unsigned int          const maxRunning,
+                         unsigned int          const maxWaiting,
+                         xmlrpc_methodLimit ** const limitPP) {
+/*----------------------------------------------------------------------------
+   Create a limit of 'maxRunning' calls executing at once, with up to
+   'maxWaiting' more waiting for their turn.
+-----------------------------------------------------------------------------*/
+    xmlrpc_methodLimit * limitP;
+
+    assert(maxRunning >= 1);
+
+    MALLOCVAR(limitP);
+
+    if (limitP == NULL)
+        xmlrpc_faultf(envP, "Unable to allocate memory for a method limit");
+    else {
+        limitP->maxRunning = maxRunning;
+        limitP->maxWaiting = maxWaiting;
+        limitP->running    = 0;
+        limitP->waiting    = 0;
+        limitP->refCount   = 1;
+
+#if HAVE_PTHREAD
+        pthread_mutex_init(&limitP->mutex, NULL);
+        pthread_cond_init(&limitP->finishCond, NULL);
+#else
+        limitP->lockP = xmlrpc_lock_create();
+
+        if (limitP->lockP == NULL) {
+            xmlrpc_faultf(envP, "Unable to create lock for a method limit");
+            free(limitP);
+        }
+#endif
+        *limitPP = limitP;
+    }
+}
+
+
+
+static void
+methodLimitDestroy(xmlrpc_methodLimit * const limitP) {
+
+    assert(limitP->running == 0);
+    assert(limitP->waiting == 0);
+
+#if HAVE_PTHREAD
+    pthread_cond_destroy(&limitP->finishCond);
+    pthread_mutex_destroy(&limitP->mutex);
+#else
+    limitP->lockP->destroy(limitP->lockP);
+#endif
+    free(limitP);
+}
+
+
+
+static void
+lockMethodLimit(xmlrpc_methodLimit * const limitP) {
+
+#if HAVE_PTHREAD
+    pthread_mutex_lock(&limitP->mutex);
+#else
+    limitP->lockP->acquire(limitP->lockP);
+#endif
+}
+
+
+
+static void
+unlockMethodLimit(xmlrpc_methodLimit * const limitP) {
+
+#if HAVE_PTHREAD
+    pthread_mutex_unlock(&limitP->mutex);
+#else
+    limitP->lockP->release(limitP->lockP);
+#endif
+}
+
+
+
+void
+xmlrpc_methodLimitIncref(xmlrpc_methodLimit * const limitP) {
+
+    lockMethodLimit(limitP);
+
+    ++limitP->refCount;
+
+    unlockMethodLimit(limitP);
+}
+
+
+
+void
+xmlrpc_methodLimitDecref(xmlrpc_methodLimit * const limitP) {
+/*----------------------------------------------------------------------------
+   Release a reference to *limitP; destroy it if that was the last one.
+-----------------------------------------------------------------------------*/
+    bool unreferenced;
+
+    lockMethodLimit(limitP);
+
+    assert(limitP->refCount > 0);
+
+    --limitP->refCount;
+
+    unreferenced = (limitP->refCount == 0);
+
+    unlockMethodLimit(limitP);
+
+    if (unreferenced)
+        methodLimitDestroy(limitP);
+}
+
+
+
+static void
+waitForFinish(xmlrpc_methodLimit * const limitP) {
+/*----------------------------------------------------------------------------
+   Wait until a call under *limitP may have finished.  Caller holds the
+   lock; we hold it again when we return.
+-----------------------------------------------------------------------------*/
+#if HAVE_PTHREAD
+    pthread_cond_wait(&limitP->finishCond, &limitP->mutex);
+#else
+    limitP->lockP->release(limitP->lockP);
+
+    xmlrpc_millisecond_sleep(1);
+
+    limitP->lockP->acquire(limitP->lockP);
+#endif
+}
+
+
+
+static void
+enterMethodLimit(xmlrpc_env *         const envP,
+                 xmlrpc_methodLimit * const limitP) {
+
+    lockMethodLimit(limitP);
+
+    if (limitP->running < limitP->maxRunning)
+        ++limitP->running;
+    else if (limitP->waiting < limitP->maxWaiting) {
+        ++limitP->waiting;
+
+        while (limitP->running >= limitP->maxRunning)
+            waitForFinish(limitP);
+
+        --limitP->waiting;
+        ++limitP->running;
+    } else
+        xmlrpc_env_set_fault_formatted(
+            envP, XMLRPC_LIMIT_EXCEEDED_ERROR,
+            "Server is too busy to take this call.  %u calls of the method "
+            "are executing and %u are waiting, which is the limit",
+            limitP->running, limitP->waiting);
+
+    unlockMethodLimit(limitP);
+}
+
+
+
+static void
+leaveMethodLimit(xmlrpc_methodLimit * const limitP) {
+
+    lockMethodLimit(limitP);
+
+    assert(limitP->running > 0);
+
+    --limitP->running;
+
+#if HAVE_PTHREAD
+    pthread_cond_signal(&limitP->finishCond);
+#endif
+
+    unlockMethodLimit(limitP);
+}
+
+
+
+void
+xmlrpc_adaptiveLimitCreate(xmlrpc_env *            const envP,
+                           unsigned int            const minLimit,
+                           unsigned int            const maxLimit,
+                           xmlrpc_adaptiveLimit ** const limitPP) {
+/*----------------------------------------------------------------------------
+   Create an adaptive limit that varies from 'minLimit' to 'maxLimit'
+   calls executing at once.  It starts at 'maxLimit'.
+-----------------------------------------------------------------------------*/
+    xmlrpc_adaptiveLimit * limitP;
+
+    assert(minLimit >= 1);
+    assert(minLimit <= maxLimit);
+
+    MALLOCVAR(limitP);
+
+    if (limitP == NULL)
+        xmlrpc_faultf(envP, "Unable to allocate memory for an "
+                      "adaptive limit");
+    else {
+        limitP->minLimit    = minLimit;
+        limitP->maxLimit    = maxLimit;
+        limitP->limit       = maxLimit;
+        limitP->running     = 0;
+        limitP->haveLatency = false;
+
+        limitP->lockP = xmlrpc_lock_create();
+
+        if (limitP->lockP == NULL) {
+            xmlrpc_faultf(envP, "Unable to create lock for an "
+                          "adaptive limit");
+            free(limitP);
+        }
+        *limitPP = limitP;
+    }
+}
+
+
+
+void
+xmlrpc_adaptiveLimitDestroy(xmlrpc_adaptiveLimit * const limitP) {
+
+    assert(limitP->running == 0);
+
+    limitP->lockP->destroy(limitP->lockP);
+
+    free(limitP);
+}
+
+
+
+static void
+enterAdaptiveLimit(xmlrpc_env *           const envP,
+                   xmlrpc_adaptiveLimit * const limitP) {
+
+    limitP->lockP->acquire(limitP->lockP);
+
+    if (limitP->running < (unsigned int)limitP->limit)
+        ++limitP->running;
+    else
+        xmlrpc_env_set_fault_formatted(
+            envP, XMLRPC_LIMIT_EXCEEDED_ERROR,
+            "Server is too busy to take this call.  %u calls are "
+            "executing, which is the limit", limitP->running);
+
+    limitP->lockP->release(limitP->lockP);
+}
+
+
+
+static void
+adapt(xmlrpc_adaptiveLimit * const limitP,
+      double                 const usec,
+      bool                   const wasFull) {
+/*----------------------------------------------------------------------------
+   Adjust *limitP for a call that just finished after 'usec' microseconds.
+   'wasFull' means there were as many calls executing as the limit allows
+   when it finished.
+
+   Caller holds the lock.
+-----------------------------------------------------------------------------*/
+    if (!limitP->haveLatency) {
+        limitP->shortUsec   = usec;
+        limitP->longUsec    = usec;
+        limitP->haveLatency = true;
+    } else {
+        limitP->shortUsec += (usec - limitP->shortUsec) * SHORT_WEIGHT;
+        limitP->longUsec  += (usec - limitP->longUsec)  * LONG_WEIGHT;
+    }
+
+    if (limitP->shortUsec > limitP->longUsec * TOLERANCE) {
+        /* Calls are taking longer than usual; probably they are waiting
+           for something, such as a CPU, so there are too many of them.
+           The slower they are, the more we lower the limit.
+        */
+        double const excess =
+            1.0 - limitP->longUsec * TOLERANCE / limitP->shortUsec;
+
+        limitP->limit -= limitP->limit * MIN(excess, MAX_DECREASE);
+    } else if (wasFull) {
+        /* Calls are as fast as usual, and the limit is keeping some from
+           executing.  Raise it by about one for every 'limit' calls that
+           finish, as TCP opens its congestion window.
+        */
+        limitP->limit += 1.0 / limitP->limit;
+    }
+    limitP->limit =
+        MAX(limitP->minLimit, MIN(limitP->maxLimit, limitP->limit));
+}
+
+
+
+static void
+leaveAdaptiveLimit(xmlrpc_adaptiveLimit * const limitP,
+                   double                 const usec) {
+
+    limitP->lockP->acquire(limitP->lockP);
+
+    assert(limitP->running > 0);
+
+    adapt(limitP, usec, limitP->running >= (unsigned int)limitP->limit);
+
+    --limitP->running;
+
+    limitP->lockP->release(limitP->lockP);
+}
+
+
+
+void
+xmlrpc_admit(xmlrpc_env *           const envP,
+             xmlrpc_adaptiveLimit * const adaptiveLimitP,
+             xmlrpc_methodLimit *   const methodLimitP,
+             xmlrpc_scheduler *     const schedulerP,
+             xmlrpc_priority        const priority,
+             xmlrpc_admission *     const admissionP) {
+/*----------------------------------------------------------------------------
+   Admit a call under adaptive limit *adaptiveLimitP and method limit
+   *methodLimitP (NULL means no such limit), waiting for its turn under
+   the method limit if necessary.  Fail with XMLRPC_LIMIT_EXCEEDED_ERROR if
+   either limit doesn't let the call in.
+
+   Then start the call under scheduler *schedulerP (NULL means none), as
+   a call of priority 'priority', waiting for its turn if necessary.
+
+   Return as *admissionP what xmlrpc_admissionFinish() needs to let the
+   next call in when this one finishes.
+-----------------------------------------------------------------------------*/
+    admissionP->adaptiveLimitP = adaptiveLimitP;
+    admissionP->methodLimitP   = methodLimitP;
+    admissionP->schedulerP     = schedulerP;
+
+    /* We check the adaptive limit first, because that doesn't wait; a call
+       it refuses mustn't have waited under the method limit first.
+    */
+    if (adaptiveLimitP)
+        enterAdaptiveLimit(envP, adaptiveLimitP);
+
+    if (!envP->fault_occurred) {
+        if (methodLimitP) {
+            enterMethodLimit(envP, methodLimitP);
+
+            if (envP->fault_occurred && adaptiveLimitP) {
+                /* The call never executed, so it says nothing about
+                   latency.
+                */
+                adaptiveLimitP->lockP->acquire(adaptiveLimitP->lockP);
+                --adaptiveLimitP->running;
+                adaptiveLimitP->lockP->release(adaptiveLimitP->lockP);
+            }
+        }
+        /* The scheduler comes last, so a call doesn't occupy a place in
+           it while it waits under the method limit.
+        */
+        if (schedulerP && !envP->fault_occurred)
+            xmlrpc_schedulerEnter(schedulerP, priority);
+
+        /* Time spent waiting under the method limit or for the scheduler
+           isn't latency the adaptive limit should react to; they cause
+           it.
+        */
+        if (adaptiveLimitP && !envP->fault_occurred)
+            xmlrpc_gettimeofday(&admissionP->startTime);
+    }
+}
+
+
+
+void
+xmlrpc_admissionFinish(const xmlrpc_admission * const admissionP) {
+/*----------------------------------------------------------------------------
+   Note that the call admitted as *admissionP has finished.
+-----------------------------------------------------------------------------*/
+    if (admissionP->schedulerP)
+        xmlrpc_schedulerLeave(admissionP->schedulerP);
+
+    if (admissionP->methodLimitP)
+        leaveMethodLimit(admissionP->methodLimitP);
+
+    if (admissionP->adaptiveLimitP) {
+        xmlrpc_timespec now;
+        double usec;
+
+        xmlrpc_gettimeofday(&now);
+
+        usec = ((double)now.tv_sec - (double)admissionP->startTime.tv_sec)
+            * 1E6 +
+            ((double)now.tv_nsec - (double)admissionP->startTime.tv_nsec)
+            / 1E3;
+
+        /* Someone may have set the clock */
+        leaveAdaptiveLimit(admissionP->adaptiveLimitP, MAX(0.0, usec));
+    }
+}
@@ -0,0 +1,85 @@
+#ifndef ADMISSION_H_INCLUDED
+#define ADMISSION_H_INCLUDED
+
+/*============================================================================
+   Admission control: limits on how many calls a registry executes at once,
+   so that when the server is overloaded it refuses some calls right away
+   with a fault instead of making every call slow.
+
+   A method limit caps the calls of one method that execute at once and the
+   calls of it that may wait for their turn.  A call beyond both fails.
+   That keeps an expensive method from occupying every thread the server
+   has while calls of cheap methods wait behind it.
+
+   The adaptive limit caps the calls of all methods that execute at once,
+   and has no waiting.  It moves between bounds according to call latency:
+   when recent calls take much longer than calls usually do, they are
+   queueing for something, so it lowers the limit; when calls take their
+   usual time and the limit is what is holding them back, it raises it.
+
+   Finally, a scheduler (see scheduler.h) may decide when an admitted call
+   gets to execute.
+============================================================================*/
+
+#include "xmlrpc-c/time_int.h"
+#include "xmlrpc-c/base.h"
+#include "xmlrpc-c/server.h"
+#include "scheduler.h"
+
+typedef struct xmlrpc_methodLimit xmlrpc_methodLimit;
+
+typedef struct xmlrpc_adaptiveLimit xmlrpc_adaptiveLimit;
+
+typedef struct {
+/*----------------------------------------------------------------------------
+   The admission of one call, from when it is admitted until it finishes
+-----------------------------------------------------------------------------*/
+    xmlrpc_adaptiveLimit * adaptiveLimitP;
+        /* The adaptive limit under which the call was admitted.  NULL if
+           none.
+        */
+    xmlrpc_methodLimit * methodLimitP;
+        /* The method limit under which the call was admitted.  NULL if
+           none.
+        */
+    xmlrpc_scheduler * schedulerP;
+        /* The scheduler that started the call.  NULL if none. */
+    xmlrpc_timespec startTime;
+        /* When the call was admitted.  Meaningful only if there is an
+           adaptive limit.
+        */
+} xmlrpc_admission;
+
+void
+xmlrpc_methodLimitCreate(xmlrpc_env *          const envP,
+                         unsigned int          const maxRunning,
+                         unsigned int          const maxWaiting,
+                         xmlrpc_methodLimit ** const limitPP);
+
+void
+xmlrpc_methodLimitIncref(xmlrpc_methodLimit * const limitP);
+
+void
+xmlrpc_methodLimitDecref(xmlrpc_methodLimit * const limitP);
+
+void
+xmlrpc_adaptiveLimitCreate(xmlrpc_env *            const envP,
+                           unsigned int            const minLimit,
+                           unsigned int            const maxLimit,
+                           xmlrpc_adaptiveLimit ** const limitPP);
+
+void
+xmlrpc_adaptiveLimitDestroy(xmlrpc_adaptiveLimit * const limitP);
+
+void
+xmlrpc_admit(xmlrpc_env *           const envP,
+             xmlrpc_adaptiveLimit * const adaptiveLimitP,
+             xmlrpc_methodLimit *   const methodLimitP,
+             xmlrpc_scheduler *     const schedulerP,
+             xmlrpc_priority        const priority,
+             xmlrpc_admission *     const admissionP);
+
+void
+xmlrpc_admissionFinish(const xmlrpc_admission * const admissionP);
+
+#endif
@@ -0,0 +1,275 @@
+/*=============================================================================
+                                  completion
+===============================================================================
+  Call completions, through which asynchronous methods finish calls.
+  See completion.h.
+
+  On a platform without POSIX threads, a thread that waits for a
+  completion polls for it.
+=============================================================================*/
+
+#include "xmlrpc_config.h"
+
+#include <stdlib.h>
+#include <assert.h>
+#if HAVE_PTHREAD
+#include <pthread.h>
+#endif
+
+#include "bool.h"
+#include "mallocvar.h"
+#include "xmlrpc-c/base_int.h"
+#include "xmlrpc-c/lock.h"
+#include "xmlrpc-c/lock_platform.h"
+#include "xmlrpc-c/sleep_int.h"
+#include "xmlrpc-c/base.h"
+#include "xmlrpc-c/server.h"
+#include "registry.h"
+
+#include "completion.h"
+
+
+
+struct xmlrpc_call_completion {
+    xmlrpc_registry * registryP;
+        /* The registry whose method is executing the call */
+    xmlrpc_methodInfo * methodP;
+        /* The method executing the call.  We hold a reference to it, so
+           that it and the statistics 'meter' counts in outlive the call,
+           even if someone removes it from the registry meanwhile.
+        */
+    xmlrpc_callMeter meter;
+        /* Measures the call, if it has a response function.  (Otherwise,
+           the waiting thread finishes measuring).
+        */
+    xmlrpc_admission admission;
+        /* The call's admission, which we finish if the call has a response
+           function, likewise.
+        */
+    xmlrpc_call_response_fn * responseFn;
+        /* The function to which to give the response when the call
+           completes.  NULL means there isn't one; a thread gets the outcome
+           with xmlrpc_completionWait() instead, and everything below is
+           for that.
+        */
+    void * responseContext;
+#if HAVE_PTHREAD
+    pthread_mutex_t mutex;
+        /* Protects everything below */
+    pthread_cond_t completeCond;
+        /* Signalled when the call completes */
+#else
+    lock * lockP;
+        /* Protects everything below */
+#endif
+    bool isComplete;
+    xmlrpc_env fault;
+        /* How the call failed, if it did.  Meaningful only if
+           'isComplete'.
+        */
+    xmlrpc_value * resultP;
+        /* The result of the call.  Meaningful only if 'isComplete' and
+           'fault' does not indicate failure.
+        */
+};
+
+
+
+void
+xmlrpc_completionCreate(xmlrpc_env *              const envP,
+                        xmlrpc_registry *         const registryP,
+                        xmlrpc_methodInfo *       const methodP,
+                        const xmlrpc_callMeter *  const meterP,
+                        const xmlrpc_admission *  const admissionP,
+                        xmlrpc_call_response_fn * const responseFn,
+                        void *                    const responseContext,
+                        xmlrpc_call_completion ** const completionPP) {
+/*----------------------------------------------------------------------------
+   Create a completion for a call of method *methodP of registry
+   *registryP, which *meterP is measuring and which was admitted as
+   *admissionP.
+
+   When the call completes, we give the response to 'responseFn' with
+   argument 'responseContext' and destroy the completion.  Or, if
+   'responseFn' is NULL, we keep the outcome for xmlrpc_completionWait().
+-----------------------------------------------------------------------------*/
+    xmlrpc_call_completion * completionP;
+
+    MALLOCVAR(completionP);
+
+    if (completionP == NULL)
+        xmlrpc_faultf(envP, "Unable to allocate memory for a "
+                      "call completion");
+    else {
+        completionP->registryP       = registryP;
+        completionP->methodP         = methodP;
+        completionP->meter           = *meterP;
+        completionP->admission       = *admissionP;
+        completionP->responseFn      = responseFn;
+        completionP->responseContext = responseContext;
+        completionP->isComplete      = false;
+
+        xmlrpc_env_init(&completionP->fault);
+
+#if HAVE_PTHREAD
+        pthread_mutex_init(&completionP->mutex, NULL);
+        pthread_cond_init(&completionP->completeCond, NULL);
+#else
+        completionP->lockP = xmlrpc_lock_create();
+
+        if (completionP->lockP == NULL) {
+            xmlrpc_faultf(envP, "Unable to create lock for a "
+                          "call completion");
+            free(completionP);
+        }
+#endif
+        if (!envP->fault_occurred)
+            xmlrpc_methodIncref(methodP);
+
+        *completionPP = completionP;
+    }
+}
+
+
+
+void
+xmlrpc_completionDestroy(xmlrpc_call_completion * const completionP) {
+
+#if HAVE_PTHREAD
+    pthread_cond_destroy(&completionP->completeCond);
+    pthread_mutex_destroy(&completionP->mutex);
+#else
+    completionP->lockP->destroy(completionP->lockP);
+#endif
+    xmlrpc_env_clean(&completionP->fault);
+
+    xmlrpc_methodDecref(completionP->methodP);
+
+    free(completionP);
+}
+
+
+
+static void
+complete(xmlrpc_call_completion * const completionP,
+         const xmlrpc_env *       const faultP,
+         xmlrpc_value *           const resultP) {
+/*----------------------------------------------------------------------------
+   Finish the call of completion *completionP, whose outcome is *faultP
+   and, if that does not indicate failure, *resultP.
+-----------------------------------------------------------------------------*/
+    if (completionP->responseFn) {
+        xmlrpc_admissionFinish(&completionP->admission);
+
+        xmlrpc_sendCallResponse(completionP->registryP, &completionP->meter,
+                                NULL, faultP, resultP,
+                                completionP->responseFn,
+                                completionP->responseContext);
+
+        xmlrpc_completionDestroy(completionP);
+    } else {
+#if HAVE_PTHREAD
+        pthread_mutex_lock(&completionP->mutex);
+#else
+        completionP->lockP->acquire(completionP->lockP);
+#endif
+        assert(!completionP->isComplete);
+
+        if (faultP->fault_occurred)
+            xmlrpc_env_set_fault(&completionP->fault, faultP->fault_code,
+                                 faultP->fault_string);
+        else {
+            xmlrpc_INCREF(resultP);
+            completionP->resultP = resultP;
+        }
+        completionP->isComplete = true;
+
+#if HAVE_PTHREAD
+        pthread_cond_signal(&completionP->completeCond);
+        pthread_mutex_unlock(&completionP->mutex);
+#else
+        completionP->lockP->release(completionP->lockP);
+#endif
+    }
+}
+
+
+
+void
+xmlrpc_call_complete(xmlrpc_call_completion * const completionP,
+                     xmlrpc_value *           const resultP) {
+/*----------------------------------------------------------------------------
+   Finish the call of completion *completionP, with result *resultP.  An
+   asynchronous method calls this (or xmlrpc_call_complete_fault()) exactly
+   once for each call it doesn't fail immediately, from any thread.  The
+   completion no longer exists afterward.
+
+   The caller keeps its reference to *resultP.
+-----------------------------------------------------------------------------*/
+    xmlrpc_env noFault;
+
+    XMLRPC_ASSERT_PTR_OK(completionP);
+    XMLRPC_ASSERT_VALUE_OK(resultP);
+
+    xmlrpc_env_init(&noFault);
+
+    complete(completionP, &noFault, resultP);
+
+    xmlrpc_env_clean(&noFault);
+}
+
+
+
+void
+xmlrpc_call_complete_fault(xmlrpc_call_completion * const completionP,
+                           const xmlrpc_env *       const faultP) {
+/*----------------------------------------------------------------------------
+   Same as xmlrpc_call_complete(), except that the call fails, as described
+   by *faultP.
+-----------------------------------------------------------------------------*/
+    XMLRPC_ASSERT_PTR_OK(completionP);
+    XMLRPC_ASSERT(faultP->fault_occurred);
+
+    complete(completionP, faultP, NULL);
+}
+
+
+
+void
+xmlrpc_completionWait(xmlrpc_call_completion * const completionP,
+                      xmlrpc_env *             const faultP,
+                      xmlrpc_value **          const resultPP) {
+/*----------------------------------------------------------------------------
+   Wait for the call of completion *completionP, which has no response
+   function, to complete, and return its outcome as *faultP and, if that
+   is not a failure, *resultPP.
+-----------------------------------------------------------------------------*/
+    assert(completionP->responseFn == NULL);
+
+#if HAVE_PTHREAD
+    pthread_mutex_lock(&completionP->mutex);
+
+    while (!completionP->isComplete)
+        pthread_cond_wait(&completionP->completeCond, &completionP->mutex);
+
+    pthread_mutex_unlock(&completionP->mutex);
+#else
+    {
+        bool isComplete;
+
+        for (isComplete = false; !isComplete; ) {
+            completionP->lockP->acquire(completionP->lockP);
+            isComplete = completionP->isComplete;
+            completionP->lockP->release(completionP->lockP);
+
+            if (!isComplete)
+                xmlrpc_millisecond_sleep(1);
+        }
+    }
+#endif
+    if (completionP->fault.fault_occurred)
+        xmlrpc_env_set_fault(faultP, completionP->fault.fault_code,
+                             completionP->fault.fault_string);
+    else
+        *resultPP = completionP->resultP;
+}
@@ -0,0 +1,40 @@
+#ifndef COMPLETION_H_INCLUDED
+#define COMPLETION_H_INCLUDED
+
+/*============================================================================
+   A call completion is the handle through which an asynchronous method
+   (type xmlrpc_method_async) delivers the outcome of a call, possibly long
+   after the method function returned and from any thread.
+
+   The outcome goes either to a response function, which sends the
+   response to the client, or to a thread that is waiting for it in
+   xmlrpc_completionWait(), for a caller that needs the result before it
+   can go on, such as system.multicall.
+============================================================================*/
+
+#include "bool.h"
+#include "xmlrpc-c/base.h"
+#include "xmlrpc-c/server.h"
+#include "metrics.h"
+#include "admission.h"
+#include "method.h"
+
+void
+xmlrpc_completionCreate(xmlrpc_env *              const envP,
+                        xmlrpc_registry *         const registryP,
+                        xmlrpc_methodInfo *       const methodP,
+                        const xmlrpc_callMeter *  const meterP,
+                        const xmlrpc_admission *  const admissionP,
+                        xmlrpc_call_response_fn * const responseFn,
+                        void *                    const responseContext,
+                        xmlrpc_call_completion ** const completionPP);
+
+void
+xmlrpc_completionDestroy(xmlrpc_call_completion * const completionP);
+
+void
+xmlrpc_completionWait(xmlrpc_call_completion * const completionP,
+                      xmlrpc_env *             const faultP,
+                      xmlrpc_value **          const resultPP);
+
+#endif
@@ -449,6 +449,9 @@ public:
              bool *               const gotPacketP,
              packetPtr *          const packetPP);
 
+    void
+    readBuffered(vector<packetPtr> * const packetsP);
+
 private:
     socketx sock;
         // The kernel stream socket we use.
@@ -800,6 +803,24 @@ packetSocket_impl::readWait(volatile const int * const interruptP,
 
 
 
+void
+packetSocket_impl::readBuffered(vector<packetPtr> * const packetsP) {
+/*----------------------------------------------------------------------------
+   Add to *packetsP every packet already in the packet buffer, i.e. that
+   we have received but not yet returned, in the order received.
+
+   We don't read the underlying stream socket, so we never wait.  This is
+   for a reader that has just gotten a packet and wants to handle whatever
+   else the other side sent along with it in one go.
+-----------------------------------------------------------------------------*/
+    while (!this->readBuffer.empty()) {
+        packetsP->push_back(this->readBuffer.front());
+        this->readBuffer.pop();
+    }
+}
+
+
+
 packetSocket::packetSocket(int const sockFd) {
 
     this->implP = new packetSocket_impl(sockFd);
@@ -867,4 +888,12 @@ packetSocket::readWait(bool *      const eofP,
     this->readWait(&interrupt, eofP, packetPP);
 }
 
+
+
+void
+packetSocket::readBuffered(vector<packetPtr> * const packetsP) {
+
+    this->implP->readBuffered(packetsP);
+}
+
 } // namespace
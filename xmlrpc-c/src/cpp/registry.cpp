@@ -1,5 +1,6 @@
 #include <cassert>
 #include <string>
+#include <vector>
 #include <memory>
 #include <algorithm>
 
@@ -46,7 +47,9 @@ namespace xmlrpc_c {
 
 method::method() : 
         _signature("?"),
-        _help("No help is available for this method")
+        _help("No help is available for this method"),
+        _idempotent(false),
+        _priority(xmlrpc_priority_normal)
         {};
 
 
@@ -88,6 +91,59 @@ method2::execute(xmlrpc_c::paramList const& paramList,
 
 
 
+callCompletion::callCompletion(xmlrpc_call_completion * const completionP) :
+    completionP(completionP) {}
+
+
+
+void
+callCompletion::complete(value const& result) const {
+
+    if (!result.isInstantiated())
+        throwf("Xmlrpc-c user's xmlrpc_c::methodAsync object "
+               "completed a call with an uninstantiated result value.");
+
+    xmlrpc_value * const resultP(result.cValue());
+
+    xmlrpc_call_complete(this->completionP, resultP);
+
+    xmlrpc_DECREF(resultP);
+}
+
+
+
+void
+callCompletion::fail(fault const& fault) const {
+
+    env_wrap env;
+
+    xmlrpc_env_set_fault(&env.env_c, fault.getCode(),
+                         fault.getDescription().c_str());
+
+    xmlrpc_call_complete_fault(this->completionP, &env.env_c);
+}
+
+
+
+methodAsync::methodAsync() {}
+
+
+
+methodAsync::~methodAsync() {}
+
+
+
+void
+methodAsync::execute(xmlrpc_c::paramList const&,
+                     xmlrpc_c::value *   const) {
+
+    // The registry never calls this; it calls the asynchronous execute().
+
+    throwf("Asynchronous method executed as a synchronous one");
+}
+
+
+
 defaultMethod::~defaultMethod() {}
 
 
@@ -125,12 +181,6 @@ struct registry_impl {
         // Pointer to the C registry object we use to implement this
         // object.
 
-    std::list<xmlrpc_c::methodPtr> methodList;
-        // This is a list of all the method objects (actually, pointers
-        // to them).  But since the real registry is the C registry object,
-        // all this list is for is to maintain references to the objects
-        // to which the C registry points so that they continue to exist.
-
     xmlrpc_c::defaultMethodPtr defaultMethodP;
         // The real identifier of the default method is the C registry
         // object; this member exists only to maintain a reference to the
@@ -240,14 +290,14 @@ pListFromXmlrpcArray(xmlrpc_value * const arrayP) {
 static xmlrpc_value *
 c_executeMethod(xmlrpc_env *   const envP,
                 xmlrpc_value * const paramArrayP,
-                void *         const methodPtr,
+                void *         const methodPtrP,
                 void *         const callInfoPtr) {
 /*----------------------------------------------------------------------------
    This is a function designed to be called via a C registry to
    execute an XML-RPC method, but use a C++ method object to do the
    work.  You register this function as the method function and a
-   pointer to the C++ method object as the method data in the C
-   registry.
+   pointer to a methodPtr for the C++ method object as the method data in
+   the C registry (see registerMethod()).
 
    If we had a pure C++ registry, this would be unnecessary.
 
@@ -259,7 +309,8 @@ c_executeMethod(xmlrpc_env *   const envP,
 
    This function is of type 'xmlrpc_method2'.
 -----------------------------------------------------------------------------*/
-    method * const methodP(static_cast<method *>(methodPtr));
+    method * const methodP(
+        dynamic_cast<method *>(static_cast<methodPtr *>(methodPtrP)->get()));
     paramList const paramList(pListFromXmlrpcArray(paramArrayP));
     callInfo * const callInfoP(static_cast<callInfo *>(callInfoPtr));
 
@@ -305,6 +356,49 @@ c_executeMethod(xmlrpc_env *   const envP,
  
 
 
+static void
+c_executeMethodAsync(xmlrpc_env *             const envP,
+                     xmlrpc_value *           const paramArrayP,
+                     void *                   const methodPtrP,
+                     void *                   const callInfoPtr,
+                     xmlrpc_call_completion * const completionP) {
+/*----------------------------------------------------------------------------
+   Same as c_executeMethod(), but for an asynchronous method.
+
+   This function is of type 'xmlrpc_method_async'.
+-----------------------------------------------------------------------------*/
+    methodAsync * const methodP(
+        dynamic_cast<methodAsync *>(
+            static_cast<methodPtr *>(methodPtrP)->get()));
+    callInfo * const callInfoP(static_cast<callInfo *>(callInfoPtr));
+
+    try {
+        paramList const paramList(pListFromXmlrpcArray(paramArrayP));
+
+        try {
+            methodP->execute(paramList, callInfoP,
+                             callCompletion(completionP));
+        } catch (xmlrpc_c::fault const& fault) {
+            xmlrpc_env_set_fault(envP, fault.getCode(), 
+                                 fault.getDescription().c_str()); 
+        }
+    } catch (exception const& e) {
+        xmlrpc_faultf(envP, "Unexpected error executing code for "
+                      "particular method, detected by Xmlrpc-c "
+                      "method registry code.  Method did not "
+                      "fail; rather, it did not complete at all.  %s",
+                      e.what());
+    } catch (...) {
+        xmlrpc_env_set_fault(envP, XMLRPC_INTERNAL_ERROR,
+                             "Unexpected error executing code for "
+                             "particular method, detected by Xmlrpc-c "
+                             "method registry code.  Method did not "
+                             "fail; rather, it did not complete at all.");
+    }
+}
+
+
+
 static xmlrpc_value *
 c_executeDefaultMethod(xmlrpc_env *   const envP,
                        const char *   const , // host
@@ -368,26 +462,121 @@ c_executeDefaultMethod(xmlrpc_env *   const envP,
  
 
 
+static void
+c_releaseMethod(void * const methodPtrP) {
+/*----------------------------------------------------------------------------
+   Release the reference to a C++ method object that we gave a C registry
+   with the object (see registerMethod()).  The C registry calls this when
+   it is done with the method.
+
+   This function is of type 'xmlrpc_server_info_release'.
+-----------------------------------------------------------------------------*/
+    delete static_cast<methodPtr *>(methodPtrP);
+}
+
+
+
+static void
+registerMethod(xmlrpc_registry * const c_registryP,
+               string            const name,
+               methodPtr         const methodP,
+               bool              const replace) {
+/*----------------------------------------------------------------------------
+   Register C++ method object *methodP in C registry *c_registryP as method
+   'name'.
+
+   The C registry's method data is a reference to the object of its own,
+   which it releases when it is done with the method.  So the object lives
+   exactly as long as some call may need it.
+-----------------------------------------------------------------------------*/
+    env_wrap env;
+    string const signatureString(methodP->signature());
+    string const help(methodP->help());
+    methodAsync * const methodAsyncP(
+        dynamic_cast<methodAsync *>(methodP.get()));
+
+    if (methodAsyncP) {
+        struct xmlrpc_method_info_async methodInfo;
+
+        methodInfo.methodName      = name.c_str();
+        methodInfo.methodFunction  = &c_executeMethodAsync;
+        methodInfo.serverInfo      = new methodPtr(methodP);
+        methodInfo.stackSize       = 0;
+        methodInfo.signatureString = signatureString.c_str();
+        methodInfo.help            = help.c_str();
+
+        if (replace)
+            xmlrpc_registry_replace_method_async_w_release(
+                &env.env_c, c_registryP, &methodInfo, &c_releaseMethod);
+        else
+            xmlrpc_registry_add_method_async_w_release(
+                &env.env_c, c_registryP, &methodInfo, &c_releaseMethod);
+    } else {
+        struct xmlrpc_method_info3 methodInfo;
+
+        methodInfo.methodName      = name.c_str();
+        methodInfo.methodFunction  = &c_executeMethod;
+        methodInfo.serverInfo      = new methodPtr(methodP);
+        methodInfo.stackSize       = 0;
+        methodInfo.signatureString = signatureString.c_str();
+        methodInfo.help            = help.c_str();
+    
+        if (replace)
+            xmlrpc_registry_replace_method3_w_release(
+                &env.env_c, c_registryP, &methodInfo, &c_releaseMethod);
+        else
+            xmlrpc_registry_add_method3_w_release(
+                &env.env_c, c_registryP, &methodInfo, &c_releaseMethod);
+    }
+    if (!env.env_c.fault_occurred && methodP->idempotent())
+        xmlrpc_registry_mark_idempotent(&env.env_c, c_registryP,
+                                        name.c_str());
+
+    if (!env.env_c.fault_occurred &&
+        methodP->priority() != xmlrpc_priority_normal)
+        xmlrpc_registry_set_method_priority(&env.env_c, c_registryP,
+                                            name.c_str(),
+                                            methodP->priority());
+
+    throwIfError(env);
+}
+
+
+
 void
 registry::addMethod(string    const name,
                     methodPtr const methodP) {
 
-    this->implP->methodList.push_back(methodP);
+    registerMethod(this->implP->c_registryP, name, methodP, false);
+}
+
+
+
+void
+registry::replaceMethod(string    const name,
+                        methodPtr const methodP) {
+/*----------------------------------------------------------------------------
+   Same as addMethod(), except that the method replaces any existing one
+   named 'name'.  You may do this while a server is processing calls with
+   the registry; a call already executing the old method finishes with it.
+
+   The old method object lives until the last such call finishes.
+-----------------------------------------------------------------------------*/
+    registerMethod(this->implP->c_registryP, name, methodP, true);
+}
 
-    struct xmlrpc_method_info3 methodInfo;
+
+
+void
+registry::removeMethod(string const& name) {
+/*----------------------------------------------------------------------------
+   Remove the method named 'name'.  Like replaceMethod(), this is safe
+   while a server is processing calls with the registry.
+-----------------------------------------------------------------------------*/
     env_wrap env;
 
-    methodInfo.methodName      = name.c_str();
-    methodInfo.methodFunction  = &c_executeMethod;
-    methodInfo.serverInfo      = methodP.get();
-    methodInfo.stackSize       = 0;
-    string const signatureString(methodP->signature());
-    methodInfo.signatureString = signatureString.c_str();
-    string const help(methodP->help());
-    methodInfo.help            = help.c_str();
-    
-	xmlrpc_registry_add_method3(&env.env_c, this->implP->c_registryP,
-                                &methodInfo);
+    xmlrpc_registry_remove_method(&env.env_c, this->implP->c_registryP,
+                                  name.c_str());
 
     throwIfError(env);
 }
@@ -464,6 +653,142 @@ registry::setDialect(xmlrpc_dialect const dialect) {
 
 
 
+void
+registry::setSerializeThreads(unsigned int const threadCount) {
+
+    xmlrpc_registry_set_serialize_threads(this->implP->c_registryP,
+                                          threadCount);
+}
+
+
+
+void
+registry::setMulticallThreads(unsigned int const threadCount) {
+
+    xmlrpc_registry_set_multicall_threads(this->implP->c_registryP,
+                                          threadCount);
+}
+
+
+
+void
+registry::enableStatsMethod() {
+
+    env_wrap env;
+
+    xmlrpc_registry_enable_stats_method(&env.env_c, this->implP->c_registryP);
+
+    throwIfError(env);
+}
+
+
+
+xmlrpc_method_stats
+registry::methodStats(string const& methodName) const {
+
+    env_wrap env;
+    xmlrpc_method_stats stats;
+
+    xmlrpc_registry_get_method_stats(&env.env_c, this->implP->c_registryP,
+                                     methodName.c_str(), &stats);
+
+    throwIfError(env);
+
+    return stats;
+}
+
+
+
+void
+registry::setResponseCache(size_t       const maxBytes,
+                           unsigned int const ttlSecs) {
+
+    env_wrap env;
+
+    xmlrpc_registry_set_response_cache(&env.env_c, this->implP->c_registryP,
+                                       maxBytes, ttlSecs);
+
+    throwIfError(env);
+}
+
+
+
+void
+registry::setMethodLimit(string       const& methodName,
+                         unsigned int const  maxRunning,
+                         unsigned int const  maxWaiting) {
+
+    env_wrap env;
+
+    xmlrpc_registry_set_method_limit(&env.env_c, this->implP->c_registryP,
+                                     methodName.c_str(),
+                                     maxRunning, maxWaiting);
+
+    throwIfError(env);
+}
+
+
+
+void
+registry::setAdaptiveLimit(unsigned int const minLimit,
+                           unsigned int const maxLimit) {
+
+    env_wrap env;
+
+    xmlrpc_registry_set_adaptive_limit(&env.env_c, this->implP->c_registryP,
+                                       minLimit, maxLimit);
+
+    throwIfError(env);
+}
+
+
+
+void
+registry::setCheckParams(bool const check) {
+
+    xmlrpc_registry_set_check_params(this->implP->c_registryP, check);
+}
+
+
+
+void
+registry::setScheduler(unsigned int         const  maxRunning,
+                       vector<unsigned int> const& weights) {
+/*----------------------------------------------------------------------------
+   See xmlrpc_registry_set_scheduler().  'weights' empty means the default
+   weights; otherwise, it has one for each priority class.
+-----------------------------------------------------------------------------*/
+    if (!weights.empty() && weights.size() != XMLRPC_PRIORITY_COUNT)
+        throwf("There are %u priority classes, but you supplied %u weights",
+               XMLRPC_PRIORITY_COUNT, (unsigned int)weights.size());
+
+    env_wrap env;
+
+    xmlrpc_registry_set_scheduler(&env.env_c, this->implP->c_registryP,
+                                  maxRunning,
+                                  weights.empty() ? NULL : &weights[0]);
+
+    throwIfError(env);
+}
+
+
+
+xmlrpc_priority_stats
+registry::priorityStats(xmlrpc_priority const priority) const {
+
+    env_wrap env;
+    xmlrpc_priority_stats stats;
+
+    xmlrpc_registry_get_priority_stats(&env.env_c, this->implP->c_registryP,
+                                       priority, &stats);
+
+    throwIfError(env);
+
+    return stats;
+}
+
+
+
 void
 registry::processCall(string           const& callXml,
                       const callInfo * const  callInfoP,
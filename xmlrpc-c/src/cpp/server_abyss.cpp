@@ -197,6 +197,11 @@ struct serverAbyss::constrOpt_impl {
         std::string    logFileName;
         bool           serverOwnsSignals;
         bool           expectSigchld;
+        bool           eventDriven;
+        unsigned int   workerThreads;
+        unsigned int   acceptorThreads;
+        unsigned int   readBufferSize;
+        std::string    statsUri;
     } value;
     struct {
         bool registryPtr;
@@ -218,6 +223,11 @@ struct serverAbyss::constrOpt_impl {
         bool logFileName;
         bool serverOwnsSignals;
         bool expectSigchld;
+        bool eventDriven;
+        bool workerThreads;
+        bool acceptorThreads;
+        bool readBufferSize;
+        bool statsUri;
     } present;
 };
 
@@ -243,6 +253,11 @@ serverAbyss::constrOpt_impl::constrOpt_impl() {
     present.sockAddrLen       = false;
     present.serverOwnsSignals = false;
     present.expectSigchld     = false;
+    present.eventDriven       = false;
+    present.workerThreads     = false;
+    present.acceptorThreads   = false;
+    present.readBufferSize    = false;
+    present.statsUri          = false;
     
     // Set default values
     value.dontAdvertise     = false;
@@ -250,6 +265,7 @@ serverAbyss::constrOpt_impl::constrOpt_impl() {
     value.chunkResponse     = false;
     value.serverOwnsSignals = true;
     value.expectSigchld     = false;
+    value.eventDriven       = false;
 }
 
 
@@ -281,6 +297,11 @@ DEFINE_OPTION_SETTER(sockAddrLen,       socklen_t);
 DEFINE_OPTION_SETTER(logFileName,       string);
 DEFINE_OPTION_SETTER(serverOwnsSignals, bool);
 DEFINE_OPTION_SETTER(expectSigchld,     bool);
+DEFINE_OPTION_SETTER(eventDriven,       bool);
+DEFINE_OPTION_SETTER(workerThreads,     unsigned int);
+DEFINE_OPTION_SETTER(acceptorThreads,   unsigned int);
+DEFINE_OPTION_SETTER(readBufferSize,    unsigned int);
+DEFINE_OPTION_SETTER(statsUri,          string);
 
 #undef DEFINE_OPTION_SETTER
 
@@ -611,6 +632,15 @@ setAdditionalServerParms(TServer *                   const  serverP,
     ServerSetAdvertise(serverP, !opt.value.dontAdvertise);
     if (opt.value.expectSigchld)
         ServerUseSigchld(serverP);
+    ServerSetEventDriven(serverP, opt.value.eventDriven);
+    if (opt.present.workerThreads)
+        ServerSetWorkerThreads(serverP, opt.value.workerThreads);
+    if (opt.present.acceptorThreads)
+        ServerSetAcceptorThreads(serverP, opt.value.acceptorThreads);
+    if (opt.present.readBufferSize)
+        ServerSetReadBufferSize(serverP, opt.value.readBufferSize);
+    if (opt.present.statsUri)
+        ServerSetStatsUri(serverP, opt.value.statsUri.c_str());
 }
 
 
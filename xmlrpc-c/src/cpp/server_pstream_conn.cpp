@@ -23,6 +23,7 @@
 =============================================================================*/
 
 #include <memory>
+#include <vector>
 
 #include "xmlrpc-c/girerr.hpp"
 using girerr::throwf;
@@ -105,8 +106,8 @@ struct serverPstreamConn_impl {
     establishPacketSocket(serverPstreamConn::constrOpt_impl const& opt);
     
     void
-    processRecdPacket(packetPtr  const callPacketP,
-                      callInfo * const callInfoP);
+    processRecdPackets(packetPtr  const firstCallPacketP,
+                       callInfo * const callInfoP);
 
     // 'registryP' is what we actually use; 'registryHolder' just holds a
     // reference to 'registryP' so the registry doesn't disappear while
@@ -219,21 +220,40 @@ processCall(const registry * const  registryP,
 
 
 void
-serverPstreamConn_impl::processRecdPacket(packetPtr  const callPacketP,
-                                          callInfo * const callInfoP) {
-    
-    packetPtr responsePacketP;
-    try {
-        processCall(this->registryP, callPacketP, callInfoP, &responsePacketP);
-    } catch (exception const& e) {
-        throwf("Error executing received packet as an XML-RPC RPC.  %s",
-               e.what());
-    }
-    try {
-        this->packetSocketP->writeWait(responsePacketP);
-    } catch (exception const& e) {
-        throwf("Failed to write the response to the packet socket.  %s",
-               e.what());
+serverPstreamConn_impl::processRecdPackets(
+    packetPtr  const firstCallPacketP,
+    callInfo * const callInfoP) {
+/*----------------------------------------------------------------------------
+   Execute the call in packet 'firstCallPacketP', which we just read from
+   the packet socket, and every other call the client has already sent
+   (which is there when the client doesn't wait for a response before
+   sending its next call), and send their responses.
+
+   We execute the calls one at a time, in the order the client sent them,
+   and send each response as soon as its call is done, so a slow call
+   doesn't hold up the responses to the calls before it.
+-----------------------------------------------------------------------------*/
+    vector<packetPtr> callPackets;
+
+    callPackets.push_back(firstCallPacketP);
+
+    this->packetSocketP->readBuffered(&callPackets);
+
+    for (unsigned int i = 0; i < callPackets.size(); ++i) {
+        packetPtr responsePacketP;
+        try {
+            processCall(this->registryP, callPackets[i], callInfoP,
+                        &responsePacketP);
+        } catch (exception const& e) {
+            throwf("Error executing received packet as an XML-RPC RPC.  %s",
+                   e.what());
+        }
+        try {
+            this->packetSocketP->writeWait(responsePacketP);
+        } catch (exception const& e) {
+            throwf("Failed to write the response to the packet socket.  %s",
+                   e.what());
+        }
     }
 }
 
@@ -244,7 +264,8 @@ serverPstreamConn::runOnce(callInfo *           const callInfoP,
                            volatile const int * const interruptP,
                            bool *               const eofP) {
 /*----------------------------------------------------------------------------
-   Get and execute one RPC from the client.
+   Get and execute one RPC from the client, along with any others the
+   client has already sent.
 
    Unless *interruptP gets set nonzero first.
 -----------------------------------------------------------------------------*/
@@ -259,7 +280,7 @@ serverPstreamConn::runOnce(callInfo *           const callInfoP,
                e.what());
     }
     if (gotPacket)
-        this->implP->processRecdPacket(callPacketP, callInfoP);
+        this->implP->processRecdPackets(callPacketP, callInfoP);
 }
 
 
@@ -304,7 +325,7 @@ serverPstreamConn::runOnceNoWait(callInfo * const callInfoP,
                e.what());
     }
     if (gotPacket)
-        this->implP->processRecdPacket(callPacketP, callInfoP);
+        this->implP->processRecdPackets(callPacketP, callInfoP);
 
     if (didOneP)
         *didOneP = gotPacket;
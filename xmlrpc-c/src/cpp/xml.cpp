@@ -224,7 +224,8 @@ generateResponse(rpcOutcome     const& outcome,
             xmlrpc_env_set_fault(&cFault.env_c, outcome.getFault().getCode(),
                                  outcome.getFault().getDescription().c_str());
 
-            xmlrpc_serialize_fault(&env.env_c, respXmlMP, &cFault.env_c);
+            xmlrpc_serialize_fault2(&env.env_c, respXmlMP, &cFault.env_c,
+                                    dialect);
         
             *respXmlP = string(XMLRPC_MEMBLOCK_CONTENTS(char, respXmlMP),
                                    XMLRPC_MEMBLOCK_SIZE(char, respXmlMP));
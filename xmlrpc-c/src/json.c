@@ -1189,7 +1189,12 @@ serializeInt(xmlrpc_env *       const envP,
 
     xmlrpc_read_int(envP, valP, &value);
 
-    formatOut(envP, outP, "%d", value);
+    if (!envP->fault_occurred) {
+        char buffer[XMLRPC_INT64_DECIMAL_MAX];
+        size_t const len = xmlrpc_format_int64(buffer, value);
+
+        XMLRPC_MEMBLOCK_APPEND(char, envP, outP, buffer, len);
+    }
 }
 
 
@@ -1202,8 +1207,13 @@ serializeI8(xmlrpc_env *       const envP,
     xmlrpc_int64 value;
 
     xmlrpc_read_i8(envP, valP, &value);
-            
-    formatOut(envP, outP, "%" XMLRPC_PRId64, value);
+
+    if (!envP->fault_occurred) {
+        char buffer[XMLRPC_INT64_DECIMAL_MAX];
+        size_t const len = xmlrpc_format_int64(buffer, value);
+
+        XMLRPC_MEMBLOCK_APPEND(char, envP, outP, buffer, len);
+    }
 }
 
 
@@ -1401,67 +1411,121 @@ serializeStruct(xmlrpc_env *       const envP,
 
 
 static void
-serializeValue(xmlrpc_env *       const envP,
-               xmlrpc_value *     const valP,
-               unsigned int       const level,
-               xmlrpc_mem_block * const outP) {
-
-    XMLRPC_ASSERT_ENV_OK(envP);
-
-    indent(envP, level, outP);
-        
-    switch (xmlrpc_value_type(valP)) {
-    case XMLRPC_TYPE_INT:
-        serializeInt(envP, valP, outP);
-        break;
-
-    case XMLRPC_TYPE_I8:
-        serializeI8(envP, valP, outP);
-        break;
-
-    case XMLRPC_TYPE_BOOL:
-        serializeBool(envP, valP, outP);
-        break;
-
-    case XMLRPC_TYPE_DOUBLE:
-        serializeDouble(envP, valP, outP);
-        break;
+appendCachedJson(xmlrpc_env *             const envP,
+                 const xmlrpc_mem_block * const cachedP,
+                 unsigned int             const level,
+                 xmlrpc_mem_block *       const outP) {
+/*----------------------------------------------------------------------------
+   Append to *outP the JSON *cachedP, which was generated at nesting level
+   zero, re-indented for nesting level 'level'.
+
+   The only white space we generate outside of strings is the indentation
+   that follows a newline or the colon after a struct member name, and that
+   indentation is proportional to the nesting level.  So all we have to do
+   is add the indentation for 'level' at each of those places, taking care
+   not to be fooled by a colon inside a string.
+-----------------------------------------------------------------------------*/
+    const char * const begin = XMLRPC_MEMBLOCK_CONTENTS(char, cachedP);
+    const char * const end   = begin + XMLRPC_MEMBLOCK_SIZE(char, cachedP);
 
-    case XMLRPC_TYPE_DATETIME:
-        serializeDatetime(envP, valP, outP);
-        break;
+    if (level == 0)
+        XMLRPC_MEMBLOCK_APPEND(char, envP, outP, begin, end - begin);
+    else {
+        const char * last;
+        const char * cur;
+        bool inString;
 
-    case XMLRPC_TYPE_STRING:
-        serializeString(envP, valP, outP);
-        break;
+        for (last = cur = begin, inString = false;
+             cur != end && !envP->fault_occurred;
+             ++cur) {
 
-    case XMLRPC_TYPE_BASE64:
-        serializeBitstring(envP, valP, outP);
-        break;      
+            if (inString) {
+                if (*cur == '\\' && cur + 1 != end)
+                    ++cur;
+                else if (*cur == '"')
+                    inString = false;
+            } else if (*cur == '"')
+                inString = true;
+            else if (*cur == '\n' || *cur == ':') {
+                XMLRPC_MEMBLOCK_APPEND(char, envP, outP, last, cur - last + 1);
+                if (!envP->fault_occurred)
+                    indent(envP, level, outP);
+                last = cur + 1;
+            }
+        }
+        if (!envP->fault_occurred)
+            XMLRPC_MEMBLOCK_APPEND(char, envP, outP, last, end - last);
+    }
+}
 
-    case XMLRPC_TYPE_ARRAY:
-        serializeArray(envP, valP, level, outP);
-        break;
 
-    case XMLRPC_TYPE_STRUCT:
-        serializeStruct(envP, valP, level, outP);
-        break;
 
-    case XMLRPC_TYPE_C_PTR:
-        xmlrpc_faultf(envP, "Tried to serialize a C pointer value.");
-        break;
+static void
+serializeValue(xmlrpc_env *       const envP,
+               xmlrpc_value *     const valP,
+               unsigned int       const level,
+               xmlrpc_mem_block * const outP) {
 
-    case XMLRPC_TYPE_NIL:
-        formatOut(envP, outP, "null");
-        break;
+    XMLRPC_ASSERT_ENV_OK(envP);
 
-    case XMLRPC_TYPE_DEAD:
-        xmlrpc_faultf(envP, "Tried to serialize a dead value.");
-        break;
+    indent(envP, level, outP);
 
-    default:
-        xmlrpc_faultf(envP, "Invalid xmlrpc_value type: 0x%x",
-                      xmlrpc_value_type(valP));
+    if (valP->_serialCacheP && valP->_serialCacheP->jsonP)
+        appendCachedJson(envP, valP->_serialCacheP->jsonP, level, outP);
+    else {
+        switch (xmlrpc_value_type(valP)) {
+        case XMLRPC_TYPE_INT:
+            serializeInt(envP, valP, outP);
+            break;
+
+        case XMLRPC_TYPE_I8:
+            serializeI8(envP, valP, outP);
+            break;
+
+        case XMLRPC_TYPE_BOOL:
+            serializeBool(envP, valP, outP);
+            break;
+
+        case XMLRPC_TYPE_DOUBLE:
+            serializeDouble(envP, valP, outP);
+            break;
+
+        case XMLRPC_TYPE_DATETIME:
+            serializeDatetime(envP, valP, outP);
+            break;
+
+        case XMLRPC_TYPE_STRING:
+            serializeString(envP, valP, outP);
+            break;
+
+        case XMLRPC_TYPE_BASE64:
+            serializeBitstring(envP, valP, outP);
+            break;      
+
+        case XMLRPC_TYPE_ARRAY:
+            serializeArray(envP, valP, level, outP);
+            break;
+
+        case XMLRPC_TYPE_STRUCT:
+            serializeStruct(envP, valP, level, outP);
+            break;
+
+        case XMLRPC_TYPE_C_PTR:
+            xmlrpc_faultf(envP, "Tried to serialize a C pointer value.");
+            break;
+
+        case XMLRPC_TYPE_NIL:
+            formatOut(envP, outP, "null");
+            break;
+
+        case XMLRPC_TYPE_DEAD:
+            xmlrpc_faultf(envP, "Tried to serialize a dead value.");
+            break;
+
+        default:
+            xmlrpc_faultf(envP, "Invalid xmlrpc_value type: 0x%x",
+                          xmlrpc_value_type(valP));
+        }
     }
 }
 
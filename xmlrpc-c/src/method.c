@@ -22,6 +22,7 @@
 #include "mallocvar.h"
 #include "xmlrpc-c/base_int.h"
 #include "xmlrpc-c/string_int.h"
+#include "xmlrpc-c/lock_platform.h"
 #include "xmlrpc-c/base.h"
 #include "registry.h"
 
@@ -33,6 +34,8 @@ signatureDestroy(struct xmlrpc_signature * const signatureP) {
 
     if (signatureP->argList)
         free((void*)signatureP->argList);
+    if (signatureP->argTypeList)
+        free(signatureP->argTypeList);
 
     free(signatureP);
 }
@@ -63,6 +66,34 @@ translateTypeSpecifierToName(xmlrpc_env *  const envP,
         *typeNameP = NULL;  /* quiet compiler warning */
     }
 }
+
+
+
+static xmlrpc_type
+typeOfSpecifier(char const typeSpecifier) {
+/*----------------------------------------------------------------------------
+   The type for valid type specifier 'typeSpecifier' (see
+   translateTypeSpecifierToName()).
+-----------------------------------------------------------------------------*/
+    xmlrpc_type retval;
+
+    switch (typeSpecifier) {
+    case 'i': retval = XMLRPC_TYPE_INT;      break;
+    case 'b': retval = XMLRPC_TYPE_BOOL;     break;
+    case 'd': retval = XMLRPC_TYPE_DOUBLE;   break;
+    case 's': retval = XMLRPC_TYPE_STRING;   break;
+    case '8': retval = XMLRPC_TYPE_DATETIME; break;
+    case '6': retval = XMLRPC_TYPE_BASE64;   break;
+    case 'S': retval = XMLRPC_TYPE_STRUCT;   break;
+    case 'A': retval = XMLRPC_TYPE_ARRAY;    break;
+    case 'n': retval = XMLRPC_TYPE_NIL;      break;
+    case 'I': retval = XMLRPC_TYPE_I8;       break;
+    default:
+        assert(false);
+        retval = XMLRPC_TYPE_DEAD;
+    }
+    return retval;
+}
                 
 
 
@@ -81,11 +112,13 @@ makeRoomInArgList(xmlrpc_env *              const envP,
 
     if (signatureP->argListSpace < minArgCount) {
         REALLOCARRAY(signatureP->argList, minArgCount);
-        if (signatureP->argList == NULL) {
+        REALLOCARRAY(signatureP->argTypeList, minArgCount);
+        if (signatureP->argList == NULL || signatureP->argTypeList == NULL) {
             xmlrpc_faultf(envP, "Couldn't get memory for a argument list for "
                           "a method signature with %u arguments", minArgCount);
             signatureP->argListSpace = 0;
-        }
+        } else
+            signatureP->argListSpace = minArgCount;
     }
 }
 
@@ -114,7 +147,12 @@ parseArgumentTypeSpecifiers(xmlrpc_env *              const envP,
 
             makeRoomInArgList(envP, signatureP, signatureP->argCount + 1);
 
-            signatureP->argList[signatureP->argCount++] = typeName;
+            if (!envP->fault_occurred) {
+                signatureP->argList[signatureP->argCount] = typeName;
+                signatureP->argTypeList[signatureP->argCount] =
+                    typeOfSpecifier(cursorP[-1]);
+                ++signatureP->argCount;
+            }
         }
     }
     if (!envP->fault_occurred) {
@@ -123,8 +161,12 @@ parseArgumentTypeSpecifiers(xmlrpc_env *              const envP,
             ++cursorP;  /* Move past the signature and comma */
         }
     }
-    if (envP->fault_occurred) 
-        free((void*)signatureP->argList);
+    if (envP->fault_occurred) {
+        if (signatureP->argList)
+            free((void*)signatureP->argList);
+        if (signatureP->argTypeList)
+            free(signatureP->argTypeList);
+    }
 
     *nextPP = cursorP;
 }
@@ -156,6 +198,7 @@ parseOneSignature(xmlrpc_env *               const envP,
 
         signatureP->argListSpace = 0;  /* Start with no argument space */
         signatureP->argList = NULL;   /* Nothing allocated yet */
+        signatureP->argTypeList = NULL;
         signatureP->argCount = 0;  /* Start with no arguments */
 
         cursorP = startP;  /* start at the beginning */
@@ -306,7 +349,9 @@ void
 xmlrpc_methodCreate(xmlrpc_env *           const envP,
                     xmlrpc_method1               methodFnType1,
                     xmlrpc_method2               methodFnType2,
+                    xmlrpc_method_async          methodFnAsync,
                     void *                 const userData,
+                    xmlrpc_server_info_release   releaseFn,
                     const char *           const signatureString,
                     const char *           const helpText,
                     size_t                 const stackSize,
@@ -324,12 +369,37 @@ xmlrpc_methodCreate(xmlrpc_env *           const envP,
     else {
         methodP->methodFnType1  = methodFnType1;
         methodP->methodFnType2  = methodFnType2;
+        methodP->methodFnAsync  = methodFnAsync;
         methodP->userData       = userData;
+        methodP->releaseFn      = releaseFn;
         methodP->helpText       = xmlrpc_strdupsol(helpText);
         methodP->stackSize      = stackSize;
+        methodP->idempotent     = false;
+        methodP->limitP         = NULL;
+        methodP->priority       = xmlrpc_priority_normal;
+        methodP->baseP          = NULL;
+        methodP->refCount       = 1;
 
         makeSignatureList(envP, signatureString, &methodP->signatureListP);
 
+        if (!envP->fault_occurred) {
+            xmlrpc_methodMetricsCreate(envP, &methodP->metricsP);
+
+            if (envP->fault_occurred)
+                signatureListDestroy(methodP->signatureListP);
+        }
+#if !HAVE_SYNC_FETCH_AND_ADD
+        if (!envP->fault_occurred) {
+            methodP->refLockP = xmlrpc_lock_create();
+
+            if (methodP->refLockP == NULL) {
+                xmlrpc_faultf(envP, "Unable to create lock for a method "
+                              "descriptor");
+                xmlrpc_methodMetricsDestroy(methodP->metricsP);
+                signatureListDestroy(methodP->signatureListP);
+            }
+        }
+#endif
         if (envP->fault_occurred) {
             xmlrpc_strfree(methodP->helpText);
             free(methodP);
@@ -342,17 +412,214 @@ xmlrpc_methodCreate(xmlrpc_env *           const envP,
 
 
 void
-xmlrpc_methodDestroy(xmlrpc_methodInfo * const methodP) {
+xmlrpc_methodCopy(xmlrpc_env *         const envP,
+                  xmlrpc_methodInfo *  const methodP,
+                  xmlrpc_methodInfo ** const copyPP) {
+/*----------------------------------------------------------------------------
+   Make a method the same as *methodP, whose attributes (idempotent,
+   limitP, priority) the caller may change before anyone else can see it.
+
+   The copy shares everything else with *methodP, including the
+   statistics and the limit, so calls of either count in both.
+-----------------------------------------------------------------------------*/
+    xmlrpc_methodInfo * copyP;
+
+    XMLRPC_ASSERT_ENV_OK(envP);
+
+    MALLOCVAR(copyP);
+
+    if (copyP == NULL)
+        xmlrpc_faultf(envP, "Unable to allocate storage for a method "
+                      "descriptor");
+    else {
+        *copyP = *methodP;
+
+        copyP->baseP    = methodP->baseP ? methodP->baseP : methodP;
+        copyP->refCount = 1;
+
+#if !HAVE_SYNC_FETCH_AND_ADD
+        copyP->refLockP = xmlrpc_lock_create();
+
+        if (copyP->refLockP == NULL) {
+            xmlrpc_faultf(envP, "Unable to create lock for a method "
+                          "descriptor");
+            free(copyP);
+        }
+#endif
+        if (!envP->fault_occurred) {
+            xmlrpc_methodIncref(copyP->baseP);
+
+            if (copyP->limitP)
+                xmlrpc_methodLimitIncref(copyP->limitP);
+
+            *copyPP = copyP;
+        }
+    }
+}
+
+
+
+static void
+methodDestroy(xmlrpc_methodInfo * const methodP) {
     
-    signatureListDestroy(methodP->signatureListP);
+#if !HAVE_SYNC_FETCH_AND_ADD
+    methodP->refLockP->destroy(methodP->refLockP);
+#endif
+    if (methodP->limitP)
+        xmlrpc_methodLimitDecref(methodP->limitP);
 
-    xmlrpc_strfree(methodP->helpText);
+    if (methodP->baseP)
+        xmlrpc_methodDecref(methodP->baseP);
+    else {
+        xmlrpc_methodMetricsDestroy(methodP->metricsP);
+
+        signatureListDestroy(methodP->signatureListP);
+
+        xmlrpc_strfree(methodP->helpText);
 
+        if (methodP->releaseFn)
+            methodP->releaseFn(methodP->userData);
+    }
     free(methodP);
 }
 
 
 
+void
+xmlrpc_methodIncref(xmlrpc_methodInfo * const methodP) {
+
+#if HAVE_SYNC_FETCH_AND_ADD
+    __sync_fetch_and_add(&methodP->refCount, 1);
+#else
+    methodP->refLockP->acquire(methodP->refLockP);
+    ++methodP->refCount;
+    methodP->refLockP->release(methodP->refLockP);
+#endif
+}
+
+
+
+void
+xmlrpc_methodDecref(xmlrpc_methodInfo * const methodP) {
+/*----------------------------------------------------------------------------
+   Release a reference to the method, destroying it if it was the last one.
+-----------------------------------------------------------------------------*/
+    unsigned int newRefCount;
+
+#if HAVE_SYNC_FETCH_AND_ADD
+    newRefCount = __sync_sub_and_fetch(&methodP->refCount, 1);
+#else
+    methodP->refLockP->acquire(methodP->refLockP);
+    newRefCount = --methodP->refCount;
+    methodP->refLockP->release(methodP->refLockP);
+#endif
+    if (newRefCount == 0)
+        methodDestroy(methodP);
+}
+
+
+
+static bool
+signatureMatches(const struct xmlrpc_signature * const signatureP,
+                 xmlrpc_value *                  const paramArrayP) {
+/*----------------------------------------------------------------------------
+   The parameters *paramArrayP are a valid way to call the method per
+   signature *signatureP: there are as many as the signature has arguments,
+   and each is of the type of the corresponding argument.
+-----------------------------------------------------------------------------*/
+    xmlrpc_env env;
+    bool matches;
+
+    xmlrpc_env_init(&env);
+
+    if ((unsigned int)xmlrpc_array_size(&env, paramArrayP) !=
+        signatureP->argCount)
+        matches = false;
+    else {
+        unsigned int i;
+
+        for (i = 0, matches = true;
+             i < signatureP->argCount && matches && !env.fault_occurred;
+             ++i) {
+            xmlrpc_value * paramP;
+
+            xmlrpc_array_read_item(&env, paramArrayP, i, &paramP);
+
+            if (!env.fault_occurred) {
+                if (xmlrpc_value_type(paramP) != signatureP->argTypeList[i])
+                    matches = false;
+
+                xmlrpc_DECREF(paramP);
+            }
+        }
+    }
+    if (env.fault_occurred)
+        matches = false;
+
+    xmlrpc_env_clean(&env);
+
+    return matches;
+}
+
+
+
+void
+xmlrpc_methodCheckParams(xmlrpc_env *              const envP,
+                         const xmlrpc_methodInfo * const methodP,
+                         xmlrpc_value *            const paramArrayP) {
+/*----------------------------------------------------------------------------
+   Fail with XMLRPC_TYPE_ERROR if the parameters *paramArrayP don't match
+   any of the method's signatures.
+
+   A method that has no signatures accepts any parameters.
+-----------------------------------------------------------------------------*/
+    const struct xmlrpc_signature * const firstSignatureP =
+        methodP->signatureListP->firstSignatureP;
+
+    if (firstSignatureP) {
+        const struct xmlrpc_signature * signatureP;
+        bool matched;
+
+        for (signatureP = firstSignatureP, matched = false;
+             signatureP && !matched;
+             signatureP = signatureP->nextP)
+            matched = signatureMatches(signatureP, paramArrayP);
+
+        if (!matched)
+            xmlrpc_env_set_fault(
+                envP, XMLRPC_TYPE_ERROR,
+                "The parameters do not match any signature of the method.  "
+                "Use system.methodSignature to see the valid ones");
+    }
+}
+
+
+
+/* The hash table starts with this many buckets and doubles whenever there
+   are more methods than buckets, so a lookup examines about one method no
+   matter how many are registered.
+*/
+#define INITIAL_BUCKET_COUNT 16
+
+
+
+static uint32_t
+hashMethodName(const char * const methodName) {
+
+    /* This is the Bernstein hash, as xmlrpc_struct uses for member
+       names.
+    */
+    uint32_t hash;
+    const char * p;
+
+    for (hash = 0, p = &methodName[0]; *p; ++p)
+        hash = hash + *p + (hash << 5);
+
+    return hash;
+}
+
+
+
 void
 xmlrpc_methodListCreate(xmlrpc_env *         const envP,
                         xmlrpc_methodList ** const methodListPP) {
@@ -368,8 +635,22 @@ xmlrpc_methodListCreate(xmlrpc_env *         const envP,
     else {
         methodListP->firstMethodP = NULL;
         methodListP->lastMethodP = NULL;
+        methodListP->methodCount = 0;
+        methodListP->bucketCount = INITIAL_BUCKET_COUNT;
+
+        MALLOCARRAY(methodListP->bucket, methodListP->bucketCount);
+
+        if (methodListP->bucket == NULL) {
+            xmlrpc_faultf(envP, "Couldn't allocate method hash table");
+            free(methodListP);
+        } else {
+            unsigned int i;
+
+            for (i = 0; i < methodListP->bucketCount; ++i)
+                methodListP->bucket[i] = NULL;
 
-        *methodListPP = methodListP;
+            *methodListPP = methodListP;
+        }
     }
 }
 
@@ -384,11 +665,12 @@ xmlrpc_methodListDestroy(xmlrpc_methodList * methodListP) {
     for (p = methodListP->firstMethodP; p; p = nextP) {
         nextP = p->nextP;
 
-        xmlrpc_methodDestroy(p->methodP);
+        xmlrpc_methodDecref(p->methodP);
         xmlrpc_strfree(p->methodName);
         free(p);
     }
 
+    free(methodListP->bucket);
     free(methodListP);
 }
 
@@ -399,19 +681,17 @@ xmlrpc_methodListLookupByName(xmlrpc_methodList *  const methodListP,
                               const char *         const methodName,
                               xmlrpc_methodInfo ** const methodPP) {
 
-
-    /* We do a simple linear lookup along a linked list.
-       If speed is important, we can make this a binary tree instead.
-    */
+    uint32_t const hash = hashMethodName(methodName);
 
     xmlrpc_methodNode * p;
     xmlrpc_methodInfo * methodP;
 
-    for (p = methodListP->firstMethodP, methodP = NULL;
+    for (p = methodListP->bucket[hash & (methodListP->bucketCount - 1)],
+             methodP = NULL;
          p && !methodP;
-         p = p->nextP) {
+         p = p->hashNextP) {
 
-        if (xmlrpc_streq(p->methodName, methodName))
+        if (p->hash == hash && xmlrpc_streq(p->methodName, methodName))
             methodP = p->methodP;
     }
     *methodPP = methodP;
@@ -419,6 +699,52 @@ xmlrpc_methodListLookupByName(xmlrpc_methodList *  const methodListP,
 
 
 
+static void
+addToBucket(xmlrpc_methodList * const methodListP,
+            xmlrpc_methodNode * const methodNodeP) {
+
+    xmlrpc_methodNode ** const bucketP =
+        &methodListP->bucket[methodNodeP->hash &
+                             (methodListP->bucketCount - 1)];
+
+    methodNodeP->hashNextP = *bucketP;
+    *bucketP = methodNodeP;
+}
+
+
+
+static void
+growHashTable(xmlrpc_methodList * const methodListP) {
+/*----------------------------------------------------------------------------
+   Double the number of buckets in the method hash table.
+
+   If we can't get the memory, we leave the table as it is.  It still works,
+   just with longer chains.
+-----------------------------------------------------------------------------*/
+    unsigned int const newBucketCount = methodListP->bucketCount * 2;
+
+    xmlrpc_methodNode ** newBucket;
+
+    MALLOCARRAY(newBucket, newBucketCount);
+
+    if (newBucket) {
+        xmlrpc_methodNode * p;
+        unsigned int i;
+
+        for (i = 0; i < newBucketCount; ++i)
+            newBucket[i] = NULL;
+
+        free(methodListP->bucket);
+        methodListP->bucket      = newBucket;
+        methodListP->bucketCount = newBucketCount;
+
+        for (p = methodListP->firstMethodP; p; p = p->nextP)
+            addToBucket(methodListP, p);
+    }
+}
+
+
+
 void
 xmlrpc_methodListAdd(xmlrpc_env *        const envP,
                      xmlrpc_methodList * const methodListP,
@@ -444,6 +770,7 @@ xmlrpc_methodListAdd(xmlrpc_env *        const envP,
         else {
             methodNodeP->methodName = strdup(methodName);
             methodNodeP->methodP = methodP;
+            methodNodeP->hash = hashMethodName(methodName);
             methodNodeP->nextP = NULL;
             
             if (!methodListP->firstMethodP)
@@ -453,7 +780,127 @@ xmlrpc_methodListAdd(xmlrpc_env *        const envP,
                 methodListP->lastMethodP->nextP = methodNodeP;
 
             methodListP->lastMethodP = methodNodeP;
+
+            addToBucket(methodListP, methodNodeP);
+
+            ++methodListP->methodCount;
+
+            if (methodListP->methodCount > methodListP->bucketCount)
+                growHashTable(methodListP);
         }
     }
 }
 
+
+
+void
+xmlrpc_methodListRemove(xmlrpc_methodList * const methodListP,
+                        const char *        const methodName) {
+/*----------------------------------------------------------------------------
+   Remove the method named 'methodName' from *methodListP and release the
+   list's reference to it.  Do nothing if there is no such method.
+
+   This changes the list in place, so no one else may be reading it.
+-----------------------------------------------------------------------------*/
+    uint32_t const hash = hashMethodName(methodName);
+
+    xmlrpc_methodNode * prevP;
+    xmlrpc_methodNode * p;
+
+    for (p = methodListP->firstMethodP, prevP = NULL;
+         p && !(p->hash == hash && xmlrpc_streq(p->methodName, methodName));
+         prevP = p, p = p->nextP);
+
+    if (p) {
+        xmlrpc_methodNode ** bucketP;
+
+        if (prevP)
+            prevP->nextP = p->nextP;
+        else
+            methodListP->firstMethodP = p->nextP;
+
+        if (methodListP->lastMethodP == p)
+            methodListP->lastMethodP = prevP;
+
+        for (bucketP = &methodListP->bucket[hash &
+                                            (methodListP->bucketCount - 1)];
+             *bucketP != p;
+             bucketP = &(*bucketP)->hashNextP);
+
+        *bucketP = p->hashNextP;
+
+        --methodListP->methodCount;
+
+        xmlrpc_methodDecref(p->methodP);
+        xmlrpc_strfree(p->methodName);
+        free(p);
+    }
+}
+
+
+
+void
+xmlrpc_methodListSetMethod(xmlrpc_methodList * const methodListP,
+                           const char *        const methodName,
+                           xmlrpc_methodInfo * const methodP,
+                           bool *              const foundP) {
+/*----------------------------------------------------------------------------
+   Make *methodP the method named 'methodName' in *methodListP, in place of
+   the one there, and release the list's reference to that one.  The list
+   takes over the caller's reference to *methodP.
+
+   Return *foundP false, and do nothing, if there is no such method.
+
+   This changes the list in place, so no one else may be reading it.
+-----------------------------------------------------------------------------*/
+    uint32_t const hash = hashMethodName(methodName);
+
+    xmlrpc_methodNode * p;
+
+    for (p = methodListP->bucket[hash & (methodListP->bucketCount - 1)];
+         p && !(p->hash == hash && xmlrpc_streq(p->methodName, methodName));
+         p = p->hashNextP);
+
+    if (p) {
+        xmlrpc_methodDecref(p->methodP);
+        p->methodP = methodP;
+    }
+    *foundP = !!p;
+}
+
+
+
+void
+xmlrpc_methodListCopy(xmlrpc_env *         const envP,
+                      xmlrpc_methodList *  const methodListP,
+                      const char *         const exceptName,
+                      xmlrpc_methodList ** const copyPP) {
+/*----------------------------------------------------------------------------
+   Make a new method list with the same methods as *methodListP, except the
+   one named 'exceptName' (if 'exceptName' is non-null).  The methods
+   themselves are shared; the new list holds its own reference to each.
+-----------------------------------------------------------------------------*/
+    xmlrpc_methodList * copyP;
+
+    xmlrpc_methodListCreate(envP, &copyP);
+
+    if (!envP->fault_occurred) {
+        xmlrpc_methodNode * p;
+
+        for (p = methodListP->firstMethodP;
+             p && !envP->fault_occurred;
+             p = p->nextP) {
+
+            if (!exceptName || !xmlrpc_streq(p->methodName, exceptName)) {
+                xmlrpc_methodListAdd(envP, copyP, p->methodName, p->methodP);
+
+                if (!envP->fault_occurred)
+                    xmlrpc_methodIncref(p->methodP);
+            }
+        }
+        if (envP->fault_occurred)
+            xmlrpc_methodListDestroy(copyP);
+        else
+            *copyPP = copyP;
+    }
+}
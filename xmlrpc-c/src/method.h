@@ -1,7 +1,14 @@
 #ifndef METHOD_H_INCLUDED
 #define METHOD_H_INCLUDED
 
+#include "xmlrpc_config.h"
+#include "int.h"
 #include "xmlrpc-c/base.h"
+#include "xmlrpc-c/lock.h"
+#include "metrics.h"
+#include "admission.h"
+#include "scheduler.h"
+#include "rcu.h"
 
 struct xmlrpc_signature {
     struct xmlrpc_signature * nextP;
@@ -21,6 +28,11 @@ struct xmlrpc_signature {
 
            The strings are constants, not malloc'ed.
         */
+    xmlrpc_type * argTypeList;
+        /* Array of size 'argCount'.  argTypeList[i] is the type of
+           argument i -- the same thing as argList[i], in the form in which
+           we can check a parameter against it quickly.
+        */
 };
 
 typedef struct xmlrpc_signatureList {
@@ -34,7 +46,22 @@ typedef struct xmlrpc_signatureList {
 
 struct xmlrpc_registry {
     bool                        introspectionEnabled;
-    struct xmlrpc_methodList *  methodListP;
+    xmlrpc_rcu *                methodListRcuP;
+        /* Points to the registry's methods, a struct xmlrpc_methodList.
+           A method list never changes once anyone may be reading it (see
+           'methodListShared'); changing the methods after that means
+           replacing the list (see rcu.h).
+        */
+    lock *                      writeLockP;
+        /* Serializes replacing the method list, and changing the
+           methods in it.
+        */
+    volatile bool               methodListShared;
+        /* Someone may have read the method list.  Until then, the
+           registry changes the list in place instead of replacing it, so
+           registering methods before the first call is cheap.  Set with
+           'writeLockP' held; never cleared.
+        */
     xmlrpc_default_method       defaultMethodFunction;
     void *                      defaultMethodUserData;
     xmlrpc_preinvoke_method     preinvokeFunction;
@@ -48,25 +75,63 @@ struct xmlrpc_registry {
            that function, passed to it as argument.
         */
     xmlrpc_dialect dialect;
+    unsigned int serializeThreadCount;
+        /* Maximum number of threads to use to serialize a response */
+    unsigned int multicallThreadCount;
+        /* Maximum number of threads to use to execute the calls of a
+           system.multicall.  All but the multicall's own thread come from
+           a budget of multicallThreadCount - 1 extra threads that all the
+           registry's multicalls share.
+        */
+    unsigned int multicallThreadsBusy;
+        /* Number of extra threads the multicalls in progress are using */
+    lock * multicallLockP;
+        /* Protects 'multicallThreadCount' and 'multicallThreadsBusy' */
+    struct xmlrpc_responseCache * responseCacheP;
+        /* Responses of idempotent methods.  NULL if the registry doesn't
+           cache responses.
+        */
+    xmlrpc_adaptiveLimit * adaptiveLimitP;
+        /* Limit on calls executing at once, of all methods together.
+           NULL if none.
+        */
+    bool checkParams;
+        /* Reject a call whose parameters match none of the method's
+           signatures, without calling the method.
+        */
+    xmlrpc_scheduler * schedulerP;
+        /* Scheduler that orders calls by priority when too many arrive
+           at once.  NULL if none.
+        */
 };
 
-typedef struct {
+typedef struct xmlrpc_methodInfo {
 /*----------------------------------------------------------------------------
-   Everything a registry knows about one XML-RPC method
+   Everything a registry knows about one XML-RPC method.
+
+   Nothing in it changes once a call may be using it.  To change an
+   attribute of a method (idempotent, limitP, priority), the registry puts
+   a changed copy in its place (see xmlrpc_methodCopy()).
 -----------------------------------------------------------------------------*/
-    /* One of the methodTypeX fields is NULL and the other isn't.
-       (The reason there are two is backward compatibility.  Old
-       programs set up the registry with Type 1; modern ones set it up
-       with Type 2.
+    /* Exactly one of the methodFnX fields is non-NULL.
+       (The reason there are two synchronous ones is backward
+       compatibility.  Old programs set up the registry with Type 1; modern
+       ones set it up with Type 2.
     */
     xmlrpc_method1 methodFnType1;
         /* The method function, if it's type 1.  Null if it's not */
     xmlrpc_method2 methodFnType2;
         /* The method function, if it's type 2.  Null if it's not */
+    xmlrpc_method_async methodFnAsync;
+        /* The method function, if it's asynchronous.  Null if it's not */
     void * userData;
         /* Passed to method function */
+    xmlrpc_server_info_release releaseFn;
+        /* Function we call with 'userData' when we destroy the method.
+           NULL if none.
+        */
     size_t stackSize;
-        /* Amount of stack space 'methodFnType1' or 'methodFnType2' uses.
+        /* Amount of stack space the method function uses.
            Zero means unspecified.
         */
     struct xmlrpc_signatureList * signatureListP;
@@ -76,10 +141,43 @@ typedef struct {
         */
     const char * helpText;
         /* Stuff returned by system method system.methodHelp */
+    xmlrpc_methodMetrics * metricsP;
+        /* Statistics about calls of the method */
+    bool idempotent;
+        /* A call with given parameters always has the same response, so
+           the registry may cache it (see xmlrpc_registry_mark_idempotent())
+        */
+    xmlrpc_methodLimit * limitP;
+        /* Limit on calls of the method executing at once.  NULL if
+           none.
+        */
+    xmlrpc_priority priority;
+        /* Priority of calls of the method under the registry's
+           scheduler
+        */
+    struct xmlrpc_methodInfo * baseP;
+        /* The method of which this is a copy, which owns the things
+           the two share: 'userData', the signatures, the help text, and
+           the statistics.  We hold a reference to it.  NULL if this is not
+           a copy.
+        */
+    volatile unsigned int refCount;
+        /* One reference for each method list that contains the method and
+           one for each call that is using it.  A method stays around
+           until its last call finishes, even if the registry drops it.
+        */
+#if !HAVE_SYNC_FETCH_AND_ADD
+    lock * refLockP;
+        /* Protects 'refCount' */
+#endif
 } xmlrpc_methodInfo;
 
 typedef struct xmlrpc_methodNode {
     struct xmlrpc_methodNode * nextP;
+    struct xmlrpc_methodNode * hashNextP;
+        /* Next node in the same hash bucket (see xmlrpc_methodList) */
+    uint32_t hash;
+        /* Hash of 'methodName' */
     const char * methodName;
     xmlrpc_methodInfo * methodP;
 } xmlrpc_methodNode;
@@ -87,20 +185,46 @@ typedef struct xmlrpc_methodNode {
 typedef struct xmlrpc_methodList {
     xmlrpc_methodNode * firstMethodP;
     xmlrpc_methodNode * lastMethodP;
+        /* All the methods, linked by 'nextP', in the order they were
+           added.
+        */
+    xmlrpc_methodNode ** bucket;
+        /* Hash table of the same methods, for lookup by name: the methods
+           whose name hashes to h are in the list linked by 'hashNextP'
+           from bucket[h % bucketCount].
+        */
+    unsigned int bucketCount;
+        /* A power of two, so h % bucketCount is a mask */
+    unsigned int methodCount;
 } xmlrpc_methodList;
 
 void
 xmlrpc_methodCreate(xmlrpc_env *           const envP,
                     xmlrpc_method1               methodFnType1,
                     xmlrpc_method2               methodFnType2,
+                    xmlrpc_method_async          methodFnAsync,
                     void *                 const userData,
+                    xmlrpc_server_info_release   releaseFn,
                     const char *           const signatureString,
                     const char *           const helpText,
                     size_t                 const stackSize,
                     xmlrpc_methodInfo **   const methodPP);
 
 void
-xmlrpc_methodDestroy(xmlrpc_methodInfo * const methodP);
+xmlrpc_methodCopy(xmlrpc_env *         const envP,
+                  xmlrpc_methodInfo *  const methodP,
+                  xmlrpc_methodInfo ** const copyPP);
+
+void
+xmlrpc_methodIncref(xmlrpc_methodInfo * const methodP);
+
+void
+xmlrpc_methodDecref(xmlrpc_methodInfo * const methodP);
+
+void
+xmlrpc_methodCheckParams(xmlrpc_env *              const envP,
+                         const xmlrpc_methodInfo * const methodP,
+                         xmlrpc_value *            const paramArrayP);
 
 void
 xmlrpc_methodListCreate(xmlrpc_env *         const envP,
@@ -120,6 +244,35 @@ xmlrpc_methodListAdd(xmlrpc_env *        const envP,
                      const char *        const methodName,
                      xmlrpc_methodInfo * const methodP);
 
+void
+xmlrpc_methodListRemove(xmlrpc_methodList * const methodListP,
+                        const char *        const methodName);
+
+void
+xmlrpc_methodListSetMethod(xmlrpc_methodList * const methodListP,
+                           const char *        const methodName,
+                           xmlrpc_methodInfo * const methodP,
+                           bool *              const foundP);
+
+void
+xmlrpc_methodListCopy(xmlrpc_env *         const envP,
+                      xmlrpc_methodList *  const methodListP,
+                      const char *         const exceptName,
+                      xmlrpc_methodList ** const copyPP);
+
+xmlrpc_methodList *
+xmlrpc_registryReadMethods(struct xmlrpc_registry * const registryP,
+                           unsigned int *           const tokenP);
+
+void
+xmlrpc_registryReadMethodsDone(struct xmlrpc_registry * const registryP,
+                               unsigned int             const token);
+
+void
+xmlrpc_registryAcquireMethod(struct xmlrpc_registry * const registryP,
+                             const char *             const methodName,
+                             xmlrpc_methodInfo **     const methodPP);
+
 
 
 #endif
@@ -0,0 +1,290 @@
+/*=============================================================================
+                                  metrics
+===============================================================================
+  Per-method call statistics.  See metrics.h.
+
+  Where the compiler provides an atomic add (HAVE_SYNC_FETCH_AND_ADD), a
+  thread updates its slot with that, since another thread may share the
+  slot.  Elsewhere, a lock protects all the slots.
+=============================================================================*/
+
+#include "xmlrpc_config.h"
+
+#include <stdlib.h>
+#include <string.h>
+#if HAVE_PTHREAD
+#include <pthread.h>
+#endif
+
+#include "bool.h"
+#include "int.h"
+#include "mallocvar.h"
+#include "xmlrpc-c/base_int.h"
+#include "xmlrpc-c/lock.h"
+#include "xmlrpc-c/lock_platform.h"
+#include "xmlrpc-c/time_int.h"
+#include "xmlrpc-c/counter_int.h"
+#include "xmlrpc-c/base.h"
+#include "xmlrpc-c/server.h"
+
+#include "metrics.h"
+
+
+/* Threads count in this many slots */
+#define SLOT_COUNT 8
+
+#define CACHE_LINE_SIZE 64
+
+struct counters {
+    /* Where updates aren't atomic, the user of these holds the metrics'
+       lock, so passes no lock to xmlrpc_counterAdd(), etc.
+    */
+    xmlrpc_counter calls;
+    xmlrpc_counter faults;
+    xmlrpc_counter totalUsec;
+    xmlrpc_counter latency[XMLRPC_METHOD_STATS_BUCKETS];
+    xmlrpc_counter callBytes;
+    xmlrpc_counter responseBytes;
+};
+
+typedef union {
+    struct counters counters;
+    char pad[(sizeof(struct counters) + CACHE_LINE_SIZE - 1)
+             / CACHE_LINE_SIZE * CACHE_LINE_SIZE];
+        /* Makes the slot whole cache lines */
+} slot;
+
+struct xmlrpc_methodMetrics {
+    void * memory;
+        /* The malloc'ed memory in which 'slot' is */
+    slot * slot;
+        /* Array of SLOT_COUNT slots, starting on a cache line boundary */
+#if !HAVE_SYNC_FETCH_AND_ADD
+    lock * lockP;
+        /* Protects the slots */
+#endif
+};
+
+
+
+#if HAVE_PTHREAD
+
+static pthread_once_t slotKeyOnce = PTHREAD_ONCE_INIT;
+
+static pthread_key_t slotKey;
+    /* A thread's value for this key points to slotTag[n], where n is the
+       thread's slot.  NULL if the thread hasn't counted a call yet.
+    */
+
+static char slotTag[SLOT_COUNT];
+
+static unsigned int nextSlot;
+    /* The slot for the next thread that counts a call, modulo SLOT_COUNT */
+
+
+
+static void
+createSlotKey(void) {
+
+    pthread_key_create(&slotKey, NULL);
+}
+
+
+
+static unsigned int
+threadSlot(void) {
+/*----------------------------------------------------------------------------
+   The slot in which the calling thread counts calls.  Threads get slots in
+   turn, the first time they count something.
+-----------------------------------------------------------------------------*/
+    const char * tagP;
+
+    pthread_once(&slotKeyOnce, &createSlotKey);
+
+    tagP = pthread_getspecific(slotKey);
+
+    if (tagP == NULL) {
+        unsigned int thisSlot;
+
+#if HAVE_SYNC_FETCH_AND_ADD
+        thisSlot = __sync_fetch_and_add(&nextSlot, 1);
+#else
+        /* A race here just means two threads may get the same slot */
+        thisSlot = nextSlot++;
+#endif
+        tagP = &slotTag[thisSlot % SLOT_COUNT];
+
+        pthread_setspecific(slotKey, tagP);
+    }
+    return tagP - &slotTag[0];
+}
+
+#else
+
+static unsigned int
+threadSlot(void) {
+
+    return 0;
+}
+
+#endif
+
+
+
+void
+xmlrpc_methodMetricsCreate(xmlrpc_env *            const envP,
+                           xmlrpc_methodMetrics ** const metricsPP) {
+
+    xmlrpc_methodMetrics * metricsP;
+
+    MALLOCVAR(metricsP);
+
+    if (metricsP == NULL)
+        xmlrpc_faultf(envP, "Unable to allocate memory for method "
+                      "statistics");
+    else {
+        metricsP->memory =
+            malloc(SLOT_COUNT * sizeof(slot) + CACHE_LINE_SIZE - 1);
+
+        if (metricsP->memory == NULL)
+            xmlrpc_faultf(envP, "Unable to allocate memory for %u method "
+                          "statistics slots", SLOT_COUNT);
+        else {
+            char * const memory = metricsP->memory;
+            size_t const misalignment = (size_t)memory % CACHE_LINE_SIZE;
+
+            metricsP->slot = (slot *)
+                (misalignment == 0 ?
+                 memory : memory + CACHE_LINE_SIZE - misalignment);
+
+            memset(metricsP->slot, 0, SLOT_COUNT * sizeof(slot));
+
+#if !HAVE_SYNC_FETCH_AND_ADD
+            metricsP->lockP = xmlrpc_lock_create();
+
+            if (metricsP->lockP == NULL) {
+                xmlrpc_faultf(envP, "Unable to create lock for method "
+                              "statistics");
+                free(metricsP->memory);
+            }
+#endif
+        }
+        if (envP->fault_occurred)
+            free(metricsP);
+    }
+    *metricsPP = metricsP;
+}
+
+
+
+void
+xmlrpc_methodMetricsDestroy(xmlrpc_methodMetrics * const metricsP) {
+
+#if !HAVE_SYNC_FETCH_AND_ADD
+    metricsP->lockP->destroy(metricsP->lockP);
+#endif
+    free(metricsP->memory);
+
+    free(metricsP);
+}
+
+
+
+void
+xmlrpc_callMeterStart(xmlrpc_callMeter *     const meterP,
+                      xmlrpc_methodMetrics * const metricsP,
+                      size_t                 const callSize) {
+/*----------------------------------------------------------------------------
+   Start measuring a call that is to be counted in *metricsP (NULL means
+   not to count it) and whose call XML is 'callSize' bytes.
+-----------------------------------------------------------------------------*/
+    meterP->metricsP = metricsP;
+    meterP->callSize = callSize;
+
+    if (metricsP)
+        xmlrpc_gettimeofday(&meterP->startTime);
+}
+
+
+
+void
+xmlrpc_callMeterFinish(const xmlrpc_callMeter * const meterP,
+                       bool                     const faulted,
+                       size_t                   const responseSize) {
+/*----------------------------------------------------------------------------
+   Count the call measured by *meterP, which has just produced a
+   'responseSize'-byte response, which is a fault response iff 'faulted'.
+-----------------------------------------------------------------------------*/
+    xmlrpc_methodMetrics * const metricsP = meterP->metricsP;
+
+    if (metricsP) {
+        struct counters * const countersP =
+            &metricsP->slot[threadSlot()].counters;
+
+        xmlrpc_timespec now;
+        uint64_t usec;
+
+        xmlrpc_gettimeofday(&now);
+
+        usec = xmlrpc_usecBetween(meterP->startTime, now);
+
+#if !HAVE_SYNC_FETCH_AND_ADD
+        metricsP->lockP->acquire(metricsP->lockP);
+#endif
+        xmlrpc_counterAdd(&countersP->calls, NULL, 1);
+        if (faulted)
+            xmlrpc_counterAdd(&countersP->faults, NULL, 1);
+        xmlrpc_counterAdd(&countersP->totalUsec, NULL, usec);
+        xmlrpc_counterAdd(
+            &countersP->latency[
+                xmlrpc_latencyBucket(usec, XMLRPC_METHOD_STATS_BUCKETS)],
+            NULL, 1);
+        xmlrpc_counterAdd(&countersP->callBytes, NULL, meterP->callSize);
+        xmlrpc_counterAdd(&countersP->responseBytes, NULL, responseSize);
+#if !HAVE_SYNC_FETCH_AND_ADD
+        metricsP->lockP->release(metricsP->lockP);
+#endif
+    }
+}
+
+
+
+void
+xmlrpc_methodMetricsRead(xmlrpc_methodMetrics * const metricsP,
+                         xmlrpc_method_stats *  const statsP) {
+/*----------------------------------------------------------------------------
+   Return the statistics in *metricsP as *statsP.
+
+   Other threads may be counting calls while we read, so the result need
+   not be a consistent snapshot; e.g. a call may show in 'calls' but not
+   yet in 'latency'.
+-----------------------------------------------------------------------------*/
+    unsigned int i;
+
+    memset(statsP, 0, sizeof(*statsP));
+
+#if !HAVE_SYNC_FETCH_AND_ADD
+    metricsP->lockP->acquire(metricsP->lockP);
+#endif
+    for (i = 0; i < SLOT_COUNT; ++i) {
+        struct counters * const countersP = &metricsP->slot[i].counters;
+
+        unsigned int bucket;
+
+        statsP->calls     += xmlrpc_counterValue(&countersP->calls, NULL);
+        statsP->faults    += xmlrpc_counterValue(&countersP->faults, NULL);
+        statsP->totalUsec += xmlrpc_counterValue(&countersP->totalUsec, NULL);
+
+        for (bucket = 0; bucket < XMLRPC_METHOD_STATS_BUCKETS; ++bucket)
+            statsP->latency[bucket] +=
+                xmlrpc_counterValue(&countersP->latency[bucket], NULL);
+
+        statsP->callBytes +=
+            xmlrpc_counterValue(&countersP->callBytes, NULL);
+        statsP->responseBytes +=
+            xmlrpc_counterValue(&countersP->responseBytes, NULL);
+    }
+#if !HAVE_SYNC_FETCH_AND_ADD
+    metricsP->lockP->release(metricsP->lockP);
+#endif
+}
@@ -0,0 +1,61 @@
+#ifndef METRICS_H_INCLUDED
+#define METRICS_H_INCLUDED
+
+/*============================================================================
+   Statistics about the calls of one method, for
+   xmlrpc_registry_get_method_stats() and system.stats.
+
+   Any number of threads may be executing a method at once, so each thread
+   counts in a slot of its own that occupies whole cache lines; threads
+   counting calls don't contend for memory.  (If there are more threads than
+   slots, some share a slot).  Reading the statistics adds up the slots.
+============================================================================*/
+
+#include <stddef.h>
+
+#include "bool.h"
+#include "int.h"
+#include "xmlrpc-c/time_int.h"
+#include "xmlrpc-c/base.h"
+#include "xmlrpc-c/server.h"
+
+typedef struct xmlrpc_methodMetrics xmlrpc_methodMetrics;
+
+typedef struct {
+/*----------------------------------------------------------------------------
+   A call being measured, from when its method starts executing until its
+   response is ready.
+-----------------------------------------------------------------------------*/
+    xmlrpc_methodMetrics * metricsP;
+        /* Where to count the call.  NULL means nowhere, e.g. because
+           there is no such method.
+        */
+    xmlrpc_timespec startTime;
+    size_t callSize;
+        /* Size of the call XML; zero if there isn't any, as for a call
+           within system.multicall.
+        */
+} xmlrpc_callMeter;
+
+void
+xmlrpc_methodMetricsCreate(xmlrpc_env *            const envP,
+                           xmlrpc_methodMetrics ** const metricsPP);
+
+void
+xmlrpc_methodMetricsDestroy(xmlrpc_methodMetrics * const metricsP);
+
+void
+xmlrpc_methodMetricsRead(xmlrpc_methodMetrics * const metricsP,
+                         xmlrpc_method_stats *  const statsP);
+
+void
+xmlrpc_callMeterStart(xmlrpc_callMeter *     const meterP,
+                      xmlrpc_methodMetrics * const metricsP,
+                      size_t                 const callSize);
+
+void
+xmlrpc_callMeterFinish(const xmlrpc_callMeter * const meterP,
+                       bool                     const faulted,
+                       size_t                   const responseSize);
+
+#endif
@@ -9,6 +9,8 @@
 #include <float.h>
 
 #include "bool.h"
+#include "girmath.h"
+#include "mallocvar.h"
 
 #include "xmlrpc-c/base.h"
 #include "xmlrpc-c/base_int.h"
@@ -267,9 +269,9 @@ parseStruct(xmlrpc_env *    const envP,
 
 
 static void
-parseInt(xmlrpc_env *    const envP,
-         const char *    const str,
-         xmlrpc_value ** const valuePP) {
+parseIntString(xmlrpc_env *   const envP,
+               const char *   const str,
+               xmlrpc_int32 * const valueP) {
 /*----------------------------------------------------------------------------
    Parse the content of a <int> XML-RPC XML element, e.g. "34".
 
@@ -318,7 +320,7 @@ parseInt(xmlrpc_env *    const envP,
                                   "<int> value '%s' contains non-numerical "
                                   "junk: '%s'", str, tail);
                 else
-                    *valuePP = xmlrpc_int_new(envP, i);
+                    *valueP = i;
             }
         }
     }
@@ -327,9 +329,24 @@ parseInt(xmlrpc_env *    const envP,
 
 
 static void
-parseBoolean(xmlrpc_env *    const envP,
-             const char *    const str,
-             xmlrpc_value ** const valuePP) {
+parseInt(xmlrpc_env *    const envP,
+         const char *    const str,
+         xmlrpc_value ** const valuePP) {
+
+    xmlrpc_int32 i;
+
+    parseIntString(envP, str, &i);
+
+    if (!envP->fault_occurred)
+        *valuePP = xmlrpc_int_new(envP, i);
+}
+
+
+
+static void
+parseBooleanString(xmlrpc_env *  const envP,
+                   const char *  const str,
+                   xmlrpc_bool * const valueP) {
 /*----------------------------------------------------------------------------
    Parse the content of a <boolean> XML-RPC XML element, e.g. "1".
 
@@ -339,7 +356,7 @@ parseBoolean(xmlrpc_env *    const envP,
     XMLRPC_ASSERT_PTR_OK(str);
 
     if (xmlrpc_streq(str, "0") || xmlrpc_streq(str, "1"))
-        *valuePP = xmlrpc_bool_new(envP, xmlrpc_streq(str, "1") ? 1 : 0);
+        *valueP = xmlrpc_streq(str, "1") ? 1 : 0;
     else
         setParseFault(envP, "<boolean> XML element content must be either "
                       "'0' or '1' according to XML-RPC.  This one has '%s'",
@@ -348,6 +365,21 @@ parseBoolean(xmlrpc_env *    const envP,
 
 
 
+static void
+parseBoolean(xmlrpc_env *    const envP,
+             const char *    const str,
+             xmlrpc_value ** const valuePP) {
+
+    xmlrpc_bool b;
+
+    parseBooleanString(envP, str, &b);
+
+    if (!envP->fault_occurred)
+        *valuePP = xmlrpc_bool_new(envP, b);
+}
+
+
+
 static void
 scanAndValidateDoubleString(xmlrpc_env *  const envP,
                             const char *  const string,
@@ -493,9 +525,9 @@ parseDoubleStringStrtod(const char * const str,
 
 
 static void
-parseDouble(xmlrpc_env *    const envP,
-            const char *    const str,
-            xmlrpc_value ** const valuePP) {
+parseDoubleContent(xmlrpc_env * const envP,
+                   const char * const str,
+                   double *     const valueP) {
 /*----------------------------------------------------------------------------
    Parse the content of a <double> XML-RPC XML element, e.g. "34.5".
 
@@ -527,13 +559,28 @@ parseDouble(xmlrpc_env *    const envP,
     }
     
     if (!envP->fault_occurred)
-        *valuePP = xmlrpc_double_new(envP, valueDouble);
+        *valueP = valueDouble;
 
     xmlrpc_env_clean(&parseEnv);
 }
 
 
 
+static void
+parseDouble(xmlrpc_env *    const envP,
+            const char *    const str,
+            xmlrpc_value ** const valuePP) {
+
+    double d;
+
+    parseDoubleContent(envP, str, &d);
+
+    if (!envP->fault_occurred)
+        *valuePP = xmlrpc_double_new(envP, d);
+}
+
+
+
 static void
 parseBase64(xmlrpc_env *    const envP,
             const char *    const str,
@@ -565,9 +612,9 @@ parseBase64(xmlrpc_env *    const envP,
 
 
 static void
-parseI8(xmlrpc_env *    const envP,
-        const char *    const str,
-        xmlrpc_value ** const valuePP) {
+parseI8String(xmlrpc_env *   const envP,
+              const char *   const str,
+              xmlrpc_int64 * const valueP) {
 /*----------------------------------------------------------------------------
    Parse the content of a <i8> XML-RPC XML element, e.g. "34".
 
@@ -594,7 +641,7 @@ parseI8(xmlrpc_env *    const envP,
                           "because it does not represent "
                           "a 64 bit integer.  %s", env.fault_string);
         else
-            *valuePP = xmlrpc_i8_new(envP, i);
+            *valueP = i;
 
         xmlrpc_env_clean(&env);
     }
@@ -602,6 +649,45 @@ parseI8(xmlrpc_env *    const envP,
 
 
 
+static void
+parseI8(xmlrpc_env *    const envP,
+        const char *    const str,
+        xmlrpc_value ** const valuePP) {
+
+    xmlrpc_int64 i;
+
+    parseI8String(envP, str, &i);
+
+    if (!envP->fault_occurred)
+        *valuePP = xmlrpc_i8_new(envP, i);
+}
+
+
+
+static bool
+isIntElement(const char * const elementName) {
+
+    return
+        xmlrpc_streq(elementName, "int")   ||
+        xmlrpc_streq(elementName, "i4")    ||
+        xmlrpc_streq(elementName, "i1")    ||
+        xmlrpc_streq(elementName, "i2")    ||
+        xmlrpc_streq(elementName, "ex:i1") ||
+        xmlrpc_streq(elementName, "ex:i2");
+}
+
+
+
+static bool
+isI8Element(const char * const elementName) {
+
+    return
+        xmlrpc_streq(elementName, "i8") ||
+        xmlrpc_streq(elementName, "ex:i8");
+}
+
+
+
 static void
 parseSimpleValueCdata(xmlrpc_env *    const envP,
                       const char *    const elementName,
@@ -634,12 +720,7 @@ parseSimpleValueCdata(xmlrpc_env *    const envP,
        "i1" and "i2" are just from my imagination.
     */
 
-    if (xmlrpc_streq(elementName, "int")   ||
-        xmlrpc_streq(elementName, "i4")    ||
-        xmlrpc_streq(elementName, "i1")    ||
-        xmlrpc_streq(elementName, "i2")    ||
-        xmlrpc_streq(elementName, "ex:i1") ||
-        xmlrpc_streq(elementName, "ex:i2"))
+    if (isIntElement(elementName))
         parseInt(envP, cdata, valuePP);
     else if (xmlrpc_streq(elementName, "boolean"))
         parseBoolean(envP, cdata, valuePP);
@@ -654,8 +735,7 @@ parseSimpleValueCdata(xmlrpc_env *    const envP,
     else if (xmlrpc_streq(elementName, "nil") ||
              xmlrpc_streq(elementName, "ex:nil"))
         *valuePP = xmlrpc_nil_new(envP);
-    else if (xmlrpc_streq(elementName, "i8") ||
-             xmlrpc_streq(elementName, "ex:i8"))
+    else if (isI8Element(elementName))
         parseI8(envP, cdata, valuePP);
     else
         setParseFault(envP, "Unknown value type -- XML element is named "
@@ -742,3 +822,279 @@ xmlrpc_parseValue(xmlrpc_env *    const envP,
 
 
 
+
+
+
+static void
+parseStringMember(xmlrpc_env *  const envP,
+                  const char *  const cdata,
+                  size_t        const cdataSize,
+                  const char ** const stringP) {
+/*----------------------------------------------------------------------------
+   Make a NUL-terminated copy of the 'cdataSize'-byte content 'cdata' of a
+   string member, as newly malloc'ed storage *stringP.  Fail if it isn't
+   UTF-8, like xmlrpc_string_new_lp() does for a string value.
+-----------------------------------------------------------------------------*/
+    xmlrpc_validate_utf8(envP, cdata, cdataSize);
+
+    if (!envP->fault_occurred) {
+        char * string;
+
+        MALLOCARRAY(string, cdataSize + 1);
+
+        if (string == NULL)
+            xmlrpc_faultf(envP, "Couldn't allocate memory for "
+                          "%u-character string",
+                          (unsigned int)cdataSize);
+        else {
+            memcpy(string, cdata, cdataSize);
+            string[cdataSize] = '\0';
+            *stringP = string;
+        }
+    }
+}
+
+
+
+static void
+parseMemberDirect(xmlrpc_env *                const envP,
+                  xml_element *               const valueElemP,
+                  const xmlrpc_struct_field * const fieldP,
+                  void *                      const structP) {
+/*----------------------------------------------------------------------------
+   Parse the <value> element 'valueElemP' of a structure member and store
+   the value in the member of C structure *structP that *fieldP describes.
+-----------------------------------------------------------------------------*/
+    char * const memberP = (char *)structP + fieldP->offset;
+
+    size_t const childCount = xml_element_children_size(valueElemP);
+
+    const char * typeName;
+        /* Name of the type element; NULL if there isn't one */
+    const char * cdata;
+    size_t cdataSize;
+
+    if (childCount == 0) {
+        typeName  = NULL;
+        cdata     = xml_element_cdata(valueElemP);
+        cdataSize = xml_element_cdata_size(valueElemP);
+    } else if (childCount > 1) {
+        setParseFault(envP, "<value> has %u child elements.  "
+                      "Only zero or one make sense.",
+                      (unsigned int)childCount);
+    } else {
+        xml_element * const childP = xml_element_children(valueElemP)[0];
+
+        if (xml_element_children_size(childP) > 0)
+            setParseFault(envP, "Member '%s' is not a simple value",
+                          fieldP->name);
+        else {
+            typeName  = xml_element_name(childP);
+            cdata     = xml_element_cdata(childP);
+            cdataSize = xml_element_cdata_size(childP);
+        }
+    }
+    if (!envP->fault_occurred) {
+        switch (fieldP->type) {
+        case XMLRPC_TYPE_INT:
+            if (typeName && isIntElement(typeName))
+                parseIntString(envP, cdata, (xmlrpc_int32 *)memberP);
+            else
+                setParseFault(envP, "Member '%s' is not an integer",
+                              fieldP->name);
+            break;
+        case XMLRPC_TYPE_I8:
+            if (typeName && isI8Element(typeName))
+                parseI8String(envP, cdata, (xmlrpc_int64 *)memberP);
+            else if (typeName && isIntElement(typeName)) {
+                xmlrpc_int32 i;
+                parseIntString(envP, cdata, &i);
+                if (!envP->fault_occurred)
+                    *(xmlrpc_int64 *)memberP = i;
+            } else
+                setParseFault(envP, "Member '%s' is not an integer",
+                              fieldP->name);
+            break;
+        case XMLRPC_TYPE_BOOL:
+            if (typeName && xmlrpc_streq(typeName, "boolean"))
+                parseBooleanString(envP, cdata, (xmlrpc_bool *)memberP);
+            else
+                setParseFault(envP, "Member '%s' is not a boolean",
+                              fieldP->name);
+            break;
+        case XMLRPC_TYPE_DOUBLE:
+            if (typeName && xmlrpc_streq(typeName, "double"))
+                parseDoubleContent(envP, cdata, (double *)memberP);
+            else
+                setParseFault(envP, "Member '%s' is not a double",
+                              fieldP->name);
+            break;
+        case XMLRPC_TYPE_STRING:
+            if (typeName && !xmlrpc_streq(typeName, "string"))
+                setParseFault(envP, "Member '%s' is not a string",
+                              fieldP->name);
+            else
+                parseStringMember(envP, cdata, cdataSize,
+                                  (const char **)memberP);
+            break;
+        default:
+            xmlrpc_faultf(envP, "Member '%s' is of type %s, which a "
+                          "structure descriptor cannot describe",
+                          fieldP->name, xmlrpc_type_name(fieldP->type));
+        }
+    }
+}
+
+
+
+static const xmlrpc_struct_field *
+fieldNamed(const xmlrpc_struct_field * const fields,
+           const char *                const name,
+           size_t                      const nameLen) {
+
+    const xmlrpc_struct_field * fieldP;
+
+    for (fieldP = &fields[0]; fieldP->name; ++fieldP) {
+        if (strlen(fieldP->name) == nameLen &&
+            memcmp(fieldP->name, name, nameLen) == 0)
+            return fieldP;
+    }
+    return NULL;
+}
+
+
+
+static void
+freeDirectStrings(const xmlrpc_struct_field * const fields,
+                  const bool *                const found,
+                  void *                      const structP) {
+
+    unsigned int i;
+
+    for (i = 0; fields[i].name; ++i) {
+        if (found[i] && fields[i].type == XMLRPC_TYPE_STRING)
+            xmlrpc_strfree(*(const char **)((char *)structP +
+                                            fields[i].offset));
+    }
+}
+
+
+
+static void
+parseMembersDirect(xmlrpc_env *                const envP,
+                   xml_element *               const structElemP,
+                   const xmlrpc_struct_field * const fields,
+                   bool *                      const found,
+                   void *                      const structP) {
+
+    xml_element ** const members = xml_element_children(structElemP);
+    unsigned int   const size    = xml_element_children_size(structElemP);
+
+    unsigned int i;
+
+    for (i = 0; i < size && !envP->fault_occurred; ++i) {
+        const char * const elemName = xml_element_name(members[i]);
+
+        if (!xmlrpc_streq(elemName, "member"))
+            setParseFault(envP, "<%s> element found where only <member> "
+                          "makes sense", elemName);
+        else if (xml_element_children_size(members[i]) != 2)
+            setParseFault(envP, "<member> element has %u children.  "
+                          "Only one <name> and one <value> make sense.",
+                          (unsigned int)xml_element_children_size(
+                              members[i]));
+        else {
+            xml_element * nameElemP;
+
+            getNameChild(envP, members[i], &nameElemP);
+
+            if (!envP->fault_occurred) {
+                const xmlrpc_struct_field * const fieldP =
+                    fieldNamed(fields, xml_element_cdata(nameElemP),
+                               xml_element_cdata_size(nameElemP));
+
+                /* We ignore members the descriptor doesn't mention */
+                if (fieldP) {
+                    unsigned int const fieldIndex = fieldP - fields;
+                    xml_element * valueElemP;
+
+                    getValueChild(envP, members[i], &valueElemP);
+
+                    if (!envP->fault_occurred) {
+                        if (found[fieldIndex] &&
+                            fieldP->type == XMLRPC_TYPE_STRING) {
+                            /* Duplicate member; last one wins */
+                            xmlrpc_strfree(*(const char **)
+                                           ((char *)structP + fieldP->offset));
+                            found[fieldIndex] = false;
+                        }
+                        parseMemberDirect(envP, valueElemP, fieldP, structP);
+
+                        if (!envP->fault_occurred)
+                            found[fieldIndex] = true;
+                    }
+                }
+            }
+        }
+    }
+}
+
+
+
+void
+xmlrpc_parseStructDirect(xmlrpc_env *                const envP,
+                         xml_element *               const elemP,
+                         const xmlrpc_struct_field * const fields,
+                         void *                      const structP) {
+/*----------------------------------------------------------------------------
+   Fill in C structure *structP from the XML <value> element 'elemP', which
+   must contain a <struct> with (at least) the members that 'fields'
+   describes.
+
+   This is the same as xmlrpc_parseValue() followed by picking the members
+   out of the resulting xmlrpc_value, but we don't build one.
+-----------------------------------------------------------------------------*/
+    XMLRPC_ASSERT_ENV_OK(envP);
+    XMLRPC_ASSERT(elemP != NULL);
+
+    if (!xmlrpc_streq(xml_element_name(elemP), "value"))
+        setParseFault(envP, "<%s> element where <value> expected",
+                      xml_element_name(elemP));
+    else if (xml_element_children_size(elemP) != 1 ||
+             !xmlrpc_streq(xml_element_name(xml_element_children(elemP)[0]),
+                           "struct"))
+        setParseFault(envP, "<value> element does not contain a <struct>");
+    else {
+        unsigned int fieldCount;
+        bool * found;
+            /* found[i] means we have filled in the member fields[i]
+               describes.
+            */
+        for (fieldCount = 0; fields[fieldCount].name; ++fieldCount);
+
+        MALLOCARRAY(found, MAX(fieldCount, 1));
+
+        if (found == NULL)
+            xmlrpc_faultf(envP, "Couldn't allocate memory for "
+                          "%u-member structure descriptor", fieldCount);
+        else {
+            unsigned int i;
+
+            for (i = 0; i < fieldCount; ++i)
+                found[i] = false;
+
+            parseMembersDirect(envP, xml_element_children(elemP)[0],
+                               fields, found, structP);
+
+            for (i = 0; i < fieldCount && !envP->fault_occurred; ++i) {
+                if (!found[i])
+                    setParseFault(envP, "Structure has no member '%s'",
+                                  fields[i].name);
+            }
+            if (envP->fault_occurred)
+                freeDirectStrings(fields, found, structP);
+
+            free(found);
+        }
+    }
+}
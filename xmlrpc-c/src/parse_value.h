@@ -10,4 +10,10 @@ xmlrpc_parseValue(xmlrpc_env *    const envP,
                   xml_element *   const elemP,
                   xmlrpc_value ** const valuePP);
 
+void
+xmlrpc_parseStructDirect(xmlrpc_env *                const envP,
+                         xml_element *               const elemP,
+                         const xmlrpc_struct_field * const fields,
+                         void *                      const structP);
+
 #endif
@@ -0,0 +1,197 @@
+/*=============================================================================
+                                    rcu
+===============================================================================
+  Read-copy-update.  See rcu.h.
+
+  A reader counts itself in one of two reader counts, chosen by the parity
+  of the current epoch.  A writer publishes the new object, advances the
+  epoch, and waits for the count of the old epoch's parity to drain.  A
+  reader that entered before the epoch advanced is in that count; a reader
+  that enters after sees the new object.
+
+  A reader that reads the epoch just before it advances would count itself
+  in the old parity after the writer may have stopped waiting, so after
+  counting itself it checks that the epoch is still the one it read, and
+  if not, starts over.
+
+  Without atomic operations, a lock takes the place of all this.
+=============================================================================*/
+
+#include "xmlrpc_config.h"
+
+#include <stdlib.h>
+
+#include "bool.h"
+#include "mallocvar.h"
+#include "xmlrpc-c/base_int.h"
+#include "xmlrpc-c/lock.h"
+#include "xmlrpc-c/lock_platform.h"
+#include "xmlrpc-c/sleep_int.h"
+#include "xmlrpc-c/base.h"
+
+#include "rcu.h"
+
+
+
+struct xmlrpc_rcu {
+    void * volatile objectP;
+        /* The current object */
+#if HAVE_SYNC_FETCH_AND_ADD
+    volatile unsigned int epoch;
+        /* Advances each time a writer replaces the object */
+    volatile unsigned int readers[2];
+        /* readers[n] is the number of readers in read sections they
+           entered during an epoch of parity n
+        */
+#else
+    lock * lockP;
+        /* Held by readers in read sections and by a writer replacing the
+           object
+        */
+#endif
+};
+
+
+
+void
+xmlrpc_rcuCreate(xmlrpc_env *  const envP,
+                 void *        const objectP,
+                 xmlrpc_rcu ** const rcuPP) {
+/*----------------------------------------------------------------------------
+   Create an RCU pointer, initially to *objectP.
+-----------------------------------------------------------------------------*/
+    xmlrpc_rcu * rcuP;
+
+    MALLOCVAR(rcuP);
+
+    if (rcuP == NULL)
+        xmlrpc_faultf(envP, "Unable to allocate memory for an RCU pointer");
+    else {
+        rcuP->objectP = objectP;
+
+#if HAVE_SYNC_FETCH_AND_ADD
+        rcuP->epoch      = 0;
+        rcuP->readers[0] = 0;
+        rcuP->readers[1] = 0;
+#else
+        rcuP->lockP = xmlrpc_lock_create();
+
+        if (rcuP->lockP == NULL) {
+            xmlrpc_faultf(envP, "Unable to create lock for an RCU pointer");
+            free(rcuP);
+        }
+#endif
+        *rcuPP = rcuP;
+    }
+}
+
+
+
+void
+xmlrpc_rcuDestroy(xmlrpc_rcu * const rcuP) {
+/*----------------------------------------------------------------------------
+   Destroy the RCU pointer, but not the object to which it points.  There
+   must be no readers.
+-----------------------------------------------------------------------------*/
+#if !HAVE_SYNC_FETCH_AND_ADD
+    rcuP->lockP->destroy(rcuP->lockP);
+#endif
+    free(rcuP);
+}
+
+
+
+void *
+xmlrpc_rcuReadLock(xmlrpc_rcu *   const rcuP,
+                   unsigned int * const tokenP) {
+/*----------------------------------------------------------------------------
+   Enter a read section and return the current object, which stays valid
+   until we leave it with xmlrpc_rcuReadUnlock(), passing it the token we
+   return as *tokenP.
+-----------------------------------------------------------------------------*/
+#if HAVE_SYNC_FETCH_AND_ADD
+    unsigned int epoch;
+    bool entered;
+
+    for (entered = false; !entered; ) {
+        epoch = rcuP->epoch;
+
+        /* This is a full memory barrier, so we read the epoch again, and
+           then the object, only after we count ourselves.
+        */
+        __sync_fetch_and_add(&rcuP->readers[epoch & 1], 1);
+
+        if (rcuP->epoch == epoch)
+            entered = true;
+        else
+            __sync_fetch_and_sub(&rcuP->readers[epoch & 1], 1);
+    }
+    *tokenP = epoch & 1;
+#else
+    rcuP->lockP->acquire(rcuP->lockP);
+
+    *tokenP = 0;
+#endif
+    return rcuP->objectP;
+}
+
+
+
+void
+xmlrpc_rcuReadUnlock(xmlrpc_rcu * const rcuP,
+                     unsigned int const token) {
+
+#if HAVE_SYNC_FETCH_AND_ADD
+    __sync_fetch_and_sub(&rcuP->readers[token], 1);
+#else
+    (void)token;
+
+    rcuP->lockP->release(rcuP->lockP);
+#endif
+}
+
+
+
+void *
+xmlrpc_rcuCurrent(xmlrpc_rcu * const rcuP) {
+/*----------------------------------------------------------------------------
+   The current object, for a writer.  It stays valid only because no other
+   writer can replace it.
+-----------------------------------------------------------------------------*/
+    return rcuP->objectP;
+}
+
+
+
+void *
+xmlrpc_rcuReplace(xmlrpc_rcu * const rcuP,
+                  void *       const newObjectP) {
+/*----------------------------------------------------------------------------
+   Make *newObjectP the current object, and once no reader can have the
+   object it replaces, return that one.  The caller may then destroy it.
+-----------------------------------------------------------------------------*/
+    void * const oldObjectP = rcuP->objectP;
+
+#if HAVE_SYNC_FETCH_AND_ADD
+    unsigned int oldEpoch;
+
+    /* A reader that gets the new object must see everything the writer
+       did to build it.
+    */
+    __sync_synchronize();
+
+    rcuP->objectP = newObjectP;
+
+    oldEpoch = __sync_fetch_and_add(&rcuP->epoch, 1);
+
+    while (__sync_fetch_and_add(&rcuP->readers[oldEpoch & 1], 0) > 0)
+        xmlrpc_millisecond_sleep(1);
+#else
+    rcuP->lockP->acquire(rcuP->lockP);
+
+    rcuP->objectP = newObjectP;
+
+    rcuP->lockP->release(rcuP->lockP);
+#endif
+    return oldObjectP;
+}
@@ -0,0 +1,49 @@
+#ifndef RCU_H_INCLUDED
+#define RCU_H_INCLUDED
+
+/*============================================================================
+   Read-copy-update: a pointer to an object that any number of threads read
+   while another thread replaces it, without the readers taking a lock.
+
+   The object a reader gets stays valid until the reader says it is done
+   with it.  A writer never changes the object; it makes a new one and
+   replaces the old one with it.  Replacing waits until every reader that
+   might have the old object is done with it, after which the writer may
+   destroy the old one.  Read sections must therefore be short and must
+   not replace the object themselves.
+
+   Writers must not replace the object at the same time; the user serializes
+   them.
+
+   Where the compiler has no atomic operations (HAVE_SYNC_FETCH_AND_ADD),
+   readers take a lock instead.
+============================================================================*/
+
+#include "xmlrpc-c/base.h"
+
+typedef struct xmlrpc_rcu xmlrpc_rcu;
+
+void
+xmlrpc_rcuCreate(xmlrpc_env *  const envP,
+                 void *        const objectP,
+                 xmlrpc_rcu ** const rcuPP);
+
+void
+xmlrpc_rcuDestroy(xmlrpc_rcu * const rcuP);
+
+void *
+xmlrpc_rcuReadLock(xmlrpc_rcu *   const rcuP,
+                   unsigned int * const tokenP);
+
+void
+xmlrpc_rcuReadUnlock(xmlrpc_rcu * const rcuP,
+                     unsigned int const token);
+
+void *
+xmlrpc_rcuCurrent(xmlrpc_rcu * const rcuP);
+
+void *
+xmlrpc_rcuReplace(xmlrpc_rcu * const rcuP,
+                  void *       const newObjectP);
+
+#endif
@@ -22,10 +22,18 @@
 #include "mallocvar.h"
 #include "xmlrpc-c/base_int.h"
 #include "xmlrpc-c/string_int.h"
+#include "xmlrpc-c/lock.h"
+#include "xmlrpc-c/lock_platform.h"
 #include "xmlrpc-c/base.h"
 #include "xmlrpc-c/server.h"
+#include "rcu.h"
 #include "method.h"
 #include "system_method.h"
+#include "completion.h"
+#include "metrics.h"
+#include "response_cache.h"
+#include "admission.h"
+#include "scheduler.h"
 #include "version.h"
 
 #include "registry.h"
@@ -66,11 +74,52 @@ xmlrpc_registry_new(xmlrpc_env * const envP) {
         registryP->preinvokeFunction     = NULL;
         registryP->shutdownServerFn      = NULL;
         registryP->dialect               = xmlrpc_dialect_i8;
+        registryP->serializeThreadCount  = 1;
+        registryP->multicallThreadCount  = 1;
+        registryP->multicallThreadsBusy  = 0;
+        registryP->responseCacheP        = NULL;
+        registryP->adaptiveLimitP        = NULL;
+        registryP->schedulerP            = NULL;
+        registryP->checkParams           = false;
+        registryP->methodListShared      = false;
+
+        registryP->writeLockP = xmlrpc_lock_create();
+
+        if (registryP->writeLockP == NULL)
+            xmlrpc_faultf(envP, "Could not create lock for registry");
+        else {
+            registryP->multicallLockP = xmlrpc_lock_create();
 
-        xmlrpc_methodListCreate(envP, &registryP->methodListP);
-        if (!envP->fault_occurred)
-            xmlrpc_installSystemMethods(envP, registryP);
-
+            if (registryP->multicallLockP == NULL)
+                xmlrpc_faultf(envP, "Could not create multicall lock "
+                              "for registry");
+            else {
+                xmlrpc_methodList * methodListP;
+
+                xmlrpc_methodListCreate(envP, &methodListP);
+
+                if (!envP->fault_occurred) {
+                    xmlrpc_rcuCreate(envP, methodListP,
+                                     &registryP->methodListRcuP);
+
+                    if (!envP->fault_occurred) {
+                        xmlrpc_installSystemMethods(envP, registryP);
+
+                        if (envP->fault_occurred) {
+                            xmlrpc_methodListDestroy(
+                                xmlrpc_rcuCurrent(registryP->methodListRcuP));
+                            xmlrpc_rcuDestroy(registryP->methodListRcuP);
+                        }
+                    } else
+                        xmlrpc_methodListDestroy(methodListP);
+                }
+                if (envP->fault_occurred)
+                    registryP->multicallLockP->destroy(
+                        registryP->multicallLockP);
+            }
+            if (envP->fault_occurred)
+                registryP->writeLockP->destroy(registryP->writeLockP);
+        }
         if (envP->fault_occurred)
             free(registryP);
     }
@@ -84,24 +133,133 @@ xmlrpc_registry_free(xmlrpc_registry * const registryP) {
 
     XMLRPC_ASSERT_PTR_OK(registryP);
 
-    xmlrpc_methodListDestroy(registryP->methodListP);
+    xmlrpc_methodListDestroy(xmlrpc_rcuCurrent(registryP->methodListRcuP));
+
+    xmlrpc_rcuDestroy(registryP->methodListRcuP);
+
+    registryP->writeLockP->destroy(registryP->writeLockP);
+
+    registryP->multicallLockP->destroy(registryP->multicallLockP);
+
+    if (registryP->responseCacheP)
+        xmlrpc_responseCacheDestroy(registryP->responseCacheP);
+
+    if (registryP->adaptiveLimitP)
+        xmlrpc_adaptiveLimitDestroy(registryP->adaptiveLimitP);
+
+    if (registryP->schedulerP)
+        xmlrpc_schedulerDestroy(registryP->schedulerP);
 
     free(registryP);
 }
 
 
 
+static void
+publishMethodList(xmlrpc_registry *   const registryP,
+                  xmlrpc_methodList * const methodListP,
+                  bool                const methodDropped) {
+/*----------------------------------------------------------------------------
+   Make *methodListP the registry's method list, replacing the current
+   one, which we destroy once no call can be looking a method up in it.
+
+   'methodDropped' means some method in the current list is not in the new
+   one, so we forget any response we cached from it.
+
+   The caller must hold the registry's write lock.
+-----------------------------------------------------------------------------*/
+    xmlrpc_methodList * const oldMethodListP =
+        xmlrpc_rcuReplace(registryP->methodListRcuP, methodListP);
+
+    xmlrpc_methodListDestroy(oldMethodListP);
+
+    if (methodDropped && registryP->responseCacheP)
+        xmlrpc_responseCacheFlush(registryP->responseCacheP);
+}
+
+
+
+static void
+putMethod(xmlrpc_env *        const envP,
+          xmlrpc_registry *   const registryP,
+          const char *        const methodName,
+          xmlrpc_methodInfo * const methodP,
+          bool                const replace) {
+/*----------------------------------------------------------------------------
+   Put *methodP in the registry's method list as method 'methodName'.  If
+   'replace' is true, it replaces any existing method of that name;
+   otherwise, there must not be one.  The list takes over the caller's
+   reference to *methodP if we succeed.
+
+   Until someone first reads the method list, we change it in place, so
+   registering N methods before the first call takes time proportional to
+   N rather than to N squared.  After that, we change a copy and publish
+   it.
+
+   The caller must hold the registry's write lock.
+-----------------------------------------------------------------------------*/
+    xmlrpc_methodList * const methodListP =
+        xmlrpc_rcuCurrent(registryP->methodListRcuP);
+
+    if (!registryP->methodListShared) {
+        bool replaced;
+
+        if (replace)
+            xmlrpc_methodListSetMethod(methodListP, methodName, methodP,
+                                       &replaced);
+        else
+            replaced = false;
+
+        if (!replaced)
+            xmlrpc_methodListAdd(envP, methodListP, methodName, methodP);
+    } else {
+        xmlrpc_methodInfo * oldMethodP;
+        xmlrpc_methodList * newMethodListP;
+
+        xmlrpc_methodListLookupByName(methodListP, methodName, &oldMethodP);
+
+        xmlrpc_methodListCopy(envP, methodListP,
+                              replace ? methodName : NULL,
+                              &newMethodListP);
+
+        if (!envP->fault_occurred) {
+            xmlrpc_methodListAdd(envP, newMethodListP, methodName, methodP);
+
+            if (envP->fault_occurred)
+                xmlrpc_methodListDestroy(newMethodListP);
+            else
+                publishMethodList(registryP, newMethodListP,
+                                  replace && oldMethodP);
+        }
+    }
+}
+
+
+
 static void 
 registryAddMethod(xmlrpc_env *      const envP,
                   xmlrpc_registry * const registryP,
                   const char *      const methodName,
                   xmlrpc_method1          method1,
                   xmlrpc_method2          method2,
+                  xmlrpc_method_async     methodAsync,
                   const char *      const signatureString,
                   const char *      const help,
                   void *            const userData,
-                  size_t            const stackSize) {
+                  xmlrpc_server_info_release releaseFn,
+                  size_t            const stackSize,
+                  bool              const replace) {
+/*----------------------------------------------------------------------------
+   Add a method named 'methodName' to the registry.  If 'replace' is true,
+   it replaces any existing method of that name; otherwise, there must not
+   be one.
 
+   We call 'releaseFn' (if non-null) with 'userData' once the registry is
+   done with the method, or right away if we fail.
+
+   Calls in progress see either the old set of methods or the new one, and
+   a call of a method we replace finishes with the method it started with.
+-----------------------------------------------------------------------------*/
     const char * const helpString =
         help ? help : "No help is available for this method.";
 
@@ -110,17 +268,24 @@ registryAddMethod(xmlrpc_env *      const envP,
     XMLRPC_ASSERT_ENV_OK(envP);
     XMLRPC_ASSERT_PTR_OK(registryP);
     XMLRPC_ASSERT_PTR_OK(methodName);
-    XMLRPC_ASSERT(method1 != NULL || method2 != NULL);
+    XMLRPC_ASSERT(method1 != NULL || method2 != NULL || methodAsync != NULL);
 
-    xmlrpc_methodCreate(envP, method1, method2, userData,
+    xmlrpc_methodCreate(envP, method1, method2, methodAsync,
+                        userData, releaseFn,
                         signatureString, helpString, stackSize, &methodP);
 
-    if (!envP->fault_occurred) {
-        xmlrpc_methodListAdd(envP, registryP->methodListP, methodName,
-                             methodP);
+    if (envP->fault_occurred) {
+        if (releaseFn)
+            releaseFn(userData);
+    } else {
+        registryP->writeLockP->acquire(registryP->writeLockP);
+
+        putMethod(envP, registryP, methodName, methodP, replace);
+
+        registryP->writeLockP->release(registryP->writeLockP);
 
         if (envP->fault_occurred)
-            xmlrpc_methodDestroy(methodP);
+            xmlrpc_methodDecref(methodP);
     }
 }
 
@@ -139,8 +304,8 @@ xmlrpc_registry_add_method_w_doc(
 
     XMLRPC_ASSERT(host == NULL);
 
-    registryAddMethod(envP, registryP, methodName, method, NULL,
-                      signatureString, help, serverInfo, 0);
+    registryAddMethod(envP, registryP, methodName, method, NULL, NULL,
+                      signatureString, help, serverInfo, NULL, 0, false);
 }
 
 
@@ -169,8 +334,8 @@ xmlrpc_registry_add_method2(xmlrpc_env *      const envP,
                             const char *      const help,
                             void *            const serverInfo) {
 
-    registryAddMethod(envP, registryP, methodName, NULL, method,
-                      signatureString, help, serverInfo, 0);
+    registryAddMethod(envP, registryP, methodName, NULL, method, NULL,
+                      signatureString, help, serverInfo, NULL, 0, false);
 }
 
 
@@ -182,9 +347,200 @@ xmlrpc_registry_add_method3(
     const struct xmlrpc_method_info3 * const infoP) {
 
     registryAddMethod(envP, registryP, infoP->methodName, NULL,
+                      infoP->methodFunction, NULL,
+                      infoP->signatureString, infoP->help, infoP->serverInfo,
+                      NULL, infoP->stackSize, false);
+}
+
+
+
+void
+xmlrpc_registry_add_method_async(
+    xmlrpc_env *                            const envP,
+    xmlrpc_registry *                       const registryP,
+    const struct xmlrpc_method_info_async * const infoP) {
+/*----------------------------------------------------------------------------
+   Add an asynchronous method: one whose method function need not have the
+   result when it returns.
+
+   The method function either fails the call immediately, by returning a
+   fault in its 'envP' argument, or arranges for someone to finish it later
+   with xmlrpc_call_complete() or xmlrpc_call_complete_fault() on the
+   completion it gets as argument.  It may do that before it returns, and
+   from any thread.  The parameter array is valid only until the method
+   function returns (take a reference to keep it); the call information
+   is valid until the call completes.
+
+   Where the server can, e.g. an event-driven Abyss server, no thread waits
+   while the call is outstanding.  Elsewhere, e.g. in system.multicall, the
+   thread that called the method waits for the completion.
+-----------------------------------------------------------------------------*/
+    registryAddMethod(envP, registryP, infoP->methodName, NULL, NULL,
+                      infoP->methodFunction,
+                      infoP->signatureString, infoP->help, infoP->serverInfo,
+                      NULL, infoP->stackSize, false);
+}
+
+
+
+void
+xmlrpc_registry_replace_method3(
+    xmlrpc_env *                       const envP,
+    xmlrpc_registry *                  const registryP,
+    const struct xmlrpc_method_info3 * const infoP) {
+/*----------------------------------------------------------------------------
+   Same as xmlrpc_registry_add_method3(), except that the method replaces
+   any existing method of the same name instead of failing.
+
+   You may do this while the registry is processing calls.  Each call
+   executes either the old method or the new one; none fails for want of
+   a method in between.  A call already executing the old method finishes
+   with it.
+-----------------------------------------------------------------------------*/
+    registryAddMethod(envP, registryP, infoP->methodName, NULL,
+                      infoP->methodFunction, NULL,
+                      infoP->signatureString, infoP->help, infoP->serverInfo,
+                      NULL, infoP->stackSize, true);
+}
+
+
+
+void
+xmlrpc_registry_replace_method_async(
+    xmlrpc_env *                            const envP,
+    xmlrpc_registry *                       const registryP,
+    const struct xmlrpc_method_info_async * const infoP) {
+/*----------------------------------------------------------------------------
+   Same as xmlrpc_registry_replace_method3(), but for an asynchronous
+   method (see xmlrpc_registry_add_method_async()).
+-----------------------------------------------------------------------------*/
+    registryAddMethod(envP, registryP, infoP->methodName, NULL, NULL,
+                      infoP->methodFunction,
+                      infoP->signatureString, infoP->help, infoP->serverInfo,
+                      NULL, infoP->stackSize, true);
+}
+
+
+
+void
+xmlrpc_registry_add_method3_w_release(
+    xmlrpc_env *                       const envP,
+    xmlrpc_registry *                  const registryP,
+    const struct xmlrpc_method_info3 * const infoP,
+    xmlrpc_server_info_release               releaseFn) {
+/*----------------------------------------------------------------------------
+   Same as xmlrpc_registry_add_method3(), except that the registry calls
+   releaseFn(infoP->serverInfo) when it is done with the method: when the
+   method is no longer in the registry and no call is executing it.  If we
+   fail, we call it before we return.
+
+   This is for server information that exists only for the method, such as
+   an object of a language binding, which you could otherwise not safely
+   destroy after replacing or removing the method.
+-----------------------------------------------------------------------------*/
+    registryAddMethod(envP, registryP, infoP->methodName, NULL,
+                      infoP->methodFunction, NULL,
+                      infoP->signatureString, infoP->help, infoP->serverInfo,
+                      releaseFn, infoP->stackSize, false);
+}
+
+
+
+void
+xmlrpc_registry_add_method_async_w_release(
+    xmlrpc_env *                            const envP,
+    xmlrpc_registry *                       const registryP,
+    const struct xmlrpc_method_info_async * const infoP,
+    xmlrpc_server_info_release                    releaseFn) {
+/*----------------------------------------------------------------------------
+   Same as xmlrpc_registry_add_method3_w_release(), but for an asynchronous
+   method.
+-----------------------------------------------------------------------------*/
+    registryAddMethod(envP, registryP, infoP->methodName, NULL, NULL,
+                      infoP->methodFunction,
+                      infoP->signatureString, infoP->help, infoP->serverInfo,
+                      releaseFn, infoP->stackSize, false);
+}
+
+
+
+void
+xmlrpc_registry_replace_method3_w_release(
+    xmlrpc_env *                       const envP,
+    xmlrpc_registry *                  const registryP,
+    const struct xmlrpc_method_info3 * const infoP,
+    xmlrpc_server_info_release               releaseFn) {
+/*----------------------------------------------------------------------------
+   Same as xmlrpc_registry_replace_method3(), except that the registry
+   calls 'releaseFn' as xmlrpc_registry_add_method3_w_release() does.
+-----------------------------------------------------------------------------*/
+    registryAddMethod(envP, registryP, infoP->methodName, NULL,
+                      infoP->methodFunction, NULL,
+                      infoP->signatureString, infoP->help, infoP->serverInfo,
+                      releaseFn, infoP->stackSize, true);
+}
+
+
+
+void
+xmlrpc_registry_replace_method_async_w_release(
+    xmlrpc_env *                            const envP,
+    xmlrpc_registry *                       const registryP,
+    const struct xmlrpc_method_info_async * const infoP,
+    xmlrpc_server_info_release                    releaseFn) {
+/*----------------------------------------------------------------------------
+   Same as xmlrpc_registry_replace_method_async(), except that the registry
+   calls 'releaseFn' as xmlrpc_registry_add_method3_w_release() does.
+-----------------------------------------------------------------------------*/
+    registryAddMethod(envP, registryP, infoP->methodName, NULL, NULL,
                       infoP->methodFunction,
                       infoP->signatureString, infoP->help, infoP->serverInfo,
-                      infoP->stackSize);
+                      releaseFn, infoP->stackSize, true);
+}
+
+
+
+void
+xmlrpc_registry_remove_method(xmlrpc_env *      const envP,
+                              xmlrpc_registry * const registryP,
+                              const char *      const methodName) {
+/*----------------------------------------------------------------------------
+   Remove the method named 'methodName' from the registry.  A later call
+   of it gets the default method, or fails with fault code
+   XMLRPC_NO_SUCH_METHOD_ERROR.
+
+   You may do this while the registry is processing calls.  A call already
+   executing the method finishes with it.
+-----------------------------------------------------------------------------*/
+    xmlrpc_methodList * methodListP;
+    xmlrpc_methodInfo * methodP;
+
+    XMLRPC_ASSERT_ENV_OK(envP);
+    XMLRPC_ASSERT_PTR_OK(registryP);
+    XMLRPC_ASSERT_PTR_OK(methodName);
+
+    registryP->writeLockP->acquire(registryP->writeLockP);
+
+    methodListP = xmlrpc_rcuCurrent(registryP->methodListRcuP);
+
+    xmlrpc_methodListLookupByName(methodListP, methodName, &methodP);
+
+    if (!methodP)
+        xmlrpc_env_set_fault_formatted(
+            envP, XMLRPC_NO_SUCH_METHOD_ERROR,
+            "Method '%s' not defined", methodName);
+    else if (!registryP->methodListShared)
+        xmlrpc_methodListRemove(methodListP, methodName);
+    else {
+        xmlrpc_methodList * newMethodListP;
+
+        xmlrpc_methodListCopy(envP, methodListP, methodName,
+                              &newMethodListP);
+
+        if (!envP->fault_occurred)
+            publishMethodList(registryP, newMethodListP, true);
+    }
+    registryP->writeLockP->release(registryP->writeLockP);
 }
 
 
@@ -234,15 +590,18 @@ xmlrpc_registry_max_stackSize(xmlrpc_registry * const registryP) {
 
    If there are no methods, return 0.
 -----------------------------------------------------------------------------*/
+    xmlrpc_methodList * methodListP;
+    unsigned int rcuToken;
     xmlrpc_methodNode * p;
     size_t stackSize;
 
-    for (p = registryP->methodListP->firstMethodP, stackSize = 0;
-         p;
-         p = p->nextP) {
-        
+    methodListP = xmlrpc_registryReadMethods(registryP, &rcuToken);
+
+    for (p = methodListP->firstMethodP, stackSize = 0; p; p = p->nextP)
         stackSize = MAX(stackSize, methodStackSize(p->methodP));
-    }
+
+    xmlrpc_registryReadMethodsDone(registryP, rcuToken);
+
     return stackSize;
 }
 
@@ -286,165 +645,768 @@ xmlrpc_registry_set_dialect(xmlrpc_env *      const envP,
                             xmlrpc_dialect    const dialect) {
 
     if (dialect != xmlrpc_dialect_i8 &&
-        dialect != xmlrpc_dialect_apache)
+        dialect != xmlrpc_dialect_apache &&
+        dialect != xmlrpc_dialect_compact)
         xmlrpc_faultf(envP, "Invalid dialect argument -- not of type "
                       "xmlrpc_dialect.  Numerical value is %u", dialect);
-    else
+    else {
         registryP->dialect = dialect;
+
+        if (registryP->responseCacheP)
+            xmlrpc_responseCacheFlush(registryP->responseCacheP);
+    }
 }
 
 
 
-static void
-callNamedMethod(xmlrpc_env *        const envP,
-                xmlrpc_methodInfo * const methodP,
-                xmlrpc_value *      const paramArrayP,
-                void *              const callInfoP,
-                xmlrpc_value **     const resultPP) {
+void
+xmlrpc_registry_set_serialize_threads(xmlrpc_registry * const registryP,
+                                      unsigned int      const threadCount) {
+/*----------------------------------------------------------------------------
+   Let the registry use up to 'threadCount' threads to serialize a
+   response, so a method that returns a huge array or structure doesn't
+   leave the other CPUs idle while its XML gets generated.  1 means serialize
+   in the thread that executed the call, which is the default.
+-----------------------------------------------------------------------------*/
+    registryP->serializeThreadCount = MAX(1, threadCount);
+}
 
-    if (methodP->methodFnType2)
-        *resultPP =
-            methodP->methodFnType2(envP, paramArrayP,
-                                   methodP->userData, callInfoP);
-    else {
-        assert(methodP->methodFnType1);
-        *resultPP =
-            methodP->methodFnType1(envP, paramArrayP, methodP->userData);
-    }
+
+
+void
+xmlrpc_registry_set_multicall_threads(xmlrpc_registry * const registryP,
+                                      unsigned int      const threadCount) {
+/*----------------------------------------------------------------------------
+   Let system.multicall execute up to 'threadCount' of its calls at once,
+   each on its own thread, so a boxcar of slow calls takes about as long as
+   its slowest call instead of the sum of them.  The result array is in the
+   order of the calls either way.
+
+   The threads other than the multicall's own are a budget of
+   'threadCount' - 1 that all the multicalls the registry is executing at
+   once share, so many multicalls at once don't mean many times as many
+   threads.  A multicall that finds the budget spent executes its calls one
+   after another in its own thread.
+
+   Use this only if every method may execute in several threads at once,
+   and with the same 'callInfo' as another call in progress.  The threads
+   have the system's default stack size.  1 means execute the calls one
+   after another in the thread of the multicall, which is the default.
+-----------------------------------------------------------------------------*/
+    lock * const lockP = registryP->multicallLockP;
+
+    lockP->acquire(lockP);
+
+    registryP->multicallThreadCount = MAX(1, threadCount);
+
+    lockP->release(lockP);
 }
 
 
 
 void
-xmlrpc_dispatchCall(xmlrpc_env *      const envP, 
-                    xmlrpc_registry * const registryP,
-                    const char *      const methodName, 
-                    xmlrpc_value *    const paramArrayP,
-                    void *            const callInfoP,
-                    xmlrpc_value **   const resultPP) {
+xmlrpc_registry_get_method_stats(xmlrpc_env *          const envP,
+                                 xmlrpc_registry *     const registryP,
+                                 const char *          const methodName,
+                                 xmlrpc_method_stats * const statsP) {
+/*----------------------------------------------------------------------------
+   Return as *statsP the statistics about calls of method 'methodName'
+   since it was registered.
 
-    if (registryP->preinvokeFunction)
-        registryP->preinvokeFunction(envP, methodName, paramArrayP,
-                                     registryP->preinvokeUserData);
+   A call the default method executes doesn't count anywhere.
+-----------------------------------------------------------------------------*/
+    xmlrpc_methodInfo * methodP;
 
-    if (!envP->fault_occurred) {
-        xmlrpc_methodInfo * methodP;
+    XMLRPC_ASSERT_ENV_OK(envP);
+    XMLRPC_ASSERT_PTR_OK(registryP);
+    XMLRPC_ASSERT_PTR_OK(methodName);
 
-        xmlrpc_methodListLookupByName(registryP->methodListP, methodName,
-                                      &methodP);
+    xmlrpc_registryAcquireMethod(registryP, methodName, &methodP);
 
-        if (methodP)
-            callNamedMethod(envP, methodP, paramArrayP, callInfoP, resultPP);
-        else {
-            if (registryP->defaultMethodFunction)
-                *resultPP = registryP->defaultMethodFunction(
-                    envP, callInfoP, methodName, paramArrayP,
-                    registryP->defaultMethodUserData);
-            else {
-                /* No matching method, and no default. */
-                xmlrpc_env_set_fault_formatted(
-                    envP, XMLRPC_NO_SUCH_METHOD_ERROR,
-                    "Method '%s' not defined", methodName);
-            } 
-        }
-    }
-    /* For backward compatibility, for sloppy users: */
-    if (envP->fault_occurred)
-        *resultPP = NULL;
+    if (methodP) {
+        xmlrpc_methodMetricsRead(methodP->metricsP, statsP);
+
+        xmlrpc_methodDecref(methodP);
+    } else
+        xmlrpc_env_set_fault_formatted(
+            envP, XMLRPC_NO_SUCH_METHOD_ERROR,
+            "Method '%s' not defined", methodName);
 }
 
 
 
-/*=========================================================================
-**  xmlrpc_registry_process_call
-**=========================================================================
-**
-*/
+void
+xmlrpc_registry_set_response_cache(xmlrpc_env *      const envP,
+                                   xmlrpc_registry * const registryP,
+                                   size_t            const maxBytes,
+                                   unsigned int      const ttlSecs) {
+/*----------------------------------------------------------------------------
+   Cache the responses of idempotent methods (see
+   xmlrpc_registry_mark_idempotent()) in up to 'maxBytes' bytes of memory,
+   discarding the least recently used ones to make room.  A cached
+   response is good for 'ttlSecs' seconds; 0 means for as long as it
+   stays in the cache.
 
-static void
-serializeFault(xmlrpc_env *       const envP,
-               xmlrpc_env         const fault,
-               xmlrpc_mem_block * const responseXmlP) {
+   'maxBytes' zero means don't cache responses, which is the default.
 
-    xmlrpc_env env;
+   This discards any responses cached before.
+-----------------------------------------------------------------------------*/
+    XMLRPC_ASSERT_ENV_OK(envP);
+    XMLRPC_ASSERT_PTR_OK(registryP);
 
-    xmlrpc_env_init(&env);
+    if (registryP->responseCacheP) {
+        xmlrpc_responseCacheDestroy(registryP->responseCacheP);
+        registryP->responseCacheP = NULL;
+    }
+    if (maxBytes > 0) {
+        xmlrpc_responseCache * cacheP;
 
-    xmlrpc_serialize_fault(&env, responseXmlP, &fault);
+        xmlrpc_responseCacheCreate(envP, maxBytes, ttlSecs, &cacheP);
 
-    if (env.fault_occurred)
-        xmlrpc_faultf(envP,
-                      "Executed XML-RPC method completely and it "
-                      "generated a fault response, but we failed "
-                      "to encode that fault response as XML-RPC "
-                      "so we could send it to the client.  %s",
-                      env.fault_string);
+        if (!envP->fault_occurred)
+            registryP->responseCacheP = cacheP;
+    }
+}
 
-    xmlrpc_env_clean(&env);
+
+
+static void
+copyMethod(xmlrpc_env *         const envP,
+           xmlrpc_registry *    const registryP,
+           const char *         const methodName,
+           xmlrpc_methodInfo ** const copyPP) {
+/*----------------------------------------------------------------------------
+   Return a copy of the registry's method 'methodName', for the caller to
+   change an attribute of and put in place of the method with putMethod().
+   A call in progress may be using the method itself, so it must not
+   change.
+
+   The caller must hold the registry's write lock.
+-----------------------------------------------------------------------------*/
+    xmlrpc_methodInfo * methodP;
+
+    xmlrpc_methodListLookupByName(
+        xmlrpc_rcuCurrent(registryP->methodListRcuP), methodName, &methodP);
+
+    if (methodP)
+        xmlrpc_methodCopy(envP, methodP, copyPP);
+    else
+        xmlrpc_env_set_fault_formatted(
+            envP, XMLRPC_NO_SUCH_METHOD_ERROR,
+            "Method '%s' not defined", methodName);
 }
 
 
 
 void
-xmlrpc_registry_process_call2(xmlrpc_env *        const envP,
-                              xmlrpc_registry *   const registryP,
-                              const char *        const callXml,
-                              size_t              const callXmlLen,
-                              void *              const callInfo,
-                              xmlrpc_mem_block ** const responseXmlPP) {
+xmlrpc_registry_mark_idempotent(xmlrpc_env *      const envP,
+                                xmlrpc_registry * const registryP,
+                                const char *      const methodName) {
+/*----------------------------------------------------------------------------
+   Declare that a call of method 'methodName' with given parameters always
+   gets the same response, whoever calls it and whenever (within the
+   response cache's time limit), and has no effect a client depends on.
+   The registry may then answer such a call from its response cache (see
+   xmlrpc_registry_set_response_cache()) without executing the method.
 
-    xmlrpc_mem_block * responseXmlP;
+   Registering the method again undoes this.  Responses of asynchronous
+   methods don't get cached.
+
+   You may do this while the registry is processing calls.
+-----------------------------------------------------------------------------*/
+    xmlrpc_methodInfo * methodP;
 
     XMLRPC_ASSERT_ENV_OK(envP);
-    XMLRPC_ASSERT_PTR_OK(callXml);
-    
-    xmlrpc_traceXml("XML-RPC CALL", callXml, callXmlLen);
+    XMLRPC_ASSERT_PTR_OK(registryP);
+    XMLRPC_ASSERT_PTR_OK(methodName);
+
+    registryP->writeLockP->acquire(registryP->writeLockP);
+
+    copyMethod(envP, registryP, methodName, &methodP);
 
-    /* Allocate our output buffer.
-    ** If this fails, we need to die in a special fashion. */
-    responseXmlP = XMLRPC_MEMBLOCK_NEW(char, envP, 0);
     if (!envP->fault_occurred) {
-        const char * methodName;
-        xmlrpc_value * paramArrayP;
-        xmlrpc_env fault;
-        xmlrpc_env parseEnv;
-
-        xmlrpc_env_init(&fault);
-        xmlrpc_env_init(&parseEnv);
-
-        xmlrpc_parse_call(&parseEnv, callXml, callXmlLen, 
-                          &methodName, &paramArrayP);
-
-        if (parseEnv.fault_occurred)
-            xmlrpc_env_set_fault_formatted(
-                &fault, XMLRPC_PARSE_ERROR,
-                "Call XML not a proper XML-RPC call.  %s",
-                parseEnv.fault_string);
-        else {
-            xmlrpc_value * resultP;
-            
-            xmlrpc_dispatchCall(&fault, registryP, methodName, paramArrayP,
-                                callInfo, &resultP);
-
-            if (!fault.fault_occurred) {
-                xmlrpc_serialize_response2(envP, responseXmlP,
-                                           resultP, registryP->dialect);
-
-                xmlrpc_DECREF(resultP);
-            } 
-            xmlrpc_strfree(methodName);
-            xmlrpc_DECREF(paramArrayP);
-        }
-        if (!envP->fault_occurred && fault.fault_occurred)
-            serializeFault(envP, fault, responseXmlP);
+        methodP->idempotent = true;
 
-        xmlrpc_env_clean(&parseEnv);
-        xmlrpc_env_clean(&fault);
+        putMethod(envP, registryP, methodName, methodP, true);
 
         if (envP->fault_occurred)
-            XMLRPC_MEMBLOCK_FREE(char, responseXmlP);
-        else {
-            *responseXmlPP = responseXmlP;
+            xmlrpc_methodDecref(methodP);
+    }
+    registryP->writeLockP->release(registryP->writeLockP);
+}
+
+
+
+void
+xmlrpc_registry_set_method_limit(xmlrpc_env *      const envP,
+                                 xmlrpc_registry * const registryP,
+                                 const char *      const methodName,
+                                 unsigned int      const maxRunning,
+                                 unsigned int      const maxWaiting) {
+/*----------------------------------------------------------------------------
+   Limit the calls of method 'methodName' that execute at once to
+   'maxRunning'.  Up to 'maxWaiting' more calls may wait for one of those
+   to finish; any call beyond that fails immediately with fault code
+   XMLRPC_LIMIT_EXCEEDED_ERROR.
+
+   'maxRunning' zero means no limit, which is the default.
+
+   The limit counts the calls within a system.multicall as well.  An
+   asynchronous call counts until it completes.
+
+   You may do this while the registry is processing calls.  A call already
+   admitted under the old limit counts against that one until it finishes.
+-----------------------------------------------------------------------------*/
+    xmlrpc_methodInfo * methodP;
+
+    XMLRPC_ASSERT_ENV_OK(envP);
+    XMLRPC_ASSERT_PTR_OK(registryP);
+    XMLRPC_ASSERT_PTR_OK(methodName);
+
+    registryP->writeLockP->acquire(registryP->writeLockP);
+
+    copyMethod(envP, registryP, methodName, &methodP);
+
+    if (!envP->fault_occurred) {
+        if (methodP->limitP) {
+            xmlrpc_methodLimitDecref(methodP->limitP);
+            methodP->limitP = NULL;
+        }
+        if (maxRunning > 0) {
+            xmlrpc_methodLimit * limitP;
+
+            xmlrpc_methodLimitCreate(envP, maxRunning, maxWaiting, &limitP);
+
+            if (!envP->fault_occurred)
+                methodP->limitP = limitP;
+        }
+        if (!envP->fault_occurred)
+            putMethod(envP, registryP, methodName, methodP, true);
+
+        if (envP->fault_occurred)
+            xmlrpc_methodDecref(methodP);
+    }
+    registryP->writeLockP->release(registryP->writeLockP);
+}
+
+
+
+void
+xmlrpc_registry_set_adaptive_limit(xmlrpc_env *      const envP,
+                                   xmlrpc_registry * const registryP,
+                                   unsigned int      const minLimit,
+                                   unsigned int      const maxLimit) {
+/*----------------------------------------------------------------------------
+   Limit the calls that execute at once, of all methods together, to
+   between 'minLimit' and 'maxLimit', adjusting the limit according to
+   how long calls take: when they start taking much longer than usual, the
+   server is doing too much at once, so we lower the limit.  A call beyond
+   the limit fails immediately with fault code XMLRPC_LIMIT_EXCEEDED_ERROR.
+
+   'maxLimit' zero means no limit, which is the default.
+
+   A system.multicall counts as one call.
+
+   Do this before the registry processes any calls.
+-----------------------------------------------------------------------------*/
+    XMLRPC_ASSERT_ENV_OK(envP);
+    XMLRPC_ASSERT_PTR_OK(registryP);
+
+    if (maxLimit > 0 && (minLimit < 1 || minLimit > maxLimit))
+        xmlrpc_faultf(envP, "Invalid adaptive limit bounds %u-%u.  "
+                      "The minimum must be at least 1 and not more than "
+                      "the maximum", minLimit, maxLimit);
+    else {
+        if (registryP->adaptiveLimitP) {
+            xmlrpc_adaptiveLimitDestroy(registryP->adaptiveLimitP);
+            registryP->adaptiveLimitP = NULL;
+        }
+        if (maxLimit > 0) {
+            xmlrpc_adaptiveLimit * limitP;
+
+            xmlrpc_adaptiveLimitCreate(envP, minLimit, maxLimit, &limitP);
+
+            if (!envP->fault_occurred)
+                registryP->adaptiveLimitP = limitP;
+        }
+    }
+}
+
+
+
+void
+xmlrpc_registry_set_check_params(xmlrpc_registry * const registryP,
+                                 xmlrpc_bool       const check) {
+/*----------------------------------------------------------------------------
+   Make the registry check the parameters of each call against the
+   signatures registered for the method, and fail a call whose parameters
+   match none of them with fault code XMLRPC_TYPE_ERROR, without calling
+   the method.
+
+   The check compares the number of parameters and the type of each.  A
+   method registered without signatures accepts any parameters.  The
+   registry does not check by default.
+-----------------------------------------------------------------------------*/
+    XMLRPC_ASSERT_PTR_OK(registryP);
+
+    registryP->checkParams = !!check;
+}
+
+
+
+void
+xmlrpc_registry_set_method_priority(xmlrpc_env *      const envP,
+                                    xmlrpc_registry * const registryP,
+                                    const char *      const methodName,
+                                    xmlrpc_priority   const priority) {
+/*----------------------------------------------------------------------------
+   Make calls of method 'methodName' have priority 'priority' under the
+   registry's scheduler (see xmlrpc_registry_set_scheduler()).  A method
+   has normal priority by default, and again when you register it again.
+
+   You may do this while the registry is processing calls.
+-----------------------------------------------------------------------------*/
+    xmlrpc_methodInfo * methodP;
+
+    XMLRPC_ASSERT_ENV_OK(envP);
+    XMLRPC_ASSERT_PTR_OK(registryP);
+    XMLRPC_ASSERT_PTR_OK(methodName);
+
+    if ((unsigned int)priority >= XMLRPC_PRIORITY_COUNT)
+        xmlrpc_faultf(envP, "Invalid priority argument -- not of type "
+                      "xmlrpc_priority.  Numerical value is %u", priority);
+    else {
+        registryP->writeLockP->acquire(registryP->writeLockP);
+
+        copyMethod(envP, registryP, methodName, &methodP);
+
+        if (!envP->fault_occurred) {
+            methodP->priority = priority;
+
+            putMethod(envP, registryP, methodName, methodP, true);
+
+            if (envP->fault_occurred)
+                xmlrpc_methodDecref(methodP);
+        }
+        registryP->writeLockP->release(registryP->writeLockP);
+    }
+}
+
+
+
+void
+xmlrpc_registry_set_scheduler(xmlrpc_env *         const envP,
+                              xmlrpc_registry *    const registryP,
+                              unsigned int         const maxRunning,
+                              const unsigned int * const weights) {
+/*----------------------------------------------------------------------------
+   Limit the calls that execute at once, of all methods together, to
+   'maxRunning', and let the calls beyond that wait for their turn by the
+   priority of their method (see xmlrpc_registry_set_method_priority())
+   rather than in the order they arrived.
+
+   Priority class i has weight weights[i] (XMLRPC_PRIORITY_COUNT of them,
+   each at least 1): while calls of several classes are waiting, they
+   start in proportion to their weights, so high priority calls go ahead
+   of low priority ones without starving them.  'weights' NULL means
+   16, 4, and 1 for high, normal, and low priority.
+
+   This is useful when there are more threads processing calls than
+   should execute at once, e.g. an Abyss server with more connection
+   threads than CPUs.  Unlike the adaptive limit, the scheduler never
+   refuses a call.
+
+   'maxRunning' zero means no scheduler, which is the default.  A
+   system.multicall counts as one call, of the priority of
+   system.multicall.  An asynchronous call counts until it completes.
+
+   Do this before the registry processes any calls.
+-----------------------------------------------------------------------------*/
+    XMLRPC_ASSERT_ENV_OK(envP);
+    XMLRPC_ASSERT_PTR_OK(registryP);
+
+    if (weights) {
+        unsigned int i;
+
+        for (i = 0; i < XMLRPC_PRIORITY_COUNT && !envP->fault_occurred; ++i)
+            if (weights[i] < 1)
+                xmlrpc_faultf(envP, "Invalid weight %u for priority class "
+                              "%u.  It must be at least 1", weights[i], i);
+    }
+    if (!envP->fault_occurred) {
+        if (registryP->schedulerP) {
+            xmlrpc_schedulerDestroy(registryP->schedulerP);
+            registryP->schedulerP = NULL;
+        }
+        if (maxRunning > 0) {
+            xmlrpc_scheduler * schedulerP;
+
+            xmlrpc_schedulerCreate(envP, maxRunning, weights, &schedulerP);
+
+            if (!envP->fault_occurred)
+                registryP->schedulerP = schedulerP;
+        }
+    }
+}
+
+
+
+void
+xmlrpc_registry_get_priority_stats(xmlrpc_env *            const envP,
+                                   xmlrpc_registry *       const registryP,
+                                   xmlrpc_priority         const priority,
+                                   xmlrpc_priority_stats * const statsP) {
+/*----------------------------------------------------------------------------
+   Return as *statsP the statistics about how long calls of priority
+   'priority' have waited for their turn under the registry's scheduler
+   since it was set.  They are all zero if there is no scheduler.
+-----------------------------------------------------------------------------*/
+    XMLRPC_ASSERT_ENV_OK(envP);
+    XMLRPC_ASSERT_PTR_OK(registryP);
+
+    if ((unsigned int)priority >= XMLRPC_PRIORITY_COUNT)
+        xmlrpc_faultf(envP, "Invalid priority argument -- not of type "
+                      "xmlrpc_priority.  Numerical value is %u", priority);
+    else if (registryP->schedulerP)
+        xmlrpc_schedulerRead(registryP->schedulerP, priority, statsP);
+    else
+        memset(statsP, 0, sizeof(*statsP));
+}
+
+
+
+xmlrpc_methodList *
+xmlrpc_registryReadMethods(xmlrpc_registry * const registryP,
+                           unsigned int *    const tokenP) {
+/*----------------------------------------------------------------------------
+   Enter a read section of the registry's method list and return the list.
+   It stays valid, and unchanged, until you leave the section with
+   xmlrpc_registryReadMethodsDone(), passing it *tokenP.
+
+   The first time anyone does this, we mark the list shared, so from then
+   on the registry replaces the list rather than changing it (see
+   'methodListShared').  Only that first time waits for anyone changing
+   the registry.
+-----------------------------------------------------------------------------*/
+    if (!registryP->methodListShared) {
+        registryP->writeLockP->acquire(registryP->writeLockP);
+
+        registryP->methodListShared = true;
+
+        registryP->writeLockP->release(registryP->writeLockP);
+    }
+    return xmlrpc_rcuReadLock(registryP->methodListRcuP, tokenP);
+}
+
+
+
+void
+xmlrpc_registryReadMethodsDone(xmlrpc_registry * const registryP,
+                               unsigned int      const token) {
+
+    xmlrpc_rcuReadUnlock(registryP->methodListRcuP, token);
+}
+
+
+
+void
+xmlrpc_registryAcquireMethod(xmlrpc_registry *    const registryP,
+                             const char *         const methodName,
+                             xmlrpc_methodInfo ** const methodPP) {
+/*----------------------------------------------------------------------------
+   Look up method 'methodName' in the registry and return it as *methodPP,
+   with a reference to it for the caller, so that it stays valid even if
+   someone removes or replaces it.  The caller releases that with
+   xmlrpc_methodDecref().  Return NULL if there is no such method.
+
+   After the first call, this never waits for anyone changing the registry.
+-----------------------------------------------------------------------------*/
+    xmlrpc_methodList * methodListP;
+    unsigned int rcuToken;
+    xmlrpc_methodInfo * methodP;
+
+    methodListP = xmlrpc_registryReadMethods(registryP, &rcuToken);
+
+    xmlrpc_methodListLookupByName(methodListP, methodName, &methodP);
+
+    if (methodP)
+        xmlrpc_methodIncref(methodP);
+
+    xmlrpc_registryReadMethodsDone(registryP, rcuToken);
+
+    *methodPP = methodP;
+}
+
+
+
+static void
+callNamedMethod(xmlrpc_env *        const envP,
+                xmlrpc_methodInfo * const methodP,
+                xmlrpc_value *      const paramArrayP,
+                void *              const callInfoP,
+                xmlrpc_value **     const resultPP) {
+
+    if (methodP->methodFnType2)
+        *resultPP =
+            methodP->methodFnType2(envP, paramArrayP,
+                                   methodP->userData, callInfoP);
+    else {
+        assert(methodP->methodFnType1);
+        *resultPP =
+            methodP->methodFnType1(envP, paramArrayP, methodP->userData);
+    }
+}
+
+
+
+static void
+callAsyncMethod(xmlrpc_env *              const envP,
+                xmlrpc_registry *         const registryP,
+                xmlrpc_methodInfo *       const methodP,
+                xmlrpc_value *            const paramArrayP,
+                void *                    const callInfoP,
+                const xmlrpc_callMeter *  const meterP,
+                const xmlrpc_admission *  const admissionP,
+                xmlrpc_call_response_fn * const responseFn,
+                void *                    const responseContext,
+                bool *                    const pendingP,
+                xmlrpc_value **           const resultPP) {
+/*----------------------------------------------------------------------------
+   Start executing asynchronous method *methodP.  *meterP is measuring the
+   call, which was admitted as *admissionP.
+
+   If 'responseFn' is NULL, wait for the call to complete and return its
+   outcome like a synchronous method.  Otherwise, the call's completion
+   gives the response to 'responseFn' when it comes, and we return
+   *pendingP true -- unless the method fails immediately.
+-----------------------------------------------------------------------------*/
+    xmlrpc_call_completion * completionP;
+
+    *pendingP = false;
+
+    xmlrpc_completionCreate(envP, registryP, methodP, meterP, admissionP,
+                            responseFn, responseContext, &completionP);
+
+    if (!envP->fault_occurred) {
+        xmlrpc_env env;
+
+        xmlrpc_env_init(&env);
+
+        methodP->methodFnAsync(&env, paramArrayP, methodP->userData,
+                               callInfoP, completionP);
+
+        if (env.fault_occurred) {
+            /* The method failed without starting the call, so nobody will
+               complete it.
+            */
+            xmlrpc_env_set_fault(envP, env.fault_code, env.fault_string);
+            xmlrpc_completionDestroy(completionP);
+        } else if (responseFn) {
+            /* The completion may have sent the response and ceased to
+               exist already.
+            */
+            *pendingP = true;
+        } else {
+            xmlrpc_completionWait(completionP, envP, resultPP);
+            xmlrpc_completionDestroy(completionP);
+        }
+        xmlrpc_env_clean(&env);
+    }
+}
+
+
+
+static void
+preinvoke(xmlrpc_env *      const envP,
+          xmlrpc_registry * const registryP,
+          const char *      const methodName,
+          xmlrpc_value *    const paramArrayP) {
+
+    if (registryP->preinvokeFunction)
+        registryP->preinvokeFunction(envP, methodName, paramArrayP,
+                                     registryP->preinvokeUserData);
+}
+
+
+
+static void
+dispatch(xmlrpc_env *              const envP, 
+         xmlrpc_registry *         const registryP,
+         const char *              const methodName, 
+         xmlrpc_methodInfo *       const methodP,
+         xmlrpc_value *            const paramArrayP,
+         void *                    const callInfoP,
+         size_t                    const callSize,
+         xmlrpc_adaptiveLimit *    const adaptiveLimitP,
+         xmlrpc_scheduler *        const schedulerP,
+         xmlrpc_call_response_fn * const responseFn,
+         void *                    const responseContext,
+         xmlrpc_callMeter *        const meterP,
+         bool *                    const pendingP,
+         xmlrpc_value **           const resultPP) {
+/*----------------------------------------------------------------------------
+   Execute a call of method 'methodName', whose call XML is 'callSize'
+   bytes.  *methodP is the method by that name, which the caller looked
+   up; NULL means there is none, so the default method executes the call.
+
+   Return its outcome as *envP and *resultPP, or, if the method is
+   asynchronous and 'responseFn' is not NULL, return *pendingP true to say
+   that 'responseFn' will get the response (see callAsyncMethod()).
+
+   The call must pass the registry's parameter check, if any, and get
+   past the method's limit and *adaptiveLimitP (NULL means none), and
+   take its turn under *schedulerP (likewise), before it executes.
+
+   Start *meterP measuring the call, for the method's statistics.  The
+   caller finishes it, unless the call is pending.
+-----------------------------------------------------------------------------*/
+    *pendingP = false;
+
+    /* Until we know the method, there are no statistics to count in */
+    xmlrpc_callMeterStart(meterP, NULL, callSize);
+
+    preinvoke(envP, registryP, methodName, paramArrayP);
+
+    if (!envP->fault_occurred) {
+        xmlrpc_admission admission;
+
+        if (methodP)
+            xmlrpc_callMeterStart(meterP, methodP->metricsP, callSize);
+
+        if (methodP && registryP->checkParams)
+            xmlrpc_methodCheckParams(envP, methodP, paramArrayP);
+
+        if (!envP->fault_occurred)
+            xmlrpc_admit(envP, adaptiveLimitP,
+                         methodP ? methodP->limitP : NULL,
+                         schedulerP,
+                         methodP ? methodP->priority : xmlrpc_priority_normal,
+                         &admission);
+
+        if (!envP->fault_occurred) {
+            if (methodP) {
+                if (methodP->methodFnAsync)
+                    callAsyncMethod(envP, registryP, methodP, paramArrayP,
+                                    callInfoP, meterP, &admission,
+                                    responseFn, responseContext,
+                                    pendingP, resultPP);
+                else
+                    callNamedMethod(envP, methodP, paramArrayP, callInfoP,
+                                    resultPP);
+            } else {
+                if (registryP->defaultMethodFunction)
+                    *resultPP = registryP->defaultMethodFunction(
+                        envP, callInfoP, methodName, paramArrayP,
+                        registryP->defaultMethodUserData);
+                else {
+                    /* No matching method, and no default. */
+                    xmlrpc_env_set_fault_formatted(
+                        envP, XMLRPC_NO_SUCH_METHOD_ERROR,
+                        "Method '%s' not defined", methodName);
+                } 
+            }
+            /* A pending call's completion finishes the admission when the
+               call completes.
+            */
+            if (!*pendingP)
+                xmlrpc_admissionFinish(&admission);
+        }
+    }
+    /* For backward compatibility, for sloppy users: */
+    if (envP->fault_occurred)
+        *resultPP = NULL;
+}
+
+
+
+void
+xmlrpc_dispatchCall(xmlrpc_env *      const envP, 
+                    xmlrpc_registry * const registryP,
+                    const char *      const methodName, 
+                    xmlrpc_value *    const paramArrayP,
+                    void *            const callInfoP,
+                    xmlrpc_value **   const resultPP) {
+
+    xmlrpc_methodInfo * methodP;
+    xmlrpc_callMeter meter;
+    bool pending;
+
+    xmlrpc_registryAcquireMethod(registryP, methodName, &methodP);
+
+    /* A call within a system.multicall is part of a call that is already
+       under the adaptive limit and the scheduler.
+    */
+    dispatch(envP, registryP, methodName, methodP, paramArrayP, callInfoP,
+             0, NULL, NULL, NULL, NULL, &meter, &pending, resultPP);
+
+    assert(!pending);
+
+    xmlrpc_callMeterFinish(&meter, envP->fault_occurred, 0);
+
+    if (methodP)
+        xmlrpc_methodDecref(methodP);
+}
+
+
+
+/*=========================================================================
+**  xmlrpc_registry_process_call
+**=========================================================================
+**
+*/
+
+static void
+serializeFault(xmlrpc_env *       const envP,
+               xmlrpc_env         const fault,
+               xmlrpc_dialect     const dialect,
+               xmlrpc_mem_block * const responseXmlP) {
+
+    xmlrpc_env env;
+
+    xmlrpc_env_init(&env);
+
+    xmlrpc_serialize_fault2(&env, responseXmlP, &fault, dialect);
+
+    if (env.fault_occurred)
+        xmlrpc_faultf(envP,
+                      "Executed XML-RPC method completely and it "
+                      "generated a fault response, but we failed "
+                      "to encode that fault response as XML-RPC "
+                      "so we could send it to the client.  %s",
+                      env.fault_string);
+
+    xmlrpc_env_clean(&env);
+}
+
+
+
+static void
+serializeResponse(xmlrpc_env *        const envP,
+                  xmlrpc_registry *   const registryP,
+                  const xmlrpc_env *  const faultP,
+                  xmlrpc_value *      const resultP,
+                  xmlrpc_mem_block ** const responseXmlPP) {
+/*----------------------------------------------------------------------------
+   Generate the XML-RPC response for a call whose outcome is *faultP and,
+   if that does not indicate failure, *resultP.
+-----------------------------------------------------------------------------*/
+    xmlrpc_mem_block * responseXmlP;
+
+    /* Allocate our output buffer.
+    ** If this fails, we need to die in a special fashion. */
+    responseXmlP = XMLRPC_MEMBLOCK_NEW(char, envP, 0);
+    if (!envP->fault_occurred) {
+        if (faultP->fault_occurred)
+            serializeFault(envP, *faultP, registryP->dialect, responseXmlP);
+        else
+            xmlrpc_serialize_response_parallel(
+                envP, responseXmlP, resultP, registryP->dialect,
+                registryP->serializeThreadCount);
+
+        if (envP->fault_occurred)
+            XMLRPC_MEMBLOCK_FREE(char, responseXmlP);
+        else {
+            *responseXmlPP = responseXmlP;
             xmlrpc_traceXml("XML-RPC RESPONSE", 
                             XMLRPC_MEMBLOCK_CONTENTS(char, responseXmlP),
                             XMLRPC_MEMBLOCK_SIZE(char, responseXmlP));
@@ -454,6 +1416,368 @@ xmlrpc_registry_process_call2(xmlrpc_env *        const envP,
 
 
 
+static void
+finishMeter(const xmlrpc_callMeter * const meterP,
+            const xmlrpc_env *       const faultP,
+            const xmlrpc_env *       const serializeEnvP,
+            xmlrpc_mem_block *       const responseXmlP) {
+/*----------------------------------------------------------------------------
+   Count the call measured by *meterP, whose outcome is *faultP, now that
+   we have serialized its response as *responseXmlP -- or failed to, as
+   *serializeEnvP says.
+-----------------------------------------------------------------------------*/
+    if (serializeEnvP->fault_occurred)
+        xmlrpc_callMeterFinish(meterP, true, 0);
+    else
+        xmlrpc_callMeterFinish(meterP, faultP->fault_occurred,
+                               XMLRPC_MEMBLOCK_SIZE(char, responseXmlP));
+}
+
+
+
+static void
+generateResponse(xmlrpc_env *            const envP,
+                 xmlrpc_registry *       const registryP,
+                 const xmlrpc_cacheKey * const cacheKeyP,
+                 const xmlrpc_env *      const faultP,
+                 xmlrpc_value *          const resultP,
+                 xmlrpc_mem_block **     const responseXmlPP) {
+/*----------------------------------------------------------------------------
+   Same as serializeResponse(), but also add the response to the
+   registry's response cache under key *cacheKeyP, if 'cacheKeyP' is not
+   NULL and the call succeeded.
+-----------------------------------------------------------------------------*/
+    serializeResponse(envP, registryP, faultP, resultP, responseXmlPP);
+
+    if (!envP->fault_occurred && cacheKeyP && !faultP->fault_occurred)
+        xmlrpc_responseCacheAdd(registryP->responseCacheP, cacheKeyP,
+                                *responseXmlPP);
+}
+
+
+
+void
+xmlrpc_sendCallResponse(xmlrpc_registry *         const registryP,
+                        const xmlrpc_callMeter *  const meterP,
+                        const xmlrpc_cacheKey *   const cacheKeyP,
+                        const xmlrpc_env *        const faultP,
+                        xmlrpc_value *            const resultP,
+                        xmlrpc_call_response_fn * const responseFn,
+                        void *                    const responseContext) {
+/*----------------------------------------------------------------------------
+   Give 'responseFn' the XML-RPC response for a call whose outcome is
+   *faultP and, if that does not indicate failure, *resultP.  *meterP is
+   measuring the call.  Cache the response under key *cacheKeyP, unless
+   'cacheKeyP' is NULL (see generateResponse()).
+-----------------------------------------------------------------------------*/
+    xmlrpc_env env;
+    xmlrpc_mem_block * responseXmlP;
+
+    xmlrpc_env_init(&env);
+
+    generateResponse(&env, registryP, cacheKeyP, faultP, resultP,
+                     &responseXmlP);
+
+    finishMeter(meterP, faultP, &env, responseXmlP);
+
+    responseFn(responseContext, &env,
+               env.fault_occurred ? NULL : responseXmlP);
+
+    xmlrpc_env_clean(&env);
+}
+
+
+
+static void
+getCacheKey(xmlrpc_registry *         const registryP,
+            const char *              const methodName,
+            const xmlrpc_methodInfo * const methodP,
+            xmlrpc_value *            const paramArrayP,
+            xmlrpc_cacheKey **        const keyPP) {
+/*----------------------------------------------------------------------------
+   Return as *keyPP the key under which the response to a call of method
+   'methodName' (*methodP; NULL if none) with parameters *paramArrayP
+   belongs in the registry's response cache.  Return *keyPP NULL if the
+   response doesn't belong in the cache.
+-----------------------------------------------------------------------------*/
+    *keyPP = NULL;
+
+    if (registryP->responseCacheP) {
+        if (methodP && methodP->idempotent && !methodP->methodFnAsync) {
+            xmlrpc_env env;
+
+            xmlrpc_env_init(&env);
+
+            xmlrpc_cacheKeyCreate(&env, methodName, paramArrayP, keyPP);
+
+            if (env.fault_occurred) {
+                /* E.g. a parameter is a C pointer.  We just don't cache
+                   the response.
+                */
+                *keyPP = NULL;
+            }
+            xmlrpc_env_clean(&env);
+        }
+    }
+}
+
+
+
+static void
+respondFromCache(xmlrpc_env *            const faultP,
+                 xmlrpc_registry *       const registryP,
+                 const char *            const methodName,
+                 xmlrpc_value *          const paramArrayP,
+                 xmlrpc_methodInfo *     const methodP,
+                 const xmlrpc_cacheKey * const keyP,
+                 size_t                  const callXmlLen,
+                 xmlrpc_callMeter *      const meterP,
+                 xmlrpc_mem_block **     const responseXmlPP) {
+/*----------------------------------------------------------------------------
+   If the response to a call of method *methodP is in the registry's
+   response cache, under key *keyP, return it as *responseXmlPP, having
+   done everything executing the call would do except execute the method:
+   run the preinvoke function, which may fail the call, and start *meterP.
+
+   If it isn't, return *responseXmlPP NULL and do nothing.
+-----------------------------------------------------------------------------*/
+    xmlrpc_env env;
+    xmlrpc_mem_block * responseXmlP;
+
+    xmlrpc_env_init(&env);
+
+    xmlrpc_responseCacheLookup(&env, registryP->responseCacheP, keyP,
+                               &responseXmlP);
+
+    if (env.fault_occurred || !responseXmlP)
+        *responseXmlPP = NULL;
+    else {
+        xmlrpc_callMeterStart(meterP, NULL, callXmlLen);
+
+        preinvoke(faultP, registryP, methodName, paramArrayP);
+
+        if (faultP->fault_occurred) {
+            XMLRPC_MEMBLOCK_FREE(char, responseXmlP);
+            *responseXmlPP = NULL;
+        } else {
+            xmlrpc_callMeterStart(meterP, methodP->metricsP, callXmlLen);
+
+            xmlrpc_traceXml("XML-RPC RESPONSE (CACHED)", 
+                            XMLRPC_MEMBLOCK_CONTENTS(char, responseXmlP),
+                            XMLRPC_MEMBLOCK_SIZE(char, responseXmlP));
+
+            *responseXmlPP = responseXmlP;
+        }
+    }
+    xmlrpc_env_clean(&env);
+}
+
+
+
+static void
+processCall(xmlrpc_registry *         const registryP,
+            const char *              const callXml,
+            size_t                    const callXmlLen,
+            void *                    const callInfo,
+            xmlrpc_call_response_fn * const responseFn,
+            void *                    const responseContext,
+            xmlrpc_env *              const faultP,
+            xmlrpc_callMeter *        const meterP,
+            xmlrpc_methodInfo **      const methodPP,
+            xmlrpc_cacheKey **        const cacheKeyPP,
+            xmlrpc_mem_block **       const cachedResponsePP,
+            bool *                    const pendingP,
+            xmlrpc_value **           const resultPP) {
+/*----------------------------------------------------------------------------
+   Parse and execute the XML-RPC call 'callXml'.  Return its outcome as
+   *faultP and *resultPP, or *pendingP true, and start *meterP, as for
+   dispatch().
+
+   But if the response is in the registry's response cache, don't execute
+   the call; return the response as *cachedResponsePP instead.  Otherwise,
+   return *cachedResponsePP NULL, and if the response belongs in the
+   cache, return as *cacheKeyPP the key under which to add it once it
+   exists (else NULL).
+
+   Return as *methodPP the method we called, with a reference to it that
+   keeps *meterP valid, which the caller releases after finishing *meterP.
+   NULL if we didn't call a registered method.
+-----------------------------------------------------------------------------*/
+    const char * methodName;
+    xmlrpc_value * paramArrayP;
+    xmlrpc_env parseEnv;
+
+    *methodPP         = NULL;
+    *cacheKeyPP       = NULL;
+    *cachedResponsePP = NULL;
+    *pendingP         = false;
+
+    xmlrpc_env_init(&parseEnv);
+
+    xmlrpc_parse_call(&parseEnv, callXml, callXmlLen, 
+                      &methodName, &paramArrayP);
+
+    if (parseEnv.fault_occurred) {
+        xmlrpc_env_set_fault_formatted(
+            faultP, XMLRPC_PARSE_ERROR,
+            "Call XML not a proper XML-RPC call.  %s",
+            parseEnv.fault_string);
+        xmlrpc_callMeterStart(meterP, NULL, callXmlLen);
+    } else {
+        xmlrpc_methodInfo * methodP;
+        xmlrpc_cacheKey * cacheKeyP;
+
+        /* We look the method up only once, so the call executes the
+           method whose response we would cache even if someone replaces
+           it meanwhile.
+        */
+        xmlrpc_registryAcquireMethod(registryP, methodName, &methodP);
+
+        getCacheKey(registryP, methodName, methodP, paramArrayP, &cacheKeyP);
+
+        if (cacheKeyP)
+            respondFromCache(faultP, registryP, methodName, paramArrayP,
+                             methodP, cacheKeyP, callXmlLen, meterP,
+                             cachedResponsePP);
+
+        if (*cachedResponsePP || faultP->fault_occurred) {
+            xmlrpc_cacheKeyDestroy(cacheKeyP);
+            *resultPP = NULL;
+        } else {
+            dispatch(faultP, registryP, methodName, methodP, paramArrayP,
+                     callInfo, callXmlLen, registryP->adaptiveLimitP,
+                     registryP->schedulerP,
+                     responseFn, responseContext, meterP, pendingP, resultPP);
+
+            *cacheKeyPP = cacheKeyP;
+        }
+        *methodPP = methodP;
+        xmlrpc_strfree(methodName);
+        xmlrpc_DECREF(paramArrayP);
+    }
+    xmlrpc_env_clean(&parseEnv);
+}
+
+
+
+void
+xmlrpc_registry_process_call2(xmlrpc_env *        const envP,
+                              xmlrpc_registry *   const registryP,
+                              const char *        const callXml,
+                              size_t              const callXmlLen,
+                              void *              const callInfo,
+                              xmlrpc_mem_block ** const responseXmlPP) {
+/*----------------------------------------------------------------------------
+   Execute the XML-RPC call 'callXml' and return its XML-RPC response as
+   *responseXmlPP -- or, if the method is idempotent, the response to an
+   earlier identical call from the registry's response cache.
+-----------------------------------------------------------------------------*/
+    xmlrpc_env fault;
+    xmlrpc_value * resultP;
+    xmlrpc_callMeter meter;
+    xmlrpc_methodInfo * methodP;
+    xmlrpc_cacheKey * cacheKeyP;
+    xmlrpc_mem_block * cachedResponseP;
+    bool pending;
+
+    XMLRPC_ASSERT_ENV_OK(envP);
+    XMLRPC_ASSERT_PTR_OK(callXml);
+    
+    xmlrpc_traceXml("XML-RPC CALL", callXml, callXmlLen);
+
+    xmlrpc_env_init(&fault);
+
+    processCall(registryP, callXml, callXmlLen, callInfo, NULL, NULL,
+                &fault, &meter, &methodP, &cacheKeyP, &cachedResponseP,
+                &pending, &resultP);
+
+    assert(!pending);
+
+    if (cachedResponseP)
+        *responseXmlPP = cachedResponseP;
+    else {
+        generateResponse(envP, registryP, cacheKeyP, &fault, resultP,
+                         responseXmlPP);
+
+        if (!fault.fault_occurred)
+            xmlrpc_DECREF(resultP);
+    }
+    finishMeter(&meter, &fault, envP,
+                envP->fault_occurred ? NULL : *responseXmlPP);
+
+    if (methodP)
+        xmlrpc_methodDecref(methodP);
+
+    if (cacheKeyP)
+        xmlrpc_cacheKeyDestroy(cacheKeyP);
+
+    xmlrpc_env_clean(&fault);
+}
+
+
+
+void
+xmlrpc_registry_process_call_async(
+    xmlrpc_registry *         const registryP,
+    const char *              const callXml,
+    size_t                    const callXmlLen,
+    void *                    const callInfo,
+    xmlrpc_call_response_fn * const responseFn,
+    void *                    const responseContext) {
+/*----------------------------------------------------------------------------
+   Same as xmlrpc_registry_process_call2(), except that instead of
+   returning the response, we give it to 'responseFn' (with argument
+   'responseContext'), which we call exactly once.  For an asynchronous
+   method, that may be after we return, from whatever thread completes the
+   call, so no thread waits for such a method.
+
+   'responseFn' gets a failure instead of a response if we can't generate
+   the XML-RPC response.  Otherwise, it must free the response.
+
+   We don't use 'callXml' after we return.
+-----------------------------------------------------------------------------*/
+    xmlrpc_env fault;
+    xmlrpc_value * resultP;
+    xmlrpc_callMeter meter;
+    xmlrpc_methodInfo * methodP;
+    xmlrpc_cacheKey * cacheKeyP;
+    xmlrpc_mem_block * cachedResponseP;
+    bool pending;
+
+    XMLRPC_ASSERT_PTR_OK(callXml);
+    XMLRPC_ASSERT_PTR_OK(responseFn);
+    
+    xmlrpc_traceXml("XML-RPC CALL", callXml, callXmlLen);
+
+    xmlrpc_env_init(&fault);
+
+    processCall(registryP, callXml, callXmlLen, callInfo,
+                responseFn, responseContext, &fault, &meter, &methodP,
+                &cacheKeyP, &cachedResponseP, &pending, &resultP);
+
+    if (cachedResponseP) {
+        finishMeter(&meter, &fault, &fault, cachedResponseP);
+
+        responseFn(responseContext, &fault, cachedResponseP);
+    } else if (!pending) {
+        xmlrpc_sendCallResponse(registryP, &meter, cacheKeyP, &fault,
+                                resultP, responseFn, responseContext);
+
+        if (!fault.fault_occurred)
+            xmlrpc_DECREF(resultP);
+    }
+    /* A pending call's completion has its own reference to the method */
+    if (methodP)
+        xmlrpc_methodDecref(methodP);
+
+    if (cacheKeyP)
+        xmlrpc_cacheKeyDestroy(cacheKeyP);
+
+    xmlrpc_env_clean(&fault);
+}
+
+
+
 xmlrpc_mem_block *
 xmlrpc_registry_process_call(xmlrpc_env *      const envP,
                              xmlrpc_registry * const registryP,
@@ -3,6 +3,8 @@
 
 #include "xmlrpc-c/base.h"
 #include "xmlrpc-c/server.h"
+#include "metrics.h"
+#include "response_cache.h"
 
 void
 xmlrpc_dispatchCall(struct _xmlrpc_env *     const envP, 
@@ -12,4 +14,13 @@ xmlrpc_dispatchCall(struct _xmlrpc_env *     const envP,
                     void *                   const callInfoP,
                     struct _xmlrpc_value **  const resultPP);
 
+void
+xmlrpc_sendCallResponse(struct xmlrpc_registry *  const registryP,
+                        const xmlrpc_callMeter *  const meterP,
+                        const xmlrpc_cacheKey *   const cacheKeyP,
+                        const struct _xmlrpc_env * const faultP,
+                        struct _xmlrpc_value *    const resultP,
+                        xmlrpc_call_response_fn * const responseFn,
+                        void *                    const responseContext);
+
 #endif
@@ -0,0 +1,778 @@
+/*=============================================================================
+                                response_cache
+===============================================================================
+  A cache of XML-RPC responses of idempotent methods.  See response_cache.h.
+=============================================================================*/
+
+#include "xmlrpc_config.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "bool.h"
+#include "int.h"
+#include "mallocvar.h"
+#include "xmlrpc-c/base_int.h"
+#include "xmlrpc-c/string_int.h"
+#include "xmlrpc-c/lock.h"
+#include "xmlrpc-c/lock_platform.h"
+#include "xmlrpc-c/base.h"
+
+#include "response_cache.h"
+
+
+/* Buckets in a new cache's hash table.  growHashTable() keeps there being
+   at least as many buckets as entries.
+*/
+#define INITIAL_BUCKET_COUNT 64
+
+struct xmlrpc_cacheKey {
+    xmlrpc_mem_block * bytesP;
+        /* The method name, a NUL, and the canonical form of the
+           parameters
+        */
+    uint32_t hash;
+        /* Hash of the contents of *bytesP */
+};
+
+typedef struct cacheEntry {
+/*----------------------------------------------------------------------------
+   A cached response.  The key and response bytes follow this structure
+   in the same malloc'ed block.
+-----------------------------------------------------------------------------*/
+    struct cacheEntry * hashNextP;
+        /* Next entry in the same hash bucket */
+    struct cacheEntry * newerP;
+    struct cacheEntry * olderP;
+        /* Neighbors in the list of all entries in order of last use */
+    uint32_t hash;
+    size_t keySize;
+    size_t responseSize;
+    time_t expiry;
+        /* When the entry stops being valid.  0 means never. */
+} cacheEntry;
+
+struct xmlrpc_responseCache {
+    lock * lockP;
+        /* Protects everything below */
+    size_t maxBytes;
+        /* Most memory the entries may use */
+    unsigned int ttlSecs;
+        /* How long an entry is valid.  0 means forever. */
+    size_t bytes;
+        /* Memory the entries use */
+    unsigned int entryCount;
+    cacheEntry ** bucket;
+        /* Hash table of the entries: those whose hash is h are in the list
+           linked by 'hashNextP' from bucket[h % bucketCount].
+        */
+    unsigned int bucketCount;
+        /* A power of two, so h % bucketCount is a mask */
+    cacheEntry * newestP;
+    cacheEntry * oldestP;
+        /* Ends of the list of entries in order of last use */
+};
+
+
+
+static char *
+entryKey(cacheEntry * const entryP) {
+
+    return (char *)(entryP + 1);
+}
+
+
+
+static char *
+entryResponse(cacheEntry * const entryP) {
+
+    return (char *)(entryP + 1) + entryP->keySize;
+}
+
+
+
+static size_t
+entryBytes(const cacheEntry * const entryP) {
+
+    return sizeof(*entryP) + entryP->keySize + entryP->responseSize;
+}
+
+
+
+static uint32_t
+hashBytes(const char * const bytes,
+          size_t       const size) {
+
+    /* This is the Bernstein hash, as the method list uses for method
+       names.
+    */
+    uint32_t hash;
+    size_t i;
+
+    for (hash = 0, i = 0; i < size; ++i)
+        hash = hash + (unsigned char)bytes[i] + (hash << 5);
+
+    return hash;
+}
+
+
+
+void
+xmlrpc_responseCacheCreate(xmlrpc_env *            const envP,
+                           size_t                  const maxBytes,
+                           unsigned int            const ttlSecs,
+                           xmlrpc_responseCache ** const cachePP) {
+/*----------------------------------------------------------------------------
+   Create a cache whose entries use at most 'maxBytes' bytes of memory and
+   stay valid for 'ttlSecs' seconds (0 means as long as there is room for
+   them).
+-----------------------------------------------------------------------------*/
+    xmlrpc_responseCache * cacheP;
+
+    MALLOCVAR(cacheP);
+
+    if (cacheP == NULL)
+        xmlrpc_faultf(envP, "Unable to allocate memory for response cache");
+    else {
+        cacheP->maxBytes    = maxBytes;
+        cacheP->ttlSecs     = ttlSecs;
+        cacheP->bytes       = 0;
+        cacheP->entryCount  = 0;
+        cacheP->newestP     = NULL;
+        cacheP->oldestP     = NULL;
+        cacheP->bucketCount = INITIAL_BUCKET_COUNT;
+
+        MALLOCARRAY(cacheP->bucket, cacheP->bucketCount);
+
+        if (cacheP->bucket == NULL)
+            xmlrpc_faultf(envP, "Unable to allocate memory for response "
+                          "cache hash table");
+        else {
+            unsigned int i;
+
+            for (i = 0; i < cacheP->bucketCount; ++i)
+                cacheP->bucket[i] = NULL;
+
+            cacheP->lockP = xmlrpc_lock_create();
+
+            if (cacheP->lockP == NULL) {
+                xmlrpc_faultf(envP, "Unable to create lock for response "
+                              "cache");
+                free(cacheP->bucket);
+            }
+        }
+        if (envP->fault_occurred)
+            free(cacheP);
+    }
+    *cachePP = cacheP;
+}
+
+
+
+static void
+unlinkFromLru(xmlrpc_responseCache * const cacheP,
+              cacheEntry *           const entryP) {
+
+    if (entryP->newerP)
+        entryP->newerP->olderP = entryP->olderP;
+    else
+        cacheP->newestP = entryP->olderP;
+
+    if (entryP->olderP)
+        entryP->olderP->newerP = entryP->newerP;
+    else
+        cacheP->oldestP = entryP->newerP;
+}
+
+
+
+static void
+removeEntry(xmlrpc_responseCache * const cacheP,
+            cacheEntry *           const entryP) {
+/*----------------------------------------------------------------------------
+   Remove entry *entryP from the cache and free it.
+
+   Caller must hold the lock.
+-----------------------------------------------------------------------------*/
+    cacheEntry ** pp;
+
+    for (pp = &cacheP->bucket[entryP->hash & (cacheP->bucketCount - 1)];
+         *pp != entryP;
+         pp = &(*pp)->hashNextP);
+
+    *pp = entryP->hashNextP;
+
+    unlinkFromLru(cacheP, entryP);
+
+    cacheP->bytes -= entryBytes(entryP);
+    --cacheP->entryCount;
+
+    free(entryP);
+}
+
+
+
+static void
+removeAll(xmlrpc_responseCache * const cacheP) {
+
+    while (cacheP->oldestP)
+        removeEntry(cacheP, cacheP->oldestP);
+}
+
+
+
+void
+xmlrpc_responseCacheDestroy(xmlrpc_responseCache * const cacheP) {
+
+    removeAll(cacheP);
+
+    cacheP->lockP->destroy(cacheP->lockP);
+
+    free(cacheP->bucket);
+
+    free(cacheP);
+}
+
+
+
+void
+xmlrpc_responseCacheFlush(xmlrpc_responseCache * const cacheP) {
+/*----------------------------------------------------------------------------
+   Discard every response in the cache.
+-----------------------------------------------------------------------------*/
+    cacheP->lockP->acquire(cacheP->lockP);
+
+    removeAll(cacheP);
+
+    cacheP->lockP->release(cacheP->lockP);
+}
+
+
+
+/*=========================================================================
+  Canonical form of parameters
+=========================================================================*/
+
+static void
+appendValue(xmlrpc_env *       const envP,
+            xmlrpc_mem_block * const blockP,
+            xmlrpc_value *     const valueP);
+
+
+
+static void
+appendBytes(xmlrpc_env *       const envP,
+            xmlrpc_mem_block * const blockP,
+            const void *       const bytes,
+            size_t             const size) {
+
+    XMLRPC_MEMBLOCK_APPEND(char, envP, blockP, bytes, size);
+}
+
+
+
+static void
+appendString(xmlrpc_env *       const envP,
+             xmlrpc_mem_block * const blockP,
+             const char *       const bytes,
+             size_t             const size) {
+/*----------------------------------------------------------------------------
+   Append a byte string, preceded by its length so that the end of it
+   is unambiguous.
+-----------------------------------------------------------------------------*/
+    appendBytes(envP, blockP, &size, sizeof(size));
+
+    if (!envP->fault_occurred)
+        appendBytes(envP, blockP, bytes, size);
+}
+
+
+
+static void
+appendArray(xmlrpc_env *       const envP,
+            xmlrpc_mem_block * const blockP,
+            xmlrpc_value *     const arrayP) {
+
+    unsigned int const size = xmlrpc_array_size(envP, arrayP);
+
+    if (!envP->fault_occurred) {
+        unsigned int i;
+
+        appendBytes(envP, blockP, &size, sizeof(size));
+
+        for (i = 0; i < size && !envP->fault_occurred; ++i) {
+            xmlrpc_value * itemP;
+
+            xmlrpc_array_read_item(envP, arrayP, i, &itemP);
+
+            if (!envP->fault_occurred) {
+                appendValue(envP, blockP, itemP);
+
+                xmlrpc_DECREF(itemP);
+            }
+        }
+    }
+}
+
+
+
+typedef struct {
+    const char *   key;
+    size_t         keySize;
+    xmlrpc_value * valueP;
+} structMember;
+
+
+
+static int
+compareMembers(const void * const aP,
+               const void * const bP) {
+
+    const structMember * const memberAP = aP;
+    const structMember * const memberBP = bP;
+
+    int const cmp = memcmp(memberAP->key, memberBP->key,
+                           MIN(memberAP->keySize, memberBP->keySize));
+
+    if (cmp != 0)
+        return cmp;
+    else if (memberAP->keySize < memberBP->keySize)
+        return -1;
+    else if (memberAP->keySize > memberBP->keySize)
+        return 1;
+    else
+        return 0;
+}
+
+
+
+static void
+readMembers(xmlrpc_env *   const envP,
+            xmlrpc_value * const structP,
+            unsigned int   const size,
+            structMember * const member,
+            unsigned int * const readCountP) {
+/*----------------------------------------------------------------------------
+   Read the 'size' members of struct *structP into member[].  Return as
+   *readCountP how many we read, which is fewer than 'size' if we fail.
+   The caller must release those.
+-----------------------------------------------------------------------------*/
+    unsigned int i;
+
+    for (i = 0, *readCountP = 0; i < size && !envP->fault_occurred; ++i) {
+        xmlrpc_value * keyP;
+        xmlrpc_value * valueP;
+
+        xmlrpc_struct_read_member(envP, structP, i, &keyP, &valueP);
+
+        if (!envP->fault_occurred) {
+            xmlrpc_read_string_lp(envP, keyP, &member[i].keySize,
+                                  &member[i].key);
+
+            if (envP->fault_occurred)
+                xmlrpc_DECREF(valueP);
+            else {
+                member[i].valueP = valueP;
+                ++*readCountP;
+            }
+            xmlrpc_DECREF(keyP);
+        }
+    }
+}
+
+
+
+static void
+appendStruct(xmlrpc_env *       const envP,
+             xmlrpc_mem_block * const blockP,
+             xmlrpc_value *     const structP) {
+/*----------------------------------------------------------------------------
+   Append the members of a struct in order of key, because the order of
+   members isn't part of the value of a struct.
+-----------------------------------------------------------------------------*/
+    int const size = xmlrpc_struct_size(envP, structP);
+
+    if (!envP->fault_occurred) {
+        structMember * member;
+
+        MALLOCARRAY(member, MAX(size, 1));
+
+        if (member == NULL)
+            xmlrpc_faultf(envP, "Unable to allocate memory for %d struct "
+                          "members", size);
+        else {
+            unsigned int readCount;
+            unsigned int i;
+
+            readMembers(envP, structP, size, member, &readCount);
+
+            if (!envP->fault_occurred) {
+                qsort(member, size, sizeof(member[0]), &compareMembers);
+
+                appendBytes(envP, blockP, &size, sizeof(size));
+
+                for (i = 0; i < (unsigned)size && !envP->fault_occurred;
+                     ++i) {
+                    appendString(envP, blockP,
+                                 member[i].key, member[i].keySize);
+                    if (!envP->fault_occurred)
+                        appendValue(envP, blockP, member[i].valueP);
+                }
+            }
+            for (i = 0; i < readCount; ++i) {
+                xmlrpc_strfree(member[i].key);
+                xmlrpc_DECREF(member[i].valueP);
+            }
+            free(member);
+        }
+    }
+}
+
+
+
+static void
+appendDatetime(xmlrpc_env *       const envP,
+               xmlrpc_mem_block * const blockP,
+               xmlrpc_value *     const valueP) {
+
+    xmlrpc_datetime dt;
+
+    xmlrpc_read_datetime(envP, valueP, &dt);
+
+    if (!envP->fault_occurred) {
+        unsigned int const field[] = {
+            dt.Y, dt.M, dt.D, dt.h, dt.m, dt.s, dt.u
+        };
+        appendBytes(envP, blockP, field, sizeof(field));
+    }
+}
+
+
+
+static void
+appendValue(xmlrpc_env *       const envP,
+            xmlrpc_mem_block * const blockP,
+            xmlrpc_value *     const valueP) {
+/*----------------------------------------------------------------------------
+   Append to *blockP the canonical form of *valueP: its type followed by
+   its contents, such that two values have the same canonical form exactly
+   when they are equal.
+-----------------------------------------------------------------------------*/
+    xmlrpc_type const type = xmlrpc_value_type(valueP);
+    unsigned char const typeCode = (unsigned char)type;
+
+    appendBytes(envP, blockP, &typeCode, 1);
+
+    if (!envP->fault_occurred) {
+        switch (type) {
+        case XMLRPC_TYPE_INT: {
+            xmlrpc_int32 i;
+            xmlrpc_read_int(envP, valueP, &i);
+            if (!envP->fault_occurred)
+                appendBytes(envP, blockP, &i, sizeof(i));
+        } break;
+        case XMLRPC_TYPE_I8: {
+            xmlrpc_int64 i;
+            xmlrpc_read_i8(envP, valueP, &i);
+            if (!envP->fault_occurred)
+                appendBytes(envP, blockP, &i, sizeof(i));
+        } break;
+        case XMLRPC_TYPE_BOOL: {
+            xmlrpc_bool b;
+            xmlrpc_read_bool(envP, valueP, &b);
+            if (!envP->fault_occurred) {
+                unsigned char const byte = b ? 1 : 0;
+                appendBytes(envP, blockP, &byte, 1);
+            }
+        } break;
+        case XMLRPC_TYPE_DOUBLE: {
+            double d;
+            xmlrpc_read_double(envP, valueP, &d);
+            if (!envP->fault_occurred)
+                appendBytes(envP, blockP, &d, sizeof(d));
+        } break;
+        case XMLRPC_TYPE_DATETIME:
+            appendDatetime(envP, blockP, valueP);
+            break;
+        case XMLRPC_TYPE_STRING: {
+            size_t size;
+            const char * str;
+            xmlrpc_read_string_lp(envP, valueP, &size, &str);
+            if (!envP->fault_occurred) {
+                appendString(envP, blockP, str, size);
+                xmlrpc_strfree(str);
+            }
+        } break;
+        case XMLRPC_TYPE_BASE64: {
+            size_t size;
+            const unsigned char * bytes;
+            xmlrpc_read_base64(envP, valueP, &size, &bytes);
+            if (!envP->fault_occurred) {
+                appendString(envP, blockP, (const char *)bytes, size);
+                free((void *)bytes);
+            }
+        } break;
+        case XMLRPC_TYPE_ARRAY:
+            appendArray(envP, blockP, valueP);
+            break;
+        case XMLRPC_TYPE_STRUCT:
+            appendStruct(envP, blockP, valueP);
+            break;
+        case XMLRPC_TYPE_NIL:
+            break;
+        default:
+            /* A C pointer, for one, means nothing to a cache */
+            xmlrpc_faultf(envP, "A value of type %u can't be part of a "
+                          "cache key", (unsigned)type);
+        }
+    }
+}
+
+
+
+void
+xmlrpc_cacheKeyCreate(xmlrpc_env *       const envP,
+                      const char *       const methodName,
+                      xmlrpc_value *     const paramArrayP,
+                      xmlrpc_cacheKey ** const keyPP) {
+/*----------------------------------------------------------------------------
+   Create the key for the response to a call of method 'methodName' with
+   parameters *paramArrayP.
+
+   Fail if some parameter can't be part of a key.
+-----------------------------------------------------------------------------*/
+    xmlrpc_cacheKey * keyP;
+
+    MALLOCVAR(keyP);
+
+    if (keyP == NULL)
+        xmlrpc_faultf(envP, "Unable to allocate memory for cache key");
+    else {
+        keyP->bytesP = XMLRPC_MEMBLOCK_NEW(char, envP, 0);
+
+        if (!envP->fault_occurred) {
+            appendBytes(envP, keyP->bytesP, methodName,
+                        strlen(methodName) + 1);
+
+            if (!envP->fault_occurred)
+                appendValue(envP, keyP->bytesP, paramArrayP);
+
+            if (envP->fault_occurred)
+                XMLRPC_MEMBLOCK_FREE(char, keyP->bytesP);
+            else
+                keyP->hash =
+                    hashBytes(XMLRPC_MEMBLOCK_CONTENTS(char, keyP->bytesP),
+                              XMLRPC_MEMBLOCK_SIZE(char, keyP->bytesP));
+        }
+        if (envP->fault_occurred)
+            free(keyP);
+    }
+    *keyPP = keyP;
+}
+
+
+
+void
+xmlrpc_cacheKeyDestroy(xmlrpc_cacheKey * const keyP) {
+
+    XMLRPC_MEMBLOCK_FREE(char, keyP->bytesP);
+
+    free(keyP);
+}
+
+
+
+/*=========================================================================
+  Lookup and addition
+=========================================================================*/
+
+static cacheEntry *
+findEntry(xmlrpc_responseCache *  const cacheP,
+          const xmlrpc_cacheKey * const keyP) {
+/*----------------------------------------------------------------------------
+   The entry with key *keyP; NULL if none.
+
+   Caller must hold the lock.
+-----------------------------------------------------------------------------*/
+    const char * const key = XMLRPC_MEMBLOCK_CONTENTS(char, keyP->bytesP);
+    size_t const keySize = XMLRPC_MEMBLOCK_SIZE(char, keyP->bytesP);
+
+    cacheEntry * p;
+
+    for (p = cacheP->bucket[keyP->hash & (cacheP->bucketCount - 1)];
+         p && !(p->hash == keyP->hash && p->keySize == keySize &&
+                memcmp(entryKey(p), key, keySize) == 0);
+         p = p->hashNextP);
+
+    return p;
+}
+
+
+
+static void
+linkAsNewest(xmlrpc_responseCache * const cacheP,
+             cacheEntry *           const entryP) {
+
+    entryP->newerP = NULL;
+    entryP->olderP = cacheP->newestP;
+
+    if (cacheP->newestP)
+        cacheP->newestP->newerP = entryP;
+    else
+        cacheP->oldestP = entryP;
+
+    cacheP->newestP = entryP;
+}
+
+
+
+void
+xmlrpc_responseCacheLookup(xmlrpc_env *            const envP,
+                           xmlrpc_responseCache *  const cacheP,
+                           const xmlrpc_cacheKey * const keyP,
+                           xmlrpc_mem_block **     const responseXmlPP) {
+/*----------------------------------------------------------------------------
+   Return as *responseXmlPP a copy of the cached response with key *keyP,
+   or NULL if there isn't a valid one.
+-----------------------------------------------------------------------------*/
+    cacheEntry * entryP;
+
+    cacheP->lockP->acquire(cacheP->lockP);
+
+    entryP = findEntry(cacheP, keyP);
+
+    if (entryP && entryP->expiry != 0 && time(NULL) >= entryP->expiry) {
+        removeEntry(cacheP, entryP);
+        entryP = NULL;
+    }
+
+    if (entryP) {
+        xmlrpc_mem_block * const responseXmlP =
+            XMLRPC_MEMBLOCK_NEW(char, envP, entryP->responseSize);
+
+        if (!envP->fault_occurred) {
+            memcpy(XMLRPC_MEMBLOCK_CONTENTS(char, responseXmlP),
+                   entryResponse(entryP), entryP->responseSize);
+
+            unlinkFromLru(cacheP, entryP);
+            linkAsNewest(cacheP, entryP);
+
+            *responseXmlPP = responseXmlP;
+        }
+    } else
+        *responseXmlPP = NULL;
+
+    cacheP->lockP->release(cacheP->lockP);
+}
+
+
+
+static void
+growHashTable(xmlrpc_responseCache * const cacheP) {
+/*----------------------------------------------------------------------------
+   Double the number of hash buckets, if we can get the memory.  If we
+   can't, lookups just get slower.
+
+   Caller must hold the lock.
+-----------------------------------------------------------------------------*/
+    unsigned int const newBucketCount = cacheP->bucketCount * 2;
+
+    cacheEntry ** newBucket;
+
+    MALLOCARRAY(newBucket, newBucketCount);
+
+    if (newBucket) {
+        unsigned int i;
+
+        for (i = 0; i < newBucketCount; ++i)
+            newBucket[i] = NULL;
+
+        for (i = 0; i < cacheP->bucketCount; ++i) {
+            cacheEntry * p;
+            cacheEntry * nextP;
+
+            for (p = cacheP->bucket[i]; p; p = nextP) {
+                cacheEntry ** const bucketPP =
+                    &newBucket[p->hash & (newBucketCount - 1)];
+
+                nextP = p->hashNextP;
+
+                p->hashNextP = *bucketPP;
+                *bucketPP = p;
+            }
+        }
+        free(cacheP->bucket);
+        cacheP->bucket      = newBucket;
+        cacheP->bucketCount = newBucketCount;
+    }
+}
+
+
+
+void
+xmlrpc_responseCacheAdd(xmlrpc_responseCache *  const cacheP,
+                        const xmlrpc_cacheKey * const keyP,
+                        xmlrpc_mem_block *      const responseXmlP) {
+/*----------------------------------------------------------------------------
+   Cache response *responseXmlP under key *keyP, discarding the least
+   recently used responses as necessary to make room.
+
+   If the response can't fit in the cache, or we can't get memory for it,
+   we just don't cache it.
+-----------------------------------------------------------------------------*/
+    size_t const keySize = XMLRPC_MEMBLOCK_SIZE(char, keyP->bytesP);
+    size_t const responseSize = XMLRPC_MEMBLOCK_SIZE(char, responseXmlP);
+    size_t const bytes = sizeof(cacheEntry) + keySize + responseSize;
+
+    if (bytes <= cacheP->maxBytes) {
+        cacheEntry * entryP;
+
+        entryP = malloc(bytes);
+
+        if (entryP) {
+            cacheEntry * oldEntryP;
+
+            entryP->hash         = keyP->hash;
+            entryP->keySize      = keySize;
+            entryP->responseSize = responseSize;
+            memcpy(entryKey(entryP),
+                   XMLRPC_MEMBLOCK_CONTENTS(char, keyP->bytesP), keySize);
+            memcpy(entryResponse(entryP),
+                   XMLRPC_MEMBLOCK_CONTENTS(char, responseXmlP),
+                   responseSize);
+
+            cacheP->lockP->acquire(cacheP->lockP);
+
+            entryP->expiry =
+                cacheP->ttlSecs > 0 ? time(NULL) + cacheP->ttlSecs : 0;
+
+            /* Another thread may have cached the same response while we
+               were generating ours.
+            */
+            oldEntryP = findEntry(cacheP, keyP);
+            if (oldEntryP)
+                removeEntry(cacheP, oldEntryP);
+
+            while (cacheP->bytes + bytes > cacheP->maxBytes)
+                removeEntry(cacheP, cacheP->oldestP);
+
+            if (cacheP->entryCount >= cacheP->bucketCount)
+                growHashTable(cacheP);
+
+            {
+                cacheEntry ** const bucketPP =
+                    &cacheP->bucket[entryP->hash & (cacheP->bucketCount - 1)];
+
+                entryP->hashNextP = *bucketPP;
+                *bucketPP = entryP;
+            }
+            linkAsNewest(cacheP, entryP);
+
+            cacheP->bytes += bytes;
+            ++cacheP->entryCount;
+
+            cacheP->lockP->release(cacheP->lockP);
+        }
+    }
+}
@@ -0,0 +1,59 @@
+#ifndef RESPONSE_CACHE_H_INCLUDED
+#define RESPONSE_CACHE_H_INCLUDED
+
+/*============================================================================
+   A response cache holds the XML-RPC responses of recent calls of
+   idempotent methods (see xmlrpc_registry_mark_idempotent()), so the
+   registry can answer the same call again without executing the method or
+   serializing its result.
+
+   A response is keyed by the method name and a canonical form of the
+   parameters, in which e.g. the order of struct members doesn't matter.
+
+   The cache limits the memory it uses, discarding the least recently used
+   response to make room, and may limit how long a response stays in it.
+
+   Any number of threads may use the cache at once.
+============================================================================*/
+
+#include <stddef.h>
+
+#include "xmlrpc-c/base.h"
+
+typedef struct xmlrpc_responseCache xmlrpc_responseCache;
+
+typedef struct xmlrpc_cacheKey xmlrpc_cacheKey;
+
+void
+xmlrpc_responseCacheCreate(xmlrpc_env *            const envP,
+                           size_t                  const maxBytes,
+                           unsigned int            const ttlSecs,
+                           xmlrpc_responseCache ** const cachePP);
+
+void
+xmlrpc_responseCacheDestroy(xmlrpc_responseCache * const cacheP);
+
+void
+xmlrpc_responseCacheFlush(xmlrpc_responseCache * const cacheP);
+
+void
+xmlrpc_cacheKeyCreate(xmlrpc_env *       const envP,
+                      const char *       const methodName,
+                      xmlrpc_value *     const paramArrayP,
+                      xmlrpc_cacheKey ** const keyPP);
+
+void
+xmlrpc_cacheKeyDestroy(xmlrpc_cacheKey * const keyP);
+
+void
+xmlrpc_responseCacheLookup(xmlrpc_env *            const envP,
+                           xmlrpc_responseCache *  const cacheP,
+                           const xmlrpc_cacheKey * const keyP,
+                           xmlrpc_mem_block **     const responseXmlPP);
+
+void
+xmlrpc_responseCacheAdd(xmlrpc_responseCache *  const cacheP,
+                        const xmlrpc_cacheKey * const keyP,
+                        xmlrpc_mem_block *      const responseXmlP);
+
+#endif
@@ -0,0 +1,400 @@
+/*=============================================================================
+                                  scheduler
+===============================================================================
+  The call scheduler.  See scheduler.h.
+
+  Each class has a pass: how far it has got through its share of starts.
+  Starting a call of a class advances its pass by the reciprocal of its
+  weight, and the next call to start is from the waiting class with the
+  least pass.  The scheduler's virtual time is the pass at which the last
+  call started; a class that starts waiting with less than that gets that,
+  so it can't make up for the time it was idle.
+
+  On a platform without POSIX threads, a call that waits for its turn
+  polls for it.
+=============================================================================*/
+
+#include "xmlrpc_config.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#if HAVE_PTHREAD
+#include <pthread.h>
+#endif
+
+#include "bool.h"
+#include "int.h"
+#include "girmath.h"
+#include "mallocvar.h"
+#include "xmlrpc-c/base_int.h"
+#include "xmlrpc-c/lock.h"
+#include "xmlrpc-c/lock_platform.h"
+#include "xmlrpc-c/sleep_int.h"
+#include "xmlrpc-c/time_int.h"
+#include "xmlrpc-c/base.h"
+#include "xmlrpc-c/server.h"
+
+#include "scheduler.h"
+
+
+/* The weights of the priority classes when the user doesn't say */
+static unsigned int const defaultWeight[XMLRPC_PRIORITY_COUNT] = {16, 4, 1};
+
+
+
+struct waiter {
+/*----------------------------------------------------------------------------
+   A call waiting for its turn.  It lives on the waiting thread's stack.
+-----------------------------------------------------------------------------*/
+    struct waiter * nextP;
+    bool granted;
+        /* The call may start; the scheduler already counts it as
+           running.
+        */
+};
+
+
+
+struct priorityClass {
+    unsigned int weight;
+    double pass;
+    struct waiter * firstWaiterP;
+    struct waiter * lastWaiterP;
+        /* The calls of this class waiting for their turn, in the order
+           they arrived
+        */
+    xmlrpc_priority_stats stats;
+};
+
+
+
+struct xmlrpc_scheduler {
+    unsigned int maxRunning;
+        /* The most calls that may execute at once; at least 1 */
+#if HAVE_PTHREAD
+    pthread_mutex_t mutex;
+        /* Protects everything below */
+    pthread_cond_t grantCond;
+        /* Broadcast when some waiting call may start */
+#else
+    lock * lockP;
+        /* Protects everything below */
+#endif
+    unsigned int running;
+        /* Number of calls executing */
+    double virtualTime;
+    struct priorityClass priorityClass[XMLRPC_PRIORITY_COUNT];
+};
+
+
+
+void
+xmlrpc_schedulerCreate(xmlrpc_env *         const envP,
+                       unsigned int         const maxRunning,
+                       const unsigned int * const weights,
+                       xmlrpc_scheduler **  const schedulerPP) {
+/*----------------------------------------------------------------------------
+   Create a scheduler that lets 'maxRunning' calls execute at once, with
+   priority class i having weight weights[i].  'weights' NULL means
+   default weights.
+-----------------------------------------------------------------------------*/
+    xmlrpc_scheduler * schedulerP;
+
+    assert(maxRunning >= 1);
+
+    MALLOCVAR(schedulerP);
+
+    if (schedulerP == NULL)
+        xmlrpc_faultf(envP, "Unable to allocate memory for a call scheduler");
+    else {
+        unsigned int i;
+
+        schedulerP->maxRunning  = maxRunning;
+        schedulerP->running     = 0;
+        schedulerP->virtualTime = 0.0;
+
+        for (i = 0; i < XMLRPC_PRIORITY_COUNT; ++i) {
+            struct priorityClass * const classP =
+                &schedulerP->priorityClass[i];
+
+            classP->weight       = weights ? weights[i] : defaultWeight[i];
+            classP->pass         = 0.0;
+            classP->firstWaiterP = NULL;
+            classP->lastWaiterP  = NULL;
+
+            memset(&classP->stats, 0, sizeof(classP->stats));
+
+            assert(classP->weight >= 1);
+        }
+#if HAVE_PTHREAD
+        pthread_mutex_init(&schedulerP->mutex, NULL);
+        pthread_cond_init(&schedulerP->grantCond, NULL);
+#else
+        schedulerP->lockP = xmlrpc_lock_create();
+
+        if (schedulerP->lockP == NULL) {
+            xmlrpc_faultf(envP, "Unable to create lock for a "
+                          "call scheduler");
+            free(schedulerP);
+        }
+#endif
+        *schedulerPP = schedulerP;
+    }
+}
+
+
+
+void
+xmlrpc_schedulerDestroy(xmlrpc_scheduler * const schedulerP) {
+
+    assert(schedulerP->running == 0);
+
+#if HAVE_PTHREAD
+    pthread_cond_destroy(&schedulerP->grantCond);
+    pthread_mutex_destroy(&schedulerP->mutex);
+#else
+    schedulerP->lockP->destroy(schedulerP->lockP);
+#endif
+    free(schedulerP);
+}
+
+
+
+static void
+lockScheduler(xmlrpc_scheduler * const schedulerP) {
+
+#if HAVE_PTHREAD
+    pthread_mutex_lock(&schedulerP->mutex);
+#else
+    schedulerP->lockP->acquire(schedulerP->lockP);
+#endif
+}
+
+
+
+static void
+unlockScheduler(xmlrpc_scheduler * const schedulerP) {
+
+#if HAVE_PTHREAD
+    pthread_mutex_unlock(&schedulerP->mutex);
+#else
+    schedulerP->lockP->release(schedulerP->lockP);
+#endif
+}
+
+
+
+static void
+waitForGrant(xmlrpc_scheduler * const schedulerP) {
+/*----------------------------------------------------------------------------
+   Wait until some waiting call may have been granted its turn.  Caller
+   holds the lock; we hold it again when we return.
+-----------------------------------------------------------------------------*/
+#if HAVE_PTHREAD
+    pthread_cond_wait(&schedulerP->grantCond, &schedulerP->mutex);
+#else
+    schedulerP->lockP->release(schedulerP->lockP);
+
+    xmlrpc_millisecond_sleep(1);
+
+    schedulerP->lockP->acquire(schedulerP->lockP);
+#endif
+}
+
+
+
+static bool
+anyWaiting(const xmlrpc_scheduler * const schedulerP) {
+
+    unsigned int i;
+    bool any;
+
+    for (i = 0, any = false; i < XMLRPC_PRIORITY_COUNT && !any; ++i)
+        any = !!schedulerP->priorityClass[i].firstWaiterP;
+
+    return any;
+}
+
+
+
+static void
+catchUp(xmlrpc_scheduler *     const schedulerP,
+        struct priorityClass * const classP) {
+/*----------------------------------------------------------------------------
+   Bring the pass of class *classP, which has had no calls waiting, up to
+   the scheduler's virtual time.
+-----------------------------------------------------------------------------*/
+    classP->pass = MAX(classP->pass, schedulerP->virtualTime);
+}
+
+
+
+static void
+startCall(xmlrpc_scheduler *     const schedulerP,
+          struct priorityClass * const classP) {
+
+    schedulerP->virtualTime = classP->pass;
+
+    classP->pass += 1.0 / classP->weight;
+
+    ++schedulerP->running;
+}
+
+
+
+static struct priorityClass *
+nextClass(xmlrpc_scheduler * const schedulerP) {
+/*----------------------------------------------------------------------------
+   The class whose call should start next: the one with the least pass
+   among those with calls waiting, the higher priority one in a tie.  NULL
+   if no call is waiting.
+-----------------------------------------------------------------------------*/
+    struct priorityClass * nextP;
+    unsigned int i;
+
+    for (i = 0, nextP = NULL; i < XMLRPC_PRIORITY_COUNT; ++i) {
+        struct priorityClass * const classP = &schedulerP->priorityClass[i];
+
+        if (classP->firstWaiterP && (!nextP || classP->pass < nextP->pass))
+            nextP = classP;
+    }
+    return nextP;
+}
+
+
+
+static void
+countStart(struct priorityClass * const classP,
+           bool                   const waited,
+           uint64_t               const usec) {
+/*----------------------------------------------------------------------------
+   Count in the class' statistics a call that is starting, having waited
+   'usec' microseconds for its turn if 'waited'.
+-----------------------------------------------------------------------------*/
+    xmlrpc_priority_stats * const statsP = &classP->stats;
+
+    if (waited)
+        ++statsP->waited;
+
+    ++statsP->calls;
+    statsP->totalWaitUsec += usec;
+    statsP->maxWaitUsec = MAX(statsP->maxWaitUsec, usec);
+    ++statsP->wait[xmlrpc_latencyBucket(usec, XMLRPC_METHOD_STATS_BUCKETS)];
+}
+
+
+
+void
+xmlrpc_schedulerEnter(xmlrpc_scheduler * const schedulerP,
+                      xmlrpc_priority    const priority) {
+/*----------------------------------------------------------------------------
+   Start a call of priority 'priority', waiting for its turn if as many
+   calls as the scheduler allows are executing, or others are already
+   waiting.
+-----------------------------------------------------------------------------*/
+    struct priorityClass * const classP =
+        &schedulerP->priorityClass[priority];
+
+    bool waited;
+    uint64_t waitUsec;
+
+    lockScheduler(schedulerP);
+
+    if (!classP->firstWaiterP)
+        catchUp(schedulerP, classP);
+
+    if (schedulerP->running < schedulerP->maxRunning &&
+        !anyWaiting(schedulerP)) {
+        startCall(schedulerP, classP);
+        waited   = false;
+        waitUsec = 0;
+    } else {
+        struct waiter waiter;
+        xmlrpc_timespec arrivalTime;
+        xmlrpc_timespec now;
+
+        xmlrpc_gettimeofday(&arrivalTime);
+
+        waiter.nextP   = NULL;
+        waiter.granted = false;
+
+        if (classP->lastWaiterP)
+            classP->lastWaiterP->nextP = &waiter;
+        else
+            classP->firstWaiterP = &waiter;
+        classP->lastWaiterP = &waiter;
+
+        ++classP->stats.waiting;
+
+        /* xmlrpc_schedulerLeave() takes us off the queue and starts us */
+        while (!waiter.granted)
+            waitForGrant(schedulerP);
+
+        xmlrpc_gettimeofday(&now);
+
+        waited   = true;
+        waitUsec = xmlrpc_usecBetween(arrivalTime, now);
+    }
+    countStart(classP, waited, waitUsec);
+
+    unlockScheduler(schedulerP);
+}
+
+
+
+void
+xmlrpc_schedulerLeave(xmlrpc_scheduler * const schedulerP) {
+/*----------------------------------------------------------------------------
+   Note that a call the scheduler started has finished, and start the
+   waiting calls whose turn that makes it.
+-----------------------------------------------------------------------------*/
+    struct priorityClass * classP;
+    bool granted;
+
+    lockScheduler(schedulerP);
+
+    assert(schedulerP->running > 0);
+
+    --schedulerP->running;
+
+    for (granted = false;
+         schedulerP->running < schedulerP->maxRunning &&
+             (classP = nextClass(schedulerP));
+         granted = true) {
+
+        struct waiter * const waiterP = classP->firstWaiterP;
+
+        classP->firstWaiterP = waiterP->nextP;
+        if (!classP->firstWaiterP)
+            classP->lastWaiterP = NULL;
+
+        --classP->stats.waiting;
+
+        startCall(schedulerP, classP);
+
+        waiterP->granted = true;
+    }
+#if HAVE_PTHREAD
+    if (granted)
+        pthread_cond_broadcast(&schedulerP->grantCond);
+#endif
+    unlockScheduler(schedulerP);
+}
+
+
+
+void
+xmlrpc_schedulerRead(xmlrpc_scheduler *      const schedulerP,
+                     xmlrpc_priority         const priority,
+                     xmlrpc_priority_stats * const statsP) {
+/*----------------------------------------------------------------------------
+   Return as *statsP the statistics about calls of priority 'priority'
+   waiting for their turn.
+-----------------------------------------------------------------------------*/
+    lockScheduler(schedulerP);
+
+    *statsP = schedulerP->priorityClass[priority].stats;
+
+    unlockScheduler(schedulerP);
+}
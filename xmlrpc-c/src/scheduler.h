@@ -0,0 +1,48 @@
+#ifndef SCHEDULER_H_INCLUDED
+#define SCHEDULER_H_INCLUDED
+
+/*============================================================================
+   A call scheduler: a limit on how many calls a registry executes at once,
+   with the calls beyond that waiting their turn by the priority of their
+   method instead of in the order they arrived.
+
+   Each priority class has a weight.  When a call finishes, the next to
+   start is from the class that has had the least of its share of starts,
+   its share being its weight over the total weight of the classes that
+   have calls waiting (weighted fair queueing, in the form of stride
+   scheduling).  So a class with 4 times the weight of another starts 4
+   calls for each of the other's while both have calls waiting, and no
+   class with calls waiting starves.
+
+   A class that had no calls waiting doesn't get credit for the time it
+   was idle; it joins the others at the point they are at.
+============================================================================*/
+
+#include "xmlrpc-c/time_int.h"
+#include "xmlrpc-c/base.h"
+#include "xmlrpc-c/server.h"
+
+typedef struct xmlrpc_scheduler xmlrpc_scheduler;
+
+void
+xmlrpc_schedulerCreate(xmlrpc_env *         const envP,
+                       unsigned int         const maxRunning,
+                       const unsigned int * const weights,
+                       xmlrpc_scheduler **  const schedulerPP);
+
+void
+xmlrpc_schedulerDestroy(xmlrpc_scheduler * const schedulerP);
+
+void
+xmlrpc_schedulerEnter(xmlrpc_scheduler * const schedulerP,
+                      xmlrpc_priority    const priority);
+
+void
+xmlrpc_schedulerLeave(xmlrpc_scheduler * const schedulerP);
+
+void
+xmlrpc_schedulerRead(xmlrpc_scheduler *      const schedulerP,
+                     xmlrpc_priority         const priority,
+                     xmlrpc_priority_stats * const statsP);
+
+#endif
@@ -6,13 +6,17 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include "mallocvar.h"
+#include "girmath.h"
 #include "xmlrpc-c/base_int.h"
 #include "xmlrpc-c/string_int.h"
+#include "xmlrpc-c/parallel_int.h"
 #include "xmlrpc-c/base.h"
 #include "xmlrpc-c/server.h"
 #include "version.h"
 #include "registry.h"
 #include "method.h"
+#include "metrics.h"
 
 #include "system_method.h"
 
@@ -44,17 +48,15 @@ xmlrpc_registry_disable_introspection(xmlrpc_registry * const registryP) {
 =========================================================================*/
 
 static void
-callOneMethod(xmlrpc_env *      const envP,
-              xmlrpc_registry * const registryP,
-              xmlrpc_value *    const rpcDescP,
-              void *            const callInfo,
-              xmlrpc_value **   const resultPP) {
-
-    const char * methodName;
-    xmlrpc_value * paramArrayP;
-
-    XMLRPC_ASSERT_ENV_OK(envP);
-
+parseCallDesc(xmlrpc_env *    const envP,
+              xmlrpc_value *  const rpcDescP,
+              const char **   const methodNameP,
+              xmlrpc_value ** const paramArrayPP) {
+/*----------------------------------------------------------------------------
+   Get the method name and parameter array out of 'rpcDescP', an element
+   of the multicall array that describes one call.  Fail if it is malformed
+   or is itself a system.multicall.
+-----------------------------------------------------------------------------*/
     if (xmlrpc_value_type(rpcDescP) != XMLRPC_TYPE_STRUCT)
         xmlrpc_env_set_fault_formatted(
             envP, XMLRPC_TYPE_ERROR,
@@ -63,37 +65,94 @@ callOneMethod(xmlrpc_env *      const envP,
             xmlrpc_value_type(rpcDescP));
     else {
         xmlrpc_decompose_value(envP, rpcDescP, "{s:s,s:A,*}",
-                               "methodName", &methodName,
-                               "params", &paramArrayP);
+                               "methodName", methodNameP,
+                               "params", paramArrayPP);
         if (!envP->fault_occurred) {
             /* Watch out for a deep recursion attack. */
-            if (xmlrpc_streq(methodName, "system.multicall"))
+            if (xmlrpc_streq(*methodNameP, "system.multicall"))
                 xmlrpc_env_set_fault_formatted(
                     envP,
                     XMLRPC_REQUEST_REFUSED_ERROR,
                     "Recursive system.multicall forbidden");
-            else {
-                xmlrpc_env env;
-                xmlrpc_value * resultValP;
-
-                xmlrpc_env_init(&env);
-                xmlrpc_dispatchCall(&env, registryP, methodName, paramArrayP,
-                                    callInfo,
-                                    &resultValP);
-                if (env.fault_occurred) {
-                    /* Method failed, so result is a fault structure */
-                    *resultPP = 
-                        xmlrpc_build_value(
-                            envP, "{s:i,s:s}",
-                            "faultCode", (xmlrpc_int32) env.fault_code,
-                            "faultString", env.fault_string);
-                } else {
-                    *resultPP = xmlrpc_build_value(envP, "(V)", resultValP);
-
-                    xmlrpc_DECREF(resultValP);
-                }
-                xmlrpc_env_clean(&env);
+
+            if (envP->fault_occurred) {
+                xmlrpc_DECREF(*paramArrayPP);
+                xmlrpc_strfree(*methodNameP);
             }
+        }
+    }
+}
+
+
+
+static void
+callOneMethod(xmlrpc_env *      const envP,
+              xmlrpc_registry * const registryP,
+              xmlrpc_value *    const rpcDescP,
+              void *            const callInfo,
+              xmlrpc_value **   const resultPP) {
+
+    const char * methodName;
+    xmlrpc_value * paramArrayP;
+
+    XMLRPC_ASSERT_ENV_OK(envP);
+
+    parseCallDesc(envP, rpcDescP, &methodName, &paramArrayP);
+
+    if (!envP->fault_occurred) {
+        xmlrpc_env env;
+        xmlrpc_value * resultValP;
+
+        xmlrpc_env_init(&env);
+        xmlrpc_dispatchCall(&env, registryP, methodName, paramArrayP,
+                            callInfo,
+                            &resultValP);
+        if (env.fault_occurred) {
+            /* Method failed, so result is a fault structure */
+            *resultPP = 
+                xmlrpc_build_value(
+                    envP, "{s:i,s:s}",
+                    "faultCode", (xmlrpc_int32) env.fault_code,
+                    "faultString", env.fault_string);
+        } else {
+            *resultPP = xmlrpc_build_value(envP, "(V)", resultValP);
+
+            xmlrpc_DECREF(resultValP);
+        }
+        xmlrpc_env_clean(&env);
+
+        xmlrpc_DECREF(paramArrayP);
+        xmlrpc_strfree(methodName);
+    }
+}
+
+
+
+static void
+validateCalls(xmlrpc_env *   const envP,
+              xmlrpc_value * const methlistP) {
+/*----------------------------------------------------------------------------
+   Fail if any element of the multicall array 'methlistP' is malformed.
+
+   We check them all before executing any, so a multicall with a bad
+   element executes none of its calls, whether we would execute them
+   serially or in parallel.
+-----------------------------------------------------------------------------*/
+    unsigned int const methodCount = xmlrpc_array_size(envP, methlistP);
+    unsigned int i;
+
+    for (i = 0; i < methodCount && !envP->fault_occurred; ++i) {
+        xmlrpc_value * const methinfoP = 
+            xmlrpc_array_get_item(envP, methlistP, i);
+
+        const char * methodName;
+        xmlrpc_value * paramArrayP;
+
+        XMLRPC_ASSERT_ENV_OK(envP);
+
+        parseCallDesc(envP, methinfoP, &methodName, &paramArrayP);
+
+        if (!envP->fault_occurred) {
             xmlrpc_DECREF(paramArrayP);
             xmlrpc_strfree(methodName);
         }
@@ -137,6 +196,184 @@ getMethListFromMulticallPlist(xmlrpc_env *    const envP,
 
 
 
+static void
+callMethodsSerially(xmlrpc_env *      const envP,
+                    xmlrpc_registry * const registryP,
+                    xmlrpc_value *    const methlistP,
+                    void *            const callInfo,
+                    xmlrpc_value *    const resultsP) {
+
+    /* Loop over our input list, calling each method in turn. */
+    unsigned int const methodCount = xmlrpc_array_size(envP, methlistP);
+    unsigned int i;
+
+    for (i = 0; i < methodCount && !envP->fault_occurred; ++i) {
+        xmlrpc_value * const methinfoP = 
+            xmlrpc_array_get_item(envP, methlistP, i);
+            
+        xmlrpc_value * resultP;
+            
+        XMLRPC_ASSERT_ENV_OK(envP);
+            
+        callOneMethod(envP, registryP, methinfoP, callInfo, &resultP);
+            
+        if (!envP->fault_occurred) {
+            /* Append this method result to our master array. */
+            xmlrpc_array_append_item(envP, resultsP, resultP);
+            xmlrpc_DECREF(resultP);
+        }
+    }
+}
+
+
+
+struct parallelCalls {
+/*----------------------------------------------------------------------------
+   The calls of a multicall that we execute on several threads.  Job 'i'
+   executes call 'i' and fills in element 'i' of each array.
+-----------------------------------------------------------------------------*/
+    xmlrpc_registry * registryP;
+    xmlrpc_value *    methlistP;
+    void *            callInfo;
+    xmlrpc_env *      env;
+        /* env[i] is the outcome of executing call 'i' */
+    xmlrpc_value **   result;
+        /* result[i] is the result of call 'i'; meaningful only if env[i]
+           does not indicate failure.
+        */
+};
+
+
+
+static xmlrpc_parallelJobFn callOneMethodJob;
+
+static void
+callOneMethodJob(void *       const contextP,
+                 unsigned int const jobIndex) {
+
+    struct parallelCalls * const callsP = contextP;
+
+    xmlrpc_env * const envP = &callsP->env[jobIndex];
+
+    xmlrpc_value * methinfoP;
+
+    /* The array is not modified while the jobs run, so reading an item
+       from it on several threads at once is safe.
+    */
+    xmlrpc_array_read_item(envP, callsP->methlistP, jobIndex, &methinfoP);
+
+    if (!envP->fault_occurred) {
+        callOneMethod(envP, callsP->registryP, methinfoP, callsP->callInfo,
+                      &callsP->result[jobIndex]);
+
+        xmlrpc_DECREF(methinfoP);
+    }
+}
+
+
+
+static unsigned int
+reserveThreads(xmlrpc_registry * const registryP,
+               unsigned int      const wanted) {
+/*----------------------------------------------------------------------------
+   Take up to 'wanted' threads from the registry's budget of extra threads
+   for multicalls.  Return how many we took, which is zero if other
+   multicalls have them all.
+-----------------------------------------------------------------------------*/
+    lock * const lockP = registryP->multicallLockP;
+
+    unsigned int reserved;
+
+    lockP->acquire(lockP);
+
+    {
+        unsigned int const budget = registryP->multicallThreadCount - 1;
+        unsigned int const busy   = registryP->multicallThreadsBusy;
+
+        /* The budget may have shrunk below what is in use */
+        reserved = busy < budget ? MIN(wanted, budget - busy) : 0;
+
+        registryP->multicallThreadsBusy += reserved;
+    }
+    lockP->release(lockP);
+
+    return reserved;
+}
+
+
+
+static void
+releaseThreads(xmlrpc_registry * const registryP,
+               unsigned int      const count) {
+
+    lock * const lockP = registryP->multicallLockP;
+
+    lockP->acquire(lockP);
+
+    assert(registryP->multicallThreadsBusy >= count);
+
+    registryP->multicallThreadsBusy -= count;
+
+    lockP->release(lockP);
+}
+
+
+
+static void
+callMethodsInParallel(xmlrpc_env *      const envP,
+                      xmlrpc_registry * const registryP,
+                      xmlrpc_value *    const methlistP,
+                      void *            const callInfo,
+                      unsigned int      const threadCount,
+                      xmlrpc_value *    const resultsP) {
+/*----------------------------------------------------------------------------
+   Same as callMethodsSerially(), but execute the calls on up to
+   'threadCount' threads at once, including ours.
+
+   The results go into 'resultsP' in the order of the calls, regardless of
+   which call finishes first.
+-----------------------------------------------------------------------------*/
+    unsigned int const methodCount = xmlrpc_array_size(envP, methlistP);
+
+    struct parallelCalls calls;
+
+    MALLOCARRAY(calls.env, methodCount);
+    MALLOCARRAY(calls.result, methodCount);
+
+    if (calls.env == NULL || calls.result == NULL)
+        xmlrpc_faultf(envP, "Could not allocate memory for the results "
+                      "of %u calls", methodCount);
+    else {
+        unsigned int i;
+
+        calls.registryP = registryP;
+        calls.methlistP = methlistP;
+        calls.callInfo  = callInfo;
+
+        for (i = 0; i < methodCount; ++i)
+            xmlrpc_env_init(&calls.env[i]);
+
+        xmlrpc_parallel_run(threadCount, methodCount,
+                            &callOneMethodJob, &calls);
+
+        for (i = 0; i < methodCount; ++i) {
+            if (!calls.env[i].fault_occurred) {
+                if (!envP->fault_occurred)
+                    xmlrpc_array_append_item(envP, resultsP, calls.result[i]);
+                xmlrpc_DECREF(calls.result[i]);
+            } else if (!envP->fault_occurred)
+                xmlrpc_env_set_fault(envP, calls.env[i].fault_code,
+                                     calls.env[i].fault_string);
+
+            xmlrpc_env_clean(&calls.env[i]);
+        }
+    }
+    free(calls.result);
+    free(calls.env);
+}
+
+
+
 static xmlrpc_value *
 system_multicall(xmlrpc_env *   const envP,
                  xmlrpc_value * const paramArrayP,
@@ -161,26 +398,26 @@ system_multicall(xmlrpc_env *   const envP,
         /* Create an initially empty result list. */
         resultsP = xmlrpc_array_new(envP);
         if (!envP->fault_occurred) {
-            /* Loop over our input list, calling each method in turn. */
-            unsigned int const methodCount =
-                xmlrpc_array_size(envP, methlistP);
-            unsigned int i;
-            for (i = 0; i < methodCount && !envP->fault_occurred; ++i) {
-                xmlrpc_value * const methinfoP = 
-                    xmlrpc_array_get_item(envP, methlistP, i);
-            
-                xmlrpc_value * resultP;
-            
-                XMLRPC_ASSERT_ENV_OK(envP);
-            
-                callOneMethod(envP, registryP, methinfoP, callInfo, &resultP);
-            
-                if (!envP->fault_occurred) {
-                    /* Append this method result to our master array. */
-                    xmlrpc_array_append_item(envP, resultsP, resultP);
-                    xmlrpc_DECREF(resultP);
-                }
+            validateCalls(envP, methlistP);
+
+            if (!envP->fault_occurred) {
+                unsigned int const methodCount =
+                    xmlrpc_array_size(envP, methlistP);
+                unsigned int const extraThreads =
+                    methodCount > 1 ? reserveThreads(registryP,
+                                                     methodCount - 1) : 0;
+
+                if (extraThreads > 0) {
+                    callMethodsInParallel(envP, registryP, methlistP,
+                                          callInfo, 1 + extraThreads,
+                                          resultsP);
+
+                    releaseThreads(registryP, extraThreads);
+                } else
+                    callMethodsSerially(envP, registryP, methlistP,
+                                        callInfo, resultsP);
             }
+
             if (envP->fault_occurred)
                 xmlrpc_DECREF(resultsP);
             xmlrpc_DECREF(methlistP);
@@ -225,8 +462,14 @@ createMethodListArray(xmlrpc_env *      const envP,
     methodListP = xmlrpc_array_new(envP);
 
     if (!envP->fault_occurred) {
+        xmlrpc_methodList * registeredListP;
+        unsigned int rcuToken;
         xmlrpc_methodNode * methodNodeP;
-        for (methodNodeP = registryP->methodListP->firstMethodP;
+
+        registeredListP =
+            xmlrpc_registryReadMethods(registryP, &rcuToken);
+
+        for (methodNodeP = registeredListP->firstMethodP;
              methodNodeP && !envP->fault_occurred;
              methodNodeP = methodNodeP->nextP) {
             
@@ -240,6 +483,8 @@ createMethodListArray(xmlrpc_env *      const envP,
                 xmlrpc_DECREF(methodNameVP);
             }
         }
+        xmlrpc_registryReadMethodsDone(registryP, rcuToken);
+
         if (envP->fault_occurred)
             xmlrpc_DECREF(methodListP);
     }
@@ -298,10 +543,12 @@ determineMethodExistence(xmlrpc_env *      const envP,
 
     xmlrpc_methodInfo * methodP;
 
-    xmlrpc_methodListLookupByName(registryP->methodListP, methodName,
-                                  &methodP);
+    xmlrpc_registryAcquireMethod(registryP, methodName, &methodP);
 
     *existsPP = xmlrpc_bool_new(envP, !!methodP);
+
+    if (methodP)
+        xmlrpc_methodDecref(methodP);
 }
     
 
@@ -357,15 +604,17 @@ getHelpString(xmlrpc_env *      const envP,
 
     xmlrpc_methodInfo * methodP;
 
-    xmlrpc_methodListLookupByName(registryP->methodListP, methodName,
-                                  &methodP);
+    xmlrpc_registryAcquireMethod(registryP, methodName, &methodP);
 
     if (!methodP)
         xmlrpc_env_set_fault_formatted(
             envP, XMLRPC_NO_SUCH_METHOD_ERROR,
             "Method '%s' does not exist", methodName);
-    else
+    else {
         *helpStringPP = xmlrpc_string_new(envP, methodP->helpText);
+
+        xmlrpc_methodDecref(methodP);
+    }
 }
     
 
@@ -489,8 +738,7 @@ getSignatureList(xmlrpc_env *      const envP,
 -----------------------------------------------------------------------------*/
     xmlrpc_methodInfo * methodP;
 
-    xmlrpc_methodListLookupByName(registryP->methodListP, methodName,
-                                  &methodP);
+    xmlrpc_registryAcquireMethod(registryP, methodName, &methodP);
 
     if (!methodP)
         xmlrpc_env_set_fault_formatted(
@@ -524,6 +772,7 @@ getSignatureList(xmlrpc_env *      const envP,
             }
             *signatureListPP = signatureListP;
         }
+        xmlrpc_methodDecref(methodP);
     }
 }
 
@@ -798,6 +1047,154 @@ static struct systemMethodReg const methodGetCapabilities = {
 
 
 
+/*=========================================================================
+  system.stats
+=========================================================================*/
+
+static void
+buildLatencyArray(xmlrpc_env *                const envP,
+                  const xmlrpc_method_stats * const statsP,
+                  xmlrpc_value **             const latencyPP) {
+
+    xmlrpc_value * latencyP;
+
+    latencyP = xmlrpc_array_new(envP);
+
+    if (!envP->fault_occurred) {
+        unsigned int i;
+
+        for (i = 0; i < XMLRPC_METHOD_STATS_BUCKETS && !envP->fault_occurred;
+             ++i) {
+            xmlrpc_value * const countP =
+                xmlrpc_i8_new(envP, (xmlrpc_int64)statsP->latency[i]);
+
+            if (!envP->fault_occurred) {
+                xmlrpc_array_append_item(envP, latencyP, countP);
+
+                xmlrpc_DECREF(countP);
+            }
+        }
+        if (envP->fault_occurred)
+            xmlrpc_DECREF(latencyP);
+    }
+    *latencyPP = latencyP;
+}
+
+
+
+static void
+buildMethodStats(xmlrpc_env *        const envP,
+                 xmlrpc_methodInfo * const methodP,
+                 xmlrpc_value **     const statsPP) {
+/*----------------------------------------------------------------------------
+   Build the system.stats value for one method: a struct of the
+   xmlrpc_method_stats members.
+-----------------------------------------------------------------------------*/
+    xmlrpc_method_stats stats;
+    xmlrpc_value * latencyP;
+
+    xmlrpc_methodMetricsRead(methodP->metricsP, &stats);
+
+    buildLatencyArray(envP, &stats, &latencyP);
+
+    if (!envP->fault_occurred) {
+        *statsPP = xmlrpc_build_value(
+            envP, "{s:I,s:I,s:I,s:V,s:I,s:I}",
+            "calls",         (xmlrpc_int64)stats.calls,
+            "faults",        (xmlrpc_int64)stats.faults,
+            "totalUsec",     (xmlrpc_int64)stats.totalUsec,
+            "latency",       latencyP,
+            "callBytes",     (xmlrpc_int64)stats.callBytes,
+            "responseBytes", (xmlrpc_int64)stats.responseBytes);
+
+        xmlrpc_DECREF(latencyP);
+    }
+}
+
+
+
+static void
+buildStats(xmlrpc_env *      const envP,
+           xmlrpc_registry * const registryP,
+           xmlrpc_value **   const statsPP) {
+
+    xmlrpc_value * statsP;
+
+    statsP = xmlrpc_struct_new(envP);
+
+    if (!envP->fault_occurred) {
+        xmlrpc_methodList * methodListP;
+        unsigned int rcuToken;
+        xmlrpc_methodNode * methodNodeP;
+
+        methodListP =
+            xmlrpc_registryReadMethods(registryP, &rcuToken);
+
+        for (methodNodeP = methodListP->firstMethodP;
+             methodNodeP && !envP->fault_occurred;
+             methodNodeP = methodNodeP->nextP) {
+
+            xmlrpc_value * methodStatsP;
+
+            buildMethodStats(envP, methodNodeP->methodP, &methodStatsP);
+
+            if (!envP->fault_occurred) {
+                xmlrpc_struct_set_value(envP, statsP,
+                                        methodNodeP->methodName,
+                                        methodStatsP);
+
+                xmlrpc_DECREF(methodStatsP);
+            }
+        }
+        xmlrpc_registryReadMethodsDone(registryP, rcuToken);
+
+        if (envP->fault_occurred)
+            xmlrpc_DECREF(statsP);
+    }
+    *statsPP = statsP;
+}
+
+
+
+static xmlrpc_value *
+system_stats(xmlrpc_env *   const envP,
+             xmlrpc_value * const paramArrayP,
+             void *         const serverInfo,
+             void *         const callInfo ATTR_UNUSED) {
+
+    xmlrpc_registry * const registryP = serverInfo;
+
+    xmlrpc_value * retvalP;
+
+    XMLRPC_ASSERT_ENV_OK(envP);
+    XMLRPC_ASSERT_VALUE_OK(paramArrayP);
+    XMLRPC_ASSERT_PTR_OK(serverInfo);
+
+    xmlrpc_decompose_value(envP, paramArrayP, "()");
+    if (!envP->fault_occurred)
+        buildStats(envP, registryP, &retvalP);
+
+    return retvalP;
+}
+
+
+
+static struct systemMethodReg const methodStats = {
+    "system.stats",
+    &system_stats,
+    "S:",
+    "Return statistics about the calls of each method, as a struct "
+    "indexed by method name.  Each member is a struct with these "
+    "64 bit integer members: calls, faults, totalUsec (total microseconds "
+    "from start of execution to response), callBytes and responseBytes "
+    "(total XML size), and 'latency', an array in which element 0 counts "
+    "calls that took under 1 microsecond and element i counts calls that "
+    "took at least 2^(i-1) and under 2^i microseconds (the last element "
+    "also counts longer calls)."
+};
+
+
+
 /*============================================================================
   Installer of system methods
 ============================================================================*/
@@ -857,6 +1254,22 @@ xmlrpc_installSystemMethods(xmlrpc_env *      const envP,
 
 
 
+void
+xmlrpc_registry_enable_stats_method(xmlrpc_env *      const envP,
+                                    xmlrpc_registry * const registryP) {
+/*----------------------------------------------------------------------------
+   Add the system.stats method, which reports the method statistics
+   (see xmlrpc_registry_get_method_stats()) to clients.  It isn't there by
+   default because not every server wants to tell clients that.
+-----------------------------------------------------------------------------*/
+    XMLRPC_ASSERT_ENV_OK(envP);
+    XMLRPC_ASSERT_PTR_OK(registryP);
+
+    registerSystemMethod(envP, registryP, methodStats);
+}
+
+
+
 /* Copyright (C) 2001 by First Peer, Inc. All rights reserved.
 ** Copyright (C) 2001 by Eric Kidd. All rights reserved.
 ** Copyright (C) 2001 by Luke Howard. All rights reserved.
@@ -110,6 +110,9 @@ xmlrpc_array_append_item(xmlrpc_env *   const envP,
     if (xmlrpc_value_type(arrayP) != XMLRPC_TYPE_ARRAY)
         xmlrpc_env_set_fault_formatted(
             envP, XMLRPC_TYPE_ERROR, "Value is not an array");
+    else if (arrayP->_frozen)
+        xmlrpc_faultf(envP, "Array is frozen (it has a serialization "
+                      "cache), so you can't add to it");
     else {
         size_t const size = 
             XMLRPC_MEMBLOCK_SIZE(xmlrpc_value *, &arrayP->_block);
@@ -20,7 +20,7 @@
 
 static void
 getString(xmlrpc_env *    const envP,
-          const char **   const formatP,
+          bool            const hasLength,
           va_listx *      const argsP,
           xmlrpc_value ** const valPP) {
 
@@ -28,10 +28,9 @@ getString(xmlrpc_env *    const envP,
     size_t len;
     
     str = (const char*) va_arg(argsP->v, char*);
-    if (*(*formatP) == '#') {
-        ++(*formatP);
+    if (hasLength)
         len = (size_t) va_arg(argsP->v, size_t);
-    } else
+    else
         len = strlen(str);
 
     *valPP = xmlrpc_string_new_lp(envP, len, str);
@@ -41,7 +40,7 @@ getString(xmlrpc_env *    const envP,
 
 static void
 getWideString(xmlrpc_env *    const envP ATTR_UNUSED,
-              const char **   const formatP ATTR_UNUSED,
+              bool            const hasLength ATTR_UNUSED,
               va_listx *      const argsP ATTR_UNUSED,
               xmlrpc_value ** const valPP ATTR_UNUSED) {
 
@@ -50,10 +49,9 @@ getWideString(xmlrpc_env *    const envP ATTR_UNUSED,
     size_t len;
     
     wcs = (wchar_t*) va_arg(argsP->v, wchar_t*);
-    if (**formatP == '#') {
-        (*formatP)++;
+    if (hasLength)
         len = (size_t) va_arg(argsP->v, size_t);
-    } else
+    else
         len = wcslen(wcs);
 
     *valPP = xmlrpc_string_w_new_lp(envP, len, wcs);
@@ -231,25 +229,17 @@ mkStructFromVal(xmlrpc_env *    const envP,
 
 
 static void
-getValue(xmlrpc_env *    const envP, 
-         const char**    const formatP,
-         va_listx *      const argsP,
-         xmlrpc_value ** const valPP) {
+getSimpleValue(xmlrpc_env *    const envP, 
+               char            const formatChar,
+               bool            const hasLength,
+               va_listx *      const argsP,
+               xmlrpc_value ** const valPP) {
 /*----------------------------------------------------------------------------
-   Get the next value from the list.  *formatP points to the specifier
-   for the next value in the format string (i.e. to the type code
-   character) and we move *formatP past the whole specifier for the
-   next value.  We read the required arguments from 'argsP'.  We return
-   the value as *valPP with a reference to it.
-
-   For example, if *formatP points to the "i" in the string "sis",
-   we read one argument from 'argsP' and return as *valP an integer whose
-   value is the argument we read.  We advance *formatP to point to the
-   last 's' and advance 'argsP' to point to the argument that belongs to
-   that 's'.
+   Get a value that is not an array or struct given by its specifier, which
+   is 'formatChar' followed by a '#' iff 'hasLength'.  We read the required
+   arguments from 'argsP'.  We return the value as *valPP with a reference
+   to it.
 -----------------------------------------------------------------------------*/
-    char const formatChar = *(*formatP)++;
-
     switch (formatChar) {
     case 'i':
         *valPP = 
@@ -268,11 +258,11 @@ getValue(xmlrpc_env *    const envP,
         break;
 
     case 's':
-        getString(envP, formatP, argsP, valPP);
+        getString(envP, hasLength, argsP, valPP);
         break;
 
     case 'w':
-        getWideString(envP, formatP, argsP, valPP);
+        getWideString(envP, hasLength, argsP, valPP);
         break;
 
     case 't':
@@ -317,6 +307,49 @@ getValue(xmlrpc_env *    const envP,
         xmlrpc_INCREF(*valPP);
         break;
 
+    default: {
+        const char * const badCharacter = xmlrpc_makePrintableChar(formatChar);
+        xmlrpc_env_set_fault_formatted(
+            envP, XMLRPC_INTERNAL_ERROR,
+            "Unexpected character '%s' in format string", badCharacter);
+        xmlrpc_strfree(badCharacter);
+        }
+    }
+}
+
+
+
+static bool
+takesLength(char const formatChar) {
+/*----------------------------------------------------------------------------
+   A '#' after specifier 'formatChar' means there is a length argument.
+-----------------------------------------------------------------------------*/
+    return formatChar == 's' || formatChar == 'w';
+}
+
+
+
+static void
+getValue(xmlrpc_env *    const envP, 
+         const char**    const formatP,
+         va_listx *      const argsP,
+         xmlrpc_value ** const valPP) {
+/*----------------------------------------------------------------------------
+   Get the next value from the list.  *formatP points to the specifier
+   for the next value in the format string (i.e. to the type code
+   character) and we move *formatP past the whole specifier for the
+   next value.  We read the required arguments from 'argsP'.  We return
+   the value as *valPP with a reference to it.
+
+   For example, if *formatP points to the "i" in the string "sis",
+   we read one argument from 'argsP' and return as *valP an integer whose
+   value is the argument we read.  We advance *formatP to point to the
+   last 's' and advance 'argsP' to point to the argument that belongs to
+   that 's'.
+-----------------------------------------------------------------------------*/
+    char const formatChar = *(*formatP)++;
+
+    switch (formatChar) {
     case '(':
         getArray(envP, formatP, ')', argsP, valPP);
         if (!envP->fault_occurred) {
@@ -334,12 +367,13 @@ getValue(xmlrpc_env *    const envP,
         break;
 
     default: {
-        const char * const badCharacter = xmlrpc_makePrintableChar(formatChar);
-        xmlrpc_env_set_fault_formatted(
-            envP, XMLRPC_INTERNAL_ERROR,
-            "Unexpected character '%s' in format string", badCharacter);
-        xmlrpc_strfree(badCharacter);
-        }
+        bool const hasLength = takesLength(formatChar) && **formatP == '#';
+
+        if (hasLength)
+            (*formatP)++;
+
+        getSimpleValue(envP, formatChar, hasLength, argsP, valPP);
+    }
     }
 }
 
@@ -403,6 +437,350 @@ xmlrpc_build_value(xmlrpc_env * const envP,
 }
 
 
+
+/*=========================================================================
+  Compiled format strings
+
+  A builder is a format string parsed once into a list of operations, so
+  a program that builds many values the same way, such as a method
+  function building its result, doesn't parse the format string every
+  time.
+=========================================================================*/
+
+struct buildOp {
+    char formatChar;
+        /* The type code, e.g. 'i'.  '(' means array; '{' means struct */
+    bool hasLength;
+        /* The specifier is 's#' or 'w#' */
+    unsigned int count;
+        /* For '(', number of items, whose operations follow this one.
+           For '{', number of members, each of which is two operations --
+           key and value -- following this one.
+        */
+};
+
+struct xmlrpc_builder {
+    unsigned int opCount;
+    struct buildOp * op;
+        /* Array of 'opCount' operations, in format string order */
+};
+
+
+
+static void
+compileNext(xmlrpc_env *     const envP,
+            const char **    const formatP,
+            xmlrpc_builder * const builderP);
+
+
+
+static void
+compileArray(xmlrpc_env *     const envP,
+             const char **    const formatP,
+             xmlrpc_builder * const builderP,
+             struct buildOp * const opP) {
+
+    while (**formatP != ')' && !envP->fault_occurred) {
+        if (**formatP == '\0')
+            xmlrpc_env_set_fault(
+                envP, XMLRPC_INTERNAL_ERROR,
+                "format string ended before closing ')'.");
+        else {
+            compileNext(envP, formatP, builderP);
+            ++opP->count;
+        }
+    }
+    if (!envP->fault_occurred)
+        (*formatP)++;  /* Skip over closing parenthesis */
+}
+
+
+
+static void
+compileStruct(xmlrpc_env *     const envP,
+              const char **    const formatP,
+              xmlrpc_builder * const builderP,
+              struct buildOp * const opP) {
+
+    while (**formatP != '}' && !envP->fault_occurred) {
+        /* The key */
+        compileNext(envP, formatP, builderP);
+        if (!envP->fault_occurred) {
+            if (**formatP != ':')
+                xmlrpc_env_set_fault(
+                    envP, XMLRPC_INTERNAL_ERROR,
+                    "format string does not have ':' after a "
+                    "structure member key.");
+            else {
+                (*formatP)++;
+
+                /* The value */
+                compileNext(envP, formatP, builderP);
+
+                if (!envP->fault_occurred) {
+                    if (**formatP == ',')
+                        (*formatP)++;
+                    else if (**formatP != '}')
+                        xmlrpc_env_set_fault(
+                            envP, XMLRPC_INTERNAL_ERROR,
+                            "format string does not have ',' or ')' after "
+                            "a structure member");
+                    ++opP->count;
+                }
+            }
+        }
+    }
+    if (!envP->fault_occurred)
+        (*formatP)++;  /* Skip over closing brace */
+}
+
+
+
+static void
+compileNext(xmlrpc_env *     const envP,
+            const char **    const formatP,
+            xmlrpc_builder * const builderP) {
+/*----------------------------------------------------------------------------
+   Add to *builderP the operations for the value whose specifier *formatP
+   points to, and advance *formatP past that specifier, like getValue().
+-----------------------------------------------------------------------------*/
+    struct buildOp * const opP = &builderP->op[builderP->opCount++];
+    char const formatChar = *(*formatP)++;
+
+    opP->formatChar = formatChar;
+    opP->hasLength  = false;
+    opP->count      = 0;
+
+    switch (formatChar) {
+    case '(':
+        compileArray(envP, formatP, builderP, opP);
+        break;
+
+    case '{':
+        compileStruct(envP, formatP, builderP, opP);
+        break;
+
+#if !HAVE_UNICODE_WCHAR
+    case 'w':
+        xmlrpc_faultf(envP,
+                      "This XML-RPC For C/C++ library was built without "
+                      "Unicode wide character capability.  "
+                      "'w' isn't available.");
+        break;
+#else
+    case 'w':
+#endif
+    case 's':
+        if (**formatP == '#') {
+            opP->hasLength = true;
+            (*formatP)++;
+        }
+        break;
+
+    case 'i': case 'b': case 'd': case 't': case '8': case '6':
+    case 'n': case 'I': case 'p': case 'A': case 'S': case 'V':
+        break;
+
+    default: {
+        /* This may be the NUL at the end of the format string, so we
+           don't look any further.
+        */
+        const char * const badCharacter = xmlrpc_makePrintableChar(formatChar);
+        xmlrpc_env_set_fault_formatted(
+            envP, XMLRPC_INTERNAL_ERROR,
+            "Unexpected character '%s' in format string", badCharacter);
+        xmlrpc_strfree(badCharacter);
+        }
+    }
+}
+
+
+
+void
+xmlrpc_build_compile(xmlrpc_env *      const envP,
+                     const char *      const format,
+                     xmlrpc_builder ** const builderPP) {
+/*----------------------------------------------------------------------------
+   Compile format string 'format', which must describe exactly one value,
+   for xmlrpc_build_compiled().
+-----------------------------------------------------------------------------*/
+    xmlrpc_builder * builderP;
+
+    XMLRPC_ASSERT_ENV_OK(envP);
+    XMLRPC_ASSERT(format != NULL);
+
+    MALLOCVAR(builderP);
+
+    if (builderP == NULL)
+        xmlrpc_faultf(envP, "Could not allocate space for a builder");
+    else {
+        /* Every operation uses at least one character of the format
+           string, counting the terminating NUL.
+        */
+        MALLOCARRAY(builderP->op, strlen(format) + 1);
+
+        if (builderP->op == NULL)
+            xmlrpc_faultf(envP, "Could not allocate space for %u builder "
+                          "operations", (unsigned)strlen(format) + 1);
+        else {
+            if (strlen(format) == 0)
+                xmlrpc_faultf(envP, "Format string is empty.");
+            else {
+                const char * formatCursor;
+
+                builderP->opCount = 0;
+                formatCursor = &format[0];
+
+                compileNext(envP, &formatCursor, builderP);
+
+                if (!envP->fault_occurred && *formatCursor != '\0')
+                    xmlrpc_faultf(envP, "Junk after the format specifier: "
+                                  "'%s'.  The format string must describe "
+                                  "exactly one XML-RPC value "
+                                  "(but it might be a compound value "
+                                  "such as an array)",
+                                  formatCursor);
+            }
+            if (envP->fault_occurred)
+                free(builderP->op);
+        }
+        if (envP->fault_occurred)
+            free(builderP);
+        else
+            *builderPP = builderP;
+    }
+}
+
+
+
+void
+xmlrpc_builder_destroy(xmlrpc_builder * const builderP) {
+
+    XMLRPC_ASSERT(builderP != NULL);
+
+    free(builderP->op);
+
+    free(builderP);
+}
+
+
+
+static void
+buildNext(xmlrpc_env *           const envP,
+          const xmlrpc_builder * const builderP,
+          unsigned int *         const opIndexP,
+          va_listx *             const argsP,
+          xmlrpc_value **        const valPP) {
+/*----------------------------------------------------------------------------
+   Build the value whose operations start with number *opIndexP in
+   *builderP, and advance *opIndexP past them.
+-----------------------------------------------------------------------------*/
+    const struct buildOp * const opP = &builderP->op[(*opIndexP)++];
+
+    switch (opP->formatChar) {
+    case '(': {
+        xmlrpc_value * const arrayP = xmlrpc_array_new(envP);
+
+        unsigned int i;
+
+        for (i = 0; i < opP->count && !envP->fault_occurred; ++i) {
+            xmlrpc_value * itemP;
+
+            buildNext(envP, builderP, opIndexP, argsP, &itemP);
+
+            if (!envP->fault_occurred) {
+                xmlrpc_array_append_item(envP, arrayP, itemP);
+                xmlrpc_DECREF(itemP);
+            }
+        }
+        if (envP->fault_occurred && arrayP)
+            xmlrpc_DECREF(arrayP);
+
+        *valPP = arrayP;
+    } break;
+
+    case '{': {
+        xmlrpc_value * const structP = xmlrpc_struct_new(envP);
+
+        unsigned int i;
+
+        for (i = 0; i < opP->count && !envP->fault_occurred; ++i) {
+            xmlrpc_value * keyP;
+
+            buildNext(envP, builderP, opIndexP, argsP, &keyP);
+
+            if (!envP->fault_occurred) {
+                xmlrpc_value * valueP;
+
+                buildNext(envP, builderP, opIndexP, argsP, &valueP);
+
+                if (!envP->fault_occurred) {
+                    xmlrpc_struct_set_value_v(envP, structP, keyP, valueP);
+
+                    xmlrpc_DECREF(valueP);
+                }
+                xmlrpc_DECREF(keyP);
+            }
+        }
+        if (envP->fault_occurred && structP)
+            xmlrpc_DECREF(structP);
+
+        *valPP = structP;
+    } break;
+
+    default:
+        getSimpleValue(envP, opP->formatChar, opP->hasLength, argsP, valPP);
+    }
+}
+
+
+
+void
+xmlrpc_build_compiled_va(xmlrpc_env *           const envP,
+                         const xmlrpc_builder * const builderP,
+                         va_list                const args,
+                         xmlrpc_value **        const valPP) {
+/*----------------------------------------------------------------------------
+   Same as xmlrpc_build_value_va(), but with the format string compiled by
+   xmlrpc_build_compile().
+
+   Any number of threads may use the same builder at once.
+-----------------------------------------------------------------------------*/
+    va_listx argsx;
+    unsigned int opIndex;
+
+    XMLRPC_ASSERT_ENV_OK(envP);
+    XMLRPC_ASSERT(builderP != NULL);
+
+    init_va_listx(&argsx, args);
+
+    opIndex = 0;
+
+    buildNext(envP, builderP, &opIndex, &argsx, valPP);
+
+    if (!envP->fault_occurred) {
+        XMLRPC_ASSERT(opIndex == builderP->opCount);
+        XMLRPC_ASSERT_VALUE_OK(*valPP);
+    }
+}
+
+
+
+xmlrpc_value *
+xmlrpc_build_compiled(xmlrpc_env *           const envP,
+                      const xmlrpc_builder * const builderP,
+                      ...) {
+
+    va_list args;
+    xmlrpc_value * retval;
+
+    va_start(args, builderP);
+    xmlrpc_build_compiled_va(envP, builderP, args, &retval);
+    va_end(args);
+
+    return retval;
+}
+
 /* Copyright (C) 2001 by First Peer, Inc. All rights reserved.
 ** Copyright (C) 2001 by Eric Kidd. All rights reserved.
 **
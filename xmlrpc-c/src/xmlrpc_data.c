@@ -98,6 +98,8 @@ destroyValue(xmlrpc_value * const valueP) {
         XMLRPC_ASSERT(false); /* There are no other possible values */
     }
 
+    xmlrpc_destroySerialCache(valueP);
+
     valueP->lockP->destroy(valueP->lockP);
 
     /* Next, we mark this value as invalid, to help catch refcount errors.
@@ -375,8 +377,11 @@ xmlrpc_createXmlrpcValue(xmlrpc_env *    const envP,
         if (!valP->lockP)
             xmlrpc_faultf(envP, "Could not allocate memory for lock for "
                           "xmlrpc_value");
-        else
-            valP->refcount = 1;
+        else {
+            valP->refcount      = 1;
+            valP->_serialCacheP = NULL;
+            valP->_frozen       = false;
+        }
     }
     *valPP = valP;
 }
@@ -31,14 +31,13 @@
       in which Caller wants it stored.
 
    The decomposition tree is composed of information from the format
-   string and the variable arguments that the format string describes.
-   Nothing in the tree is derived from the actual XML-RPC value being
-   decomposed, and the tree may in fact be invalid for the particular
-   XML-RPC value it's meant for.
+   string alone.  Nothing in the tree is derived from the actual XML-RPC
+   value being decomposed, and the tree may in fact be invalid for the
+   particular XML-RPC value it's meant for.
 
    If the XML-RPC value is a simple value such as an integer, the
    decomposition tree is trivial -- it's a single node that says
-   "store the value of an integer via pointer P".
+   "store the value of an integer via argument N".
 
    Where it gets interesting is where the XML-RPC value to be decomposed
    is a complex value (array or struct).  Then, the root node of the tree
@@ -50,66 +49,17 @@
 
    Roots, interior nodes, and leaves are all essentially the same data
    type.
-*/
-
-struct integerDecomp {
-    xmlrpc_int32 * valueP;
-};
-
-struct boolDecomp {
-    xmlrpc_bool * valueP;
-};
-
-struct doubleDecomp {
-    double * valueP;
-};
-
-struct datetimeTDecomp {
-    time_t * valueP;
-};
-
-struct datetime8Decomp {
-    const char ** valueP;
-};
-
-struct stringDecomp {
-    const char ** valueP;
-    size_t * sizeP;
-        /* NULL means don't store a size */
-};
 
-struct wideStringDecomp {
-#if HAVE_UNICODE_WCHAR
-    const wchar_t ** valueP;
-#endif
-    size_t * sizeP;
-        /* NULL means don't store a size */
-};
-
-struct bitStringDecomp {
-    const unsigned char ** valueP;
-    size_t * sizeP;
-};
-
-struct cptrDecomp {
-    void ** valueP;
-};
-
-struct i8Decomp {
-    xmlrpc_int64 * valueP;
-};
-
-struct valueDecomp {
-    xmlrpc_value ** valueP;
-};
-
-struct arrayValDecomp {
-    xmlrpc_value ** valueP;
-};
+   THE ARGUMENT VECTOR
 
-struct structValDecomp {
-    xmlrpc_value ** valueP;
-};
+   The variable arguments that the format string describes -- pointers to
+   where to store things, and struct member keys -- are not in the tree.
+   To decompose a value, we first collect them, in format string order,
+   into an argument vector, and a tree node refers to its arguments by
+   their index in that vector.  That way, a tree is good for any number of
+   decompositions with the same format string, which is what an
+   xmlrpc_decomposer is: a format string compiled once into a tree.
+*/
 
 struct arrayDecomp {
     unsigned int itemCnt;
@@ -123,8 +73,10 @@ struct arrayDecomp {
 };
 
 struct mbrDecomp {
-    const char * key;
-        /* The key for the member whose value client wants to extract */
+    unsigned int keyArgIndex;
+        /* Index in the argument vector of the key for the member whose
+           value client wants to extract
+        */
     struct decompTreeNode * decompTreeP;
         /* Instructions on how to decompose (extract) member's value */
 };
@@ -138,23 +90,19 @@ struct structDecomp {
 struct decompTreeNode {
     char formatSpecChar;
         /* e.g. 'i', 'b', '8', 'A'.  '(' means array; '{' means struct */
+    unsigned int argIndex;
+        /* Index in the argument vector of the pointer to where to store
+           the value.  For '6', and for 's' and 'w' with 'hasSize', the
+           next argument is the pointer to where to store its size.
+           Meaningless for a format specifier that stores nothing, e.g.
+           '(' or 'n'.
+        */
+    bool hasSize;
+        /* The specifier is 's#' or 'w#' */
     union {
     /*------------------------------------------------------------------------
       'formatSpecChar' selects among these members.
     -------------------------------------------------------------------------*/
-        struct integerDecomp    Tinteger;
-        struct boolDecomp       Tbool;
-        struct doubleDecomp     Tdouble;
-        struct datetimeTDecomp  TdatetimeT;
-        struct datetime8Decomp  Tdatetime8;
-        struct stringDecomp     Tstring;
-        struct wideStringDecomp TwideString;
-        struct bitStringDecomp  TbitString;
-        struct cptrDecomp       Tcptr;
-        struct i8Decomp         Ti8;
-        struct valueDecomp      Tvalue;
-        struct arrayValDecomp   TarrayVal;
-        struct structValDecomp  TstructVal;
         struct arrayDecomp      Tarray;
         struct structDecomp     Tstruct;
     } store;
@@ -163,43 +111,61 @@ struct decompTreeNode {
 
 
 
+struct xmlrpc_decomposer {
+/*----------------------------------------------------------------------------
+   A compiled format string (see THE ARGUMENT VECTOR)
+-----------------------------------------------------------------------------*/
+    struct decompTreeNode * decompRootP;
+    unsigned int argCount;
+        /* Number of arguments the format string describes */
+};
+
+
+
 /* prototype for recursive calls */
 static void
-releaseDecomposition(const struct decompTreeNode * const decompRootP);
+releaseDecomposition(const struct decompTreeNode * const decompRootP,
+                     void *                const * const argv);
 
 
 static void
-releaseDecompArray(struct arrayDecomp const arrayDecomp) {
+releaseDecompArray(struct arrayDecomp const arrayDecomp,
+                   void *     const * const argv) {
 
     unsigned int i;
     for (i = 0; i < arrayDecomp.itemCnt; ++i) {
-        releaseDecomposition(arrayDecomp.itemArray[i]);
+        releaseDecomposition(arrayDecomp.itemArray[i], argv);
     }
 }
 
 
 
 static void
-releaseDecompStruct(struct structDecomp const structDecomp) {
+releaseDecompStruct(struct structDecomp const structDecomp,
+                    void *      const * const argv) {
 
     unsigned int i;
     for (i = 0; i < structDecomp.mbrCnt; ++i) {
-        releaseDecomposition(structDecomp.mbrArray[i].decompTreeP);
+        releaseDecomposition(structDecomp.mbrArray[i].decompTreeP, argv);
     }
 }
 
 
 
 static void
-releaseDecomposition(const struct decompTreeNode * const decompRootP) {
+releaseDecomposition(const struct decompTreeNode * const decompRootP,
+                     void *                const * const argv) {
 /*----------------------------------------------------------------------------
-   Assuming that Caller has decomposed something according to 'decompRootP',
-   release whatever resources the decomposed information occupies.
+   Assuming that Caller has decomposed something according to 'decompRootP'
+   and argument vector argv[], release whatever resources the decomposed
+   information occupies.
 
    E.g. if it's  an XML-RPC string, Caller would have allocated memory
    for the C string that represents the decomposed value of XML-RPC string,
    and we release that memory.
 -----------------------------------------------------------------------------*/
+    unsigned int const argIndex = decompRootP->argIndex;
+
     switch (decompRootP->formatSpecChar) {
     case 'i':
     case 'b':
@@ -211,31 +177,27 @@ releaseDecomposition(const struct decompTreeNode * const decompRootP) {
         /* Nothing was allocated; nothing to release */
         break;
     case '8':
-        xmlrpc_strfree(*decompRootP->store.Tdatetime8.valueP);
-        break;
     case 's':
-        xmlrpc_strfree(*decompRootP->store.Tstring.valueP);
+        xmlrpc_strfree(*(const char **)argv[argIndex]);
         break;
     case 'w':
-        free((void*)*decompRootP->store.TwideString.valueP);
+#if HAVE_UNICODE_WCHAR
+        free((void*)*(const wchar_t **)argv[argIndex]);
+#endif
         break;
     case '6':
-        free((void*)*decompRootP->store.TbitString.valueP);
+        free((void*)*(const unsigned char **)argv[argIndex]);
         break;
     case 'V':
-        xmlrpc_DECREF(*decompRootP->store.Tvalue.valueP);
-        break;
     case 'A':
-        xmlrpc_DECREF(*decompRootP->store.TarrayVal.valueP);
-        break;
     case 'S':
-        xmlrpc_DECREF(*decompRootP->store.TstructVal.valueP);
+        xmlrpc_DECREF(*(xmlrpc_value **)argv[argIndex]);
         break;
     case '(':
-        releaseDecompArray(decompRootP->store.Tarray);
+        releaseDecompArray(decompRootP->store.Tarray, argv);
         break;
     case '{':
-        releaseDecompStruct(decompRootP->store.Tstruct);
+        releaseDecompStruct(decompRootP->store.Tstruct, argv);
         break;
     }
 }
@@ -248,7 +210,8 @@ static void
 decomposeValueWithTree(xmlrpc_env *                  const envP,
                        xmlrpc_value *                const valueP,
                        bool                          const oldstyleMemMgmt,
-                       const struct decompTreeNode * const decompRootP);
+                       const struct decompTreeNode * const decompRootP,
+                       void *                const * const argv);
 
 
 
@@ -281,7 +244,8 @@ static void
 parsearray(xmlrpc_env *         const envP,
            const xmlrpc_value * const arrayP,
            struct arrayDecomp   const arrayDecomp,
-           bool                 const oldstyleMemMgmt) {
+           bool                 const oldstyleMemMgmt,
+           void *       const * const argv) {
 
     validateArraySize(envP, arrayP, arrayDecomp);
 
@@ -297,7 +261,7 @@ parsearray(xmlrpc_env *         const envP,
             if (!envP->fault_occurred) {
                 XMLRPC_ASSERT(doneCnt < ARRAY_SIZE(arrayDecomp.itemArray));
                 decomposeValueWithTree(envP, itemP, oldstyleMemMgmt,
-                                       arrayDecomp.itemArray[doneCnt]);
+                                       arrayDecomp.itemArray[doneCnt], argv);
                 
                 if (!envP->fault_occurred)
                     ++doneCnt;
@@ -310,7 +274,7 @@ parsearray(xmlrpc_env *         const envP,
                 /* Release the items we completed before we failed. */
                 unsigned int i;
                 for (i = 0; i < doneCnt; ++i)
-                    releaseDecomposition(arrayDecomp.itemArray[i]);
+                    releaseDecomposition(arrayDecomp.itemArray[i], argv);
             }
         }
     }
@@ -322,14 +286,16 @@ static void
 parsestruct(xmlrpc_env *        const envP,
             xmlrpc_value *      const structP,
             struct structDecomp const structDecomp,
-            bool                const oldstyleMemMgmt) {
+            bool                const oldstyleMemMgmt,
+            void *      const * const argv) {
 
     unsigned int doneCount;
     
     doneCount = 0;  /* No members done yet */
 
     while (doneCount < structDecomp.mbrCnt && !envP->fault_occurred) {
-        const char * const key = structDecomp.mbrArray[doneCount].key;
+        const char * const key =
+            argv[structDecomp.mbrArray[doneCount].keyArgIndex];
 
         xmlrpc_value * valueP;
 
@@ -338,7 +304,7 @@ parsestruct(xmlrpc_env *        const envP,
         if (!envP->fault_occurred) {
             decomposeValueWithTree(
                 envP, valueP, oldstyleMemMgmt,
-                structDecomp.mbrArray[doneCount].decompTreeP);
+                structDecomp.mbrArray[doneCount].decompTreeP, argv);
 
             if (!envP->fault_occurred)
                 ++doneCount;
@@ -352,7 +318,8 @@ parsestruct(xmlrpc_env *        const envP,
             /* Release the items we completed before we failed. */
             unsigned int i;
             for (i = 0; i < doneCount; ++i)
-                releaseDecomposition(structDecomp.mbrArray[i].decompTreeP);
+                releaseDecomposition(structDecomp.mbrArray[i].decompTreeP,
+                                     argv);
         }
     }
 }
@@ -450,70 +417,64 @@ static void
 decomposeValueWithTree(xmlrpc_env *                  const envP,
                        xmlrpc_value *                const valueP,
                        bool                          const oldstyleMemMgmt,
-                       const struct decompTreeNode * const decompRootP) {
+                       const struct decompTreeNode * const decompRootP,
+                       void *                const * const argv) {
 /*----------------------------------------------------------------------------
    Decompose XML-RPC value *valueP, given the decomposition tree
-   *decompRootP.  The decomposition tree tells what structure *valueP
-   is expected to have and where to put the various components of it
-   (e.g. it says "it's an array of 3 integers.  Put their values at
-   locations x, y, and z")
+   *decompRootP and argument vector argv[].  The decomposition tree tells
+   what structure *valueP is expected to have and which arguments say
+   where to put the various components of it (e.g. it says "it's an array
+   of 3 integers.  Put their values at the locations arguments 0, 1, and 2
+   point to")
 -----------------------------------------------------------------------------*/
+    unsigned int const argIndex = decompRootP->argIndex;
+
     switch (decompRootP->formatSpecChar) {
     case '-':
         /* There's nothing to validate or return */
         break;
     case 'i':
-        xmlrpc_read_int(envP, valueP, decompRootP->store.Tinteger.valueP);
+        xmlrpc_read_int(envP, valueP, argv[argIndex]);
         break;
 
     case 'b':
-        xmlrpc_read_bool(envP, valueP, decompRootP->store.Tbool.valueP);
+        xmlrpc_read_bool(envP, valueP, argv[argIndex]);
         break;
 
     case 'd':
-        xmlrpc_read_double(envP, valueP, decompRootP->store.Tdouble.valueP);
+        xmlrpc_read_double(envP, valueP, argv[argIndex]);
         break;
 
     case 't':
-        xmlrpc_read_datetime_sec(envP, valueP,
-                                 decompRootP->store.TdatetimeT.valueP);
+        xmlrpc_read_datetime_sec(envP, valueP, argv[argIndex]);
         break;
 
     case '8':
-        readDatetime8Str(envP, valueP, decompRootP->store.Tdatetime8.valueP,
-                         oldstyleMemMgmt);
+        readDatetime8Str(envP, valueP, argv[argIndex], oldstyleMemMgmt);
         break;
 
     case 's':
-        if (decompRootP->store.Tstring.sizeP)
-            readStringLp(envP, valueP,
-                         decompRootP->store.Tstring.sizeP,
-                         decompRootP->store.Tstring.valueP,
-                         oldstyleMemMgmt);
+        if (decompRootP->hasSize)
+            readStringLp(envP, valueP, argv[argIndex + 1],
+                         argv[argIndex], oldstyleMemMgmt);
         else
-            readString(envP, valueP, decompRootP->store.Tstring.valueP,
-                       oldstyleMemMgmt);
+            readString(envP, valueP, argv[argIndex], oldstyleMemMgmt);
         break;
 
     case 'w':
 #if HAVE_UNICODE_WCHAR
-        if (decompRootP->store.Tstring.sizeP)
-            readStringWLp(envP, valueP,
-                          decompRootP->store.TwideString.sizeP,
-                          decompRootP->store.TwideString.valueP,
-                          oldstyleMemMgmt);
+        if (decompRootP->hasSize)
+            readStringWLp(envP, valueP, argv[argIndex + 1],
+                          argv[argIndex], oldstyleMemMgmt);
         else
-            readStringW(envP, valueP, decompRootP->store.TwideString.valueP,
-                        oldstyleMemMgmt);
+            readStringW(envP, valueP, argv[argIndex], oldstyleMemMgmt);
 #else
         XMLRPC_ASSERT(false);
 #endif /* HAVE_UNICODE_WCHAR */
         break;
         
     case '6':
-        readBase64(envP, valueP,
-                   decompRootP->store.TbitString.sizeP,
-                   decompRootP->store.TbitString.valueP,
+        readBase64(envP, valueP, argv[argIndex + 1], argv[argIndex],
                    oldstyleMemMgmt);
         break;
 
@@ -522,15 +483,15 @@ decomposeValueWithTree(xmlrpc_env *                  const envP,
         break;
 
     case 'I':
-        xmlrpc_read_i8(envP, valueP, decompRootP->store.Ti8.valueP);
+        xmlrpc_read_i8(envP, valueP, argv[argIndex]);
         break;
 
     case 'p':
-        xmlrpc_read_cptr(envP, valueP, decompRootP->store.Tcptr.valueP);
+        xmlrpc_read_cptr(envP, valueP, argv[argIndex]);
         break;
 
     case 'V':
-        *decompRootP->store.Tvalue.valueP = valueP;
+        *(xmlrpc_value **)argv[argIndex] = valueP;
         if (!oldstyleMemMgmt)
             xmlrpc_INCREF(valueP);
         break;
@@ -542,7 +503,7 @@ decomposeValueWithTree(xmlrpc_env *                  const envP,
                 "%s, but the 'A' specifier requires type ARRAY",
                 xmlrpc_type_name(xmlrpc_value_type(valueP)));
         else {
-            *decompRootP->store.TarrayVal.valueP = valueP;
+            *(xmlrpc_value **)argv[argIndex] = valueP;
             if (!oldstyleMemMgmt)
                 xmlrpc_INCREF(valueP);
         }
@@ -555,7 +516,7 @@ decomposeValueWithTree(xmlrpc_env *                  const envP,
                 "%s, but the 'S' specifier requires type STRUCT.",
                 xmlrpc_type_name(xmlrpc_value_type(valueP)));
         else {
-            *decompRootP->store.TstructVal.valueP = valueP;
+            *(xmlrpc_value **)argv[argIndex] = valueP;
             if (!oldstyleMemMgmt)
                 xmlrpc_INCREF(valueP);
         }
@@ -569,7 +530,7 @@ decomposeValueWithTree(xmlrpc_env *                  const envP,
                 xmlrpc_type_name(xmlrpc_value_type(valueP)));
         else
             parsearray(envP, valueP, decompRootP->store.Tarray,
-                       oldstyleMemMgmt);
+                       oldstyleMemMgmt, argv);
         break;
 
     case '{':
@@ -580,7 +541,7 @@ decomposeValueWithTree(xmlrpc_env *                  const envP,
                 xmlrpc_type_name(xmlrpc_value_type(valueP)));
         else
             parsestruct(envP, valueP, decompRootP->store.Tstruct,
-                        oldstyleMemMgmt);
+                        oldstyleMemMgmt, argv);
         break;
 
     default:
@@ -597,26 +558,39 @@ decomposeValueWithTree(xmlrpc_env *                  const envP,
 static void 
 createDecompTreeNext(xmlrpc_env *             const envP,
                      const char **            const formatP,
-                     va_listx *               const argsP,
+                     unsigned int *           const argCountP,
                      struct decompTreeNode ** const decompNodePP);
 
 
 
+static void
+buildStringNode(const char **           const formatP,
+                unsigned int *          const argCountP,
+                struct decompTreeNode * const decompNodeP) {
+/*----------------------------------------------------------------------------
+   Fill in *decompNodeP for an 's' or 'w' specifier, which may have a '#'
+   after it, which *formatP points to.
+-----------------------------------------------------------------------------*/
+    *argCountP += 1;
+
+    if (**formatP == '#') {
+        decompNodeP->hasSize = true;
+        *argCountP += 1;
+        ++*formatP;
+    } else
+        decompNodeP->hasSize = false;
+}
+
+
+
 static void
 buildWideStringNode(xmlrpc_env *            const envP ATTR_UNUSED,
                     const char **           const formatP,
-                    va_listx *              const argsP,
+                    unsigned int *          const argCountP,
                     struct decompTreeNode * const decompNodeP) {
 
 #if HAVE_UNICODE_WCHAR
-    decompNodeP->store.TwideString.valueP =
-        (const wchar_t**) va_arg(argsP->v, wchar_t**);
-    if (**formatP == '#') {
-        decompNodeP->store.TwideString.sizeP =
-            (size_t*) va_arg(argsP->v, size_t**);
-        (*formatP)++;
-    } else
-        decompNodeP->store.TwideString.sizeP = NULL;
+    buildStringNode(formatP, argCountP, decompNodeP);
 #else
     xmlrpc_faultf(envP,
                   "This XML-RPC For C/C++ library was built without Unicode "
@@ -681,7 +655,7 @@ static void
 buildArrayDecompBranch(xmlrpc_env *            const envP,
                        const char **           const formatP,
                        char                    const delim,
-                       va_listx *              const argsP,
+                       unsigned int *          const argCountP,
                        struct decompTreeNode * const decompNodeP) {
 /*----------------------------------------------------------------------------
    Fill in the decomposition tree node *decompNodeP to cover an array
@@ -695,10 +669,10 @@ buildArrayDecompBranch(xmlrpc_env *            const envP,
    We create a node (and whole branch if required) to describe each array
    item.
 
-   The pointers to where those items are to be stored are given by
-   'argsP'.
+   The pointers to where those items are to be stored are the arguments
+   starting with number *argCountP.
 
-   We advance *formatP to the delimiter character, and advance 'argsP'
+   We advance *formatP to the delimiter character, and advance *argCountP
    past whatever arguments we use.
 -----------------------------------------------------------------------------*/
     unsigned int itemCnt;
@@ -716,7 +690,7 @@ buildArrayDecompBranch(xmlrpc_env *            const envP,
         else {
             struct decompTreeNode * itemNodeP;
             
-            createDecompTreeNext(envP, formatP, argsP, &itemNodeP);
+            createDecompTreeNext(envP, formatP, argCountP, &itemNodeP);
                 
             if (!envP->fault_occurred)
                 decompNodeP->store.Tarray.itemArray[itemCnt++] = itemNodeP;
@@ -740,14 +714,14 @@ buildArrayDecompBranch(xmlrpc_env *            const envP,
 static void
 doStructValue(xmlrpc_env *       const envP,
               const char **      const formatP,
-              va_listx *         const argsP,
+              unsigned int *     const argCountP,
               struct mbrDecomp * const mbrP) {
 
     struct decompTreeNode * valueNodeP;
 
-    mbrP->key = (const char*) va_arg(argsP->v, char*);
+    mbrP->keyArgIndex = (*argCountP)++;
         
-    createDecompTreeNext(envP, formatP, argsP,  &valueNodeP);
+    createDecompTreeNext(envP, formatP, argCountP, &valueNodeP);
         
     if (!envP->fault_occurred)
         mbrP->decompTreeP = valueNodeP;
@@ -819,7 +793,7 @@ static void
 buildStructDecompBranch(xmlrpc_env *            const envP,
                         const char **           const formatP,
                         char                    const delim,
-                        va_listx *              const argsP,
+                        unsigned int *          const argCountP,
                         struct decompTreeNode * const decompNodeP) {
 /*----------------------------------------------------------------------------
    Fill in the decomposition tree node *decompNodeP to cover a struct
@@ -830,12 +804,12 @@ buildStructDecompBranch(xmlrpc_env *            const envP,
    We create a node (and whole branch if required) to describe each
    struct member value.
 
-   The pointers to where those values are to be stored are given by
-   'argsP'.
+   The pointers to where those values are to be stored are the arguments
+   starting with number *argCountP.
 
-   The names of the members to be extracted are also given by 'argsP'.
+   The names of the members to be extracted are also arguments.
 
-   We advance *formatP to the delimiter character, and advance 'argsP'
+   We advance *formatP to the delimiter character, and advance *argCountP
    past whatever arguments we use.
 -----------------------------------------------------------------------------*/
     unsigned int memberCnt;
@@ -867,7 +841,7 @@ buildStructDecompBranch(xmlrpc_env *            const envP,
                 if (!envP->fault_occurred) {
                     ++*formatP;
 
-                    doStructValue(envP, formatP, argsP, mbrP);
+                    doStructValue(envP, formatP, argCountP, mbrP);
                     
                     if (!envP->fault_occurred)
                         ++memberCnt;
@@ -898,7 +872,7 @@ buildStructDecompBranch(xmlrpc_env *            const envP,
 static void 
 createDecompTreeNext(xmlrpc_env *             const envP,
                      const char **            const formatP,
-                     va_listx *               const argsP,
+                     unsigned int *           const argCountP,
                      struct decompTreeNode ** const decompNodePP) {
 /*----------------------------------------------------------------------------
    Create a branch of a decomposition tree that applies to the first
@@ -916,9 +890,9 @@ createDecompTreeNext(xmlrpc_env *             const envP,
        each of the 3 array items:  one for an integer, one for a string,
        and one for a boolean.
 
-   The locations at which the components of that value are to be
-   stored (which is the main contents of the branch we create) are
-   given by 'argsP'.
+   The arguments that go with that value (which say where to store its
+   components) start with argument number *argCountP.  We advance
+   *argCountP past them.
 
    Return as *decompNodeP a pointer to the root node of the branch we
    generate.
@@ -932,94 +906,50 @@ createDecompTreeNext(xmlrpc_env *             const envP,
                       "tree node");
     else {
         decompNodeP->formatSpecChar = *(*formatP)++;
+        decompNodeP->argIndex       = *argCountP;
+        decompNodeP->hasSize        = false;
         
         switch (decompNodeP->formatSpecChar) {
         case '-':
+        case 'n':
             /* There's nothing to store */
             break;
         case 'i':
-            decompNodeP->store.Tinteger.valueP =
-                (xmlrpc_int32*) va_arg(argsP->v, xmlrpc_int32*);
-            break;
-            
         case 'b':
-            decompNodeP->store.Tbool.valueP =
-                (xmlrpc_bool*) va_arg(argsP->v, xmlrpc_bool*);
-            break;
-            
         case 'd':
-            decompNodeP->store.Tdouble.valueP =
-                (double*) va_arg(argsP->v, double*);
-            break;
-            
         case 't':
-            decompNodeP->store.TdatetimeT.valueP =
-                va_arg(argsP->v, time_t*);
-            break;
-
         case '8':
-            decompNodeP->store.Tdatetime8.valueP =
-                (const char**) va_arg(argsP->v, char**);
+        case 'I':
+        case 'p':
+        case 'V':
+        case 'A':
+        case 'S':
+            /* One argument: where to store the value */
+            *argCountP += 1;
             break;
 
         case 's':
-            decompNodeP->store.Tstring.valueP = 
-                (const char**) va_arg(argsP->v, char**);
-            if (**formatP == '#') {
-                decompNodeP->store.Tstring.sizeP = 
-                    (size_t*) va_arg(argsP->v, size_t**);
-                ++*formatP;
-            } else
-                decompNodeP->store.Tstring.sizeP = NULL;
+            buildStringNode(formatP, argCountP, decompNodeP);
             break;
 
         case 'w':
-            buildWideStringNode(envP, formatP, argsP, decompNodeP);
+            buildWideStringNode(envP, formatP, argCountP, decompNodeP);
             break;
         
         case '6':
-            decompNodeP->store.TbitString.valueP =
-                (const unsigned char**) va_arg(argsP->v, unsigned char**);
-            decompNodeP->store.TbitString.sizeP =
-                (size_t*) va_arg(argsP->v, size_t**);        
-            break;
-
-        case 'n':
-            /* There's no value to store */
-            break;
-
-        case 'I':
-            decompNodeP->store.Ti8.valueP =
-                (xmlrpc_int64 *) va_arg(argsP->v, xmlrpc_int64 *);
-            break;
-            
-        case 'p':
-            decompNodeP->store.Tcptr.valueP =
-                (void**) va_arg(argsP->v, void**);
-            break;
-
-        case 'V':
-            decompNodeP->store.Tvalue.valueP =
-                (xmlrpc_value**) va_arg(argsP->v, xmlrpc_value**);
-            break;
-
-        case 'A':
-            decompNodeP->store.TarrayVal.valueP =
-                (xmlrpc_value**) va_arg(argsP->v, xmlrpc_value**);
-            break;
-
-        case 'S':
-            decompNodeP->store.TstructVal.valueP =
-                (xmlrpc_value**) va_arg(argsP->v, xmlrpc_value**);
+            /* Where to store the value and where to store its size */
+            *argCountP += 2;
             break;
 
         case '(':
-            buildArrayDecompBranch(envP, formatP, ')', argsP, decompNodeP);
+            buildArrayDecompBranch(envP, formatP, ')', argCountP,
+                                   decompNodeP);
             ++(*formatP);  /* skip past closing ')' */
             break;
 
         case '{':
-            buildStructDecompBranch(envP, formatP, '}', argsP, decompNodeP);
+            buildStructDecompBranch(envP, formatP, '}', argCountP,
+                                    decompNodeP);
             ++(*formatP);  /* skip past closing '}' */
             break;
 
@@ -1039,16 +969,20 @@ createDecompTreeNext(xmlrpc_env *             const envP,
 static void
 createDecompTree(xmlrpc_env *             const envP,
                  const char *             const format,
-                 va_listx                 const args,
-                 struct decompTreeNode ** const decompRootPP) {
-
+                 struct decompTreeNode ** const decompRootPP,
+                 unsigned int *           const argCountP) {
+/*----------------------------------------------------------------------------
+   Create a decomposition tree for format string 'format'.  Return as
+   *argCountP the number of arguments the format string describes, which
+   is the size of the argument vector for the tree.
+-----------------------------------------------------------------------------*/
     const char * formatCursor;
     struct decompTreeNode * decompRootP;
-    va_listx currentArgs;
+    unsigned int argCount;
 
-    currentArgs = args;
+    argCount = 0;
     formatCursor = &format[0];
-    createDecompTreeNext(envP, &formatCursor, &currentArgs, &decompRootP);
+    createDecompTreeNext(envP, &formatCursor, &argCount, &decompRootP);
     if (!envP->fault_occurred) {
         if (*formatCursor != '\0')
             xmlrpc_faultf(envP, "format string '%s' has garbage at the end: "
@@ -1058,8 +992,135 @@ createDecompTree(xmlrpc_env *             const envP,
 
         if (envP->fault_occurred)
             destroyDecompTree(decompRootP);
+        else {
+            *decompRootPP = decompRootP;
+            *argCountP    = argCount;
+        }
+    }
+}
+
+
+
+static void
+collectArgs(const struct decompTreeNode * const decompNodeP,
+            va_listx *                    const argsP,
+            void **                       const argv) {
+/*----------------------------------------------------------------------------
+   Take the arguments for the branch 'decompNodeP' of a decomposition tree
+   from 'argsP' and put them in argument vector argv[].
+
+   We take them in the order the format string describes them, which is
+   the order in which we numbered them when we created the tree.
+-----------------------------------------------------------------------------*/
+    unsigned int const argIndex = decompNodeP->argIndex;
+
+    switch (decompNodeP->formatSpecChar) {
+    case '-':
+    case 'n':
+        break;
+    case 'i':
+        argv[argIndex] = va_arg(argsP->v, xmlrpc_int32*);
+        break;
+    case 'b':
+        argv[argIndex] = va_arg(argsP->v, xmlrpc_bool*);
+        break;
+    case 'd':
+        argv[argIndex] = va_arg(argsP->v, double*);
+        break;
+    case 't':
+        argv[argIndex] = va_arg(argsP->v, time_t*);
+        break;
+    case '8':
+        argv[argIndex] = va_arg(argsP->v, char**);
+        break;
+    case 's':
+        argv[argIndex] = va_arg(argsP->v, char**);
+        if (decompNodeP->hasSize)
+            argv[argIndex + 1] = va_arg(argsP->v, size_t*);
+        break;
+    case 'w':
+#if HAVE_UNICODE_WCHAR
+        argv[argIndex] = va_arg(argsP->v, wchar_t**);
+        if (decompNodeP->hasSize)
+            argv[argIndex + 1] = va_arg(argsP->v, size_t*);
+#endif
+        break;
+    case '6':
+        argv[argIndex]     = va_arg(argsP->v, unsigned char**);
+        argv[argIndex + 1] = va_arg(argsP->v, size_t*);
+        break;
+    case 'I':
+        argv[argIndex] = va_arg(argsP->v, xmlrpc_int64*);
+        break;
+    case 'p':
+        argv[argIndex] = va_arg(argsP->v, void**);
+        break;
+    case 'V':
+    case 'A':
+    case 'S':
+        argv[argIndex] = va_arg(argsP->v, xmlrpc_value**);
+        break;
+    case '(': {
+        const struct arrayDecomp * const arrayP = &decompNodeP->store.Tarray;
+        unsigned int i;
+        for (i = 0; i < arrayP->itemCnt; ++i)
+            collectArgs(arrayP->itemArray[i], argsP, argv);
+    } break;
+    case '{': {
+        const struct structDecomp * const structP =
+            &decompNodeP->store.Tstruct;
+        unsigned int i;
+        for (i = 0; i < structP->mbrCnt; ++i) {
+            argv[structP->mbrArray[i].keyArgIndex] =
+                va_arg(argsP->v, char*);
+            collectArgs(structP->mbrArray[i].decompTreeP, argsP, argv);
+        }
+    } break;
+    default:
+        XMLRPC_ASSERT(false);
+    }
+}
+
+
+
+static void
+decomposeWithTree(xmlrpc_env *                  const envP,
+                  xmlrpc_value *                const valueP,
+                  bool                          const oldstyleMemMgmt,
+                  const struct decompTreeNode * const decompRootP,
+                  unsigned int                  const argCount,
+                  va_listx                      const args) {
+/*----------------------------------------------------------------------------
+   Decompose *valueP according to decomposition tree *decompRootP, which
+   describes 'argCount' arguments, with arguments 'args'.
+-----------------------------------------------------------------------------*/
+    void * argBuffer[16];
+        /* The argument vector, if it's small enough to fit, which it
+           usually is; otherwise, we allocate one.
+        */
+    void ** argv;
+
+    if (argCount <= ARRAY_SIZE(argBuffer))
+        argv = argBuffer;
+    else
+        MALLOCARRAY(argv, argCount);
+
+    if (argv == NULL)
+        xmlrpc_faultf(envP, "Could not allocate space for %u arguments "
+                      "of a format string", argCount);
+    else {
+        va_listx currentArgs;
+
+        currentArgs = args;
+
+        collectArgs(decompRootP, &currentArgs, argv);
+
+        decomposeValueWithTree(envP, valueP, oldstyleMemMgmt, decompRootP,
+                               argv);
+
+        if (argv != argBuffer)
+            free(argv);
     }
-    *decompRootPP = decompRootP;
 }
 
 
@@ -1072,15 +1133,17 @@ decomposeValue(xmlrpc_env *   const envP,
                va_listx       const args) {
 
     struct decompTreeNode * decompRootP;
+    unsigned int argCount;
 
     XMLRPC_ASSERT_ENV_OK(envP);
     XMLRPC_ASSERT_VALUE_OK(valueP);
     XMLRPC_ASSERT(format != NULL);
 
-    createDecompTree(envP, format, args, &decompRootP);
+    createDecompTree(envP, format, &decompRootP, &argCount);
 
     if (!envP->fault_occurred) {
-        decomposeValueWithTree(envP, valueP, oldstyleMemMgmt, decompRootP);
+        decomposeWithTree(envP, valueP, oldstyleMemMgmt, decompRootP,
+                          argCount, args);
 
         destroyDecompTree(decompRootP);
     }
@@ -1147,3 +1210,86 @@ xmlrpc_parse_value(xmlrpc_env *   const envP,
     xmlrpc_parse_value_va(envP, value, format, args);
     va_end(args);
 }
+
+
+
+void
+xmlrpc_decompose_compile(xmlrpc_env *         const envP,
+                         const char *         const format,
+                         xmlrpc_decomposer ** const decomposerPP) {
+/*----------------------------------------------------------------------------
+   Compile format string 'format' for xmlrpc_decompose_compiled(), so that
+   a program that decomposes many values the same way, such as a method
+   function, parses the format string only once.
+-----------------------------------------------------------------------------*/
+    xmlrpc_decomposer * decomposerP;
+
+    XMLRPC_ASSERT_ENV_OK(envP);
+    XMLRPC_ASSERT(format != NULL);
+
+    MALLOCVAR(decomposerP);
+
+    if (decomposerP == NULL)
+        xmlrpc_faultf(envP, "Could not allocate space for a decomposer");
+    else {
+        createDecompTree(envP, format, &decomposerP->decompRootP,
+                         &decomposerP->argCount);
+
+        if (envP->fault_occurred)
+            free(decomposerP);
+        else
+            *decomposerPP = decomposerP;
+    }
+}
+
+
+
+void
+xmlrpc_decomposer_destroy(xmlrpc_decomposer * const decomposerP) {
+
+    XMLRPC_ASSERT(decomposerP != NULL);
+
+    destroyDecompTree(decomposerP->decompRootP);
+
+    free(decomposerP);
+}
+
+
+
+void 
+xmlrpc_decompose_compiled_va(xmlrpc_env *              const envP,
+                             xmlrpc_value *            const valueP,
+                             const xmlrpc_decomposer * const decomposerP,
+                             va_list                   const args) {
+/*----------------------------------------------------------------------------
+   Same as xmlrpc_decompose_value_va(), but with the format string
+   compiled by xmlrpc_decompose_compile().
+
+   Any number of threads may use the same decomposer at once.
+-----------------------------------------------------------------------------*/
+    va_listx argsx;
+
+    XMLRPC_ASSERT_ENV_OK(envP);
+    XMLRPC_ASSERT_VALUE_OK(valueP);
+    XMLRPC_ASSERT(decomposerP != NULL);
+
+    init_va_listx(&argsx, args);
+
+    decomposeWithTree(envP, valueP, false, decomposerP->decompRootP,
+                      decomposerP->argCount, argsx);
+}
+
+
+
+void 
+xmlrpc_decompose_compiled(xmlrpc_env *              const envP,
+                          xmlrpc_value *            const valueP,
+                          const xmlrpc_decomposer * const decomposerP,
+                          ...) {
+
+    va_list args;
+
+    va_start(args, decomposerP);
+    xmlrpc_decompose_compiled_va(envP, valueP, decomposerP, args);
+    va_end(args);
+}
@@ -668,6 +668,45 @@ xmlrpc_parse_value_xml(xmlrpc_env *    const envP,
 
 
 
+void
+xmlrpc_parse_struct_direct(xmlrpc_env *                const envP,
+                           const char *                const xmlData,
+                           size_t                      const xmlDataLen,
+                           const xmlrpc_struct_field * const fields,
+                           void *                      const structP) {
+/*----------------------------------------------------------------------------
+   Fill in C structure *structP from the XML document 'xmlData' (of length
+   'xmlDataLen' characters), which must consist of a single <value> element
+   for a structure.  'fields' says which structure members go where in
+   *structP.
+
+   This is the inverse of xmlrpc_serialize_struct_direct().
+-----------------------------------------------------------------------------*/
+    xmlrpc_env env;
+
+    xml_element * valueEltP;
+
+    XMLRPC_ASSERT_ENV_OK(envP);
+    XMLRPC_ASSERT(xmlData != NULL);
+    XMLRPC_ASSERT_PTR_OK(fields);
+    XMLRPC_ASSERT_PTR_OK(structP);
+
+    xmlrpc_env_init(&env);
+
+    xml_parse(&env, xmlData, xmlDataLen, &valueEltP);
+
+    if (env.fault_occurred) {
+        setParseFault(envP, "Not valid XML.  %s", env.fault_string);
+    } else {
+        xmlrpc_parseStructDirect(envP, valueEltP, fields, structP);
+
+        xml_element_free(valueEltP);
+    }
+    xmlrpc_env_clean(&env);
+}
+
+
+
 /* Copyright (C) 2001 by First Peer, Inc. All rights reserved.
 **
 ** Redistribution and use in source and binary forms, with or without
@@ -2,11 +2,13 @@
 
 /* Implementation note:
 
-   The printf format specifiers we use appear to be entirely standard,
-   except for the "long long" one, which is %I64 on Windows and %lld
-   everywhere else.  We could use the C99 standard macro PRId64 for that,
-   but on at least one 64-bit-long GNU compiler, PRId64 is "ld", which is
-   considered to be incompatible with long long.  So we have XMLRPC_PRId64.
+   We don't use printf to format integers and datetimes, because they are
+   by far the most common things in bulk data and printf is slow.  See
+   addInt() and serializeDatetime().
+
+   A large array or structure may be serialized by several threads at
+   once, each doing a slice of its items into a separate buffer.  See
+   serializeContents().
 */
 
 #include "xmlrpc_config.h"
@@ -20,16 +22,29 @@
 #include <float.h>
 
 #include "int.h"
+#include "girmath.h"
+#include "mallocvar.h"
 #include "xmlrpc-c/base.h"
 #include "xmlrpc-c/base_int.h"
 #include "xmlrpc-c/string_int.h"
+#include "xmlrpc-c/string_number.h"
+#include "xmlrpc-c/parallel_int.h"
+#include "xmlrpc-c/json.h"
 #include "double.h"
 
 #define CRLF "\015\012"
-#define XML_PROLOGUE "<?xml version=\"1.0\" encoding=\"UTF-8\"?>"CRLF
+#define XML_DECL "<?xml version=\"1.0\" encoding=\"UTF-8\"?>"
+#define XML_PROLOGUE XML_DECL CRLF
 #define APACHE_URL "http://ws.apache.org/xmlrpc/namespaces/extensions"
 #define XMLNS_APACHE "xmlns:ex=\"" APACHE_URL "\""
 
+/* LINE(dialect, "<foo>") is "<foo>" followed by a line delimiter, except in
+   the compact dialect, where it is just "<foo>".  The line delimiters mean
+   nothing to an XML-RPC parser; they are only for humans reading the XML.
+*/
+#define LINE(dialect, text) \
+    ((dialect) == xmlrpc_dialect_compact ? (text) : (text CRLF))
+
 
 static void
 addString(xmlrpc_env *       const envP,
@@ -85,6 +100,95 @@ formatOut(xmlrpc_env *       const envP,
 
 
 
+static char *
+reserveSpace(xmlrpc_env *       const envP,
+             xmlrpc_mem_block * const outputP,
+             size_t             const maxLen) {
+/*----------------------------------------------------------------------------
+   Make room for up to 'maxLen' more characters at the end of *outputP and
+   return a pointer to where they go.  Caller writes them there directly,
+   then calls commitSpace() to say how many he actually wrote.
+-----------------------------------------------------------------------------*/
+    size_t const origSize = XMLRPC_MEMBLOCK_SIZE(char, outputP);
+
+    XMLRPC_MEMBLOCK_RESIZE(char, envP, outputP, origSize + maxLen);
+
+    return envP->fault_occurred ?
+        NULL : XMLRPC_MEMBLOCK_CONTENTS(char, outputP) + origSize;
+}
+
+
+
+static void
+commitSpace(xmlrpc_env *       const envP,
+            xmlrpc_mem_block * const outputP,
+            const char *       const start,
+            const char *       const end) {
+/*----------------------------------------------------------------------------
+   Finish what reserveSpace() started: 'start' is what it returned and 'end'
+   is just past the last character Caller wrote.
+-----------------------------------------------------------------------------*/
+    size_t const newSize =
+        (start - XMLRPC_MEMBLOCK_CONTENTS(char, outputP)) + (end - start);
+
+    /* This is a shrink, so it never allocates */
+    XMLRPC_MEMBLOCK_RESIZE(char, envP, outputP, newSize);
+}
+
+
+
+static char *
+putTag(char *       const p,
+       const char * const elemName,
+       size_t       const elemNameLen,
+       bool         const isEnd) {
+
+    char * q;
+
+    q = p;
+    *q++ = '<';
+    if (isEnd)
+        *q++ = '/';
+    memcpy(q, elemName, elemNameLen);
+    q += elemNameLen;
+    *q++ = '>';
+
+    return q;
+}
+
+
+
+static void
+addInt(xmlrpc_env *       const envP,
+       xmlrpc_mem_block * const outputP,
+       const char *       const elemName,
+       xmlrpc_int64       const value) {
+/*----------------------------------------------------------------------------
+   Add to *outputP an element named 'elemName' whose content is 'value' in
+   decimal, e.g. "<i4>42</i4>".
+
+   We do this a lot (think of an array of a million integers), so we
+   generate it right in the output buffer, with no printf.
+-----------------------------------------------------------------------------*/
+    size_t const elemNameLen = strlen(elemName);
+
+    char * const start =
+        reserveSpace(envP, outputP,
+                     2 * elemNameLen + 5 + XMLRPC_INT64_DECIMAL_MAX);
+
+    if (!envP->fault_occurred) {
+        char * p;
+
+        p = putTag(start, elemName, elemNameLen, false);
+        p += xmlrpc_format_int64(p, value);
+        p = putTag(p, elemName, elemNameLen, true);
+
+        commitSpace(envP, outputP, start, p);
+    }
+}
+
+
+
 static void 
 assertValidUtf8(const char * const str ATTR_UNUSED,
                 size_t       const len ATTR_UNUSED) {
@@ -215,29 +319,20 @@ escapeForXml(xmlrpc_env *        const envP,
 
 
 static void 
-serializeUtf8MemBlock(xmlrpc_env *       const envP,
-                      xmlrpc_mem_block * const outputP,
-                      xmlrpc_mem_block * const inputP) {
+serializeUtf8(xmlrpc_env *       const envP,
+              xmlrpc_mem_block * const outputP,
+              const char *       const chars,
+              size_t             const len) {
 /*----------------------------------------------------------------------------
-   Append the characters in *inputP to the XML stream in *outputP.
-
-   *inputP contains Unicode characters in UTF-8.
-
-   We assume *inputP ends with a NUL character that marks end of
-   string, and we ignore that.  (There might also be NUL characters
-   inside the string, though).
+   Append the 'len' UTF-8 characters at 'chars' to the XML stream in
+   *outputP.
 -----------------------------------------------------------------------------*/
     xmlrpc_mem_block * escapedP;
 
     XMLRPC_ASSERT_ENV_OK(envP);
     XMLRPC_ASSERT(outputP != NULL);
-    XMLRPC_ASSERT(inputP != NULL);
 
-    escapeForXml(envP,
-                 XMLRPC_MEMBLOCK_CONTENTS(const char, inputP),
-                 XMLRPC_MEMBLOCK_SIZE(const char, inputP) - 1,
-                    /* -1 is for the terminating NUL */
-                 &escapedP);
+    escapeForXml(envP, chars, len, &escapedP);
     if (!envP->fault_occurred) {
         const char * const contents =
             XMLRPC_MEMBLOCK_CONTENTS(const char, escapedP);
@@ -251,18 +346,47 @@ serializeUtf8MemBlock(xmlrpc_env *       const envP,
 
 
 
+static void 
+serializeUtf8MemBlock(xmlrpc_env *       const envP,
+                      xmlrpc_mem_block * const outputP,
+                      xmlrpc_mem_block * const inputP) {
+/*----------------------------------------------------------------------------
+   Append the characters in *inputP to the XML stream in *outputP.
+
+   *inputP contains Unicode characters in UTF-8.
+
+   We assume *inputP ends with a NUL character that marks end of
+   string, and we ignore that.  (There might also be NUL characters
+   inside the string, though).
+-----------------------------------------------------------------------------*/
+    XMLRPC_ASSERT(inputP != NULL);
+
+    serializeUtf8(envP, outputP,
+                  XMLRPC_MEMBLOCK_CONTENTS(const char, inputP),
+                  XMLRPC_MEMBLOCK_SIZE(const char, inputP) - 1);
+                      /* -1 is for the terminating NUL */
+}
+
+
+
 static void 
 xmlrpc_serialize_base64_data(xmlrpc_env *       const envP,
                              xmlrpc_mem_block * const output,
                              unsigned char *    const data, 
-                             size_t             const len) {
+                             size_t             const len,
+                             xmlrpc_dialect     const dialect) {
 /*----------------------------------------------------------------------------
    Encode the 'len' bytes at 'data' in base64 ASCII and append the result to
    'output'.
+
+   The compact dialect gets it all on one line.
 -----------------------------------------------------------------------------*/
     xmlrpc_mem_block * encoded;
 
-    encoded = xmlrpc_base64_encode(envP, data, len);
+    if (dialect == xmlrpc_dialect_compact)
+        encoded = xmlrpc_base64_encode_without_newlines(envP, data, len);
+    else
+        encoded = xmlrpc_base64_encode(envP, data, len);
     if (!envP->fault_occurred) {
         unsigned char * const contents =
             XMLRPC_MEMBLOCK_CONTENTS(unsigned char, encoded);
@@ -277,6 +401,8 @@ xmlrpc_serialize_base64_data(xmlrpc_env *       const envP,
 
 
 
+#define DT_ELEM "dateTime.iso8601"
+
 static void
 serializeDatetime(xmlrpc_env *       const envP,
                   xmlrpc_mem_block * const outputP,
@@ -285,44 +411,125 @@ serializeDatetime(xmlrpc_env *       const envP,
    Add to *outputP the content of a <value> element to represent
    the datetime value *valueP.  I.e.
    "<dateTime.iso8601> ... </dateTime.iso8601>".
+
+   The datetime is in the form YYYYMMDDTHH:MM:SS, plus .UUUUUU if there
+   is a fractional second.  Like addInt(), we generate it in place.
 -----------------------------------------------------------------------------*/
+    const xmlrpc_datetime * const dtP = &valueP->_value.dt;
+
+    size_t const elemNameLen = strlen(DT_ELEM);
+
+    char * const start =
+        reserveSpace(envP, outputP,
+                     2 * elemNameLen + 5 + XMLRPC_INT64_DECIMAL_MAX +
+                     sizeof("MMDDTHH:MM:SS.UUUUUU"));
 
-    addString(envP, outputP, "<dateTime.iso8601>");
     if (!envP->fault_occurred) {
-        char dtString[64];
-
-        snprintf(dtString, sizeof(dtString),
-                 "%u%02u%02uT%02u:%02u:%02u",
-                 valueP->_value.dt.Y,
-                 valueP->_value.dt.M,
-                 valueP->_value.dt.D,
-                 valueP->_value.dt.h,
-                 valueP->_value.dt.m,
-                 valueP->_value.dt.s);
-
-        if (valueP->_value.dt.u != 0) {
-            char usecString[64];
-            assert(valueP->_value.dt.u < 1000000);
-            snprintf(usecString, sizeof(usecString), ".%06u",
-                     valueP->_value.dt.u);
-            STRSCAT(dtString, usecString);
+        char * p;
+
+        assert(dtP->M < 100 && dtP->D < 100);
+        assert(dtP->h < 100 && dtP->m < 100 && dtP->s < 100);
+
+        p = putTag(start, DT_ELEM, elemNameLen, false);
+
+        p += xmlrpc_format_int64(p, dtP->Y);
+        xmlrpc_format_2digits(p, dtP->M); p += 2;
+        xmlrpc_format_2digits(p, dtP->D); p += 2;
+        *p++ = 'T';
+        xmlrpc_format_2digits(p, dtP->h); p += 2;
+        *p++ = ':';
+        xmlrpc_format_2digits(p, dtP->m); p += 2;
+        *p++ = ':';
+        xmlrpc_format_2digits(p, dtP->s); p += 2;
+
+        if (dtP->u != 0) {
+            assert(dtP->u < 1000000);
+            *p++ = '.';
+            xmlrpc_format_2digits(p, dtP->u / 10000);      p += 2;
+            xmlrpc_format_2digits(p, dtP->u / 100 % 100);  p += 2;
+            xmlrpc_format_2digits(p, dtP->u % 100);        p += 2;
         }
-        addString(envP, outputP, dtString);
+        p = putTag(p, DT_ELEM, elemNameLen, true);
 
+        commitSpace(envP, outputP, start, p);
+    }
+}
+
+
+
+static void
+addBool(xmlrpc_env *       const envP,
+        xmlrpc_mem_block * const outputP,
+        xmlrpc_bool        const value) {
+
+    addString(envP, outputP,
+              value ? "<boolean>1</boolean>" : "<boolean>0</boolean>");
+}
+
+
+
+static void
+addDouble(xmlrpc_env *       const envP,
+          xmlrpc_mem_block * const outputP,
+          double             const value) {
+
+    const char * serializedValue;
+
+    xmlrpc_formatFloat(envP, value, &serializedValue);
+    if (!envP->fault_occurred) {
+        addString(envP, outputP, "<double>");
         if (!envP->fault_occurred) {
-            addString(envP, outputP, "</dateTime.iso8601>");
+            addString(envP, outputP, serializedValue);
+            if (!envP->fault_occurred)
+                addString(envP, outputP, "</double>");
         }
+        xmlrpc_strfree(serializedValue);
     }
 }
 
 
 
+static void
+addStringContent(xmlrpc_env *       const envP,
+                 xmlrpc_mem_block * const outputP,
+                 const char *       const chars,
+                 size_t             const len,
+                 xmlrpc_dialect     const dialect) {
+/*----------------------------------------------------------------------------
+   Add to *outputP the content of a <value> element to represent the
+   string value 'chars' (which is 'len' UTF-8 characters).
+-----------------------------------------------------------------------------*/
+    if (dialect == xmlrpc_dialect_compact) {
+        /* A <value> with no type element is a string */
+        serializeUtf8(envP, outputP, chars, len);
+    } else {
+        addString(envP, outputP, "<string>");
+        if (!envP->fault_occurred) {
+            serializeUtf8(envP, outputP, chars, len);
+            if (!envP->fault_occurred)
+                addString(envP, outputP, "</string>");
+        }
+    }
+}
+
+
+
+static void
+serializeValue(xmlrpc_env *       const envP,
+               xmlrpc_mem_block * const outputP,
+               xmlrpc_value *     const valueP,
+               xmlrpc_dialect     const dialect,
+               unsigned int       const threadCount);
+
+
+
 static void
 serializeStructMember(xmlrpc_env *       const envP,
                       xmlrpc_mem_block * const outputP,
                       xmlrpc_value *     const memberKeyP,
                       xmlrpc_value *     const memberValueP,
-                      xmlrpc_dialect     const dialect) {
+                      xmlrpc_dialect     const dialect,
+                      unsigned int       const threadCount) {
     
     addString(envP, outputP, "<member><name>");
 
@@ -330,13 +537,14 @@ serializeStructMember(xmlrpc_env *       const envP,
         serializeUtf8MemBlock(envP, outputP, &memberKeyP->_block);
 
         if (!envP->fault_occurred) {
-            addString(envP, outputP, "</name>"CRLF);
+            addString(envP, outputP, LINE(dialect, "</name>"));
 
             if (!envP->fault_occurred) {
-                xmlrpc_serialize_value2(envP, outputP, memberValueP, dialect);
+                serializeValue(envP, outputP, memberValueP, dialect,
+                               threadCount);
 
                 if (!envP->fault_occurred) {
-                    addString(envP, outputP, "</member>"CRLF);
+                    addString(envP, outputP, LINE(dialect, "</member>"));
                 }
             }
         }
@@ -345,31 +553,201 @@ serializeStructMember(xmlrpc_env *       const envP,
 
 
 
+static void
+serializeItems(xmlrpc_env *       const envP,
+               xmlrpc_mem_block * const outputP,
+               xmlrpc_value *     const compoundP,
+               unsigned int       const first,
+               unsigned int       const end,
+               xmlrpc_dialect     const dialect,
+               unsigned int       const threadCount) {
+/*----------------------------------------------------------------------------
+   Add to *outputP the XML for items 'first' through 'end' - 1 of the
+   array or structure *compoundP: the <value> elements for an array, or the
+   <member> elements for a structure.
+
+   'threadCount' is how many threads we may use for each item.
+-----------------------------------------------------------------------------*/
+    unsigned int i;
+
+    for (i = first; i < end && !envP->fault_occurred; ++i) {
+        if (compoundP->_type == XMLRPC_TYPE_ARRAY) {
+            xmlrpc_value * const itemP =
+                xmlrpc_array_get_item(envP, compoundP, i);
+            if (!envP->fault_occurred) {
+                serializeValue(envP, outputP, itemP, dialect, threadCount);
+                if (!envP->fault_occurred)
+                    addString(envP, outputP, LINE(dialect, ""));
+            }
+        } else {
+            xmlrpc_value * memberKeyP;
+            xmlrpc_value * memberValueP;
+
+            xmlrpc_struct_get_key_and_value(envP, compoundP, i,
+                                            &memberKeyP, &memberValueP);
+            if (!envP->fault_occurred)
+                serializeStructMember(envP, outputP, memberKeyP, memberValueP,
+                                      dialect, threadCount);
+        }
+    }
+}
+
+
+
+/* An array or structure must have at least this many items before we'll
+   divide its serialization among threads.  With fewer, starting the threads
+   and copying their output costs more than it saves.
+*/
+#define PARALLEL_MIN_ITEMS 1024
+
+struct slice {
+    xmlrpc_env         env;
+    xmlrpc_mem_block * outputP;
+};
+
+struct sliceSet {
+/*----------------------------------------------------------------------------
+   The items of an array or structure, divided into slices to be serialized
+   by separate threads.
+-----------------------------------------------------------------------------*/
+    xmlrpc_value * compoundP;
+    xmlrpc_dialect dialect;
+    unsigned int   itemCount;
+    unsigned int   sliceCount;
+    struct slice * slices;
+        /* slices[i] is the result of serializing slice i */
+};
+
+
+
+static xmlrpc_parallelJobFn serializeSlice;
+
+static void
+serializeSlice(void *       const contextP,
+               unsigned int const sliceIndex) {
+
+    struct sliceSet * const setP   = contextP;
+    struct slice *    const sliceP = &setP->slices[sliceIndex];
+
+    unsigned int const first =
+        (unsigned int)((double)setP->itemCount * sliceIndex /
+                       setP->sliceCount);
+    unsigned int const end =
+        (unsigned int)((double)setP->itemCount * (sliceIndex + 1) /
+                       setP->sliceCount);
+
+    xmlrpc_env_init(&sliceP->env);
+
+    sliceP->outputP = XMLRPC_MEMBLOCK_NEW(char, &sliceP->env, 0);
+
+    if (!sliceP->env.fault_occurred)
+        serializeItems(&sliceP->env, sliceP->outputP, setP->compoundP,
+                       first, end, setP->dialect, 1);
+}
+
+
+
+static void
+serializeItemsParallel(xmlrpc_env *       const envP,
+                       xmlrpc_mem_block * const outputP,
+                       xmlrpc_value *     const compoundP,
+                       unsigned int       const itemCount,
+                       xmlrpc_dialect     const dialect,
+                       unsigned int       const threadCount) {
+/*----------------------------------------------------------------------------
+   Same as serializeItems() on all the items, but divide them into slices
+   and serialize the slices in separate threads, each into its own buffer.
+   Then add the buffers to *outputP in order.
+
+   The threads only read the values, so they don't get in each other's
+   way.
+-----------------------------------------------------------------------------*/
+    struct sliceSet set;
+
+    set.compoundP  = compoundP;
+    set.dialect    = dialect;
+    set.itemCount  = itemCount;
+    /* A few slices per thread, so a thread that finishes early can help
+       with the rest.
+    */
+    set.sliceCount = MIN(threadCount * 4, itemCount / 256);
+
+    MALLOCARRAY(set.slices, set.sliceCount);
+
+    if (set.slices == NULL)
+        xmlrpc_faultf(envP, "Couldn't allocate memory for %u "
+                      "serialization slices", set.sliceCount);
+    else {
+        unsigned int i;
+
+        xmlrpc_parallel_run(threadCount, set.sliceCount,
+                            &serializeSlice, &set);
+
+        for (i = 0; i < set.sliceCount; ++i) {
+            struct slice * const sliceP = &set.slices[i];
+
+            if (!envP->fault_occurred) {
+                if (sliceP->env.fault_occurred)
+                    xmlrpc_env_set_fault(envP, sliceP->env.fault_code,
+                                         sliceP->env.fault_string);
+                else
+                    XMLRPC_MEMBLOCK_APPEND(
+                        char, envP, outputP,
+                        XMLRPC_MEMBLOCK_CONTENTS(char, sliceP->outputP),
+                        XMLRPC_MEMBLOCK_SIZE(char, sliceP->outputP));
+            }
+            if (sliceP->outputP)
+                XMLRPC_MEMBLOCK_FREE(char, sliceP->outputP);
+            xmlrpc_env_clean(&sliceP->env);
+        }
+        free(set.slices);
+    }
+}
+
+
+
+static void
+serializeContents(xmlrpc_env *       const envP,
+                  xmlrpc_mem_block * const outputP,
+                  xmlrpc_value *     const compoundP,
+                  unsigned int       const itemCount,
+                  xmlrpc_dialect     const dialect,
+                  unsigned int       const threadCount) {
+/*----------------------------------------------------------------------------
+   Add to *outputP the XML for all the items of the array or structure
+   *compoundP, using up to 'threadCount' threads.
+
+   We divide the items among threads if there are enough of them to make
+   it worthwhile.  Otherwise, we do them one at a time and offer the
+   threads to each item instead, so a huge array inside a small structure
+   still gets divided.
+-----------------------------------------------------------------------------*/
+    if (threadCount > 1 && itemCount >= PARALLEL_MIN_ITEMS)
+        serializeItemsParallel(envP, outputP, compoundP, itemCount,
+                               dialect, threadCount);
+    else
+        serializeItems(envP, outputP, compoundP, 0, itemCount,
+                       dialect, threadCount);
+}
+
+
+
 static void 
 serializeStruct(xmlrpc_env *       const envP,
                 xmlrpc_mem_block * const outputP,
                 xmlrpc_value *     const structP,
-                xmlrpc_dialect     const dialect) {
+                xmlrpc_dialect     const dialect,
+                unsigned int       const threadCount) {
 /*----------------------------------------------------------------------------
    Add to *outputP the content of a <value> element to represent
    the structure value *valueP.  I.e. "<struct> ... </struct>".
 -----------------------------------------------------------------------------*/
-    addString(envP, outputP, "<struct>"CRLF);
+    addString(envP, outputP, LINE(dialect, "<struct>"));
     if (!envP->fault_occurred) {
         unsigned int const size = xmlrpc_struct_size(envP, structP);
         if (!envP->fault_occurred) {
-            unsigned int i;
-            for (i = 0; i < size && !envP->fault_occurred; ++i) {
-                xmlrpc_value * memberKeyP;
-                xmlrpc_value * memberValueP;
-
-                xmlrpc_struct_get_key_and_value(envP, structP, i,
-                                                &memberKeyP, &memberValueP);
-                if (!envP->fault_occurred) {
-                    serializeStructMember(envP, outputP,
-                                          memberKeyP, memberValueP, dialect);
-                }
-            }
+            serializeContents(envP, outputP, structP, size, dialect,
+                              threadCount);
             if (!envP->fault_occurred)
                 addString(envP, outputP, "</struct>");
         }
@@ -382,7 +760,8 @@ static void
 serializeArray(xmlrpc_env *       const envP,
                xmlrpc_mem_block * const outputP,
                xmlrpc_value *     const valueP,
-               xmlrpc_dialect     const dialect) {
+               xmlrpc_dialect     const dialect,
+               unsigned int       const threadCount) {
 /*----------------------------------------------------------------------------
    Add to *outputP the content of a <value> element to represent
    the array value *valueP.  I.e. "<array> ... </array>".
@@ -390,20 +769,10 @@ serializeArray(xmlrpc_env *       const envP,
     int const size = xmlrpc_array_size(envP, valueP);
 
     if (!envP->fault_occurred) {
-        addString(envP, outputP, "<array><data>"CRLF);
-        if (!envP->fault_occurred) {
-            int i;
-            /* Serialize each item. */
-            for (i = 0; i < size && !envP->fault_occurred; ++i) {
-                xmlrpc_value * const itemP =
-                    xmlrpc_array_get_item(envP, valueP, i);
-                if (!envP->fault_occurred) {
-                    xmlrpc_serialize_value2(envP, outputP, itemP, dialect);
-                    if (!envP->fault_occurred)
-                        addString(envP, outputP, CRLF);
-                }
-            }
-        }
+        addString(envP, outputP, LINE(dialect, "<array><data>"));
+        if (!envP->fault_occurred)
+            serializeContents(envP, outputP, valueP, size, dialect,
+                              threadCount);
     }
     if (!envP->fault_occurred)
         addString(envP, outputP, "</data></array>");
@@ -415,55 +784,44 @@ static void
 formatValueContent(xmlrpc_env *       const envP,
                    xmlrpc_mem_block * const outputP,
                    xmlrpc_value *     const valueP,
-                   xmlrpc_dialect     const dialect) {
+                   xmlrpc_dialect     const dialect,
+                   unsigned int       const threadCount) {
 /*----------------------------------------------------------------------------
    Add to *outputP the content of a <value> element to represent
    value *valueP.  E.g. "<int>42</int>"
+
+   Use up to 'threadCount' threads to do it.
 -----------------------------------------------------------------------------*/
     XMLRPC_ASSERT_ENV_OK(envP);
 
     switch (valueP->_type) {
     case XMLRPC_TYPE_INT:
-        formatOut(envP, outputP, "<i4>%d</i4>", valueP->_value.i);
+        addInt(envP, outputP, "i4", valueP->_value.i);
         break;
 
     case XMLRPC_TYPE_I8: {
         const char * const elemName =
             dialect == xmlrpc_dialect_apache ? "ex:i8" : "i8";
-        formatOut(envP, outputP, "<%s>%" PRId64 "</%s>",
-                  elemName, valueP->_value.i8, elemName);
+        addInt(envP, outputP, elemName, valueP->_value.i8);
     } break;
 
     case XMLRPC_TYPE_BOOL:
-        formatOut(envP, outputP, "<boolean>%s</boolean>",
-                  valueP->_value.b ? "1" : "0");
+        addBool(envP, outputP, valueP->_value.b);
         break;
 
-    case XMLRPC_TYPE_DOUBLE: {
-        const char * serializedValue;
-        xmlrpc_formatFloat(envP, valueP->_value.d, &serializedValue);
-        if (!envP->fault_occurred) {
-            addString(envP, outputP, "<double>");
-            if (!envP->fault_occurred) {
-                addString(envP, outputP, serializedValue);
-                if (!envP->fault_occurred)
-                    addString(envP, outputP, "</double>");
-            }
-            xmlrpc_strfree(serializedValue);
-        }
-    } break;
+    case XMLRPC_TYPE_DOUBLE:
+        addDouble(envP, outputP, valueP->_value.d);
+        break;
 
     case XMLRPC_TYPE_DATETIME:
         serializeDatetime(envP, outputP, valueP);
         break;
 
     case XMLRPC_TYPE_STRING:
-        addString(envP, outputP, "<string>");
-        if (!envP->fault_occurred) {
-            serializeUtf8MemBlock(envP, outputP, &valueP->_block);
-            if (!envP->fault_occurred)
-                addString(envP, outputP, "</string>");
-        }
+        addStringContent(envP, outputP,
+                         XMLRPC_MEMBLOCK_CONTENTS(const char, &valueP->_block),
+                         XMLRPC_MEMBLOCK_SIZE(const char, &valueP->_block) - 1,
+                         dialect);
         break;
 
     case XMLRPC_TYPE_BASE64: {
@@ -471,20 +829,21 @@ formatValueContent(xmlrpc_env *       const envP,
             XMLRPC_MEMBLOCK_CONTENTS(unsigned char, &valueP->_block);
         size_t const size =
             XMLRPC_MEMBLOCK_SIZE(unsigned char, &valueP->_block);
-        addString(envP, outputP, "<base64>"CRLF);
+        addString(envP, outputP, LINE(dialect, "<base64>"));
         if (!envP->fault_occurred) {
-            xmlrpc_serialize_base64_data(envP, outputP, contents, size);
+            xmlrpc_serialize_base64_data(envP, outputP, contents, size,
+                                         dialect);
             if (!envP->fault_occurred)
                 addString(envP, outputP, "</base64>");
         }
     } break;      
 
     case XMLRPC_TYPE_ARRAY:
-        serializeArray(envP, outputP, valueP, dialect);
+        serializeArray(envP, outputP, valueP, dialect, threadCount);
         break;
 
     case XMLRPC_TYPE_STRUCT:
-        serializeStruct(envP, outputP, valueP, dialect);
+        serializeStruct(envP, outputP, valueP, dialect, threadCount);
         break;
 
     case XMLRPC_TYPE_C_PTR:
@@ -508,6 +867,32 @@ formatValueContent(xmlrpc_env *       const envP,
 
 
 
+static void
+serializeValue(xmlrpc_env *       const envP,
+               xmlrpc_mem_block * const outputP,
+               xmlrpc_value *     const valueP,
+               xmlrpc_dialect     const dialect,
+               unsigned int       const threadCount) {
+
+    addString(envP, outputP, "<value>");
+
+    if (!envP->fault_occurred) {
+        struct xmlrpc_serialCache * const cacheP = valueP->_serialCacheP;
+
+        if (cacheP && cacheP->xmlP && cacheP->xmlDialect == dialect)
+            XMLRPC_MEMBLOCK_APPEND(char, envP, outputP,
+                                   XMLRPC_MEMBLOCK_CONTENTS(char, cacheP->xmlP),
+                                   XMLRPC_MEMBLOCK_SIZE(char, cacheP->xmlP));
+        else
+            formatValueContent(envP, outputP, valueP, dialect, threadCount);
+
+        if (!envP->fault_occurred)
+            addString(envP, outputP, "</value>");
+    }
+}
+
+
+
 void 
 xmlrpc_serialize_value2(xmlrpc_env *       const envP,
                         xmlrpc_mem_block * const outputP,
@@ -522,14 +907,26 @@ xmlrpc_serialize_value2(xmlrpc_env *       const envP,
     XMLRPC_ASSERT(outputP != NULL);
     XMLRPC_ASSERT_VALUE_OK(valueP);
 
-    addString(envP, outputP, "<value>");
+    serializeValue(envP, outputP, valueP, dialect, 1);
+}
 
-    if (!envP->fault_occurred) {
-        formatValueContent(envP, outputP, valueP, dialect);
 
-        if (!envP->fault_occurred)
-            addString(envP, outputP, "</value>");
-    }
+
+void 
+xmlrpc_serialize_value_parallel(xmlrpc_env *       const envP,
+                                xmlrpc_mem_block * const outputP,
+                                xmlrpc_value *     const valueP,
+                                xmlrpc_dialect     const dialect,
+                                unsigned int       const threadCount) {
+/*----------------------------------------------------------------------------
+   Same as xmlrpc_serialize_value2(), but use up to 'threadCount' threads
+   to serialize large arrays and structures.  The XML is identical.
+-----------------------------------------------------------------------------*/
+    XMLRPC_ASSERT_ENV_OK(envP);
+    XMLRPC_ASSERT(outputP != NULL);
+    XMLRPC_ASSERT_VALUE_OK(valueP);
+
+    serializeValue(envP, outputP, valueP, dialect, threadCount);
 }
 
 
@@ -556,7 +953,7 @@ xmlrpc_serialize_params2(xmlrpc_env *       const envP,
     XMLRPC_ASSERT(outputP != NULL);
     XMLRPC_ASSERT_VALUE_OK(paramArrayP);
 
-    addString(envP, outputP, "<params>"CRLF);
+    addString(envP, outputP, LINE(dialect, "<params>"));
     if (!envP->fault_occurred) {
         /* Serialize each parameter. */
         int const paramCount = xmlrpc_array_size(envP, paramArrayP);
@@ -573,7 +970,8 @@ xmlrpc_serialize_params2(xmlrpc_env *       const envP,
                     if (!envP->fault_occurred) {
                         xmlrpc_serialize_value2(envP, outputP, itemP, dialect);
                         if (!envP->fault_occurred)
-                            addString(envP, outputP, "</param>"CRLF);
+                            addString(envP, outputP,
+                                      LINE(dialect, "</param>"));
                     }
                 }
             }
@@ -581,7 +979,7 @@ xmlrpc_serialize_params2(xmlrpc_env *       const envP,
     }
 
     if (!envP->fault_occurred)
-        addString(envP, outputP, "</params>"CRLF);
+        addString(envP, outputP, LINE(dialect, "</params>"));
 }
 
 
@@ -622,11 +1020,12 @@ xmlrpc_serialize_call2(xmlrpc_env *       const envP,
     XMLRPC_ASSERT(methodName != NULL);
     XMLRPC_ASSERT_VALUE_OK(paramArrayP);
     
-    addString(envP, outputP, XML_PROLOGUE);
+    addString(envP, outputP, LINE(dialect, XML_DECL));
     if (!envP->fault_occurred) {
         const char * const xmlns =
             dialect == xmlrpc_dialect_apache ? " " XMLNS_APACHE : "";
-        formatOut(envP, outputP, "<methodCall%s>"CRLF"<methodName>", xmlns);
+        formatOut(envP, outputP, "<methodCall%s>%s<methodName>",
+                  xmlns, LINE(dialect, ""));
         if (!envP->fault_occurred) {
             xmlrpc_mem_block * encodedP;
             escapeForXml(envP, methodName, strlen(methodName), &encodedP);
@@ -636,12 +1035,14 @@ xmlrpc_serialize_call2(xmlrpc_env *       const envP,
                 size_t const size = XMLRPC_MEMBLOCK_SIZE(char, encodedP);
                 XMLRPC_MEMBLOCK_APPEND(char, envP, outputP, contents, size);
                 if (!envP->fault_occurred) {
-                    addString(envP, outputP, "</methodName>"CRLF);
+                    addString(envP, outputP,
+                              LINE(dialect, "</methodName>"));
                     if (!envP->fault_occurred) {
                         xmlrpc_serialize_params2(envP, outputP, paramArrayP,
                                                  dialect);
                         if (!envP->fault_occurred)
-                            addString(envP, outputP, "</methodCall>"CRLF);
+                            addString(envP, outputP,
+                                      LINE(dialect, "</methodCall>"));
                     }
                 }
                 XMLRPC_MEMBLOCK_FREE(char, encodedP);
@@ -664,6 +1065,56 @@ xmlrpc_serialize_call(xmlrpc_env *       const envP,
 
 
 
+static void
+addResponseStart(xmlrpc_env *       const envP,
+                 xmlrpc_mem_block * const outputP,
+                 xmlrpc_dialect     const dialect) {
+/*----------------------------------------------------------------------------
+   Add to *outputP the part of a result response that precedes the
+   <value> element for the result.
+-----------------------------------------------------------------------------*/
+    addString(envP, outputP, LINE(dialect, XML_DECL));
+    if (!envP->fault_occurred) {
+        const char * const xmlns =
+            dialect == xmlrpc_dialect_apache ? " " XMLNS_APACHE : "";
+        const char * const nl = LINE(dialect, "");
+        formatOut(envP, outputP,
+                  "<methodResponse%s>%s<params>%s<param>", xmlns, nl, nl);
+    }
+}
+
+
+
+static void
+addResponseEnd(xmlrpc_env *       const envP,
+               xmlrpc_mem_block * const outputP,
+               xmlrpc_dialect     const dialect) {
+
+    addString(envP, outputP,
+              dialect == xmlrpc_dialect_compact ?
+              "</param></params></methodResponse>" :
+              "</param>"CRLF"</params>"CRLF"</methodResponse>"CRLF);
+}
+
+
+
+static void 
+serializeResponse(xmlrpc_env *       const envP,
+                  xmlrpc_mem_block * const outputP,
+                  xmlrpc_value *     const valueP,
+                  xmlrpc_dialect     const dialect,
+                  unsigned int       const threadCount) {
+
+    addResponseStart(envP, outputP, dialect);
+    if (!envP->fault_occurred) {
+        serializeValue(envP, outputP, valueP, dialect, threadCount);
+        if (!envP->fault_occurred)
+            addResponseEnd(envP, outputP, dialect);
+    }
+}
+
+
+
 void 
 xmlrpc_serialize_response2(xmlrpc_env *       const envP,
                            xmlrpc_mem_block * const outputP,
@@ -680,21 +1131,26 @@ xmlrpc_serialize_response2(xmlrpc_env *       const envP,
     XMLRPC_ASSERT(outputP != NULL);
     XMLRPC_ASSERT_VALUE_OK(valueP);
 
-    addString(envP, outputP, XML_PROLOGUE);
-    if (!envP->fault_occurred) {
-        const char * const xmlns =
-            dialect == xmlrpc_dialect_apache ? " " XMLNS_APACHE : "";
-        formatOut(envP, outputP,
-                  "<methodResponse%s>"CRLF"<params>"CRLF"<param>", xmlns);
-        if (!envP->fault_occurred) {
-            xmlrpc_serialize_value2(envP, outputP, valueP, dialect);
-            if (!envP->fault_occurred) {
-                addString(envP, outputP,
-                          "</param>"CRLF"</params>"CRLF
-                          "</methodResponse>"CRLF);
-            }
-        }
-    }    
+    serializeResponse(envP, outputP, valueP, dialect, 1);
+}
+
+
+
+void 
+xmlrpc_serialize_response_parallel(xmlrpc_env *       const envP,
+                                   xmlrpc_mem_block * const outputP,
+                                   xmlrpc_value *     const valueP,
+                                   xmlrpc_dialect     const dialect,
+                                   unsigned int       const threadCount) {
+/*----------------------------------------------------------------------------
+   Same as xmlrpc_serialize_response2(), but use up to 'threadCount'
+   threads to serialize large arrays and structures in the result.
+-----------------------------------------------------------------------------*/
+    XMLRPC_ASSERT_ENV_OK(envP);
+    XMLRPC_ASSERT(outputP != NULL);
+    XMLRPC_ASSERT_VALUE_OK(valueP);
+
+    serializeResponse(envP, outputP, valueP, dialect, threadCount);
 }
 
 
@@ -709,10 +1165,144 @@ xmlrpc_serialize_response(xmlrpc_env *       const envP,
 
 
 
+static void
+addFieldContent(xmlrpc_env *                const envP,
+                xmlrpc_mem_block *          const outputP,
+                const xmlrpc_struct_field * const fieldP,
+                const void *                const structP,
+                xmlrpc_dialect              const dialect) {
+/*----------------------------------------------------------------------------
+   Add to *outputP the content of a <value> element to represent the
+   member of C structure *structP that *fieldP describes.
+-----------------------------------------------------------------------------*/
+    const char * const memberP = (const char *)structP + fieldP->offset;
+
+    switch (fieldP->type) {
+    case XMLRPC_TYPE_INT:
+        addInt(envP, outputP, "i4", *(const xmlrpc_int32 *)memberP);
+        break;
+    case XMLRPC_TYPE_I8:
+        addInt(envP, outputP,
+               dialect == xmlrpc_dialect_apache ? "ex:i8" : "i8",
+               *(const xmlrpc_int64 *)memberP);
+        break;
+    case XMLRPC_TYPE_BOOL:
+        addBool(envP, outputP, *(const xmlrpc_bool *)memberP);
+        break;
+    case XMLRPC_TYPE_DOUBLE:
+        addDouble(envP, outputP, *(const double *)memberP);
+        break;
+    case XMLRPC_TYPE_STRING: {
+        const char * const string = *(const char * const *)memberP;
+        if (string == NULL)
+            xmlrpc_faultf(envP, "String member '%s' is a null pointer",
+                          fieldP->name);
+        else
+            addStringContent(envP, outputP, string, strlen(string), dialect);
+    } break;
+    default:
+        xmlrpc_faultf(envP, "Member '%s' is of type %s, which a structure "
+                      "descriptor cannot describe", fieldP->name,
+                      xmlrpc_type_name(fieldP->type));
+    }
+}
+
+
+
+static void
+serializeStructDirect(xmlrpc_env *                const envP,
+                      xmlrpc_mem_block *          const outputP,
+                      const xmlrpc_struct_field * const fields,
+                      const void *                const structP,
+                      xmlrpc_dialect              const dialect) {
+
+    addString(envP, outputP, "<value>");
+    if (!envP->fault_occurred)
+        addString(envP, outputP, LINE(dialect, "<struct>"));
+    if (!envP->fault_occurred) {
+        const xmlrpc_struct_field * fieldP;
+
+        for (fieldP = &fields[0];
+             fieldP->name && !envP->fault_occurred;
+             ++fieldP) {
+            addString(envP, outputP, "<member><name>");
+            if (!envP->fault_occurred)
+                serializeUtf8(envP, outputP,
+                              fieldP->name, strlen(fieldP->name));
+            if (!envP->fault_occurred)
+                addString(envP, outputP, LINE(dialect, "</name>"));
+            if (!envP->fault_occurred)
+                addString(envP, outputP, "<value>");
+            if (!envP->fault_occurred)
+                addFieldContent(envP, outputP, fieldP, structP, dialect);
+            if (!envP->fault_occurred)
+                addString(envP, outputP, "</value>");
+            if (!envP->fault_occurred)
+                addString(envP, outputP, LINE(dialect, "</member>"));
+        }
+        if (!envP->fault_occurred)
+            addString(envP, outputP, "</struct></value>");
+    }
+}
+
+
+
+void
+xmlrpc_serialize_struct_direct(xmlrpc_env *                const envP,
+                               xmlrpc_mem_block *          const outputP,
+                               const xmlrpc_struct_field * const fields,
+                               const void *                const structP,
+                               xmlrpc_dialect              const dialect) {
+/*----------------------------------------------------------------------------
+   Generate the XML for an XML-RPC structure value whose members are the
+   members of C structure *structP that 'fields' describes, in that order.
+   Add it to *outputP.
+
+   This is the same XML xmlrpc_serialize_value2() would generate for an
+   xmlrpc_value built from *structP, but we don't build one.
+-----------------------------------------------------------------------------*/
+    XMLRPC_ASSERT_ENV_OK(envP);
+    XMLRPC_ASSERT(outputP != NULL);
+    XMLRPC_ASSERT_PTR_OK(fields);
+    XMLRPC_ASSERT_PTR_OK(structP);
+
+    serializeStructDirect(envP, outputP, fields, structP, dialect);
+}
+
+
+
+void
+xmlrpc_serialize_response_struct_direct(
+    xmlrpc_env *                const envP,
+    xmlrpc_mem_block *          const outputP,
+    const xmlrpc_struct_field * const fields,
+    const void *                const structP,
+    xmlrpc_dialect              const dialect) {
+/*----------------------------------------------------------------------------
+   Same as xmlrpc_serialize_response2(), but the result is a structure
+   taken straight from a C structure, as with
+   xmlrpc_serialize_struct_direct().
+-----------------------------------------------------------------------------*/
+    XMLRPC_ASSERT_ENV_OK(envP);
+    XMLRPC_ASSERT(outputP != NULL);
+    XMLRPC_ASSERT_PTR_OK(fields);
+    XMLRPC_ASSERT_PTR_OK(structP);
+
+    addResponseStart(envP, outputP, dialect);
+    if (!envP->fault_occurred) {
+        serializeStructDirect(envP, outputP, fields, structP, dialect);
+        if (!envP->fault_occurred)
+            addResponseEnd(envP, outputP, dialect);
+    }
+}
+
+
+
 void 
-xmlrpc_serialize_fault(xmlrpc_env *       const envP,
-                       xmlrpc_mem_block * const outputP,
-                       const xmlrpc_env * const faultP) {
+xmlrpc_serialize_fault2(xmlrpc_env *       const envP,
+                        xmlrpc_mem_block * const outputP,
+                        const xmlrpc_env * const faultP,
+                        xmlrpc_dialect     const dialect) {
 /*----------------------------------------------------------------------------
    Serialize a fault response to an XML-RPC call.
 
@@ -732,13 +1322,18 @@ xmlrpc_serialize_fault(xmlrpc_env *       const envP,
                                       (xmlrpc_int32) faultP->fault_code,
                                       "faultString", faultP->fault_string);
     if (!envP->fault_occurred) {
-        addString(envP, outputP, XML_PROLOGUE);
+        addString(envP, outputP, LINE(dialect, XML_DECL));
         if (!envP->fault_occurred) {
-            addString(envP, outputP, "<methodResponse>"CRLF"<fault>"CRLF);
+            addString(envP, outputP, LINE(dialect, "<methodResponse>"));
+            if (!envP->fault_occurred)
+                addString(envP, outputP, LINE(dialect, "<fault>"));
             if (!envP->fault_occurred) {
-                xmlrpc_serialize_value(envP, outputP, faultStructP);
+                xmlrpc_serialize_value2(envP, outputP, faultStructP,
+                                        dialect);
                 if (!envP->fault_occurred) {
                     addString(envP, outputP,
+                              dialect == xmlrpc_dialect_compact ?
+                              "</fault></methodResponse>" :
                               CRLF"</fault>"CRLF"</methodResponse>"CRLF);
                 }
             }
@@ -749,6 +1344,136 @@ xmlrpc_serialize_fault(xmlrpc_env *       const envP,
 
 
 
+void 
+xmlrpc_serialize_fault(xmlrpc_env *       const envP,
+                       xmlrpc_mem_block * const outputP,
+                       const xmlrpc_env * const faultP) {
+
+    xmlrpc_serialize_fault2(envP, outputP, faultP, xmlrpc_dialect_i8);
+}
+
+
+
+/*=========================================================================
+**  Serialization cache
+**=========================================================================
+*/
+
+static void
+freeze(xmlrpc_value * const valueP) {
+/*----------------------------------------------------------------------------
+   Mark *valueP and every value it contains as unmodifiable.
+
+   This can't fail, so we can do it last, once a cache is in place.
+-----------------------------------------------------------------------------*/
+    valueP->_frozen = true;
+
+    switch (valueP->_type) {
+    case XMLRPC_TYPE_ARRAY: {
+        size_t const size =
+            XMLRPC_MEMBLOCK_SIZE(xmlrpc_value *, &valueP->_block);
+        xmlrpc_value ** const items =
+            XMLRPC_MEMBLOCK_CONTENTS(xmlrpc_value *, &valueP->_block);
+
+        size_t i;
+
+        for (i = 0; i < size; ++i)
+            freeze(items[i]);
+    } break;
+    case XMLRPC_TYPE_STRUCT: {
+        size_t const size =
+            XMLRPC_MEMBLOCK_SIZE(_struct_member, &valueP->_block);
+        _struct_member * const members =
+            XMLRPC_MEMBLOCK_CONTENTS(_struct_member, &valueP->_block);
+
+        size_t i;
+
+        for (i = 0; i < size; ++i)
+            freeze(members[i].value);
+    } break;
+    default:
+        break;
+    }
+}
+
+
+
+void
+xmlrpc_destroySerialCache(xmlrpc_value * const valueP) {
+
+    struct xmlrpc_serialCache * const cacheP = valueP->_serialCacheP;
+
+    if (cacheP) {
+        if (cacheP->xmlP)
+            XMLRPC_MEMBLOCK_FREE(char, cacheP->xmlP);
+        if (cacheP->jsonP)
+            XMLRPC_MEMBLOCK_FREE(char, cacheP->jsonP);
+        free(cacheP);
+        valueP->_serialCacheP = NULL;
+    }
+}
+
+
+
+void
+xmlrpc_value_cache_serialization(xmlrpc_env *   const envP,
+                                 xmlrpc_value * const valueP,
+                                 xmlrpc_dialect const dialect,
+                                 xmlrpc_bool    const json) {
+/*----------------------------------------------------------------------------
+   Serialize *valueP and attach the result to it, so that
+   xmlrpc_serialize_value2() (and xmlrpc_serialize_json() if 'json') can
+   splice those bytes into their output instead of working through the
+   value again.
+
+   This is for large values that don't change and get sent over and over,
+   such as a lookup table a method returns in every response.
+
+   We freeze the value, since a cache of something that can change is
+   worthless.  Replaces any cache the value already has.  If we fail, we
+   leave the value as it was, neither frozen by us nor with a new cache.
+-----------------------------------------------------------------------------*/
+    struct xmlrpc_serialCache * cacheP;
+
+    XMLRPC_ASSERT_ENV_OK(envP);
+    XMLRPC_ASSERT_VALUE_OK(valueP);
+
+    MALLOCVAR(cacheP);
+
+    if (!cacheP)
+        xmlrpc_faultf(envP, "Could not allocate memory for "
+                      "serialization cache");
+    else {
+        cacheP->xmlDialect = dialect;
+        cacheP->jsonP      = NULL;
+
+        cacheP->xmlP = XMLRPC_MEMBLOCK_NEW(char, envP, 0);
+        if (!envP->fault_occurred) {
+            formatValueContent(envP, cacheP->xmlP, valueP, dialect, 1);
+
+            if (!envP->fault_occurred && json) {
+                cacheP->jsonP = XMLRPC_MEMBLOCK_NEW(char, envP, 0);
+                if (!envP->fault_occurred)
+                    xmlrpc_serialize_json(envP, valueP, cacheP->jsonP);
+            }
+            if (!envP->fault_occurred) {
+                xmlrpc_destroySerialCache(valueP);
+                valueP->_serialCacheP = cacheP;
+
+                freeze(valueP);
+            } else {
+                if (cacheP->jsonP)
+                    XMLRPC_MEMBLOCK_FREE(char, cacheP->jsonP);
+                XMLRPC_MEMBLOCK_FREE(char, cacheP->xmlP);
+            }
+        }
+        if (envP->fault_occurred)
+            free(cacheP);
+    }
+}
+
+
+
 /* Copyright (C) 2001 by First Peer, Inc. All rights reserved.
 **
 ** Redistribution and use in source and binary forms, with or without
@@ -146,6 +146,23 @@ processXmlrpcCall(xmlrpc_env *        const envP,
 
 
 
+static void
+processXmlrpcCallAsync(void *                    const arg,
+                       const char *              const callXml,
+                       size_t                    const callXmlLen,
+                       TSession *                const abyssSessionP,
+                       xmlrpc_call_response_fn * const responseFn,
+                       void *                    const responseContext) {
+
+    xmlrpc_registry * const registryP = arg;
+
+    xmlrpc_registry_process_call_async(registryP,
+                                       callXml, callXmlLen, abyssSessionP,
+                                       responseFn, responseContext);
+}
+
+
+
 static void
 setHandler(xmlrpc_env *              const envP,
            TServer *                 const srvP,
@@ -252,6 +269,12 @@ xmlrpc_server_abyss_set_handler3(
             uriHandlerXmlrpcP->chunkResponse = parmsP->chunk_response;
         else
             uriHandlerXmlrpcP->chunkResponse = false;
+
+        if (parmSize >= XMLRPC_AHPSIZE(xml_processor_async))
+            uriHandlerXmlrpcP->xmlProcessorAsync =
+                parmsP->xml_processor_async;
+        else
+            uriHandlerXmlrpcP->xmlProcessorAsync = NULL;
         
         interpretHttpAccessControl(parmsP, parmSize,
                                    &uriHandlerXmlrpcP->accessControl);
@@ -311,9 +334,14 @@ xmlrpc_server_abyss_set_handler(xmlrpc_env *      const envP,
     parms.xml_processor_arg = registryP;
     parms.xml_processor_max_stack = xmlrpc_registry_max_stackSize(registryP);
     parms.uri_path = uriPath;
+    parms.chunk_response = false;
+    parms.allow_origin = NULL;
+    parms.access_ctl_expires = false;
+    parms.access_ctl_max_age = 0;
+    parms.xml_processor_async = &processXmlrpcCallAsync;
 
-    xmlrpc_server_abyss_set_handler3(envP, srvP,
-                                     &parms, XMLRPC_AHPSIZE(uri_path));
+    xmlrpc_server_abyss_set_handler3(
+        envP, srvP, &parms, XMLRPC_AHPSIZE(xml_processor_async));
 }
 
     
@@ -348,9 +376,10 @@ setHandlersRegistry(TServer *         const srvP,
     parms.allow_origin = allowOrigin;
     parms.access_ctl_expires = expires;
     parms.access_ctl_max_age = maxAge;
+    parms.xml_processor_async = &processXmlrpcCallAsync;
 
     xmlrpc_server_abyss_set_handler3(
-        &env, srvP, &parms, XMLRPC_AHPSIZE(access_ctl_max_age));
+        &env, srvP, &parms, XMLRPC_AHPSIZE(xml_processor_async));
     
     if (env.fault_occurred)
         abort();
@@ -409,6 +438,16 @@ setAdditionalServerParms(const xmlrpc_server_abyss_parms * const parmsP,
         if (parmsP->max_conn_backlog != 0)
             ServerSetMaxConnBacklog(serverP, parmsP->max_conn_backlog);
     }
+    if (parmSize >= XMLRPC_APSIZE(event_driven))
+        ServerSetEventDriven(serverP, parmsP->event_driven);
+    if (parmSize >= XMLRPC_APSIZE(worker_threads))
+        ServerSetWorkerThreads(serverP, parmsP->worker_threads);
+    if (parmSize >= XMLRPC_APSIZE(acceptor_threads))
+        ServerSetAcceptorThreads(serverP, parmsP->acceptor_threads);
+    if (parmSize >= XMLRPC_APSIZE(read_buffer_size))
+        ServerSetReadBufferSize(serverP, parmsP->read_buffer_size);
+    if (parmSize >= XMLRPC_APSIZE(stats_uri))
+        ServerSetStatsUri(serverP, parmsP->stats_uri);
 }
 
 
@@ -523,6 +523,9 @@ xmlrpc_struct_set_value_v(xmlrpc_env *   const envP,
     else if (keyvalP->_type != XMLRPC_TYPE_STRING)
         xmlrpc_env_set_fault(envP, XMLRPC_TYPE_ERROR,
                              "Key value is not a string");
+    else if (structP->_frozen)
+        xmlrpc_faultf(envP, "Struct is frozen (it has a serialization "
+                      "cache), so you can't change its members");
     else {
         const char * const key =
             XMLRPC_MEMBLOCK_CONTENTS(char, &keyvalP->_block);
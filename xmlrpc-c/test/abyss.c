@@ -1,6 +1,7 @@
-/* None of the tests in here rely on a client existing, or even a network
-   connection.  We should figure out how to create a test client and do
-   such tests.
+/* Most of the tests in here don't rely on a client existing, or even a
+   network connection.  Where we have POSIX threads, the rest run a server
+   in a thread and talk HTTP to it over TCP connections on the loopback
+   interface.
 */
 #define WIN32_LEAN_AND_MEAN  /* required by xmlrpc-c/abyss.h */
 
@@ -11,12 +12,23 @@
 #include <netinet/in.h>
 #endif
 #include <errno.h>
+#include <stdlib.h>
 #include <string.h>
+#include <time.h>
 
 #include "xmlrpc_config.h"
 
+#if HAVE_PTHREAD
+#include <pthread.h>
+#include <fcntl.h>
+#include <arpa/inet.h>
+#endif
+
 #include "int.h"
+#include "c_util.h"
+#include "girstring.h"
 #include "casprintf.h"
+#include "xmlrpc-c/sleep_int.h"
 #include "xmlrpc-c/base.h"
 #include "xmlrpc-c/server.h"
 #include "xmlrpc-c/abyss.h"
@@ -380,6 +392,1134 @@ testServerCreate(void) {
 
 
 
+#if HAVE_PTHREAD
+
+struct testServer {
+/*----------------------------------------------------------------------------
+   A server listening on an ephemeral port of the loopback interface,
+   running in a thread of its own.
+-----------------------------------------------------------------------------*/
+    TServer server;
+    TChanSwitch * chanSwitchP;
+    int listenFd;
+    uint16_t port;
+    pthread_t thread;
+};
+
+
+
+static void
+respond(TSession *   const sessionP,
+        const char * const body) {
+
+    ResponseStatus(sessionP, 200);
+    ResponseContentType(sessionP, "text/plain");
+    ResponseContentLength(sessionP, strlen(body));
+    ResponseWriteStart(sessionP);
+    ResponseWriteBody(sessionP, body, strlen(body));
+    ResponseWriteEnd(sessionP);
+}
+
+
+
+static pthread_mutex_t deferredLock = PTHREAD_MUTEX_INITIALIZER;
+
+static TSession * deferredSessionP;
+    /* The session whose response the handler deferred, if any.  Protected
+       by 'deferredLock'.
+    */
+
+
+
+static TSession *
+deferredSession(void) {
+
+    TSession * sessionP;
+
+    pthread_mutex_lock(&deferredLock);
+
+    sessionP = deferredSessionP;
+
+    pthread_mutex_unlock(&deferredLock);
+
+    return sessionP;
+}
+
+
+
+static void
+handleTestReq(void *       const userdata ATTR_UNUSED,
+              TSession *   const sessionP,
+              abyss_bool * const handledP) {
+/*----------------------------------------------------------------------------
+   The request handler of the test server:
+
+     /hello          responds "hello"
+     /header?NAME    responds with the value of request header field NAME
+     /defer          defers the response, leaving the session for the test
+                     to complete
+
+   It leaves any other request to the default handler, which serves files.
+-----------------------------------------------------------------------------*/
+    const TRequestInfo * requestInfoP;
+
+    SessionGetRequestInfo(sessionP, &requestInfoP);
+
+    *handledP = TRUE;
+
+    if (streq(requestInfoP->uri, "/hello"))
+        respond(sessionP, "hello");
+    else if (streq(requestInfoP->uri, "/header")) {
+        const char * const value =
+            RequestHeaderValue(sessionP, requestInfoP->query);
+
+        respond(sessionP, value ? value : "(none)");
+    } else if (streq(requestInfoP->uri, "/defer")) {
+        if (SessionDefer(sessionP)) {
+            pthread_mutex_lock(&deferredLock);
+            deferredSessionP = sessionP;
+            pthread_mutex_unlock(&deferredLock);
+        } else
+            respond(sessionP, "not deferred");
+    } else
+        *handledP = FALSE;
+}
+
+
+
+static void
+createTestServer(struct testServer * const testServerP) {
+/*----------------------------------------------------------------------------
+   Create a test server.  Caller may configure it before startTestServer().
+-----------------------------------------------------------------------------*/
+    struct ServerReqHandler3 handler;
+    struct sockaddr_in sockAddr;
+    socklen_t sockAddrLen;
+    const char * error;
+    abyss_bool success;
+    int rc;
+
+    testServerP->listenFd = socket(AF_INET, SOCK_STREAM, 0);
+    TEST(testServerP->listenFd >= 0);
+
+    sockAddr.sin_family = AF_INET;
+    sockAddr.sin_port   = htons(0);
+    sockAddr.sin_addr   = test_ipAddrFromDecimal(127, 0, 0, 1);
+
+    rc = bind(testServerP->listenFd,
+              (struct sockaddr *)&sockAddr, sizeof(sockAddr));
+    TEST(rc == 0);
+
+    sockAddrLen = sizeof(sockAddr);
+    rc = getsockname(testServerP->listenFd,
+                     (struct sockaddr *)&sockAddr, &sockAddrLen);
+    TEST(rc == 0);
+
+    testServerP->port = ntohs(sockAddr.sin_port);
+
+    chanSwitchCreateFd(testServerP->listenFd, &testServerP->chanSwitchP,
+                       &error);
+    TEST_NULL_STRING(error);
+
+    ServerCreateSwitch(&testServerP->server, testServerP->chanSwitchP,
+                       &error);
+    TEST_NULL_STRING(error);
+
+    ServerSetAdvertise(&testServerP->server, FALSE);
+
+    handler.term               = NULL;
+    handler.handleReq          = &handleTestReq;
+    handler.userdata           = NULL;
+    handler.handleReqStackSize = 0;
+
+    ServerAddHandler3(&testServerP->server, &handler, &success);
+    TEST(success);
+}
+
+
+
+static void *
+runTestServer(void * const arg) {
+
+    struct testServer * const testServerP = arg;
+
+    ServerRun(&testServerP->server);
+
+    return NULL;
+}
+
+
+
+static void
+startTestServer(struct testServer * const testServerP) {
+
+    int rc;
+
+    ServerInit(&testServerP->server);
+
+    rc = pthread_create(&testServerP->thread, NULL, &runTestServer,
+                        testServerP);
+    TEST(rc == 0);
+}
+
+
+
+static void
+terminateTestServer(struct testServer * const testServerP) {
+/*----------------------------------------------------------------------------
+   Make the test server stop and wait for ServerRun() to return.
+-----------------------------------------------------------------------------*/
+    ServerTerminate(&testServerP->server);
+
+    pthread_join(testServerP->thread, NULL);
+}
+
+
+
+static void
+destroyTestServer(struct testServer * const testServerP) {
+
+    ServerFree(&testServerP->server);
+
+    ChanSwitchDestroy(testServerP->chanSwitchP);
+
+    closesock(testServerP->listenFd);
+}
+
+
+
+static int
+connectToServer(const struct testServer * const testServerP) {
+/*----------------------------------------------------------------------------
+   Open a client connection to the test server.  A read on it times out
+   after 10 seconds, so a test that fails doesn't hang.
+-----------------------------------------------------------------------------*/
+    struct sockaddr_in sockAddr;
+    struct timeval timeout;
+    int fd;
+    int rc;
+
+    fd = socket(AF_INET, SOCK_STREAM, 0);
+    TEST(fd >= 0);
+
+    timeout.tv_sec  = 10;
+    timeout.tv_usec = 0;
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+    sockAddr.sin_family = AF_INET;
+    sockAddr.sin_port   = htons(testServerP->port);
+    sockAddr.sin_addr   = test_ipAddrFromDecimal(127, 0, 0, 1);
+
+    rc = connect(fd, (struct sockaddr *)&sockAddr, sizeof(sockAddr));
+    TEST(rc == 0);
+
+    return fd;
+}
+
+
+
+static void
+sendString(int          const fd,
+           const char * const string) {
+
+    size_t const size = strlen(string);
+
+    size_t bytesSent;
+    bool failed;
+
+    for (bytesSent = 0, failed = FALSE; bytesSent < size && !failed; ) {
+        ssize_t const rc = write(fd, &string[bytesSent], size - bytesSent);
+
+        if (rc <= 0)
+            failed = TRUE;
+        else
+            bytesSent += rc;
+    }
+    TEST(!failed);
+}
+
+
+
+static size_t
+readToEof(int    const fd,
+          char * const buffer,
+          size_t const size) {
+/*----------------------------------------------------------------------------
+   Read from 'fd' until the server closes the connection, into 'buffer',
+   which is 'size' bytes, and NUL-terminate it.  Return the number of bytes
+   read.
+-----------------------------------------------------------------------------*/
+    size_t bytesRead;
+    bool eof;
+
+    for (bytesRead = 0, eof = FALSE; !eof && bytesRead < size - 1; ) {
+        ssize_t const rc = read(fd, &buffer[bytesRead], size - 1 - bytesRead);
+
+        if (rc <= 0)
+            eof = TRUE;
+        else
+            bytesRead += rc;
+    }
+    buffer[bytesRead] = '\0';
+
+    TEST(eof);
+
+    return bytesRead;
+}
+
+
+
+static void
+readResponse(int    const fd,
+             char * const buffer,
+             size_t const size) {
+/*----------------------------------------------------------------------------
+   Read one HTTP response, which must have a Content-length, from 'fd' into
+   'buffer', which is 'size' bytes, and NUL-terminate it.
+
+   We read the header a byte at a time so as not to read any of the next
+   response.
+-----------------------------------------------------------------------------*/
+    size_t bytesRead;
+    bool failed;
+
+    for (bytesRead = 0, failed = FALSE;
+         !failed && bytesRead < size - 1 &&
+             !(bytesRead >= 4 &&
+               memcmp(&buffer[bytesRead-4], "\r\n\r\n", 4) == 0); ) {
+        ssize_t const rc = read(fd, &buffer[bytesRead], 1);
+
+        if (rc <= 0)
+            failed = TRUE;
+        else
+            ++bytesRead;
+    }
+    buffer[bytesRead] = '\0';
+
+    if (!failed) {
+        const char * const contentLength = strstr(buffer, "Content-length: ");
+
+        TEST(contentLength != NULL);
+
+        if (contentLength) {
+            size_t const bodySize =
+                atoi(&contentLength[strlen("Content-length: ")]);
+
+            size_t const responseSize = bytesRead + bodySize;
+
+            while (!failed && bytesRead < responseSize &&
+                   bytesRead < size - 1) {
+                ssize_t const rc =
+                    read(fd, &buffer[bytesRead], responseSize - bytesRead);
+
+                if (rc <= 0)
+                    failed = TRUE;
+                else
+                    bytesRead += rc;
+            }
+            buffer[bytesRead] = '\0';
+        }
+    }
+    TEST(!failed);
+}
+
+
+
+static bool
+beginsWith(const char * const string,
+           const char * const prefix) {
+
+    return strncmp(string, prefix, strlen(prefix)) == 0;
+}
+
+
+
+static const char *
+responseBody(const char * const response) {
+
+    const char * const endOfHeader = strstr(response, "\r\n\r\n");
+
+    return endOfHeader ? endOfHeader + 4 : "";
+}
+
+
+
+static uint64_t
+histogramTotal(const uint64_t * const histogram) {
+
+    uint64_t total;
+    unsigned int i;
+
+    for (i = 0, total = 0; i < ABYSS_STATS_BUCKETS; ++i)
+        total += histogram[i];
+
+    return total;
+}
+
+
+
+static void
+testStatsServed(void) {
+
+    const char * const request =
+        "GET /hello HTTP/1.1\r\n"
+        "Host: localhost\r\n"
+        "Connection: close\r\n"
+        "\r\n";
+
+    struct testServer testServer;
+    TServerStats stats;
+    char response[4096];
+    size_t responseSize;
+    int fd;
+
+    createTestServer(&testServer);
+
+    startTestServer(&testServer);
+
+    fd = connectToServer(&testServer);
+
+    sendString(fd, request);
+
+    responseSize = readToEof(fd, response, sizeof(response));
+
+    TEST(beginsWith(response, "HTTP/1.1 200 OK\r\n"));
+    TEST(streq(responseBody(response), "hello"));
+
+    closesock(fd);
+
+    terminateTestServer(&testServer);
+
+    ServerGetStats(&testServer.server, &stats);
+
+    TEST(stats.connectionsAccepted == 1);
+    TEST(stats.connectionsOpen == 0);
+    TEST(stats.connectionsActive == 0);
+    TEST(stats.requests == 1);
+    TEST(stats.requestsOnReusedConn == 0);
+    TEST(stats.bytesIn == strlen(request));
+    TEST(stats.bytesOut == responseSize);
+    TEST(histogramTotal(stats.readTime) == 1);
+    TEST(histogramTotal(stats.parseTime) == 1);
+    TEST(histogramTotal(stats.handleTime) == 1);
+    TEST(histogramTotal(stats.writeTime) == 1);
+
+    destroyTestServer(&testServer);
+}
+
+
+
+static void
+testRequestHeaderValue(void) {
+/*----------------------------------------------------------------------------
+   Test RequestHeaderValue() on every header field Abyss knows and on ones
+   it doesn't.
+-----------------------------------------------------------------------------*/
+    static const char * const field[][3] = {
+        /* name in request, name to look up, value */
+        {"Authorization",     "authorization",     "Basic dXNlcjpwYXNz"},
+        {"Connection",        "connection",        "keep-alive"},
+        {"Content-Length",    "content-length",    "0"},
+        {"Content-Type",      "content-type",      "text/xml"},
+        {"Cookie",            "cookie",            "a=1"},
+        {"Cookies",           "cookies",           "b=2"},
+        {"Expect",            "expect",            "nothing"},
+        {"From",              "from",              "me@example.com"},
+        {"Host",              "host",              "localhost"},
+        {"If-Modified-Since", "if-modified-since",
+                                       "Sat, 01 Jan 2000 00:00:00 GMT"},
+        {"Range",             "range",             "bytes=0-1"},
+        {"Referer",           "referer",           "http://example.com/"},
+        {"User-Agent",        "user-agent",        "abyss-test"},
+        {"X-Unknown-1",       "x-unknown-1",       "first"},
+        {"X-Unknown-2",       "x-unknown-2",       "second"},
+    };
+    struct testServer testServer;
+    const char * fields;
+    unsigned int i;
+    int fd;
+
+    createTestServer(&testServer);
+
+    startTestServer(&testServer);
+
+    for (i = 0, fields = strdup(""); i < ARRAY_SIZE(field); ++i) {
+        const char * newFields;
+
+        casprintf(&newFields, "%s%s: %s\r\n",
+                  fields, field[i][0], field[i][2]);
+
+        strfree(fields);
+        fields = newFields;
+    }
+
+    fd = connectToServer(&testServer);
+
+    for (i = 0; i <= ARRAY_SIZE(field); ++i) {
+        /* The last time through, we look up a field that isn't there */
+        const char * const lookupName =
+            i < ARRAY_SIZE(field) ? field[i][1] : "x-absent";
+        const char * const expectedValue =
+            i < ARRAY_SIZE(field) ? field[i][2] : "(none)";
+
+        const char * request;
+        char response[4096];
+
+        casprintf(&request, "GET /header?%s HTTP/1.1\r\n%s"
+                  "X-Unknown-1: repeated\r\n"
+                  "\r\n",
+                  lookupName, fields);
+
+        sendString(fd, request);
+
+        readResponse(fd, response, sizeof(response));
+
+        TEST(beginsWith(response, "HTTP/1.1 200 OK\r\n"));
+        TEST(streq(responseBody(response), expectedValue));
+
+        strfree(request);
+    }
+    closesock(fd);
+
+    strfree(fields);
+
+    terminateTestServer(&testServer);
+
+    destroyTestServer(&testServer);
+}
+
+
+
+static void
+testLongHeader(void) {
+/*----------------------------------------------------------------------------
+   Test a request header too big for the initial 4K connection buffer,
+   which the server must grow, up to its 64K limit.
+-----------------------------------------------------------------------------*/
+    struct testServer testServer;
+    char * longValue;
+    static char response[16384];
+    unsigned int i;
+    int fd;
+
+    longValue = malloc(10000 + 1);
+    memset(longValue, 'x', 10000);
+    longValue[10000] = '\0';
+
+    createTestServer(&testServer);
+
+    startTestServer(&testServer);
+
+    fd = connectToServer(&testServer);
+
+    for (i = 0; i < 2; ++i) {
+        /* The first time, we look up the long field; the second time, a
+           field after it, i.e. past where the buffer grew.
+        */
+        const char * request;
+
+        casprintf(&request, "GET /header?%s HTTP/1.1\r\n"
+                  "Host: localhost\r\n"
+                  "X-Long: %s\r\n"
+                  "X-After: after\r\n"
+                  "\r\n",
+                  i == 0 ? "x-long" : "x-after", longValue);
+
+        sendString(fd, request);
+
+        readResponse(fd, response, sizeof(response));
+
+        TEST(beginsWith(response, "HTTP/1.1 200 OK\r\n"));
+        TEST(streq(responseBody(response), i == 0 ? longValue : "after"));
+
+        strfree(request);
+    }
+    closesock(fd);
+
+    free(longValue);
+
+    {
+        /* A header too big even for the biggest buffer is an error */
+        size_t const longSize = 70000;
+
+        const char * request;
+
+        longValue = malloc(longSize + 1);
+        memset(longValue, 'x', longSize);
+        longValue[longSize] = '\0';
+
+        fd = connectToServer(&testServer);
+
+        casprintf(&request, "GET /header?x-long HTTP/1.1\r\n"
+                  "X-Long: %s\r\n"
+                  "\r\n",
+                  longValue);
+
+        sendString(fd, request);
+
+        readToEof(fd, response, sizeof(response));
+
+        TEST(beginsWith(response, "HTTP/1.1 4"));
+
+        strfree(request);
+        closesock(fd);
+        free(longValue);
+    }
+    terminateTestServer(&testServer);
+
+    destroyTestServer(&testServer);
+}
+
+
+
+static void
+testPipelined(void) {
+/*----------------------------------------------------------------------------
+   Test two requests that arrive in one packet: the server must serve the
+   second from what it buffered reading the first, rather than wait for
+   more to arrive.
+-----------------------------------------------------------------------------*/
+    struct testServer testServer;
+    TServerStats stats;
+    char response[4096];
+    const char * secondP;
+    int fd;
+
+    createTestServer(&testServer);
+
+    startTestServer(&testServer);
+
+    fd = connectToServer(&testServer);
+
+    sendString(fd,
+               "GET /header?x-n HTTP/1.1\r\n"
+               "Host: localhost\r\n"
+               "X-N: one\r\n"
+               "\r\n"
+               "GET /header?x-n HTTP/1.1\r\n"
+               "Host: localhost\r\n"
+               "X-N: two\r\n"
+               "Connection: close\r\n"
+               "\r\n");
+
+    readToEof(fd, response, sizeof(response));
+
+    closesock(fd);
+
+    TEST(beginsWith(response, "HTTP/1.1 200 OK\r\n"));
+    TEST(strstr(response, "Connection: Keep-Alive\r\n") != NULL);
+
+    secondP = strstr(&response[1], "HTTP/1.1 ");
+    TEST(secondP != NULL);
+
+    if (secondP) {
+        TEST(beginsWith(secondP, "HTTP/1.1 200 OK\r\n"));
+        TEST(beginsWith(responseBody(response), "one"));
+        TEST(responseBody(response) + strlen("one") == secondP);
+        TEST(strstr(secondP, "Connection: close\r\n") != NULL);
+        TEST(streq(responseBody(secondP), "two"));
+    }
+    terminateTestServer(&testServer);
+
+    ServerGetStats(&testServer.server, &stats);
+
+    TEST(stats.connectionsAccepted == 1);
+    TEST(stats.requests == 2);
+    TEST(stats.requestsOnReusedConn == 1);
+
+    destroyTestServer(&testServer);
+}
+
+
+
+static bool
+isExpectedResponse(const char * const response,
+                   const char * const connectionFields,
+                   time_t       const earliest,
+                   time_t       const latest) {
+/*----------------------------------------------------------------------------
+   'response' is exactly the response to GET /hello that has connection
+   header fields 'connectionFields' and a Date of 'earliest' or 'latest'.
+-----------------------------------------------------------------------------*/
+    time_t const times[2] = {earliest, latest};
+
+    bool matches;
+    unsigned int i;
+
+    for (i = 0, matches = FALSE; i < 2 && !matches; ++i) {
+        char date[64];
+        const char * expected;
+
+        strftime(date, sizeof(date), "%a, %d %b %Y %H:%M:%S UTC",
+                 gmtime(&times[i]));
+
+        casprintf(&expected,
+                  "HTTP/1.1 200 OK\r\n"
+                  "Content-type: text/plain\r\n"
+                  "Content-length: 5\r\n"
+                  "%s"
+                  "Date: %s\r\n"
+                  "\r\n"
+                  "hello",
+                  connectionFields, date);
+
+        matches = streq(response, expected);
+
+        strfree(expected);
+    }
+    return matches;
+}
+
+
+
+static void
+testResponseHeader(void) {
+/*----------------------------------------------------------------------------
+   Test the exact bytes of a response header, both one that keeps the
+   connection alive and one that closes it.  The server composes the
+   connection fields ahead of time and caches the Date field.
+-----------------------------------------------------------------------------*/
+    struct testServer testServer;
+    char response[4096];
+    time_t earliest;
+    int fd;
+
+    createTestServer(&testServer);
+
+    ServerSetKeepaliveTimeout(&testServer.server, 7);
+    ServerSetKeepaliveMaxConn(&testServer.server, 9);
+
+    startTestServer(&testServer);
+
+    fd = connectToServer(&testServer);
+
+    earliest = time(NULL);
+
+    sendString(fd,
+               "GET /hello HTTP/1.1\r\n"
+               "Host: localhost\r\n"
+               "\r\n");
+
+    readResponse(fd, response, sizeof(response));
+
+    TEST(isExpectedResponse(response,
+                            "Connection: Keep-Alive\r\n"
+                            "Keep-Alive: timeout=7, max=9\r\n",
+                            earliest, time(NULL)));
+
+    earliest = time(NULL);
+
+    sendString(fd,
+               "GET /hello HTTP/1.1\r\n"
+               "Host: localhost\r\n"
+               "Connection: close\r\n"
+               "\r\n");
+
+    readToEof(fd, response, sizeof(response));
+
+    TEST(isExpectedResponse(response, "Connection: close\r\n",
+                            earliest, time(NULL)));
+
+    closesock(fd);
+
+    terminateTestServer(&testServer);
+
+    destroyTestServer(&testServer);
+}
+
+
+
+static void
+getFile(const struct testServer * const testServerP,
+        const char *              const range,
+        char *                    const response,
+        size_t                    const responseSize) {
+/*----------------------------------------------------------------------------
+   GET /data.bin from the test server, with Range header field value
+   'range' (NULL for none).
+-----------------------------------------------------------------------------*/
+    const char * request;
+    const char * rangeField;
+    int fd;
+
+    if (range)
+        casprintf(&rangeField, "Range: %s\r\n", range);
+    else
+        casprintf(&rangeField, "%s", "");
+
+    casprintf(&request, "GET /data.bin HTTP/1.1\r\n"
+              "Host: localhost\r\n"
+              "%s"
+              "Connection: close\r\n"
+              "\r\n",
+              rangeField);
+
+    fd = connectToServer(testServerP);
+
+    sendString(fd, request);
+
+    readToEof(fd, response, responseSize);
+
+    closesock(fd);
+
+    strfree(request);
+    strfree(rangeField);
+}
+
+
+
+static void
+testServeFileRanges(const struct testServer * const testServerP,
+                    const char *              const fileData,
+                    size_t                    const fileSize) {
+
+    size_t const responseSize = fileSize + 4096;
+
+    char * response;
+    const char * body;
+
+    response = malloc(responseSize);
+
+    getFile(testServerP, NULL, response, responseSize);
+
+    TEST(beginsWith(response, "HTTP/1.1 200 OK\r\n"));
+    body = responseBody(response);
+    TEST(memeq(body, fileData, fileSize));
+    TEST(body + fileSize == response + strlen(response));
+
+    getFile(testServerP, "bytes=5000-70000", response, responseSize);
+
+    TEST(beginsWith(response, "HTTP/1.1 206 "));
+    TEST(strstr(response, "Content-length: 65001\r\n") != NULL);
+    body = responseBody(response);
+    TEST(memeq(body, &fileData[5000], 65001));
+    TEST(body + 65001 == response + strlen(response));
+
+    free(response);
+}
+
+
+
+static void
+testServeFile(void) {
+/*----------------------------------------------------------------------------
+   Test serving a file, whole and a range of it starting past the
+   beginning.
+
+   We do it first the way the server normally does, which is with
+   sendfile() where the system has it, then with connection tracing on,
+   which makes the server read the file through a buffer instead.
+-----------------------------------------------------------------------------*/
+    size_t const fileSize = 100000;
+
+    struct testServer testServer;
+    char dirName[] = "/tmp/abyss_test_XXXXXX";
+    const char * fileName;
+    char * fileData;
+    unsigned int i;
+    int fd;
+
+    TEST(mkdtemp(dirName) != NULL);
+
+    casprintf(&fileName, "%s/data.bin", dirName);
+
+    fileData = malloc(fileSize);
+    for (i = 0; i < fileSize; ++i)
+        fileData[i] = 'a' + (i * 7 + i / 26) % 26;
+
+    fd = open(fileName, O_WRONLY | O_CREAT | O_TRUNC, 0600);
+    TEST(fd >= 0);
+    TEST(write(fd, fileData, fileSize) == (ssize_t)fileSize);
+    close(fd);
+
+    createTestServer(&testServer);
+
+    ServerSetFilesPath(&testServer.server, dirName);
+
+    startTestServer(&testServer);
+
+    testServeFileRanges(&testServer, fileData, fileSize);
+
+    {
+        int const saveStderr = dup(STDERR_FILENO);
+        int const devNull    = open("/dev/null", O_WRONLY);
+
+        /* The trace goes to Standard Error; we don't want to see it */
+        dup2(devNull, STDERR_FILENO);
+        setenv("ABYSS_TRACE_CONN", "1", 1);
+
+        testServeFileRanges(&testServer, fileData, fileSize);
+
+        unsetenv("ABYSS_TRACE_CONN");
+        dup2(saveStderr, STDERR_FILENO);
+        close(saveStderr);
+        close(devNull);
+    }
+    terminateTestServer(&testServer);
+
+    destroyTestServer(&testServer);
+
+    unlink(fileName);
+    rmdir(dirName);
+    strfree(fileName);
+    free(fileData);
+}
+
+
+
+static void
+testShutdownPooled(void) {
+/*----------------------------------------------------------------------------
+   Test terminating a server whose worker pool threads are waiting on
+   kept-alive connections for another request.  The server must interrupt
+   them rather than wait out the keepalive timeout, even as a client
+   closes its connection, which makes the connection destroy its channel,
+   at the same time.
+-----------------------------------------------------------------------------*/
+    unsigned int const workerCount = 2;
+
+    unsigned int iteration;
+
+    for (iteration = 0; iteration < 10; ++iteration) {
+        struct testServer testServer;
+        char response[4096];
+        int fds[2];
+        time_t startTime;
+        unsigned int i;
+
+        createTestServer(&testServer);
+
+        ServerSetWorkerThreads(&testServer.server, workerCount);
+        ServerSetKeepaliveTimeout(&testServer.server, 60);
+
+        startTestServer(&testServer);
+
+        for (i = 0; i < workerCount; ++i) {
+            fds[i] = connectToServer(&testServer);
+
+            sendString(fds[i],
+                       "GET /hello HTTP/1.1\r\n"
+                       "Host: localhost\r\n"
+                       "\r\n");
+
+            readResponse(fds[i], response, sizeof(response));
+
+            TEST(beginsWith(response, "HTTP/1.1 200 OK\r\n"));
+        }
+        startTime = time(NULL);
+
+        closesock(fds[0]);
+
+        terminateTestServer(&testServer);
+
+        TEST(time(NULL) - startTime < 10);
+
+        /* The server closed the other connection */
+        TEST(read(fds[1], response, sizeof(response)) == 0);
+
+        closesock(fds[1]);
+
+        destroyTestServer(&testServer);
+    }
+}
+
+
+
+#if HAVE_EPOLL
+
+static void
+sendSlowly(int          const fd,
+           const char * const string) {
+/*----------------------------------------------------------------------------
+   Send 'string' a few bytes at a time, with a pause after each.
+-----------------------------------------------------------------------------*/
+    size_t const size = strlen(string);
+
+    size_t pos;
+
+    for (pos = 0; pos < size; pos += 7) {
+        char piece[8];
+
+        STRSCPY(piece, &string[pos]);
+
+        sendString(fd, piece);
+
+        xmlrpc_millisecond_sleep(20);
+    }
+}
+
+
+
+static void
+testEventLoop(void) {
+/*----------------------------------------------------------------------------
+   Test an event-driven server with just one worker thread.  A client that
+   sends only part of a request must not keep the worker from serving
+   other clients, and the server must close its connection when the
+   request timeout expires.
+-----------------------------------------------------------------------------*/
+    const char * const request =
+        "GET /header?x-n HTTP/1.1\r\n"
+        "Host: localhost\r\n"
+        "X-N: %u\r\n"
+        "\r\n";
+
+    struct testServer testServer;
+    TServerStats stats;
+    char response[4096];
+    time_t startTime;
+    int stalledFd;
+    int fd;
+    unsigned int i;
+
+    createTestServer(&testServer);
+
+    ServerSetEventDriven(&testServer.server, TRUE);
+    ServerSetMaxConn(&testServer.server, 1);
+    ServerSetTimeout(&testServer.server, 5);
+
+    startTestServer(&testServer);
+
+    startTime = time(NULL);
+
+    stalledFd = connectToServer(&testServer);
+
+    sendString(stalledFd, "GET /hello HTTP/1.1\r\nHo");
+
+    fd = connectToServer(&testServer);
+
+    for (i = 0; i < 3; ++i) {
+        /* Several requests on one kept-alive connection, one of them
+           arriving in pieces
+        */
+        const char * thisRequest;
+        const char * expectedBody;
+
+        casprintf(&thisRequest, request, i);
+        casprintf(&expectedBody, "%u", i);
+
+        if (i == 1)
+            sendSlowly(fd, thisRequest);
+        else
+            sendString(fd, thisRequest);
+
+        readResponse(fd, response, sizeof(response));
+
+        TEST(beginsWith(response, "HTTP/1.1 200 OK\r\n"));
+        TEST(streq(responseBody(response), expectedBody));
+
+        strfree(expectedBody);
+        strfree(thisRequest);
+    }
+    closesock(fd);
+
+    /* The stalled request didn't hold up the others */
+    TEST(time(NULL) - startTime < 3);
+
+    /* The server gives up on the stalled request, without a response */
+    TEST(read(stalledFd, response, sizeof(response)) == 0);
+    TEST(time(NULL) - startTime >= 4);
+
+    closesock(stalledFd);
+
+    terminateTestServer(&testServer);
+
+    ServerGetStats(&testServer.server, &stats);
+
+    TEST(stats.requests == 3);
+    TEST(stats.requestsOnReusedConn == 2);
+
+    destroyTestServer(&testServer);
+}
+
+
+static void
+testTerminateDeferred(void) {
+/*----------------------------------------------------------------------------
+   Test terminating an event-driven server while a response is deferred:
+   the server must give up waiting for it after its request timeout, and
+   the connection must get closed when the response completes afterward.
+-----------------------------------------------------------------------------*/
+    struct testServer testServer;
+    char response[4096];
+    TSession * sessionP;
+    time_t startTime;
+    int fd;
+
+    createTestServer(&testServer);
+
+    ServerSetEventDriven(&testServer.server, TRUE);
+    ServerSetTimeout(&testServer.server, 1);
+
+    startTestServer(&testServer);
+
+    fd = connectToServer(&testServer);
+
+    sendString(fd,
+               "GET /defer HTTP/1.1\r\n"
+               "Host: localhost\r\n"
+               "\r\n");
+
+    while (!deferredSession())
+        xmlrpc_millisecond_sleep(10);
+
+    startTime = time(NULL);
+
+    terminateTestServer(&testServer);
+
+    TEST(time(NULL) - startTime < 5);
+
+    sessionP = deferredSession();
+
+    deferredSessionP = NULL;
+
+    respond(sessionP, "late");
+
+    SessionComplete(sessionP);
+
+    /* The connection is closed now, whether the response got out or not */
+    readToEof(fd, response, sizeof(response));
+
+    closesock(fd);
+
+    destroyTestServer(&testServer);
+}
+
+
+#endif  /* HAVE_EPOLL */
+
+
+
+static void
+testServing(void) {
+/*----------------------------------------------------------------------------
+   Test a server serving real HTTP requests.
+-----------------------------------------------------------------------------*/
+    testStatsServed();
+
+    testRequestHeaderValue();
+
+    testLongHeader();
+
+    testPipelined();
+
+    testResponseHeader();
+
+    testServeFile();
+
+    testShutdownPooled();
+
+#if HAVE_EPOLL
+    testEventLoop();
+
+    testTerminateDeferred();
+#endif
+}
+
+#endif  /* HAVE_PTHREAD */
+
+
+
 void
 test_abyss(void) {
 
@@ -406,6 +1546,10 @@ test_abyss(void) {
 
     testServerCreate();
 
+#if HAVE_PTHREAD
+    testServing();
+#endif
+
     ChannelTerm();
     ChanSwitchTerm();
     AbyssTerm();
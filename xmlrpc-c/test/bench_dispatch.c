@@ -0,0 +1,164 @@
+/*=============================================================================
+                               bench_dispatch
+===============================================================================
+  Measure how long the method registry takes to process a call, as a
+  function of how many methods are registered.
+
+  Each call is a small XML-RPC call to a different registered method, so
+  what changes with the registry size is the cost of finding the method.
+
+  Example:
+
+    bench_dispatch 100000
+=============================================================================*/
+
+#include <stdlib.h>
+#include <stdio.h>
+
+#include "casprintf.h"
+
+#include "xmlrpc_config.h"
+#include "xmlrpc-c/base.h"
+#include "xmlrpc-c/server.h"
+#include "xmlrpc-c/time_int.h"
+
+
+
+static xmlrpc_value *
+benchMethod(xmlrpc_env *   const envP,
+            xmlrpc_value * const paramArrayP ATTR_UNUSED,
+            void *         const serverInfo ATTR_UNUSED,
+            void *         const callInfo ATTR_UNUSED) {
+
+    return xmlrpc_nil_new(envP);
+}
+
+
+
+static void
+die(xmlrpc_env * const envP) {
+
+    fprintf(stderr, "Failed.  %s\n", envP->fault_string);
+    exit(1);
+}
+
+
+
+static void
+makeCalls(xmlrpc_env *         const envP,
+          unsigned int         const methodCount,
+          xmlrpc_mem_block *** const callsPP) {
+/*----------------------------------------------------------------------------
+   Serialize a call of each of the 'methodCount' benchmark methods.
+-----------------------------------------------------------------------------*/
+    xmlrpc_mem_block ** callP;
+    xmlrpc_value * paramArrayP;
+    unsigned int i;
+
+    callP = malloc(methodCount * sizeof(callP[0]));
+
+    paramArrayP = xmlrpc_array_new(envP);
+
+    for (i = 0; i < methodCount && !envP->fault_occurred; ++i) {
+        const char * methodName;
+
+        casprintf(&methodName, "bench.method%u", i);
+
+        callP[i] = xmlrpc_mem_block_new(envP, 0);
+
+        if (!envP->fault_occurred)
+            xmlrpc_serialize_call(envP, callP[i], methodName, paramArrayP);
+
+        strfree(methodName);
+    }
+    xmlrpc_DECREF(paramArrayP);
+
+    *callsPP = callP;
+}
+
+
+
+static void
+runBenchmark(unsigned int const methodCount,
+             unsigned int const callCount) {
+
+    xmlrpc_env env;
+    xmlrpc_registry * registryP;
+    xmlrpc_mem_block ** callP;
+    xmlrpc_timespec start, end;
+    double elapsed;
+    unsigned int i;
+
+    xmlrpc_env_init(&env);
+
+    registryP = xmlrpc_registry_new(&env);
+
+    for (i = 0; i < methodCount && !env.fault_occurred; ++i) {
+        const char * methodName;
+
+        casprintf(&methodName, "bench.method%u", i);
+
+        xmlrpc_registry_add_method2(&env, registryP, methodName,
+                                    benchMethod, NULL, NULL, NULL);
+        strfree(methodName);
+    }
+    if (env.fault_occurred)
+        die(&env);
+
+    makeCalls(&env, methodCount, &callP);
+
+    if (env.fault_occurred)
+        die(&env);
+
+    xmlrpc_gettimeofday(&start);
+
+    for (i = 0; i < callCount && !env.fault_occurred; ++i) {
+        /* Stride through the methods so we don't favor any part of the
+           registry.
+        */
+        xmlrpc_mem_block * const thisCallP =
+            callP[(i * 7919u) % methodCount];
+
+        xmlrpc_mem_block * responseP;
+
+        xmlrpc_registry_process_call2(&env, registryP,
+                                      xmlrpc_mem_block_contents(thisCallP),
+                                      xmlrpc_mem_block_size(thisCallP),
+                                      NULL, &responseP);
+        if (!env.fault_occurred)
+            xmlrpc_mem_block_free(responseP);
+    }
+    if (env.fault_occurred)
+        die(&env);
+
+    xmlrpc_gettimeofday(&end);
+
+    elapsed = (end.tv_sec - start.tv_sec) +
+        (end.tv_nsec - start.tv_nsec) / 1e9;
+
+    printf("%6u methods: %u calls in %.3f s, %.2f us per call\n",
+           methodCount, callCount, elapsed, elapsed * 1e6 / callCount);
+
+    for (i = 0; i < methodCount; ++i)
+        xmlrpc_mem_block_free(callP[i]);
+    free(callP);
+
+    xmlrpc_registry_free(registryP);
+
+    xmlrpc_env_clean(&env);
+}
+
+
+
+int
+main(int           const argc,
+     const char ** const argv) {
+
+    unsigned int const callCount = argc > 1 ? atoi(argv[1]) : 100000;
+
+    runBenchmark(10,    callCount);
+    runBenchmark(1000,  callCount);
+    runBenchmark(10000, callCount);
+
+    return 0;
+}
@@ -5,7 +5,14 @@
   
 =============================================================================*/
 
+#include "xmlrpc_config.h"
+
 #include <string>
+#include <vector>
+#if HAVE_PTHREAD
+#include <pthread.h>
+#include <unistd.h>
+#endif
 
 #include "xmlrpc-c/girerr.hpp"
 using girerr::error;
@@ -239,6 +246,54 @@ public:
 
 
 
+class countingAddMethod : public method {
+/*----------------------------------------------------------------------------
+   sample.add that is idempotent and counts its executions.
+-----------------------------------------------------------------------------*/
+public:
+    countingAddMethod(unsigned int * const countP) : countP(countP) {
+        this->_signature = "i:ii";
+        this->_idempotent = true;
+    }
+    void
+    execute(xmlrpc_c::paramList const& paramList,
+            value *             const  retvalP) {
+        
+        int const addend(paramList.getInt(0));
+        int const adder(paramList.getInt(1));
+        
+        paramList.verifyEnd(2);
+
+        ++*this->countP;
+        
+        *retvalP = value_int(addend + adder);
+    }
+private:
+    unsigned int * const countP;
+};
+
+
+
+class trackedAddMethod : public countingAddMethod {
+/*----------------------------------------------------------------------------
+   countingAddMethod that records when it is destroyed.
+-----------------------------------------------------------------------------*/
+public:
+    trackedAddMethod(unsigned int * const countP,
+                     bool *         const destroyedP) :
+        countingAddMethod(countP), destroyedP(destroyedP) {
+
+        *this->destroyedP = false;
+    }
+    ~trackedAddMethod() {
+        *this->destroyedP = true;
+    }
+private:
+    bool * const destroyedP;
+};
+
+
+
 class sampleAddMethod2 : public method2 {
 public:
     sampleAddMethod2() {
@@ -261,6 +316,28 @@ public:
 
 
 
+class sampleAddMethodAsync : public methodAsync {
+public:
+    sampleAddMethodAsync() {
+        this->_signature = "i:ii";
+        this->_help = "This method adds two integers together";
+    }
+    void
+    execute(xmlrpc_c::paramList const& paramList,
+            const callInfo *    const,
+            callCompletion      const& completion) {
+        
+        int const addend(paramList.getInt(0));
+        int const adder(paramList.getInt(1));
+        
+        paramList.verifyEnd(2);
+        
+        completion.complete(value_int(addend + adder));
+    }
+};
+
+
+
 class testCallInfoMethod : public method2 {
 public:
     testCallInfoMethod() {
@@ -437,6 +514,432 @@ public:
 
 
 
+class methodAsyncTestSuite : public testSuite {
+
+public:
+    virtual string suiteName() {
+        return "methodAsyncTestSuite";
+    }
+    virtual void runtests(unsigned int const) {
+
+        xmlrpc_c::registry myRegistry;
+        
+        myRegistry.addMethod("sample.add", 
+                             xmlrpc_c::methodPtr(new sampleAddMethodAsync));
+        {
+            string response;
+            myRegistry.processCall(sampleAddGoodCallXml, &response);
+            TEST(response == sampleAddGoodResponseXml);
+        }
+        {
+            string response;
+            myRegistry.processCall(sampleAddBadCallXml, &response);
+            TEST(response == sampleAddBadResponseXml);
+        }
+    }
+};
+
+
+
+class methodStatsTestSuite : public testSuite {
+
+public:
+    virtual string suiteName() {
+        return "methodStatsTestSuite";
+    }
+    virtual void runtests(unsigned int const) {
+
+        xmlrpc_c::registry myRegistry;
+        
+        myRegistry.addMethod("sample.add", 
+                             xmlrpc_c::methodPtr(new sampleAddMethod));
+        {
+            string response;
+            myRegistry.processCall(sampleAddGoodCallXml, &response);
+            myRegistry.processCall(sampleAddBadCallXml, &response);
+        }
+        xmlrpc_method_stats const stats(myRegistry.methodStats("sample.add"));
+
+        TEST(stats.calls == 2);
+        TEST(stats.faults == 1);
+        TEST(stats.callBytes ==
+             sampleAddGoodCallXml.size() + sampleAddBadCallXml.size());
+        TEST(stats.responseBytes ==
+             sampleAddGoodResponseXml.size() +
+             sampleAddBadResponseXml.size());
+
+        EXPECT_ERROR(myRegistry.methodStats("sample.nosuch"););
+
+        myRegistry.enableStatsMethod();
+    }
+};
+
+
+
+class responseCacheTestSuite : public testSuite {
+
+public:
+    virtual string suiteName() {
+        return "responseCacheTestSuite";
+    }
+    virtual void runtests(unsigned int const) {
+
+        xmlrpc_c::registry myRegistry;
+        unsigned int count;
+
+        count = 0;
+
+        myRegistry.addMethod(
+            "sample.add", xmlrpc_c::methodPtr(new countingAddMethod(&count)));
+        myRegistry.setResponseCache(100000, 60);
+        {
+            string response;
+            myRegistry.processCall(sampleAddGoodCallXml, &response);
+            TEST(response == sampleAddGoodResponseXml);
+            myRegistry.processCall(sampleAddGoodCallXml, &response);
+            TEST(response == sampleAddGoodResponseXml);
+        }
+        TEST(count == 1);
+
+        myRegistry.setResponseCache(0, 0);
+        {
+            string response;
+            myRegistry.processCall(sampleAddGoodCallXml, &response);
+            TEST(response == sampleAddGoodResponseXml);
+        }
+        TEST(count == 2);
+    }
+};
+
+
+
+class callLimitTestSuite : public testSuite {
+
+public:
+    virtual string suiteName() {
+        return "callLimitTestSuite";
+    }
+    virtual void runtests(unsigned int const) {
+
+        xmlrpc_c::registry myRegistry;
+        
+        myRegistry.addMethod("sample.add", 
+                             xmlrpc_c::methodPtr(new sampleAddMethod));
+
+        myRegistry.setMethodLimit("sample.add", 2, 10);
+        myRegistry.setAdaptiveLimit(1, 100);
+
+        EXPECT_ERROR(myRegistry.setMethodLimit("sample.nosuch", 1, 0););
+        EXPECT_ERROR(myRegistry.setAdaptiveLimit(0, 1););
+        {
+            string response;
+            myRegistry.processCall(sampleAddGoodCallXml, &response);
+            TEST(response == sampleAddGoodResponseXml);
+        }
+    }
+};
+
+
+
+class checkParamsTestSuite : public testSuite {
+
+public:
+    virtual string suiteName() {
+        return "checkParamsTestSuite";
+    }
+    virtual void runtests(unsigned int const) {
+
+        xmlrpc_c::registry myRegistry;
+        unsigned int count;
+
+        count = 0;
+
+        myRegistry.addMethod(
+            "sample.add", xmlrpc_c::methodPtr(new countingAddMethod(&count)));
+        myRegistry.setCheckParams(true);
+        {
+            string response;
+            myRegistry.processCall(sampleAddGoodCallXml, &response);
+            TEST(response == sampleAddGoodResponseXml);
+            myRegistry.processCall(sampleAddBadCallXml, &response);
+            TEST(response != sampleAddBadResponseXml);
+            TEST(response.find("-501") != string::npos);
+        }
+        TEST(count == 1);
+    }
+};
+
+
+
+class replaceMethodTestSuite : public testSuite {
+
+public:
+    virtual string suiteName() {
+        return "replaceMethodTestSuite";
+    }
+    virtual void runtests(unsigned int const) {
+
+        xmlrpc_c::registry myRegistry;
+        unsigned int count1, count2;
+        bool destroyed1, destroyed2;
+        string response;
+
+        count1 = 0;
+        count2 = 0;
+
+        myRegistry.addMethod(
+            "sample.add",
+            xmlrpc_c::methodPtr(new trackedAddMethod(&count1, &destroyed1)));
+        myRegistry.replaceMethod(
+            "sample.add",
+            xmlrpc_c::methodPtr(new trackedAddMethod(&count2, &destroyed2)));
+
+        // The registry doesn't keep a method object it no longer needs
+        TEST(destroyed1);
+        TEST(!destroyed2);
+
+        myRegistry.processCall(sampleAddGoodCallXml, &response);
+        TEST(response == sampleAddGoodResponseXml);
+        TEST(count1 == 0);
+        TEST(count2 == 1);
+
+        myRegistry.removeMethod("sample.add");
+        TEST(destroyed2);
+
+        myRegistry.processCall(sampleAddGoodCallXml, &response);
+        TEST(response.find("-506") != string::npos);
+        TEST(count2 == 1);
+
+        EXPECT_ERROR(  // no such method
+            myRegistry.removeMethod("sample.add");
+            );
+    }
+};
+
+
+
+#if HAVE_PTHREAD
+
+class orderMethod : public method {
+/*----------------------------------------------------------------------------
+   A method that records that it executed, in a list of the methods that
+   did, in order.
+-----------------------------------------------------------------------------*/
+public:
+    orderMethod(string          const  tag,
+                xmlrpc_priority const  priority,
+                vector<string> * const orderP,
+                pthread_mutex_t * const mutexP) :
+        tag(tag), orderP(orderP), mutexP(mutexP) {
+
+        this->_priority = priority;
+    }
+    void
+    execute(xmlrpc_c::paramList const&,
+            value *             const  retvalP) {
+
+        pthread_mutex_lock(this->mutexP);
+        this->orderP->push_back(this->tag);
+        pthread_mutex_unlock(this->mutexP);
+
+        *retvalP = value_nil();
+    }
+private:
+    string const tag;
+    vector<string> * const orderP;
+    pthread_mutex_t * const mutexP;
+};
+
+
+
+class holdMethod : public method {
+/*----------------------------------------------------------------------------
+   A method that doesn't finish until *releasedP is true.
+-----------------------------------------------------------------------------*/
+public:
+    holdMethod(bool *            const releasedP,
+               pthread_mutex_t * const mutexP) :
+        releasedP(releasedP), mutexP(mutexP) {}
+
+    void
+    execute(xmlrpc_c::paramList const&,
+            value *             const  retvalP) {
+
+        bool released;
+
+        do {
+            pthread_mutex_lock(this->mutexP);
+            released = *this->releasedP;
+            pthread_mutex_unlock(this->mutexP);
+
+            if (!released)
+                usleep(1000);
+        } while (!released);
+
+        *retvalP = value_nil();
+    }
+private:
+    bool * const releasedP;
+    pthread_mutex_t * const mutexP;
+};
+
+
+
+struct callThreadArg {
+    const registry * registryP;
+    string callXml;
+};
+
+
+
+static void *
+callThread(void * const arg) {
+
+    callThreadArg * const argP(static_cast<callThreadArg *>(arg));
+
+    string response;
+
+    argP->registryP->processCall(argP->callXml, &response);
+
+    return NULL;
+}
+
+
+
+static string
+noParamCallXml(string const& methodName) {
+
+    return
+        xmlPrologue +
+        "<methodCall>\r\n"
+        "<methodName>" + methodName + "</methodName>\r\n"
+        "<params>\r\n"
+        "</params>\r\n"
+        "</methodCall>\r\n";
+}
+
+
+
+static void
+waitForStats(const registry & registry,
+             xmlrpc_priority  const priority,
+             unsigned int     const calls,
+             unsigned int     const waiting) {
+/*----------------------------------------------------------------------------
+   Wait until the scheduler has started 'calls' calls of priority
+   'priority' and has 'waiting' of them waiting.
+-----------------------------------------------------------------------------*/
+    xmlrpc_priority_stats stats;
+
+    do {
+        stats = registry.priorityStats(priority);
+
+        if (stats.calls != calls || stats.waiting != waiting)
+            usleep(1000);
+    } while (stats.calls != calls || stats.waiting != waiting);
+}
+
+#endif
+
+
+
+class schedulerTestSuite : public testSuite {
+
+public:
+    virtual string suiteName() {
+        return "schedulerTestSuite";
+    }
+    virtual void runtests(unsigned int const) {
+
+        registry myRegistry;
+
+        EXPECT_ERROR(  // wrong number of weights
+            myRegistry.setScheduler(1, vector<unsigned int>(2, 1));
+            );
+        EXPECT_ERROR(  // zero weight
+            myRegistry.setScheduler(1, vector<unsigned int>(3, 0));
+            );
+
+        TEST(myRegistry.priorityStats(xmlrpc_priority_high).calls == 0);
+
+#if HAVE_PTHREAD
+        // With one call executing, a high priority call goes ahead of low
+        // priority ones that arrived before it.
+
+        pthread_mutex_t mutex;
+        vector<string> order;
+        bool released;
+
+        pthread_mutex_init(&mutex, NULL);
+        released = false;
+
+        myRegistry.setScheduler(1);
+
+        myRegistry.addMethod("test.hold",
+                             methodPtr(new holdMethod(&released, &mutex)));
+        myRegistry.addMethod("test.high",
+                             methodPtr(new orderMethod(
+                                           "high", xmlrpc_priority_high,
+                                           &order, &mutex)));
+        myRegistry.addMethod("test.low",
+                             methodPtr(new orderMethod(
+                                           "low", xmlrpc_priority_low,
+                                           &order, &mutex)));
+
+        string const methodName[4] = {
+            "test.hold", "test.low", "test.low", "test.high"
+        };
+        callThreadArg arg[4];
+        pthread_t thread[4];
+
+        for (unsigned int i = 0; i < 4; ++i) {
+            arg[i].registryP = &myRegistry;
+            arg[i].callXml   = noParamCallXml(methodName[i]);
+
+            pthread_create(&thread[i], NULL, &callThread, &arg[i]);
+
+            switch (i) {
+            case 0: waitForStats(myRegistry, xmlrpc_priority_normal, 1, 0);
+                break;
+            case 1: waitForStats(myRegistry, xmlrpc_priority_low, 0, 1);
+                break;
+            case 2: waitForStats(myRegistry, xmlrpc_priority_low, 0, 2);
+                break;
+            case 3: waitForStats(myRegistry, xmlrpc_priority_high, 0, 1);
+                break;
+            }
+        }
+        pthread_mutex_lock(&mutex);
+        released = true;
+        pthread_mutex_unlock(&mutex);
+
+        for (unsigned int i = 0; i < 4; ++i)
+            pthread_join(thread[i], NULL);
+
+        TEST(order.size() == 3);
+        TEST(order[0] == "high");
+        TEST(order[1] == "low");
+        TEST(order[2] == "low");
+
+        xmlrpc_priority_stats const highStats(
+            myRegistry.priorityStats(xmlrpc_priority_high));
+        xmlrpc_priority_stats const lowStats(
+            myRegistry.priorityStats(xmlrpc_priority_low));
+
+        TEST(highStats.calls == 1);
+        TEST(highStats.waited == 1);
+        TEST(lowStats.calls == 2);
+        TEST(lowStats.waited == 2);
+        TEST(lowStats.waiting == 0);
+        TEST(lowStats.maxWaitUsec >= highStats.maxWaitUsec);
+
+        pthread_mutex_destroy(&mutex);
+#endif
+    }
+};
+
+
+
 class dialectTestSuite : public testSuite {
 
 public:
@@ -531,6 +1034,17 @@ registryTestSuite::runtests(unsigned int const indentation) {
 
     method2TestSuite().run(indentation+1);
 
+    methodAsyncTestSuite().run(indentation+1);
+
+    methodStatsTestSuite().run(indentation+1);
+
+    responseCacheTestSuite().run(indentation+1);
+
+    callLimitTestSuite().run(indentation+1);
+    checkParamsTestSuite().run(indentation+1);
+    replaceMethodTestSuite().run(indentation+1);
+    schedulerTestSuite().run(indentation+1);
+
     registry myRegistry;
 
     myRegistry.disableIntrospection();
@@ -327,6 +327,11 @@ public:
                                     .logFileName("/tmp/logfile")
                                     .serverOwnsSignals(false)
                                     .expectSigchld(true)
+                                    .eventDriven(true)
+                                    .workerThreads(4)
+                                    .acceptorThreads(2)
+                                    .readBufferSize(65536)
+                                    .statsUri("/stats")
                 );
     
         }
@@ -568,6 +568,56 @@ testNoWaitCall(registry const& myRegistry) {
 
 
 
+static void
+testPipelinedCalls(registry const& myRegistry) {
+/*----------------------------------------------------------------------------
+   Here the client sends two calls without waiting for a response.  The
+   server should execute both at once and respond to them in order.
+-----------------------------------------------------------------------------*/
+    string const sampleAddGoodCallStream(
+        packetStart + sampleAddCallXml + packetEnd
+        );
+
+    string const sampleAddGoodResponseStream(
+        packetStart + sampleAddResponseXml + packetEnd
+        );
+
+    client client;
+
+    serverPstreamConn server(serverPstreamConn::constrOpt()
+                             .registryP(&myRegistry)
+                             .socketFd(client.serverFd));
+
+    client.sendCall(sampleAddGoodCallStream + sampleAddGoodCallStream);
+
+    bool eof;
+    bool gotOne;
+
+    server.runOnceNoWait(&eof, &gotOne);
+
+    TEST(!eof);
+    TEST(gotOne);
+
+    string response;
+    client.recvResp(&response);
+
+    TEST(response ==
+         sampleAddGoodResponseStream + sampleAddGoodResponseStream);
+
+    server.runOnceNoWait(&eof, &gotOne);
+
+    TEST(!eof);
+    TEST(!gotOne);
+
+    client.hangup();
+
+    server.runOnce(&eof);
+
+    TEST(eof);
+}
+
+
+
 static void
 testMultiRpcRunNoRpc(registry const& myRegistry) {
 
@@ -681,6 +731,8 @@ public:
 
         testNoWaitCall(myRegistry);
 
+        testPipelinedCalls(myRegistry);
+
         testMultiRpcRunNoRpc(myRegistry);
 
         testMultiRpcRunOneRpc(myRegistry);
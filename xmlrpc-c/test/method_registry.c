@@ -1,12 +1,19 @@
+#include <stdarg.h>
 #include <stdlib.h>
 #include <string.h>
 
 #include "int.h"
+#include "c_util.h"
 #include "casprintf.h"
 #include "girstring.h"
 
 #include "xmlrpc_config.h"
 
+#if HAVE_PTHREAD
+#include <pthread.h>
+#endif
+
+#include "xmlrpc-c/sleep_int.h"
 #include "xmlrpc-c/base.h"
 #include "xmlrpc-c/server.h"
 
@@ -874,6 +881,96 @@ test_system_multicall(xmlrpc_registry * const registryP) {
 
 
 
+static void
+testParallelMulticall(xmlrpc_registry * const registryP) {
+/*----------------------------------------------------------------------------
+   Test system.multicall executing its calls on several threads.
+-----------------------------------------------------------------------------*/
+    unsigned int const callCount = 200;
+
+    xmlrpc_env env;
+    xmlrpc_value * argArrayP;
+    xmlrpc_value * callsP;
+    xmlrpc_value * multiP;
+    xmlrpc_value * valueP;
+    unsigned int i;
+
+    xmlrpc_env_init(&env);
+
+    printf("  Running parallel multicall tests.");
+
+    xmlrpc_registry_set_multicall_threads(registryP, 4);
+
+    /* The plain multicall tests must give the same results */
+    test_system_multicall(registryP);
+
+    argArrayP = xmlrpc_build_value(&env, "(ii)",
+                                   (xmlrpc_int32) 25, (xmlrpc_int32) 17); 
+    TEST_NO_FAULT(&env);
+
+    /* Alternate successful and failing calls, so we can tell whether the
+       results come back in the order of the calls.
+    */
+    callsP = xmlrpc_array_new(&env);
+    TEST_NO_FAULT(&env);
+
+    for (i = 0; i < callCount; ++i) {
+        xmlrpc_value * const callP =
+            xmlrpc_build_value(&env, "{s:s,s:A}",
+                               "methodName", i % 2 ? "test.bar" : "test.foo",
+                               "params", argArrayP);
+        TEST_NO_FAULT(&env);
+        xmlrpc_array_append_item(&env, callsP, callP);
+        TEST_NO_FAULT(&env);
+        xmlrpc_DECREF(callP);
+    }
+    multiP = xmlrpc_build_value(&env, "(A)", callsP);
+    TEST_NO_FAULT(&env);
+
+    doRpc(&env, registryP, "system.multicall", multiP, MULTI_CALLINFO,
+          &valueP);
+    TEST_NO_FAULT(&env);
+    TEST(xmlrpc_array_size(&env, valueP) == callCount);
+
+    for (i = 0; i < callCount; ++i) {
+        xmlrpc_value * resultP;
+
+        xmlrpc_array_read_item(&env, valueP, i, &resultP);
+        TEST_NO_FAULT(&env);
+
+        if (i % 2) {
+            xmlrpc_int32 faultCode;
+            const char * faultString;
+
+            xmlrpc_decompose_value(&env, resultP, "{s:i,s:s,*}",
+                                   "faultCode", &faultCode,
+                                   "faultString", &faultString);
+            TEST_NO_FAULT(&env);
+            TEST(faultCode == 123);
+            strfree(faultString);
+        } else {
+            xmlrpc_int32 sum;
+
+            xmlrpc_decompose_value(&env, resultP, "(i)", &sum);
+            TEST_NO_FAULT(&env);
+            TEST(sum == 42);
+        }
+        xmlrpc_DECREF(resultP);
+    }
+    xmlrpc_DECREF(valueP);
+    xmlrpc_DECREF(multiP);
+    xmlrpc_DECREF(callsP);
+    xmlrpc_DECREF(argArrayP);
+
+    xmlrpc_registry_set_multicall_threads(registryP, 1);
+
+    xmlrpc_env_clean(&env);
+
+    printf("\n");
+}
+
+
+
 static void
 testCall(xmlrpc_registry * const registryP) {
 
@@ -925,50 +1022,232 @@ testCall(xmlrpc_registry * const registryP) {
 
 
 
+struct asyncState {
+    xmlrpc_call_completion * pendingP;
+        /* The completion of the call test.async left pending, if any */
+};
+
+
+
 static void
-testDefaultMethod(xmlrpc_registry * const registryP) {
-    
+test_async(xmlrpc_env *             const envP,
+           xmlrpc_value *           const paramArrayP,
+           void *                   const serverInfo,
+           void *                   const callInfo,
+           xmlrpc_call_completion * const completionP) {
+/*----------------------------------------------------------------------------
+   An asynchronous method.  The first parameter says how to finish the
+   call: 0: complete it now with the sum of the other two; 1: complete it
+   now with a fault; 2: fail without starting it; 3: leave it pending.
+-----------------------------------------------------------------------------*/
+    struct asyncState * const stateP = serverInfo;
+
+    xmlrpc_int32 mode, x, y;
+
+    TEST(callInfo == FOO_CALLINFO);
+
+    xmlrpc_decompose_value(envP, paramArrayP, "(iii)", &mode, &x, &y);
+    TEST_NO_FAULT(envP);
+
+    switch (mode) {
+    case 0: {
+        xmlrpc_value * const resultP = xmlrpc_int_new(envP, x + y);
+        TEST_NO_FAULT(envP);
+        xmlrpc_call_complete(completionP, resultP);
+        xmlrpc_DECREF(resultP);
+    } break;
+    case 1: {
+        xmlrpc_env fault;
+        xmlrpc_env_init(&fault);
+        xmlrpc_env_set_fault(&fault, 124, "Async fault");
+        xmlrpc_call_complete_fault(completionP, &fault);
+        xmlrpc_env_clean(&fault);
+    } break;
+    case 2:
+        xmlrpc_env_set_fault(envP, 125, "Async refusal");
+        break;
+    default:
+        TEST(stateP->pendingP == NULL);
+        stateP->pendingP = completionP;
+    }
+}
+
+
+
+struct asyncResponse {
+    unsigned int count;
+        /* Number of times we got a response */
+    xmlrpc_env fault;
+    xmlrpc_value * resultP;
+};
+
+
+
+static xmlrpc_call_response_fn collectResponse;
+
+static void
+collectResponse(void *             const context,
+                const xmlrpc_env * const envP,
+                xmlrpc_mem_block * const responseXmlP) {
+
+    struct asyncResponse * const responseP = context;
+
+    TEST_NO_FAULT(envP);
+
+    ++responseP->count;
+
+    responseP->resultP =
+        xmlrpc_parse_response(&responseP->fault,
+                              xmlrpc_mem_block_contents(responseXmlP),
+                              xmlrpc_mem_block_size(responseXmlP));
+
+    xmlrpc_mem_block_free(responseXmlP);
+}
+
+
+
+static void
+doAsyncRpc(xmlrpc_registry *      const registryP,
+           xmlrpc_int32           const mode,
+           struct asyncResponse * const responseP) {
+
+    xmlrpc_env env;
+    xmlrpc_value * argArrayP;
+    xmlrpc_mem_block * callP;
+
+    xmlrpc_env_init(&env);
+
+    argArrayP = xmlrpc_build_value(&env, "(iii)",
+                                   mode, (xmlrpc_int32) 25, (xmlrpc_int32) 17);
+    TEST_NO_FAULT(&env);
+
+    callP = xmlrpc_mem_block_new(&env, 0);
+    TEST_NO_FAULT(&env);
+    xmlrpc_serialize_call(&env, callP, "test.async", argArrayP);
+    TEST_NO_FAULT(&env);
+
+    responseP->count = 0;
+    xmlrpc_env_init(&responseP->fault);
+
+    xmlrpc_registry_process_call_async(registryP,
+                                       xmlrpc_mem_block_contents(callP),
+                                       xmlrpc_mem_block_size(callP),
+                                       FOO_CALLINFO,
+                                       &collectResponse, responseP);
+
+    xmlrpc_mem_block_free(callP);
+    xmlrpc_DECREF(argArrayP);
+    xmlrpc_env_clean(&env);
+}
+
+
+
+static void
+testAsyncMethod(void) {
+
     xmlrpc_env env;
+    xmlrpc_registry * registryP;
+    struct asyncState state;
+    struct xmlrpc_method_info_async methodInfo;
     xmlrpc_value * argArrayP;
     xmlrpc_value * valueP;
+    struct asyncResponse response;
     xmlrpc_int32 i;
- 
-    xmlrpc_env_init(&env);
 
-    printf("  Running default method tests.");
+    printf("  Running asynchronous method tests.");
 
-    /* Build an argument array for our calls. */
-    argArrayP = xmlrpc_build_value(&env, "(ii)",
-                                   (xmlrpc_int32) 25, (xmlrpc_int32) 17); 
+    xmlrpc_env_init(&env);
 
-    xmlrpc_registry_set_default_method(&env, registryP, &test_default,
-                                       DEFAULT_SERVERINFO);
-    TEST_NO_FAULT(&env);
-    doRpc(&env, registryP, "test.nosuch", argArrayP, DEFAULT_CALLINFO,
-          &valueP);
+    registryP = xmlrpc_registry_new(&env);
     TEST_NO_FAULT(&env);
-    TEST(valueP != NULL);
-    xmlrpc_decompose_value(&env, valueP, "i", &i);
-    xmlrpc_DECREF(valueP);
+
+    state.pendingP = NULL;
+
+    methodInfo.methodName      = "test.async";
+    methodInfo.methodFunction  = &test_async;
+    methodInfo.serverInfo      = &state;
+    methodInfo.stackSize       = 0;
+    methodInfo.signatureString = "i:iii";
+    methodInfo.help            = "Asynchronous test method";
+
+    xmlrpc_registry_add_method_async(&env, registryP, &methodInfo);
     TEST_NO_FAULT(&env);
-    TEST(i == 84);
 
-    /* Now try it with old method interface */
+    /* A synchronous caller gets the outcome as for any other method */
 
-    doRpc(&env, registryP, "test.nosuch.old", argArrayP, NULL, &valueP);
+    argArrayP = xmlrpc_build_value(&env, "(iii)", (xmlrpc_int32) 0,
+                                   (xmlrpc_int32) 25, (xmlrpc_int32) 17);
+    TEST_NO_FAULT(&env);
+    doRpc(&env, registryP, "test.async", argArrayP, FOO_CALLINFO, &valueP);
     TEST_NO_FAULT(&env);
-    TEST(valueP != NULL);
     xmlrpc_read_int(&env, valueP, &i);
     TEST_NO_FAULT(&env);
+    TEST(i == 42);
     xmlrpc_DECREF(valueP);
-    TEST(i == 84);
+    xmlrpc_DECREF(argArrayP);
 
-    /* Change the default method. */
-    xmlrpc_registry_set_default_method(&env, registryP, &test_default,
-                                       BAR_SERVERINFO);
+    {
+        xmlrpc_env env2;
+
+        argArrayP = xmlrpc_build_value(&env, "(iii)", (xmlrpc_int32) 1,
+                                       (xmlrpc_int32) 25, (xmlrpc_int32) 17);
+        TEST_NO_FAULT(&env);
+        xmlrpc_env_init(&env2);
+        doRpc(&env2, registryP, "test.async", argArrayP, FOO_CALLINFO,
+              &valueP);
+        TEST_FAULT(&env2, 124);
+        xmlrpc_env_clean(&env2);
+        xmlrpc_DECREF(argArrayP);
+
+        argArrayP = xmlrpc_build_value(&env, "(iii)", (xmlrpc_int32) 2,
+                                       (xmlrpc_int32) 25, (xmlrpc_int32) 17);
+        TEST_NO_FAULT(&env);
+        xmlrpc_env_init(&env2);
+        doRpc(&env2, registryP, "test.async", argArrayP, FOO_CALLINFO,
+              &valueP);
+        TEST_FAULT(&env2, 125);
+        xmlrpc_env_clean(&env2);
+        xmlrpc_DECREF(argArrayP);
+    }
+
+    /* An asynchronous caller gets a response right away when the method
+       finishes right away...
+    */
+    doAsyncRpc(registryP, 0, &response);
+    TEST(response.count == 1);
+    TEST_NO_FAULT(&response.fault);
+    xmlrpc_read_int(&env, response.resultP, &i);
     TEST_NO_FAULT(&env);
+    TEST(i == 42);
+    xmlrpc_DECREF(response.resultP);
 
-    xmlrpc_DECREF(argArrayP);
+    doAsyncRpc(registryP, 2, &response);
+    TEST(response.count == 1);
+    TEST_FAULT(&response.fault, 125);
+    xmlrpc_env_clean(&response.fault);
+
+    /* ... and later when the method finishes later */
+    doAsyncRpc(registryP, 3, &response);
+    TEST(response.count == 0);
+    TEST(state.pendingP != NULL);
+
+    valueP = xmlrpc_string_new(&env, "later");
+    TEST_NO_FAULT(&env);
+    xmlrpc_call_complete(state.pendingP, valueP);
+    xmlrpc_DECREF(valueP);
+
+    TEST(response.count == 1);
+    TEST_NO_FAULT(&response.fault);
+    {
+        const char * str;
+        xmlrpc_read_string(&env, response.resultP, &str);
+        TEST_NO_FAULT(&env);
+        TEST(streq(str, "later"));
+        strfree(str);
+    }
+    xmlrpc_DECREF(response.resultP);
+
+    xmlrpc_registry_free(registryP);
 
     xmlrpc_env_clean(&env);
 
@@ -978,69 +1257,151 @@ testDefaultMethod(xmlrpc_registry * const registryP) {
 
 
 static void
-test_apache_dialect(void) {
-
-    char const expectedResp[] =
-        XML_PROLOGUE
-        "<methodResponse " XMLNS_APACHE ">\r\n"
-        "<params>\r\n"
-        "<param><value><array><data>\r\n"
-            "<value><ex:i8>8</ex:i8></value>\r\n"
-            "<value><ex:nil/></value>\r\n"
-        "</data></array></value></param>\r\n"
-        "</params>\r\n"
-        "</methodResponse>\r\n";
+testMethodStats(void) {
 
     xmlrpc_env env;
     xmlrpc_registry * registryP;
+    struct asyncState state;
+    struct xmlrpc_method_info_async methodInfo;
     xmlrpc_value * argArrayP;
-    xmlrpc_mem_block * callP;
-    xmlrpc_mem_block * responseP;
+    xmlrpc_value * valueP;
+    struct asyncResponse response;
+    xmlrpc_method_stats stats;
+    xmlrpc_uint64_t latencyCount;
+    unsigned int i;
 
-    xmlrpc_env_init(&env);
+    printf("  Running method statistics tests.");
 
-    printf("  Running apache dialect tests.");
+    xmlrpc_env_init(&env);
 
     registryP = xmlrpc_registry_new(&env);
     TEST_NO_FAULT(&env);
 
-    xmlrpc_registry_set_dialect(&env, registryP, xmlrpc_dialect_i8);
+    xmlrpc_registry_add_method2(&env, registryP, "test.foo",
+                                test_foo, NULL, NULL, FOO_SERVERINFO);
+    TEST_NO_FAULT(&env);
+    xmlrpc_registry_add_method2(&env, registryP, "test.bar",
+                                test_bar, NULL, NULL, BAR_SERVERINFO);
     TEST_NO_FAULT(&env);
 
-    xmlrpc_registry_set_dialect(&env, registryP, 100);
-    TEST_FAULT(&env, XMLRPC_INTERNAL_ERROR);
+    state.pendingP = NULL;
 
-    xmlrpc_registry_set_dialect(&env, registryP, xmlrpc_dialect_apache);
+    methodInfo.methodName      = "test.async";
+    methodInfo.methodFunction  = &test_async;
+    methodInfo.serverInfo      = &state;
+    methodInfo.stackSize       = 0;
+    methodInfo.signatureString = "i:iii";
+    methodInfo.help            = "Asynchronous test method";
+
+    xmlrpc_registry_add_method_async(&env, registryP, &methodInfo);
     TEST_NO_FAULT(&env);
 
-    xmlrpc_registry_add_method2(&env, registryP, "test_exttype",
-                                test_exttype, NULL, NULL, FOO_SERVERINFO);
+    xmlrpc_registry_get_method_stats(&env, registryP, "test.foo", &stats);
     TEST_NO_FAULT(&env);
+    TEST(stats.calls == 0);
+    TEST(stats.callBytes == 0);
 
-    argArrayP = xmlrpc_array_new(&env);
+    argArrayP = xmlrpc_build_value(&env, "(ii)",
+                                   (xmlrpc_int32) 25, (xmlrpc_int32) 17);
     TEST_NO_FAULT(&env);
 
-    callP = xmlrpc_mem_block_new(&env, 0);
+    for (i = 0; i < 2; ++i) {
+        doRpc(&env, registryP, "test.foo", argArrayP, FOO_CALLINFO, &valueP);
+        TEST_NO_FAULT(&env);
+        xmlrpc_DECREF(valueP);
+    }
+    {
+        xmlrpc_env env2;
+        xmlrpc_env_init(&env2);
+        doRpc(&env2, registryP, "test.bar", argArrayP, BAR_CALLINFO, &valueP);
+        TEST_FAULT(&env2, 123);
+        xmlrpc_env_clean(&env2);
+    }
+    xmlrpc_DECREF(argArrayP);
+
+    xmlrpc_registry_get_method_stats(&env, registryP, "test.foo", &stats);
     TEST_NO_FAULT(&env);
-    xmlrpc_serialize_call(&env, callP, "test_exttype", argArrayP);
+    TEST(stats.calls == 2);
+    TEST(stats.faults == 0);
+    TEST(stats.callBytes > 0);
+    TEST(stats.responseBytes > 0);
+    for (i = 0, latencyCount = 0; i < XMLRPC_METHOD_STATS_BUCKETS; ++i)
+        latencyCount += stats.latency[i];
+    TEST(latencyCount == 2);
+
+    xmlrpc_registry_get_method_stats(&env, registryP, "test.bar", &stats);
     TEST_NO_FAULT(&env);
+    TEST(stats.calls == 1);
+    TEST(stats.faults == 1);
 
-    xmlrpc_registry_process_call2(
-        &env, registryP,
-        xmlrpc_mem_block_contents(callP),
-        xmlrpc_mem_block_size(callP),
-        NULL, &responseP);
+    /* A pending asynchronous call counts when it completes */
+    doAsyncRpc(registryP, 3, &response);
+    TEST(state.pendingP != NULL);
 
+    xmlrpc_registry_get_method_stats(&env, registryP, "test.async", &stats);
     TEST_NO_FAULT(&env);
+    TEST(stats.calls == 0);
 
-    TEST(XMLRPC_MEMBLOCK_SIZE(char, responseP) == strlen(expectedResp));
-    TEST(memeq(XMLRPC_MEMBLOCK_CONTENTS(char, responseP),
-               expectedResp,
-               XMLRPC_MEMBLOCK_SIZE(char, responseP)));
+    valueP = xmlrpc_string_new(&env, "later");
+    TEST_NO_FAULT(&env);
+    xmlrpc_call_complete(state.pendingP, valueP);
+    xmlrpc_DECREF(valueP);
+    TEST(response.count == 1);
+    xmlrpc_DECREF(response.resultP);
+
+    xmlrpc_registry_get_method_stats(&env, registryP, "test.async", &stats);
+    TEST_NO_FAULT(&env);
+    TEST(stats.calls == 1);
+    TEST(stats.faults == 0);
+    TEST(stats.callBytes > 0);
+    TEST(stats.responseBytes > 0);
+
+    {
+        xmlrpc_env env2;
+        xmlrpc_env_init(&env2);
+        xmlrpc_registry_get_method_stats(&env2, registryP, "test.nosuch",
+                                         &stats);
+        TEST_FAULT(&env2, XMLRPC_NO_SUCH_METHOD_ERROR);
+        xmlrpc_env_clean(&env2);
+    }
+
+    /* system.stats reports the same, once enabled */
+    argArrayP = xmlrpc_array_new(&env);
+    TEST_NO_FAULT(&env);
+    {
+        xmlrpc_env env2;
+        xmlrpc_env_init(&env2);
+        doRpc(&env2, registryP, "system.stats", argArrayP, NULL, &valueP);
+        TEST_FAULT(&env2, XMLRPC_NO_SUCH_METHOD_ERROR);
+        xmlrpc_env_clean(&env2);
+    }
+    xmlrpc_registry_enable_stats_method(&env, registryP);
+    TEST_NO_FAULT(&env);
+
+    doRpc(&env, registryP, "system.stats", argArrayP, NULL, &valueP);
+    TEST_NO_FAULT(&env);
+    {
+        xmlrpc_value * fooStatsP;
+        xmlrpc_value * latencyP;
+        xmlrpc_int64 calls, faults;
 
+        xmlrpc_struct_find_value(&env, valueP, "test.foo", &fooStatsP);
+        TEST_NO_FAULT(&env);
+        TEST(fooStatsP != NULL);
+        xmlrpc_decompose_value(&env, fooStatsP, "{s:I,s:I,s:A,*}",
+                               "calls", &calls, "faults", &faults,
+                               "latency", &latencyP);
+        TEST_NO_FAULT(&env);
+        TEST(calls == 2);
+        TEST(faults == 0);
+        TEST(xmlrpc_array_size(&env, latencyP) ==
+             XMLRPC_METHOD_STATS_BUCKETS);
+        xmlrpc_DECREF(latencyP);
+        xmlrpc_DECREF(fooStatsP);
+    }
+    xmlrpc_DECREF(valueP);
     xmlrpc_DECREF(argArrayP);
-    xmlrpc_mem_block_free(callP);
-    xmlrpc_mem_block_free(responseP);
+
     xmlrpc_registry_free(registryP);
 
     xmlrpc_env_clean(&env);
@@ -1050,41 +1411,1262 @@ test_apache_dialect(void) {
 
 
 
-void
-test_method_registry(void) {
-
-    xmlrpc_env env, env2;
-    xmlrpc_value * valueP;
-    xmlrpc_registry * registryP;
-    xmlrpc_mem_block * responseP;
+static xmlrpc_value *
+test_count(xmlrpc_env *   const envP,
+           xmlrpc_value * const paramArrayP,
+           void *         const serverInfo,
+           void *         const callInfo ATTR_UNUSED) {
+/*----------------------------------------------------------------------------
+   Return the number of times this has been called, so a caller can tell
+   whether it got a cached response.  Fail if the parameter is false.
+-----------------------------------------------------------------------------*/
+    unsigned int * const countP = serverInfo;
 
-    xmlrpc_env_init(&env);
+    xmlrpc_value * paramP;
 
-    testVersion();
+    ++*countP;
 
-    printf("Running method registry tests.");
+    xmlrpc_array_read_item(envP, paramArrayP, 0, &paramP);
+    TEST_NO_FAULT(envP);
 
-    /* Create a new registry. */
-    registryP = xmlrpc_registry_new(&env);
-    TEST_NO_FAULT(&env);
-    TEST(registryP != NULL);
+    if (xmlrpc_value_type(paramP) == XMLRPC_TYPE_BOOL) {
+        xmlrpc_bool b;
+        xmlrpc_read_bool(envP, paramP, &b);
+        TEST_NO_FAULT(envP);
+        if (!b)
+            xmlrpc_env_set_fault(envP, 126, "Test fault");
+    }
+    xmlrpc_DECREF(paramP);
 
-    /* Add some test methods. */
-    xmlrpc_registry_add_method(&env, registryP, NULL, "test.foo",
-                               test_foo_type1, FOO_SERVERINFO);
-    TEST_NO_FAULT(&env);
-    xmlrpc_registry_add_method2(&env, registryP, "test.bar",
-                                test_bar, NULL, barHelp, BAR_SERVERINFO);
-    TEST_NO_FAULT(&env);
+    return envP->fault_occurred ?
+        NULL : xmlrpc_build_value(envP, "i", (xmlrpc_int32)*countP);
+}
 
-    printf("\n");
-    testCall(registryP);
 
-    test_system_multicall(registryP);
 
-    xmlrpc_env_init(&env2);
-    xmlrpc_registry_process_call2(&env, registryP,
-                                  expat_error_data,
+static xmlrpc_int32
+callCount(xmlrpc_registry * const registryP,
+          const char *      const methodName,
+          const char *      const format,
+          ...) {
+/*----------------------------------------------------------------------------
+   Call 'methodName' with parameters built from 'format' and the
+   arguments after it; return the result, or -1 if it fails.
+-----------------------------------------------------------------------------*/
+    xmlrpc_env env;
+    va_list args;
+    const char * tail;
+    xmlrpc_value * argArrayP;
+    xmlrpc_value * resultP;
+    xmlrpc_int32 retval;
+
+    xmlrpc_env_init(&env);
+
+    va_start(args, format);
+    xmlrpc_build_value_va(&env, format, args, &argArrayP, &tail);
+    va_end(args);
+    TEST_NO_FAULT(&env);
+
+    {
+        xmlrpc_env callEnv;
+
+        xmlrpc_env_init(&callEnv);
+
+        doRpc(&callEnv, registryP, methodName, argArrayP, FOO_CALLINFO,
+              &resultP);
+
+        if (callEnv.fault_occurred)
+            retval = -1;
+        else {
+            xmlrpc_read_int(&env, resultP, &retval);
+            TEST_NO_FAULT(&env);
+            xmlrpc_DECREF(resultP);
+        }
+        xmlrpc_env_clean(&callEnv);
+    }
+    xmlrpc_DECREF(argArrayP);
+    xmlrpc_env_clean(&env);
+
+    return retval;
+}
+
+
+
+static void
+testMulticallBadCall(void) {
+/*----------------------------------------------------------------------------
+   Test that a system.multicall with a malformed call in it executes none
+   of its calls, whether it would execute them serially or in parallel.
+-----------------------------------------------------------------------------*/
+    unsigned int const threadCount[] = {1, 4};
+
+    xmlrpc_env env;
+    xmlrpc_registry * registryP;
+    unsigned int count;
+    xmlrpc_value * multiP;
+    xmlrpc_value * valueP;
+    unsigned int i;
+
+    printf("  Running multicall bad call tests.");
+
+    xmlrpc_env_init(&env);
+
+    registryP = xmlrpc_registry_new(&env);
+    TEST_NO_FAULT(&env);
+
+    count = 0;
+
+    xmlrpc_registry_add_method2(&env, registryP, "test.count",
+                                test_count, NULL, NULL, &count);
+    TEST_NO_FAULT(&env);
+
+    multiP = xmlrpc_build_value(&env, "(({s:s,s:(i)}{s:s,s:(i)}i))",
+                                "methodName", "test.count",
+                                "params", (xmlrpc_int32) 1,
+                                "methodName", "test.count",
+                                "params", (xmlrpc_int32) 1,
+                                (xmlrpc_int32) 7);
+    TEST_NO_FAULT(&env);
+
+    for (i = 0; i < ARRAY_SIZE(threadCount); ++i) {
+        xmlrpc_registry_set_multicall_threads(registryP, threadCount[i]);
+
+        doRpc(&env, registryP, "system.multicall", multiP, MULTI_CALLINFO,
+              &valueP);
+        TEST_FAULT(&env, XMLRPC_TYPE_ERROR);
+        TEST(count == 0);
+    }
+    xmlrpc_DECREF(multiP);
+
+    xmlrpc_registry_free(registryP);
+
+    xmlrpc_env_clean(&env);
+
+    printf("\n");
+}
+
+
+
+#if HAVE_PTHREAD
+
+static pthread_key_t innerThreadKey;
+    /* Non-NULL in a thread that is executing test.inner */
+
+
+
+static xmlrpc_value *
+test_probe(xmlrpc_env *   const envP,
+           xmlrpc_value * const paramArrayP ATTR_UNUSED,
+           void *         const serverInfo ATTR_UNUSED,
+           void *         const callInfo ATTR_UNUSED) {
+/*----------------------------------------------------------------------------
+   Return whether we're executing in the thread of a test.inner call.
+
+   We take a while, so that if the multicall we're in has other threads,
+   they get some of its calls.
+-----------------------------------------------------------------------------*/
+    xmlrpc_millisecond_sleep(10);
+
+    return xmlrpc_bool_new(envP, pthread_getspecific(innerThreadKey) != NULL);
+}
+
+
+
+static xmlrpc_value *
+test_inner(xmlrpc_env *   const envP,
+           xmlrpc_value * const paramArrayP ATTR_UNUSED,
+           void *         const serverInfo,
+           void *         const callInfo ATTR_UNUSED) {
+/*----------------------------------------------------------------------------
+   Execute a system.multicall of several test.probe calls and return
+   whether they all executed in our thread.
+-----------------------------------------------------------------------------*/
+    unsigned int const probeCount = 4;
+
+    xmlrpc_registry * const registryP = serverInfo;
+
+    xmlrpc_value * callsP;
+    xmlrpc_value * multiP;
+    xmlrpc_value * valueP;
+    xmlrpc_bool allInOurThread;
+    unsigned int i;
+
+    pthread_setspecific(innerThreadKey, &innerThreadKey);
+
+    callsP = xmlrpc_array_new(envP);
+    TEST_NO_FAULT(envP);
+
+    for (i = 0; i < probeCount; ++i) {
+        xmlrpc_value * const callP =
+            xmlrpc_build_value(envP, "{s:s,s:()}",
+                               "methodName", "test.probe", "params");
+        TEST_NO_FAULT(envP);
+        xmlrpc_array_append_item(envP, callsP, callP);
+        TEST_NO_FAULT(envP);
+        xmlrpc_DECREF(callP);
+    }
+    multiP = xmlrpc_build_value(envP, "(A)", callsP);
+    TEST_NO_FAULT(envP);
+
+    doRpc(envP, registryP, "system.multicall", multiP, MULTI_CALLINFO,
+          &valueP);
+    TEST_NO_FAULT(envP);
+
+    for (i = 0, allInOurThread = true; i < probeCount; ++i) {
+        xmlrpc_bool inOurThread;
+
+        xmlrpc_decompose_value(envP, xmlrpc_array_get_item(envP, valueP, i),
+                               "(b)", &inOurThread);
+        TEST_NO_FAULT(envP);
+
+        if (!inOurThread)
+            allInOurThread = false;
+    }
+    xmlrpc_DECREF(valueP);
+    xmlrpc_DECREF(multiP);
+    xmlrpc_DECREF(callsP);
+
+    pthread_setspecific(innerThreadKey, NULL);
+
+    return xmlrpc_bool_new(envP, allInOurThread);
+}
+
+
+
+static void
+testMulticallThreadBudget(void) {
+/*----------------------------------------------------------------------------
+   Test that the multicalls a registry executes at once share one budget of
+   extra threads: a multicall that starts while another has them all
+   executes its calls in its own thread.
+-----------------------------------------------------------------------------*/
+    xmlrpc_env env;
+    xmlrpc_registry * registryP;
+    xmlrpc_value * multiP;
+    xmlrpc_value * valueP;
+    xmlrpc_bool inOurThread0, inOurThread1;
+
+    printf("  Running multicall thread budget tests.");
+
+    xmlrpc_env_init(&env);
+
+    pthread_key_create(&innerThreadKey, NULL);
+
+    registryP = xmlrpc_registry_new(&env);
+    TEST_NO_FAULT(&env);
+
+    xmlrpc_registry_add_method2(&env, registryP, "test.probe",
+                                test_probe, NULL, NULL, NULL);
+    TEST_NO_FAULT(&env);
+    xmlrpc_registry_add_method2(&env, registryP, "test.inner",
+                                test_inner, NULL, NULL, registryP);
+    TEST_NO_FAULT(&env);
+
+    /* The outer multicall takes the one extra thread, so each inner one
+       has none.
+    */
+    xmlrpc_registry_set_multicall_threads(registryP, 2);
+
+    multiP = xmlrpc_build_value(&env, "(({s:s,s:()}{s:s,s:()}))",
+                                "methodName", "test.inner", "params",
+                                "methodName", "test.inner", "params");
+    TEST_NO_FAULT(&env);
+
+    doRpc(&env, registryP, "system.multicall", multiP, MULTI_CALLINFO,
+          &valueP);
+    TEST_NO_FAULT(&env);
+
+    xmlrpc_decompose_value(&env, valueP, "((b)(b))",
+                           &inOurThread0, &inOurThread1);
+    TEST_NO_FAULT(&env);
+    TEST(inOurThread0);
+    TEST(inOurThread1);
+
+    xmlrpc_DECREF(valueP);
+    xmlrpc_DECREF(multiP);
+
+    /* With the budget back, an inner multicall uses the extra thread */
+    multiP = xmlrpc_build_value(&env, "()");
+    TEST_NO_FAULT(&env);
+
+    doRpc(&env, registryP, "test.inner", multiP, MULTI_CALLINFO, &valueP);
+    TEST_NO_FAULT(&env);
+
+    xmlrpc_read_bool(&env, valueP, &inOurThread0);
+    TEST_NO_FAULT(&env);
+    TEST(!inOurThread0);
+
+    xmlrpc_DECREF(valueP);
+    xmlrpc_DECREF(multiP);
+
+    xmlrpc_registry_free(registryP);
+
+    pthread_key_delete(innerThreadKey);
+
+    xmlrpc_env_clean(&env);
+
+    printf("\n");
+}
+
+#endif  /* HAVE_PTHREAD */
+
+
+
+static void
+testResponseCache(void) {
+
+    xmlrpc_env env;
+    xmlrpc_registry * registryP;
+    unsigned int count;
+    unsigned int otherCount;
+    xmlrpc_method_stats stats;
+
+    printf("  Running response cache tests.");
+
+    xmlrpc_env_init(&env);
+
+    registryP = xmlrpc_registry_new(&env);
+    TEST_NO_FAULT(&env);
+
+    count = 0;
+    otherCount = 0;
+
+    xmlrpc_registry_add_method2(&env, registryP, "test.count",
+                                test_count, NULL, NULL, &count);
+    TEST_NO_FAULT(&env);
+    xmlrpc_registry_add_method2(&env, registryP, "test.other",
+                                test_count, NULL, NULL, &otherCount);
+    TEST_NO_FAULT(&env);
+
+    xmlrpc_registry_mark_idempotent(&env, registryP, "test.count");
+    TEST_NO_FAULT(&env);
+
+    {
+        xmlrpc_env env2;
+        xmlrpc_env_init(&env2);
+        xmlrpc_registry_mark_idempotent(&env2, registryP, "test.nosuch");
+        TEST_FAULT(&env2, XMLRPC_NO_SUCH_METHOD_ERROR);
+        xmlrpc_env_clean(&env2);
+    }
+
+    /* Without a cache, every call executes */
+    TEST(callCount(registryP, "test.count", "(i)", 1) == 1);
+    TEST(callCount(registryP, "test.count", "(i)", 1) == 2);
+
+    xmlrpc_registry_set_response_cache(&env, registryP, 100000, 0);
+    TEST_NO_FAULT(&env);
+
+    count = 0;
+    TEST(callCount(registryP, "test.count", "(i)", 1) == 1);
+    TEST(callCount(registryP, "test.count", "(i)", 1) == 1);
+    TEST(callCount(registryP, "test.count", "(i)", 2) == 2);
+    TEST(callCount(registryP, "test.count", "(i)", 2) == 2);
+    TEST(callCount(registryP, "test.count", "(i)", 1) == 1);
+    TEST(count == 2);
+
+    /* The order of struct members doesn't matter; the types of values
+       do.
+    */
+    TEST(callCount(registryP, "test.count", "({s:i,s:s})",
+                   "a", 1, "b", "x") == 3);
+    TEST(callCount(registryP, "test.count", "({s:s,s:i})",
+                   "b", "x", "a", 1) == 3);
+    TEST(callCount(registryP, "test.count", "({s:s,s:s})",
+                   "b", "x", "a", "1") == 4);
+
+    /* Faults don't get cached */
+    TEST(callCount(registryP, "test.count", "(b)", false) == -1);
+    TEST(callCount(registryP, "test.count", "(b)", false) == -1);
+    TEST(count == 6);
+
+    /* Nor do responses of a method that isn't idempotent */
+    TEST(callCount(registryP, "test.other", "(i)", 1) == 1);
+    TEST(callCount(registryP, "test.other", "(i)", 1) == 2);
+
+    /* A response from the cache counts in the method statistics */
+    xmlrpc_registry_get_method_stats(&env, registryP, "test.count", &stats);
+    TEST_NO_FAULT(&env);
+    TEST(stats.calls == 12);
+
+    /* Adding a method leaves cached responses alone */
+    xmlrpc_registry_add_method2(&env, registryP, "test.third",
+                                test_count, NULL, NULL, &otherCount);
+    TEST_NO_FAULT(&env);
+    TEST(callCount(registryP, "test.count", "(i)", 1) == 1);
+
+    /* Dropping a method discards all cached responses */
+    xmlrpc_registry_remove_method(&env, registryP, "test.third");
+    TEST_NO_FAULT(&env);
+    TEST(callCount(registryP, "test.count", "(i)", 1) == 7);
+    TEST(callCount(registryP, "test.count", "(i)", 1) == 7);
+
+    /* A small cache discards the least recently used response */
+    xmlrpc_registry_set_response_cache(&env, registryP, 400, 0);
+    TEST_NO_FAULT(&env);
+
+    count = 0;
+    TEST(callCount(registryP, "test.count", "(i)", 1) == 1);
+    TEST(callCount(registryP, "test.count", "(i)", 1) == 1);
+    TEST(callCount(registryP, "test.count", "(i)", 2) == 2);
+    TEST(callCount(registryP, "test.count", "(i)", 2) == 2);
+    TEST(callCount(registryP, "test.count", "(i)", 1) == 3);
+
+    /* Zero size turns the cache off */
+    xmlrpc_registry_set_response_cache(&env, registryP, 0, 0);
+    TEST_NO_FAULT(&env);
+    TEST(callCount(registryP, "test.count", "(i)", 1) == 4);
+    TEST(callCount(registryP, "test.count", "(i)", 1) == 5);
+
+    xmlrpc_registry_free(registryP);
+
+    xmlrpc_env_clean(&env);
+
+    printf("\n");
+}
+
+
+
+static void
+testCallLimits(void) {
+
+    xmlrpc_env env;
+    xmlrpc_registry * registryP;
+    struct asyncState state;
+    struct xmlrpc_method_info_async methodInfo;
+    struct asyncResponse response;
+    unsigned int count;
+    xmlrpc_value * valueP;
+
+    printf("  Running call limit tests.");
+
+    xmlrpc_env_init(&env);
+
+    registryP = xmlrpc_registry_new(&env);
+    TEST_NO_FAULT(&env);
+
+    state.pendingP = NULL;
+
+    methodInfo.methodName      = "test.async";
+    methodInfo.methodFunction  = &test_async;
+    methodInfo.serverInfo      = &state;
+    methodInfo.stackSize       = 0;
+    methodInfo.signatureString = "i:iii";
+    methodInfo.help            = "Asynchronous test method";
+
+    xmlrpc_registry_add_method_async(&env, registryP, &methodInfo);
+    TEST_NO_FAULT(&env);
+
+    count = 0;
+    xmlrpc_registry_add_method2(&env, registryP, "test.count",
+                                test_count, NULL, NULL, &count);
+    TEST_NO_FAULT(&env);
+
+    {
+        xmlrpc_env env2;
+        xmlrpc_env_init(&env2);
+        xmlrpc_registry_set_method_limit(&env2, registryP, "test.nosuch",
+                                         1, 0);
+        TEST_FAULT(&env2, XMLRPC_NO_SUCH_METHOD_ERROR);
+        xmlrpc_env_clean(&env2);
+
+        xmlrpc_env_init(&env2);
+        xmlrpc_registry_set_adaptive_limit(&env2, registryP, 2, 1);
+        TEST_FAULT(&env2, XMLRPC_INTERNAL_ERROR);
+        xmlrpc_env_clean(&env2);
+    }
+
+    /* A method limit refuses a call of the method while the limit's worth
+       of calls are executing, but not a call of another method.
+    */
+    xmlrpc_registry_set_method_limit(&env, registryP, "test.async", 1, 0);
+    TEST_NO_FAULT(&env);
+
+    doAsyncRpc(registryP, 3, &response);
+    TEST(response.count == 0);
+    TEST(state.pendingP != NULL);
+
+    {
+        struct asyncResponse response2;
+
+        doAsyncRpc(registryP, 0, &response2);
+        TEST(response2.count == 1);
+        TEST_FAULT(&response2.fault, XMLRPC_LIMIT_EXCEEDED_ERROR);
+        xmlrpc_env_clean(&response2.fault);
+    }
+    TEST(callCount(registryP, "test.count", "(i)", 1) == 1);
+
+    /* Changing another attribute of the method while a call executes
+       leaves the limit as it is.
+    */
+    xmlrpc_registry_set_method_priority(&env, registryP, "test.async",
+                                        xmlrpc_priority_high);
+    TEST_NO_FAULT(&env);
+    xmlrpc_registry_mark_idempotent(&env, registryP, "test.async");
+    TEST_NO_FAULT(&env);
+    {
+        struct asyncResponse response2;
+
+        doAsyncRpc(registryP, 0, &response2);
+        TEST(response2.count == 1);
+        TEST_FAULT(&response2.fault, XMLRPC_LIMIT_EXCEEDED_ERROR);
+        xmlrpc_env_clean(&response2.fault);
+    }
+
+    /* A new limit applies to calls after it; the executing call counts
+       only against the limit it started under.
+    */
+    xmlrpc_registry_set_method_limit(&env, registryP, "test.async", 1, 0);
+    TEST_NO_FAULT(&env);
+    {
+        struct asyncResponse response2;
+
+        doAsyncRpc(registryP, 0, &response2);
+        TEST(response2.count == 1);
+        TEST_NO_FAULT(&response2.fault);
+        xmlrpc_DECREF(response2.resultP);
+    }
+
+    valueP = xmlrpc_int_new(&env, 7);
+    TEST_NO_FAULT(&env);
+    xmlrpc_call_complete(state.pendingP, valueP);
+    state.pendingP = NULL;
+    TEST(response.count == 1);
+    TEST_NO_FAULT(&response.fault);
+    xmlrpc_DECREF(response.resultP);
+
+    /* Completing the call made room */
+    doAsyncRpc(registryP, 0, &response);
+    TEST(response.count == 1);
+    TEST_NO_FAULT(&response.fault);
+    xmlrpc_DECREF(response.resultP);
+
+    xmlrpc_registry_set_method_limit(&env, registryP, "test.async", 0, 0);
+    TEST_NO_FAULT(&env);
+
+    /* The adaptive limit refuses a call of any method while the limit's
+       worth of calls are executing.
+    */
+    xmlrpc_registry_set_adaptive_limit(&env, registryP, 1, 1);
+    TEST_NO_FAULT(&env);
+
+    doAsyncRpc(registryP, 3, &response);
+    TEST(response.count == 0);
+    TEST(state.pendingP != NULL);
+
+    TEST(callCount(registryP, "test.count", "(i)", 1) == -1);
+    TEST(count == 1);
+
+    xmlrpc_call_complete(state.pendingP, valueP);
+    state.pendingP = NULL;
+    TEST(response.count == 1);
+    TEST_NO_FAULT(&response.fault);
+    xmlrpc_DECREF(response.resultP);
+
+    TEST(callCount(registryP, "test.count", "(i)", 1) == 2);
+
+    xmlrpc_registry_set_adaptive_limit(&env, registryP, 0, 0);
+    TEST_NO_FAULT(&env);
+
+    xmlrpc_DECREF(valueP);
+
+    xmlrpc_registry_free(registryP);
+
+    xmlrpc_env_clean(&env);
+
+    printf("\n");
+}
+
+
+
+static xmlrpc_value *
+test_many(xmlrpc_env *   const envP,
+          xmlrpc_value * const paramArrayP ATTR_UNUSED,
+          void *         const serverInfo,
+          void *         const callInfo ATTR_UNUSED) {
+
+    return xmlrpc_int_new(envP, (xmlrpc_int32)(size_t)serverInfo);
+}
+
+
+
+static void
+testManyMethods(void) {
+/*----------------------------------------------------------------------------
+   Test a registry with enough methods that its hash table has to grow
+   several times.
+-----------------------------------------------------------------------------*/
+    unsigned int const methodCount = 1000;
+
+    xmlrpc_env env;
+    xmlrpc_registry * registryP;
+    xmlrpc_value * argArrayP;
+    xmlrpc_value * valueP;
+    unsigned int i;
+
+    printf("  Running many-method tests.");
+
+    xmlrpc_env_init(&env);
+
+    registryP = xmlrpc_registry_new(&env);
+    TEST_NO_FAULT(&env);
+
+    for (i = 0; i < methodCount; ++i) {
+        const char * methodName;
+
+        casprintf(&methodName, "test.many%u", i);
+
+        xmlrpc_registry_add_method2(&env, registryP, methodName,
+                                    test_many, NULL, NULL, (void *)(size_t)i);
+        TEST_NO_FAULT(&env);
+
+        strfree(methodName);
+    }
+
+    {
+        xmlrpc_env env2;
+
+        xmlrpc_env_init(&env2);
+        xmlrpc_registry_add_method2(&env2, registryP, "test.many500",
+                                    test_many, NULL, NULL, NULL);
+        TEST(env2.fault_occurred);
+        xmlrpc_env_clean(&env2);
+    }
+
+    argArrayP = xmlrpc_array_new(&env);
+    TEST_NO_FAULT(&env);
+
+    for (i = 0; i < methodCount; i += 37) {
+        const char * methodName;
+        xmlrpc_int32 result;
+
+        casprintf(&methodName, "test.many%u", i);
+
+        doRpc(&env, registryP, methodName, argArrayP, NULL, &valueP);
+        TEST_NO_FAULT(&env);
+        xmlrpc_read_int(&env, valueP, &result);
+        TEST_NO_FAULT(&env);
+        TEST(result == (xmlrpc_int32)i);
+        xmlrpc_DECREF(valueP);
+
+        strfree(methodName);
+    }
+
+    {
+        xmlrpc_env env2;
+
+        xmlrpc_env_init(&env2);
+        doRpc(&env2, registryP, "test.many1000", argArrayP, NULL, &valueP);
+        TEST_FAULT(&env2, XMLRPC_NO_SUCH_METHOD_ERROR);
+        xmlrpc_env_clean(&env2);
+    }
+
+    xmlrpc_DECREF(argArrayP);
+
+    argArrayP = xmlrpc_build_value(&env, "()");
+    TEST_NO_FAULT(&env);
+
+    doRpc(&env, registryP, "system.listMethods", argArrayP, NULL, &valueP);
+    TEST_NO_FAULT(&env);
+    TEST(xmlrpc_array_size(&env, valueP) > (int)methodCount);
+    {
+        xmlrpc_value * firstP;
+        const char * firstName;
+
+        xmlrpc_array_read_item(&env, valueP, 0, &firstP);
+        TEST_NO_FAULT(&env);
+        xmlrpc_read_string(&env, firstP, &firstName);
+        TEST_NO_FAULT(&env);
+        /* Registration order is preserved */
+        TEST(streq(firstName, "system.listMethods"));
+        strfree(firstName);
+        xmlrpc_DECREF(firstP);
+    }
+    xmlrpc_DECREF(valueP);
+    xmlrpc_DECREF(argArrayP);
+
+    xmlrpc_registry_free(registryP);
+
+    xmlrpc_env_clean(&env);
+
+    printf("\n");
+}
+
+
+
+static void
+testDefaultMethod(xmlrpc_registry * const registryP) {
+    
+    xmlrpc_env env;
+    xmlrpc_value * argArrayP;
+    xmlrpc_value * valueP;
+    xmlrpc_int32 i;
+ 
+    xmlrpc_env_init(&env);
+
+    printf("  Running default method tests.");
+
+    /* Build an argument array for our calls. */
+    argArrayP = xmlrpc_build_value(&env, "(ii)",
+                                   (xmlrpc_int32) 25, (xmlrpc_int32) 17); 
+
+    xmlrpc_registry_set_default_method(&env, registryP, &test_default,
+                                       DEFAULT_SERVERINFO);
+    TEST_NO_FAULT(&env);
+    doRpc(&env, registryP, "test.nosuch", argArrayP, DEFAULT_CALLINFO,
+          &valueP);
+    TEST_NO_FAULT(&env);
+    TEST(valueP != NULL);
+    xmlrpc_decompose_value(&env, valueP, "i", &i);
+    xmlrpc_DECREF(valueP);
+    TEST_NO_FAULT(&env);
+    TEST(i == 84);
+
+    /* Now try it with old method interface */
+
+    doRpc(&env, registryP, "test.nosuch.old", argArrayP, NULL, &valueP);
+    TEST_NO_FAULT(&env);
+    TEST(valueP != NULL);
+    xmlrpc_read_int(&env, valueP, &i);
+    TEST_NO_FAULT(&env);
+    xmlrpc_DECREF(valueP);
+    TEST(i == 84);
+
+    /* Change the default method. */
+    xmlrpc_registry_set_default_method(&env, registryP, &test_default,
+                                       BAR_SERVERINFO);
+    TEST_NO_FAULT(&env);
+
+    xmlrpc_DECREF(argArrayP);
+
+    xmlrpc_env_clean(&env);
+
+    printf("\n");
+}
+
+
+
+static void
+test_apache_dialect(void) {
+
+    char const expectedResp[] =
+        XML_PROLOGUE
+        "<methodResponse " XMLNS_APACHE ">\r\n"
+        "<params>\r\n"
+        "<param><value><array><data>\r\n"
+            "<value><ex:i8>8</ex:i8></value>\r\n"
+            "<value><ex:nil/></value>\r\n"
+        "</data></array></value></param>\r\n"
+        "</params>\r\n"
+        "</methodResponse>\r\n";
+
+    xmlrpc_env env;
+    xmlrpc_registry * registryP;
+    xmlrpc_value * argArrayP;
+    xmlrpc_mem_block * callP;
+    xmlrpc_mem_block * responseP;
+
+    xmlrpc_env_init(&env);
+
+    printf("  Running apache dialect tests.");
+
+    registryP = xmlrpc_registry_new(&env);
+    TEST_NO_FAULT(&env);
+
+    xmlrpc_registry_set_dialect(&env, registryP, xmlrpc_dialect_i8);
+    TEST_NO_FAULT(&env);
+
+    xmlrpc_registry_set_dialect(&env, registryP, 100);
+    TEST_FAULT(&env, XMLRPC_INTERNAL_ERROR);
+
+    xmlrpc_registry_set_dialect(&env, registryP, xmlrpc_dialect_apache);
+    TEST_NO_FAULT(&env);
+
+    xmlrpc_registry_add_method2(&env, registryP, "test_exttype",
+                                test_exttype, NULL, NULL, FOO_SERVERINFO);
+    TEST_NO_FAULT(&env);
+
+    argArrayP = xmlrpc_array_new(&env);
+    TEST_NO_FAULT(&env);
+
+    callP = xmlrpc_mem_block_new(&env, 0);
+    TEST_NO_FAULT(&env);
+    xmlrpc_serialize_call(&env, callP, "test_exttype", argArrayP);
+    TEST_NO_FAULT(&env);
+
+    xmlrpc_registry_process_call2(
+        &env, registryP,
+        xmlrpc_mem_block_contents(callP),
+        xmlrpc_mem_block_size(callP),
+        NULL, &responseP);
+
+    TEST_NO_FAULT(&env);
+
+    TEST(XMLRPC_MEMBLOCK_SIZE(char, responseP) == strlen(expectedResp));
+    TEST(memeq(XMLRPC_MEMBLOCK_CONTENTS(char, responseP),
+               expectedResp,
+               XMLRPC_MEMBLOCK_SIZE(char, responseP)));
+
+    xmlrpc_DECREF(argArrayP);
+    xmlrpc_mem_block_free(callP);
+    xmlrpc_mem_block_free(responseP);
+    xmlrpc_registry_free(registryP);
+
+    xmlrpc_env_clean(&env);
+
+    printf("\n");
+}
+
+
+
+static void
+testCheckParams(void) {
+
+    xmlrpc_env env;
+    xmlrpc_registry * registryP;
+    unsigned int count;
+    unsigned int anyCount;
+
+    printf("  Running parameter check tests.");
+
+    xmlrpc_env_init(&env);
+
+    registryP = xmlrpc_registry_new(&env);
+    TEST_NO_FAULT(&env);
+
+    count = 0;
+    xmlrpc_registry_add_method2(&env, registryP, "test.count",
+                                test_count, "i:i,i:bs", NULL, &count);
+    TEST_NO_FAULT(&env);
+
+    anyCount = 0;
+    xmlrpc_registry_add_method2(&env, registryP, "test.any",
+                                test_count, NULL, NULL, &anyCount);
+    TEST_NO_FAULT(&env);
+
+    /* The registry doesn't check unless asked to */
+    TEST(callCount(registryP, "test.count", "(s)", "x") == 1);
+
+    xmlrpc_registry_set_check_params(registryP, true);
+
+    TEST(callCount(registryP, "test.count", "(s)", "x") == -1);
+    TEST(callCount(registryP, "test.count", "(ii)", 1, 2) == -1);
+    TEST(callCount(registryP, "test.count", "(bi)", true, 2) == -1);
+    TEST(callCount(registryP, "test.count", "()") == -1);
+    TEST(count == 1);
+
+    TEST(callCount(registryP, "test.count", "(i)", 1) == 2);
+    TEST(callCount(registryP, "test.count", "(bs)", true, "x") == 3);
+
+    /* A method without signatures accepts anything */
+    TEST(callCount(registryP, "test.any", "(s)", "x") == 1);
+
+    {
+        xmlrpc_value * argArrayP;
+        xmlrpc_value * resultP;
+
+        argArrayP = xmlrpc_build_value(&env, "(d)", 1.0);
+        TEST_NO_FAULT(&env);
+        doRpc(&env, registryP, "test.count", argArrayP, FOO_CALLINFO,
+              &resultP);
+        TEST_FAULT(&env, XMLRPC_TYPE_ERROR);
+        xmlrpc_DECREF(argArrayP);
+    }
+    xmlrpc_registry_free(registryP);
+
+    xmlrpc_env_clean(&env);
+
+    printf("\n");
+}
+
+
+
+static void
+testReplaceMethod(void) {
+
+    xmlrpc_env env;
+    xmlrpc_registry * registryP;
+    struct xmlrpc_method_info3 methodInfo;
+    struct xmlrpc_method_info_async asyncInfo;
+    struct asyncState state;
+    struct asyncResponse response;
+    unsigned int count1, count2;
+
+    printf("  Running method replacement tests.");
+
+    xmlrpc_env_init(&env);
+
+    registryP = xmlrpc_registry_new(&env);
+    TEST_NO_FAULT(&env);
+
+    count1 = 0;
+    xmlrpc_registry_add_method2(&env, registryP, "test.count",
+                                test_count, NULL, NULL, &count1);
+    TEST_NO_FAULT(&env);
+
+    {
+        xmlrpc_env env2;
+        xmlrpc_env_init(&env2);
+        xmlrpc_registry_add_method2(&env2, registryP, "test.count",
+                                    test_count, NULL, NULL, &count1);
+        TEST_FAULT(&env2, XMLRPC_INTERNAL_ERROR);
+        xmlrpc_env_clean(&env2);
+    }
+
+    /* Before its first call, the registry changes its method list in
+       place.  Replacing and removing a method work the same then.
+    */
+    count2 = 100;
+    methodInfo.methodName      = "test.early";
+    methodInfo.methodFunction  = &test_count;
+    methodInfo.serverInfo      = &count2;
+    methodInfo.stackSize       = 0;
+    methodInfo.signatureString = "i:i";
+    methodInfo.help            = NULL;
+
+    xmlrpc_registry_replace_method3(&env, registryP, &methodInfo);
+    TEST_NO_FAULT(&env);
+    xmlrpc_registry_replace_method3(&env, registryP, &methodInfo);
+    TEST_NO_FAULT(&env);
+
+    xmlrpc_registry_add_method2(&env, registryP, "test.gone",
+                                test_count, NULL, NULL, &count2);
+    TEST_NO_FAULT(&env);
+    xmlrpc_registry_remove_method(&env, registryP, "test.gone");
+    TEST_NO_FAULT(&env);
+
+    TEST(callCount(registryP, "test.count", "(i)", 1) == 1);
+    TEST(callCount(registryP, "test.early", "(i)", 1) == 101);
+    TEST(callCount(registryP, "test.gone", "(i)", 1) == -1);
+
+    xmlrpc_registry_add_method2(&env, registryP, "test.gone",
+                                test_count, NULL, NULL, &count2);
+    TEST_NO_FAULT(&env);
+    TEST(callCount(registryP, "test.gone", "(i)", 1) == 102);
+
+    /* Replacing a method changes what a call executes */
+    count2 = 10;
+    methodInfo.methodName      = "test.count";
+    methodInfo.methodFunction  = &test_count;
+    methodInfo.serverInfo      = &count2;
+    methodInfo.stackSize       = 0;
+    methodInfo.signatureString = "i:i";
+    methodInfo.help            = NULL;
+
+    xmlrpc_registry_replace_method3(&env, registryP, &methodInfo);
+    TEST_NO_FAULT(&env);
+
+    TEST(callCount(registryP, "test.count", "(i)", 1) == 11);
+    TEST(count1 == 1);
+
+    /* Replacing a method that doesn't exist adds it */
+    methodInfo.methodName = "test.count2";
+    xmlrpc_registry_replace_method3(&env, registryP, &methodInfo);
+    TEST_NO_FAULT(&env);
+    TEST(callCount(registryP, "test.count2", "(i)", 1) == 12);
+
+    xmlrpc_registry_remove_method(&env, registryP, "test.count2");
+    TEST_NO_FAULT(&env);
+    TEST(callCount(registryP, "test.count2", "(i)", 1) == -1);
+    TEST(callCount(registryP, "test.count", "(i)", 1) == 13);
+
+    {
+        xmlrpc_env env2;
+        xmlrpc_method_stats stats;
+
+        xmlrpc_env_init(&env2);
+        xmlrpc_registry_remove_method(&env2, registryP, "test.count2");
+        TEST_FAULT(&env2, XMLRPC_NO_SUCH_METHOD_ERROR);
+        xmlrpc_env_clean(&env2);
+
+        xmlrpc_env_init(&env2);
+        xmlrpc_registry_get_method_stats(&env2, registryP, "test.count2",
+                                         &stats);
+        TEST_FAULT(&env2, XMLRPC_NO_SUCH_METHOD_ERROR);
+        xmlrpc_env_clean(&env2);
+    }
+
+    /* A call in progress finishes with the method it started with, even
+       if the method is gone from the registry by then.
+    */
+    state.pendingP = NULL;
+
+    asyncInfo.methodName      = "test.async";
+    asyncInfo.methodFunction  = &test_async;
+    asyncInfo.serverInfo      = &state;
+    asyncInfo.stackSize       = 0;
+    asyncInfo.signatureString = "i:iii";
+    asyncInfo.help            = NULL;
+
+    xmlrpc_registry_replace_method_async(&env, registryP, &asyncInfo);
+    TEST_NO_FAULT(&env);
+
+    doAsyncRpc(registryP, 3, &response);
+    TEST(response.count == 0);
+    TEST(state.pendingP != NULL);
+
+    xmlrpc_registry_remove_method(&env, registryP, "test.async");
+    TEST_NO_FAULT(&env);
+
+    {
+        xmlrpc_value * const valueP = xmlrpc_int_new(&env, 7);
+        TEST_NO_FAULT(&env);
+        xmlrpc_call_complete(state.pendingP, valueP);
+        xmlrpc_DECREF(valueP);
+    }
+    TEST(response.count == 1);
+    TEST_NO_FAULT(&response.fault);
+    xmlrpc_DECREF(response.resultP);
+
+    xmlrpc_registry_free(registryP);
+
+    xmlrpc_env_clean(&env);
+
+    printf("\n");
+}
+
+
+
+static void
+countRelease(void * const serverInfo) {
+
+    unsigned int * const countP = serverInfo;
+
+    *countP += 100;
+}
+
+
+
+static void
+testMethodRelease(void) {
+
+    xmlrpc_env env;
+    xmlrpc_registry * registryP;
+    struct xmlrpc_method_info3 methodInfo;
+    unsigned int count1, count2, count3;
+
+    printf("  Running method release tests.");
+
+    xmlrpc_env_init(&env);
+
+    registryP = xmlrpc_registry_new(&env);
+    TEST_NO_FAULT(&env);
+
+    count1 = 0;
+    count2 = 0;
+    count3 = 0;
+
+    methodInfo.methodName      = "test.count";
+    methodInfo.methodFunction  = &test_count;
+    methodInfo.serverInfo      = &count1;
+    methodInfo.stackSize       = 0;
+    methodInfo.signatureString = "i:i";
+    methodInfo.help            = NULL;
+
+    xmlrpc_registry_add_method3_w_release(&env, registryP, &methodInfo,
+                                          &countRelease);
+    TEST_NO_FAULT(&env);
+
+    /* Before the first call, a replaced method goes away at once */
+    methodInfo.serverInfo = &count2;
+    xmlrpc_registry_replace_method3_w_release(&env, registryP, &methodInfo,
+                                              &countRelease);
+    TEST_NO_FAULT(&env);
+    TEST(count1 == 100);
+
+    TEST(callCount(registryP, "test.count", "(i)", 1) == 1);
+
+    /* After it, too, once no call is executing it */
+    methodInfo.serverInfo = &count3;
+    xmlrpc_registry_replace_method3_w_release(&env, registryP, &methodInfo,
+                                              &countRelease);
+    TEST_NO_FAULT(&env);
+    TEST(count2 == 101);
+
+    TEST(callCount(registryP, "test.count", "(i)", 1) == 1);
+
+    xmlrpc_registry_remove_method(&env, registryP, "test.count");
+    TEST_NO_FAULT(&env);
+    TEST(count3 == 101);
+
+    /* A failed registration releases the server information right away */
+    count1 = 0;
+    methodInfo.serverInfo      = &count1;
+    methodInfo.signatureString = "i:q";
+    {
+        xmlrpc_env env2;
+        xmlrpc_env_init(&env2);
+        xmlrpc_registry_add_method3_w_release(&env2, registryP, &methodInfo,
+                                              &countRelease);
+        TEST(env2.fault_occurred);
+        xmlrpc_env_clean(&env2);
+    }
+    TEST(count1 == 100);
+
+    /* Destroying the registry releases the methods it still has */
+    count1 = 0;
+    methodInfo.signatureString = "i:i";
+    xmlrpc_registry_add_method3_w_release(&env, registryP, &methodInfo,
+                                          &countRelease);
+    TEST_NO_FAULT(&env);
+
+    xmlrpc_registry_free(registryP);
+    TEST(count1 == 100);
+
+    xmlrpc_env_clean(&env);
+
+    printf("\n");
+}
+
+
+
+static void
+testScheduler(void) {
+
+    xmlrpc_env env;
+    xmlrpc_registry * registryP;
+    unsigned int count;
+    xmlrpc_priority_stats stats;
+
+    printf("  Running scheduler tests.");
+
+    xmlrpc_env_init(&env);
+
+    registryP = xmlrpc_registry_new(&env);
+    TEST_NO_FAULT(&env);
+
+    count = 0;
+    xmlrpc_registry_add_method2(&env, registryP, "test.count",
+                                test_count, NULL, NULL, &count);
+    TEST_NO_FAULT(&env);
+
+    {
+        unsigned int const badWeights[XMLRPC_PRIORITY_COUNT] = {4, 0, 1};
+        xmlrpc_env env2;
+
+        xmlrpc_env_init(&env2);
+        xmlrpc_registry_set_scheduler(&env2, registryP, 2, badWeights);
+        TEST_FAULT(&env2, XMLRPC_INTERNAL_ERROR);
+        xmlrpc_env_clean(&env2);
+
+        xmlrpc_env_init(&env2);
+        xmlrpc_registry_set_method_priority(&env2, registryP, "test.nosuch",
+                                            xmlrpc_priority_high);
+        TEST_FAULT(&env2, XMLRPC_NO_SUCH_METHOD_ERROR);
+        xmlrpc_env_clean(&env2);
+
+        xmlrpc_env_init(&env2);
+        xmlrpc_registry_get_priority_stats(&env2, registryP,
+                                           (xmlrpc_priority)7, &stats);
+        TEST_FAULT(&env2, XMLRPC_INTERNAL_ERROR);
+        xmlrpc_env_clean(&env2);
+    }
+
+    /* Without a scheduler, there are no statistics */
+    TEST(callCount(registryP, "test.count", "(i)", 1) == 1);
+    xmlrpc_registry_get_priority_stats(&env, registryP,
+                                       xmlrpc_priority_normal, &stats);
+    TEST_NO_FAULT(&env);
+    TEST(stats.calls == 0);
+
+    xmlrpc_registry_set_scheduler(&env, registryP, 2, NULL);
+    TEST_NO_FAULT(&env);
+
+    /* A call counts in the class of its method's priority.  With nothing
+       else executing, it doesn't wait.
+    */
+    TEST(callCount(registryP, "test.count", "(i)", 1) == 2);
+
+    xmlrpc_registry_set_method_priority(&env, registryP, "test.count",
+                                        xmlrpc_priority_high);
+    TEST_NO_FAULT(&env);
+
+    TEST(callCount(registryP, "test.count", "(i)", 1) == 3);
+    TEST(callCount(registryP, "test.count", "(i)", 1) == 4);
+
+    xmlrpc_registry_get_priority_stats(&env, registryP,
+                                       xmlrpc_priority_normal, &stats);
+    TEST_NO_FAULT(&env);
+    TEST(stats.calls == 1);
+
+    xmlrpc_registry_get_priority_stats(&env, registryP,
+                                       xmlrpc_priority_high, &stats);
+    TEST_NO_FAULT(&env);
+    TEST(stats.calls == 2);
+    TEST(stats.waited == 0);
+    TEST(stats.wait[0] == 2);
+    TEST(stats.waiting == 0);
+
+    xmlrpc_registry_set_scheduler(&env, registryP, 0, NULL);
+    TEST_NO_FAULT(&env);
+
+    xmlrpc_registry_free(registryP);
+
+    xmlrpc_env_clean(&env);
+
+    printf("\n");
+}
+
+
+
+void
+test_method_registry(void) {
+
+    xmlrpc_env env, env2;
+    xmlrpc_value * valueP;
+    xmlrpc_registry * registryP;
+    xmlrpc_mem_block * responseP;
+
+    xmlrpc_env_init(&env);
+
+    testVersion();
+
+    printf("Running method registry tests.");
+
+    /* Create a new registry. */
+    registryP = xmlrpc_registry_new(&env);
+    TEST_NO_FAULT(&env);
+    TEST(registryP != NULL);
+
+    /* Add some test methods. */
+    xmlrpc_registry_add_method(&env, registryP, NULL, "test.foo",
+                               test_foo_type1, FOO_SERVERINFO);
+    TEST_NO_FAULT(&env);
+    xmlrpc_registry_add_method2(&env, registryP, "test.bar",
+                                test_bar, NULL, barHelp, BAR_SERVERINFO);
+    TEST_NO_FAULT(&env);
+
+    printf("\n");
+    testCall(registryP);
+
+    test_system_multicall(registryP);
+
+    testParallelMulticall(registryP);
+
+    testMulticallBadCall();
+
+#if HAVE_PTHREAD
+    testMulticallThreadBudget();
+#endif
+
+    testAsyncMethod();
+
+    testMethodStats();
+
+    testResponseCache();
+
+    testCallLimits();
+
+    testCheckParams();
+
+    testReplaceMethod();
+
+    testMethodRelease();
+
+    testScheduler();
+
+    xmlrpc_env_init(&env2);
+    xmlrpc_registry_process_call2(&env, registryP,
+                                  expat_error_data,
                                   strlen(expat_error_data),
                                   NULL,
                                   &responseP);
@@ -1105,6 +2687,8 @@ test_method_registry(void) {
 
     test_system_methodExist(registryP);
 
+    testManyMethods();
+
     test_system_methodHelp(registryP);
 
     test_system_capabilities(registryP);
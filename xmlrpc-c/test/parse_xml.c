@@ -586,6 +586,100 @@ testParseXmlValue(void) {
 
 
 
+struct record {
+    xmlrpc_int32 id;
+    const char * name;
+    xmlrpc_int64 size;
+    xmlrpc_bool  active;
+    double       ratio;
+};
+
+static const xmlrpc_struct_field recordFields[] = {
+    XMLRPC_STRUCT_FIELD(struct record, id,     XMLRPC_TYPE_INT),
+    XMLRPC_STRUCT_FIELD(struct record, name,   XMLRPC_TYPE_STRING),
+    XMLRPC_STRUCT_FIELD(struct record, size,   XMLRPC_TYPE_I8),
+    XMLRPC_STRUCT_FIELD(struct record, active, XMLRPC_TYPE_BOOL),
+    XMLRPC_STRUCT_FIELD(struct record, ratio,  XMLRPC_TYPE_DOUBLE),
+    XMLRPC_STRUCT_FIELD_END
+};
+
+
+
+static void
+testParseStructDirect(void) {
+
+    const char * const xmlRecord =
+        "<value><struct>\r\n"
+        "<member><name>extra</name><value><array><data/></array></value>"
+        "</member>\r\n"
+        "<member><name>name</name><value>first</value></member>\r\n"
+        "<member><name>ratio</name><value><double>0.25</double></value>"
+        "</member>\r\n"
+        "<member><name>id</name><value><i4>-7</i4></value></member>\r\n"
+        "<member><name>active</name><value><boolean>1</boolean></value>"
+        "</member>\r\n"
+        "<member><name>size</name><value><ex:i8>1099511627776</ex:i8>"
+        "</value></member>\r\n"
+        "<member><name>name</name><value><string>a&lt;b</string></value>"
+        "</member>\r\n"
+        "</struct></value>";
+    const char * const xmlMissing =
+        "<value><struct>"
+        "<member><name>id</name><value><i4>7</i4></value></member>"
+        "<member><name>name</name><value>x</value></member>"
+        "</struct></value>";
+    const char * const xmlWrongType =
+        "<value><struct>"
+        "<member><name>name</name><value>x</value></member>"
+        "<member><name>id</name><value><string>7</string></value></member>"
+        "</struct></value>";
+    const char * const xmlNotStruct = "<value><int>7</int></value>";
+    const char * const xmlBadUtf8 =
+        "<value><struct>"
+        "<member><name>id</name><value><i4>7</i4></value></member>"
+        "<member><name>name</name><value><string>\xC0\x80</string></value>"
+        "</member>"
+        "</struct></value>";
+        /* \xC0\x80 is an overlong (invalid) UTF-8 encoding of NUL, which
+           the XML parser passes through
+        */
+
+    xmlrpc_env env;
+    struct record record;
+
+    xmlrpc_env_init(&env);
+
+    xmlrpc_parse_struct_direct(&env, xmlRecord, strlen(xmlRecord),
+                               recordFields, &record);
+    TEST_NO_FAULT(&env);
+    TEST(record.id == -7);
+    TEST(streq(record.name, "a<b"));
+    TEST(record.size == (xmlrpc_int64)1 << 40);
+    TEST(record.active == 1);
+    TEST(record.ratio == 0.25);
+    strfree(record.name);
+
+    xmlrpc_parse_struct_direct(&env, xmlMissing, strlen(xmlMissing),
+                               recordFields, &record);
+    TEST_FAULT(&env, XMLRPC_PARSE_ERROR);
+
+    xmlrpc_parse_struct_direct(&env, xmlWrongType, strlen(xmlWrongType),
+                               recordFields, &record);
+    TEST_FAULT(&env, XMLRPC_PARSE_ERROR);
+
+    xmlrpc_parse_struct_direct(&env, xmlNotStruct, strlen(xmlNotStruct),
+                               recordFields, &record);
+    TEST_FAULT(&env, XMLRPC_PARSE_ERROR);
+
+    xmlrpc_parse_struct_direct(&env, xmlBadUtf8, strlen(xmlBadUtf8),
+                               recordFields, &record);
+    TEST_FAULT(&env, XMLRPC_INVALID_UTF8_ERROR);
+
+    xmlrpc_env_clean(&env);
+}
+
+
+
 void
 test_parse_xml(void) {
 
@@ -598,6 +692,7 @@ test_parse_xml(void) {
     testParseBadResponse();
     testParseXmlCall();
     testParseXmlValue();
+    testParseStructDirect();
     printf("\n");
     printf("XML parsing tests done.\n");
 }
@@ -5,10 +5,12 @@
 #include "xmlrpc_config.h"
 
 #include "xmlrpc-c/base.h"
+#include "xmlrpc-c/json.h"
 
 #include "testtool.h"
 #include "xml_data.h"
 #include "girstring.h"
+#include "casprintf.h"
 #include "serialize_value.h"
 
 #include "serialize.h"
@@ -298,6 +300,567 @@ test_serialize_apache(void) {
 
 
 
+static void
+testOneSerialization(xmlrpc_value * const valueP,
+                     const char *   const expected) {
+
+    xmlrpc_env env;
+    xmlrpc_mem_block * outputP;
+
+    xmlrpc_env_init(&env);
+
+    outputP = XMLRPC_MEMBLOCK_NEW(char, &env, 0);
+    TEST_NO_FAULT(&env);
+    xmlrpc_serialize_value(&env, outputP, valueP);
+    TEST_NO_FAULT(&env);
+    TEST(XMLRPC_MEMBLOCK_SIZE(char, outputP) == strlen(expected));
+    TEST(memeq(XMLRPC_MEMBLOCK_CONTENTS(char, outputP), expected,
+               XMLRPC_MEMBLOCK_SIZE(char, outputP)));
+    XMLRPC_MEMBLOCK_FREE(char, outputP);
+    xmlrpc_DECREF(valueP);
+
+    xmlrpc_env_clean(&env);
+}
+
+
+
+static void
+test_serialize_numbers(void) {
+
+    /* Integers and datetimes, which we format without printf */
+
+    xmlrpc_env env;
+    xmlrpc_datetime dt;
+
+    xmlrpc_env_init(&env);
+
+    testOneSerialization(xmlrpc_int_new(&env, 0),
+                         "<value><i4>0</i4></value>");
+    testOneSerialization(xmlrpc_int_new(&env, 9),
+                         "<value><i4>9</i4></value>");
+    testOneSerialization(xmlrpc_int_new(&env, -10),
+                         "<value><i4>-10</i4></value>");
+    testOneSerialization(xmlrpc_int_new(&env, 100),
+                         "<value><i4>100</i4></value>");
+    testOneSerialization(xmlrpc_i8_new(&env, XMLRPC_INT64_MAX),
+                         "<value><i8>9223372036854775807</i8></value>");
+    testOneSerialization(xmlrpc_i8_new(&env, XMLRPC_INT64_MIN),
+                         "<value><i8>-9223372036854775808</i8></value>");
+
+    dt.Y = 2013; dt.M = 1; dt.D = 2; dt.h = 3; dt.m = 4; dt.s = 5; dt.u = 0;
+    testOneSerialization(xmlrpc_datetime_new(&env, dt),
+                         "<value><dateTime.iso8601>20130102T03:04:05"
+                         "</dateTime.iso8601></value>");
+
+    dt.Y = 999; dt.u = 60708;
+    testOneSerialization(xmlrpc_datetime_new(&env, dt),
+                         "<value><dateTime.iso8601>9990102T03:04:05.060708"
+                         "</dateTime.iso8601></value>");
+    TEST_NO_FAULT(&env);
+
+    xmlrpc_env_clean(&env);
+}
+
+
+
+static void
+test_serialize_compact(void) {
+
+    /* Serialize various things using the compact dialect of XML-RPC, and
+       make sure they parse back.
+    */
+    char const serializedValue[] =
+        "<value><array><data>"
+            "<value><i4>7</i4></value>"
+            "<value><i8>8</i8></value>"
+            "<value>a&lt;b</value>"
+            "<value><struct><member><name>k</name>"
+                "<value><base64>"
+                "MDEyMzQ1Njc4OTAxMjM0NTY3ODkwMTIzNDU2Nzg5MDEyMzQ1Njc4OTAx"
+                "MjM0NTY3ODkwMTIzNDU2Nzg5</base64></value>"
+            "</member></struct></value>"
+            "<value><nil/></value>"
+        "</data></array></value>";
+
+    char const serializedCall[] =
+        XML_PROLOGUE_COMPACT
+        "<methodCall><methodName>m</methodName>"
+        "<params><param><value>x</value></param></params>"
+        "</methodCall>";
+
+    char const serializedResponse[] =
+        XML_PROLOGUE_COMPACT
+        "<methodResponse><params>"
+        "<param><value><i4>5</i4></value></param>"
+        "</params></methodResponse>";
+
+    char const serializedFault[] =
+        XML_PROLOGUE_COMPACT
+        "<methodResponse><fault>"
+        "<value><struct>"
+        "<member><name>faultCode</name><value><i4>6</i4></value></member>"
+        "<member><name>faultString</name><value>A fault occurred</value>"
+        "</member>"
+        "</struct></value>"
+        "</fault></methodResponse>";
+
+    xmlrpc_env env;
+    xmlrpc_env fault;
+    xmlrpc_value * valueP;
+    xmlrpc_value * paramArrayP;
+    xmlrpc_mem_block * outputP;
+    const char * methodName;
+    xmlrpc_value * parsedParamArrayP;
+    xmlrpc_value * parsedValueP;
+
+    xmlrpc_env_init(&env);
+
+    valueP = xmlrpc_build_value(
+        &env, "(iIs{s:6}n)", 7, (xmlrpc_int64)8, "a<b", "k",
+        "012345678901234567890123456789012345678901234567890123456789",
+        (size_t)60);
+    TEST_NO_FAULT(&env);
+
+    outputP = XMLRPC_MEMBLOCK_NEW(char, &env, 0);
+    TEST_NO_FAULT(&env);
+    xmlrpc_serialize_value2(&env, outputP, valueP, xmlrpc_dialect_compact);
+    TEST_NO_FAULT(&env);
+    TEST(XMLRPC_MEMBLOCK_SIZE(char, outputP) == strlen(serializedValue));
+    TEST(memeq(XMLRPC_MEMBLOCK_CONTENTS(char, outputP), serializedValue,
+               XMLRPC_MEMBLOCK_SIZE(char, outputP)));
+
+    xmlrpc_parse_value_xml(&env, XMLRPC_MEMBLOCK_CONTENTS(char, outputP),
+                           XMLRPC_MEMBLOCK_SIZE(char, outputP),
+                           &parsedValueP);
+    TEST_NO_FAULT(&env);
+    {
+        const char * str;
+        xmlrpc_value * itemP;
+        xmlrpc_array_read_item(&env, parsedValueP, 2, &itemP);
+        TEST_NO_FAULT(&env);
+        xmlrpc_read_string(&env, itemP, &str);
+        TEST_NO_FAULT(&env);
+        TEST(streq(str, "a<b"));
+        strfree(str);
+        xmlrpc_DECREF(itemP);
+    }
+    xmlrpc_DECREF(parsedValueP);
+    XMLRPC_MEMBLOCK_FREE(char, outputP);
+    xmlrpc_DECREF(valueP);
+
+    paramArrayP = xmlrpc_build_value(&env, "(s)", "x");
+    TEST_NO_FAULT(&env);
+    outputP = XMLRPC_MEMBLOCK_NEW(char, &env, 0);
+    TEST_NO_FAULT(&env);
+    xmlrpc_serialize_call2(&env, outputP, "m", paramArrayP,
+                           xmlrpc_dialect_compact);
+    TEST_NO_FAULT(&env);
+    TEST(XMLRPC_MEMBLOCK_SIZE(char, outputP) == strlen(serializedCall));
+    TEST(memeq(XMLRPC_MEMBLOCK_CONTENTS(char, outputP), serializedCall,
+               XMLRPC_MEMBLOCK_SIZE(char, outputP)));
+
+    xmlrpc_parse_call(&env, XMLRPC_MEMBLOCK_CONTENTS(char, outputP),
+                      XMLRPC_MEMBLOCK_SIZE(char, outputP),
+                      &methodName, &parsedParamArrayP);
+    TEST_NO_FAULT(&env);
+    TEST(streq(methodName, "m"));
+    TEST(xmlrpc_array_size(&env, parsedParamArrayP) == 1);
+    strfree(methodName);
+    xmlrpc_DECREF(parsedParamArrayP);
+    XMLRPC_MEMBLOCK_FREE(char, outputP);
+    xmlrpc_DECREF(paramArrayP);
+
+    valueP = xmlrpc_int_new(&env, 5);
+    TEST_NO_FAULT(&env);
+    outputP = XMLRPC_MEMBLOCK_NEW(char, &env, 0);
+    TEST_NO_FAULT(&env);
+    xmlrpc_serialize_response2(&env, outputP, valueP, xmlrpc_dialect_compact);
+    TEST_NO_FAULT(&env);
+    TEST(XMLRPC_MEMBLOCK_SIZE(char, outputP) == strlen(serializedResponse));
+    TEST(memeq(XMLRPC_MEMBLOCK_CONTENTS(char, outputP), serializedResponse,
+               XMLRPC_MEMBLOCK_SIZE(char, outputP)));
+    XMLRPC_MEMBLOCK_FREE(char, outputP);
+    xmlrpc_DECREF(valueP);
+
+    xmlrpc_env_init(&fault);
+    xmlrpc_env_set_fault(&fault, 6, "A fault occurred");
+    outputP = XMLRPC_MEMBLOCK_NEW(char, &env, 0);
+    TEST_NO_FAULT(&env);
+    xmlrpc_serialize_fault2(&env, outputP, &fault, xmlrpc_dialect_compact);
+    TEST_NO_FAULT(&env);
+    TEST(XMLRPC_MEMBLOCK_SIZE(char, outputP) == strlen(serializedFault));
+    TEST(memeq(XMLRPC_MEMBLOCK_CONTENTS(char, outputP), serializedFault,
+               XMLRPC_MEMBLOCK_SIZE(char, outputP)));
+    {
+        xmlrpc_env parseEnv;
+        xmlrpc_value * resultP;
+
+        xmlrpc_env_init(&parseEnv);
+        resultP = xmlrpc_parse_response(
+            &parseEnv, XMLRPC_MEMBLOCK_CONTENTS(char, outputP),
+            XMLRPC_MEMBLOCK_SIZE(char, outputP));
+        TEST_FAULT(&parseEnv, 6);
+        TEST(resultP == NULL);
+        xmlrpc_env_clean(&parseEnv);
+    }
+    XMLRPC_MEMBLOCK_FREE(char, outputP);
+    xmlrpc_env_clean(&fault);
+
+    xmlrpc_env_clean(&env);
+}
+
+
+
+static void
+testSerializedSame(xmlrpc_value * const value1P,
+                   xmlrpc_value * const value2P,
+                   xmlrpc_dialect const dialect) {
+/*----------------------------------------------------------------------------
+   Test that *value1P and *value2P serialize the same, in both XML and JSON.
+-----------------------------------------------------------------------------*/
+    xmlrpc_env env;
+    xmlrpc_mem_block * out1P;
+    xmlrpc_mem_block * out2P;
+
+    xmlrpc_env_init(&env);
+
+    out1P = XMLRPC_MEMBLOCK_NEW(char, &env, 0);
+    out2P = XMLRPC_MEMBLOCK_NEW(char, &env, 0);
+    xmlrpc_serialize_value2(&env, out1P, value1P, dialect);
+    TEST_NO_FAULT(&env);
+    xmlrpc_serialize_value2(&env, out2P, value2P, dialect);
+    TEST_NO_FAULT(&env);
+    TEST(XMLRPC_MEMBLOCK_SIZE(char, out1P) == XMLRPC_MEMBLOCK_SIZE(char, out2P));
+    TEST(memeq(XMLRPC_MEMBLOCK_CONTENTS(char, out1P),
+               XMLRPC_MEMBLOCK_CONTENTS(char, out2P),
+               XMLRPC_MEMBLOCK_SIZE(char, out1P)));
+    XMLRPC_MEMBLOCK_FREE(char, out2P);
+    XMLRPC_MEMBLOCK_FREE(char, out1P);
+
+    out1P = XMLRPC_MEMBLOCK_NEW(char, &env, 0);
+    out2P = XMLRPC_MEMBLOCK_NEW(char, &env, 0);
+    xmlrpc_serialize_json(&env, value1P, out1P);
+    TEST_NO_FAULT(&env);
+    xmlrpc_serialize_json(&env, value2P, out2P);
+    TEST_NO_FAULT(&env);
+    TEST(XMLRPC_MEMBLOCK_SIZE(char, out1P) == XMLRPC_MEMBLOCK_SIZE(char, out2P));
+    TEST(memeq(XMLRPC_MEMBLOCK_CONTENTS(char, out1P),
+               XMLRPC_MEMBLOCK_CONTENTS(char, out2P),
+               XMLRPC_MEMBLOCK_SIZE(char, out1P)));
+    XMLRPC_MEMBLOCK_FREE(char, out2P);
+    XMLRPC_MEMBLOCK_FREE(char, out1P);
+
+    xmlrpc_env_clean(&env);
+}
+
+
+
+static void
+test_serialize_cached(void) {
+
+    /* Serialize values that carry a serialization cache and compare with
+       identical values that don't.
+    */
+    xmlrpc_env env;
+    xmlrpc_value * tableP;
+    xmlrpc_value * plainTableP;
+    xmlrpc_value * responseP;
+    xmlrpc_value * plainResponseP;
+    xmlrpc_value * itemP;
+
+    xmlrpc_env_init(&env);
+
+    tableP = xmlrpc_build_value(&env, "{s:(iIs),s:{s:b}}",
+                                "list", 7, (xmlrpc_int64)8, "<&>",
+                                "flags", "on", (xmlrpc_bool)1);
+    TEST_NO_FAULT(&env);
+    plainTableP = xmlrpc_build_value(&env, "{s:(iIs),s:{s:b}}",
+                                     "list", 7, (xmlrpc_int64)8, "<&>",
+                                     "flags", "on", (xmlrpc_bool)1);
+    TEST_NO_FAULT(&env);
+
+    xmlrpc_value_cache_serialization(&env, tableP, xmlrpc_dialect_i8, 1);
+    TEST_NO_FAULT(&env);
+
+    responseP = xmlrpc_build_value(&env, "(iV(V))", 1, tableP, tableP);
+    TEST_NO_FAULT(&env);
+    plainResponseP = xmlrpc_build_value(&env, "(iV(V))",
+                                        1, plainTableP, plainTableP);
+    TEST_NO_FAULT(&env);
+
+    testSerializedSame(responseP, plainResponseP, xmlrpc_dialect_i8);
+
+    /* A different dialect ignores the cache */
+    testSerializedSame(responseP, plainResponseP, xmlrpc_dialect_apache);
+
+    /* The cached value and its contents are frozen */
+    itemP = xmlrpc_int_new(&env, 9);
+    TEST_NO_FAULT(&env);
+    xmlrpc_struct_set_value(&env, tableP, "new", itemP);
+    TEST_FAULT(&env, XMLRPC_INTERNAL_ERROR);
+    {
+        xmlrpc_value * listP;
+        xmlrpc_struct_find_value(&env, tableP, "list", &listP);
+        TEST_NO_FAULT(&env);
+        xmlrpc_array_append_item(&env, listP, itemP);
+        TEST_FAULT(&env, XMLRPC_INTERNAL_ERROR);
+        xmlrpc_DECREF(listP);
+    }
+    /* But a value that merely contains it is not */
+    xmlrpc_array_append_item(&env, responseP, itemP);
+    TEST_NO_FAULT(&env);
+    xmlrpc_DECREF(itemP);
+
+    /* Caching again replaces the cache */
+    xmlrpc_value_cache_serialization(&env, tableP, xmlrpc_dialect_apache,
+                                     0);
+    TEST_NO_FAULT(&env);
+    testSerializedSame(tableP, plainTableP, xmlrpc_dialect_apache);
+
+    xmlrpc_DECREF(plainResponseP);
+    xmlrpc_DECREF(responseP);
+    xmlrpc_DECREF(plainTableP);
+    xmlrpc_DECREF(tableP);
+
+    /* A value we can't serialize gets no cache and stays modifiable */
+    tableP = xmlrpc_build_value(&env, "({s:i}p)", "a", 1, (void *)&env);
+    TEST_NO_FAULT(&env);
+
+    xmlrpc_value_cache_serialization(&env, tableP, xmlrpc_dialect_i8, 0);
+    TEST_FAULT(&env, XMLRPC_INTERNAL_ERROR);
+
+    itemP = xmlrpc_int_new(&env, 9);
+    TEST_NO_FAULT(&env);
+    {
+        xmlrpc_value * memberP;
+        xmlrpc_array_read_item(&env, tableP, 0, &memberP);
+        TEST_NO_FAULT(&env);
+        xmlrpc_struct_set_value(&env, memberP, "new", itemP);
+        TEST_NO_FAULT(&env);
+        xmlrpc_DECREF(memberP);
+    }
+    xmlrpc_array_append_item(&env, tableP, itemP);
+    TEST_NO_FAULT(&env);
+    xmlrpc_DECREF(itemP);
+
+    xmlrpc_DECREF(tableP);
+
+    xmlrpc_env_clean(&env);
+}
+
+
+
+static void
+testParallelSame(xmlrpc_value * const valueP,
+                 unsigned int   const threadCount) {
+/*----------------------------------------------------------------------------
+   Test that serializing *valueP with 'threadCount' threads gives the same
+   XML as serializing it with one.
+-----------------------------------------------------------------------------*/
+    xmlrpc_env env;
+    xmlrpc_mem_block * serialP;
+    xmlrpc_mem_block * parallelP;
+
+    xmlrpc_env_init(&env);
+
+    serialP = XMLRPC_MEMBLOCK_NEW(char, &env, 0);
+    parallelP = XMLRPC_MEMBLOCK_NEW(char, &env, 0);
+    xmlrpc_serialize_response2(&env, serialP, valueP, xmlrpc_dialect_i8);
+    TEST_NO_FAULT(&env);
+    xmlrpc_serialize_response_parallel(&env, parallelP, valueP,
+                                       xmlrpc_dialect_i8, threadCount);
+    TEST_NO_FAULT(&env);
+    TEST(XMLRPC_MEMBLOCK_SIZE(char, serialP) ==
+         XMLRPC_MEMBLOCK_SIZE(char, parallelP));
+    TEST(memeq(XMLRPC_MEMBLOCK_CONTENTS(char, serialP),
+               XMLRPC_MEMBLOCK_CONTENTS(char, parallelP),
+               XMLRPC_MEMBLOCK_SIZE(char, serialP)));
+    XMLRPC_MEMBLOCK_FREE(char, parallelP);
+    XMLRPC_MEMBLOCK_FREE(char, serialP);
+
+    xmlrpc_env_clean(&env);
+}
+
+
+
+static void
+test_serialize_parallel(void) {
+
+    /* Arrays and structures big enough to be divided among threads */
+
+    xmlrpc_env env;
+    xmlrpc_value * rowsP;
+    xmlrpc_value * tableP;
+    xmlrpc_value * wrapperP;
+    xmlrpc_mem_block * outputP;
+    unsigned int i;
+
+    xmlrpc_env_init(&env);
+
+    rowsP = xmlrpc_array_new(&env);
+    TEST_NO_FAULT(&env);
+    tableP = xmlrpc_struct_new(&env);
+    TEST_NO_FAULT(&env);
+
+    for (i = 0; i < 5000; ++i) {
+        char key[20];
+        xmlrpc_value * const rowP =
+            xmlrpc_build_value(&env, "(iIsd)", i, (xmlrpc_int64)i * 7,
+                               "a<b", i / 4.0);
+        TEST_NO_FAULT(&env);
+        xmlrpc_array_append_item(&env, rowsP, rowP);
+        TEST_NO_FAULT(&env);
+        sprintf(key, "key%u", i);
+        xmlrpc_struct_set_value(&env, tableP, key, rowP);
+        TEST_NO_FAULT(&env);
+        xmlrpc_DECREF(rowP);
+    }
+    testParallelSame(rowsP, 4);
+    testParallelSame(tableP, 3);
+    testParallelSame(rowsP, 1);
+
+    /* A big array inside a small structure still gets divided */
+    wrapperP = xmlrpc_build_value(&env, "{s:A,s:i}", "rows", rowsP, "n", 1);
+    TEST_NO_FAULT(&env);
+    testParallelSame(wrapperP, 4);
+    xmlrpc_DECREF(wrapperP);
+
+    /* A failure in one slice fails the whole thing */
+    {
+        xmlrpc_value * const cptrP = xmlrpc_cptr_new(&env, &env);
+        TEST_NO_FAULT(&env);
+        xmlrpc_array_append_item(&env, rowsP, cptrP);
+        TEST_NO_FAULT(&env);
+        xmlrpc_DECREF(cptrP);
+    }
+    outputP = XMLRPC_MEMBLOCK_NEW(char, &env, 0);
+    xmlrpc_serialize_value_parallel(&env, outputP, rowsP,
+                                    xmlrpc_dialect_i8, 4);
+    TEST_FAULT(&env, XMLRPC_INTERNAL_ERROR);
+    XMLRPC_MEMBLOCK_FREE(char, outputP);
+
+    xmlrpc_DECREF(tableP);
+    xmlrpc_DECREF(rowsP);
+
+    xmlrpc_env_clean(&env);
+}
+
+
+
+struct record {
+    xmlrpc_int32 id;
+    const char * name;
+    xmlrpc_int64 size;
+    xmlrpc_bool  active;
+    double       ratio;
+};
+
+static const xmlrpc_struct_field recordFields[] = {
+    XMLRPC_STRUCT_FIELD(struct record, id,     XMLRPC_TYPE_INT),
+    XMLRPC_STRUCT_FIELD(struct record, name,   XMLRPC_TYPE_STRING),
+    XMLRPC_STRUCT_FIELD(struct record, size,   XMLRPC_TYPE_I8),
+    XMLRPC_STRUCT_FIELD(struct record, active, XMLRPC_TYPE_BOOL),
+    XMLRPC_STRUCT_FIELD_NAMED("r&r", struct record, ratio,
+                              XMLRPC_TYPE_DOUBLE),
+    XMLRPC_STRUCT_FIELD_END
+};
+
+
+
+static void
+testStructDirectSame(const struct record * const recordP,
+                     xmlrpc_value *        const valueP,
+                     xmlrpc_dialect        const dialect) {
+/*----------------------------------------------------------------------------
+   Test that *recordP serializes directly the same as *valueP does, both as
+   a value and as a response.
+-----------------------------------------------------------------------------*/
+    xmlrpc_env env;
+    xmlrpc_mem_block * directP;
+    xmlrpc_mem_block * viaValueP;
+
+    xmlrpc_env_init(&env);
+
+    directP = XMLRPC_MEMBLOCK_NEW(char, &env, 0);
+    viaValueP = XMLRPC_MEMBLOCK_NEW(char, &env, 0);
+    xmlrpc_serialize_struct_direct(&env, directP, recordFields, recordP,
+                                   dialect);
+    TEST_NO_FAULT(&env);
+    xmlrpc_serialize_value2(&env, viaValueP, valueP, dialect);
+    TEST_NO_FAULT(&env);
+    TEST(XMLRPC_MEMBLOCK_SIZE(char, directP) ==
+         XMLRPC_MEMBLOCK_SIZE(char, viaValueP));
+    TEST(memeq(XMLRPC_MEMBLOCK_CONTENTS(char, directP),
+               XMLRPC_MEMBLOCK_CONTENTS(char, viaValueP),
+               XMLRPC_MEMBLOCK_SIZE(char, directP)));
+    XMLRPC_MEMBLOCK_FREE(char, viaValueP);
+    XMLRPC_MEMBLOCK_FREE(char, directP);
+
+    directP = XMLRPC_MEMBLOCK_NEW(char, &env, 0);
+    viaValueP = XMLRPC_MEMBLOCK_NEW(char, &env, 0);
+    xmlrpc_serialize_response_struct_direct(&env, directP, recordFields,
+                                            recordP, dialect);
+    TEST_NO_FAULT(&env);
+    xmlrpc_serialize_response2(&env, viaValueP, valueP, dialect);
+    TEST_NO_FAULT(&env);
+    TEST(XMLRPC_MEMBLOCK_SIZE(char, directP) ==
+         XMLRPC_MEMBLOCK_SIZE(char, viaValueP));
+    TEST(memeq(XMLRPC_MEMBLOCK_CONTENTS(char, directP),
+               XMLRPC_MEMBLOCK_CONTENTS(char, viaValueP),
+               XMLRPC_MEMBLOCK_SIZE(char, directP)));
+    XMLRPC_MEMBLOCK_FREE(char, viaValueP);
+    XMLRPC_MEMBLOCK_FREE(char, directP);
+
+    xmlrpc_env_clean(&env);
+}
+
+
+
+static void
+test_serialize_struct_direct(void) {
+
+    /* Serialize a C structure through a structure descriptor */
+
+    xmlrpc_env env;
+    struct record record;
+    xmlrpc_value * valueP;
+    xmlrpc_mem_block * outputP;
+
+    xmlrpc_env_init(&env);
+
+    record.id     = -12;
+    record.name   = "a<b & c";
+    record.size   = (xmlrpc_int64)1 << 40;
+    record.active = 1;
+    record.ratio  = 2.5;
+
+    valueP = xmlrpc_build_value(&env, "{s:i,s:s,s:I,s:b,s:d}",
+                                "id", record.id,
+                                "name", record.name,
+                                "size", record.size,
+                                "active", record.active,
+                                "r&r", record.ratio);
+    TEST_NO_FAULT(&env);
+
+    testStructDirectSame(&record, valueP, xmlrpc_dialect_i8);
+    testStructDirectSame(&record, valueP, xmlrpc_dialect_apache);
+    testStructDirectSame(&record, valueP, xmlrpc_dialect_compact);
+
+    xmlrpc_DECREF(valueP);
+
+    /* A null string pointer can't be serialized */
+    record.name = NULL;
+    outputP = XMLRPC_MEMBLOCK_NEW(char, &env, 0);
+    xmlrpc_serialize_struct_direct(&env, outputP, recordFields, &record,
+                                   xmlrpc_dialect_i8);
+    TEST_FAULT(&env, XMLRPC_INTERNAL_ERROR);
+    XMLRPC_MEMBLOCK_FREE(char, outputP);
+
+    xmlrpc_env_clean(&env);
+}
+
+
+
 void 
 test_serialize(void) {
 
@@ -310,6 +873,11 @@ test_serialize(void) {
     test_serialize_methodCall();
     test_serialize_fault();
     test_serialize_apache();
+    test_serialize_numbers();
+    test_serialize_compact();
+    test_serialize_cached();
+    test_serialize_parallel();
+    test_serialize_struct_direct();
 
     printf("\n");
     printf("Serialize tests done.\n");
@@ -107,6 +107,11 @@ testServerParms(void) {
     parms.sockaddr_p = &sockaddr;
     parms.sockaddrlen = sizeof(sockaddr);
     parms.log_file_name = "/tmp/xmlrpc_logfile";
+    parms.event_driven = TRUE;
+    parms.worker_threads = 4;
+    parms.acceptor_threads = 2;
+    parms.read_buffer_size = 65536;
+    parms.stats_uri = "/stats";
 };
 
 
@@ -245,6 +250,31 @@ testObject(void) {
 
 
 
+static void
+testStats(TServer * const abyssServerP) {
+
+    TServerStats stats;
+
+    ServerSetStatsUri(abyssServerP, "/stats");
+    ServerSetStatsUri(abyssServerP, NULL);
+    ServerSetStatsUri(abyssServerP, "/stats");
+
+    ServerGetStats(abyssServerP, &stats);
+
+    TEST(stats.startTime != 0);
+    TEST(stats.connectionsAccepted == 0);
+    TEST(stats.connectionsOpen == 0);
+    TEST(stats.connectionsActive == 0);
+    TEST(stats.requests == 0);
+    TEST(stats.requestsOnReusedConn == 0);
+    TEST(stats.bytesIn == 0);
+    TEST(stats.bytesOut == 0);
+    TEST(stats.readTime[0] == 0);
+    TEST(stats.writeTime[ABYSS_STATS_BUCKETS-1] == 0);
+}
+
+
+
 void
 test_server_abyss(void) {
 
@@ -262,6 +292,12 @@ test_server_abyss(void) {
     ServerSetKeepaliveMaxConn(&abyssServer, 10);
     ServerSetTimeout(&abyssServer, 0);
     ServerSetAdvertise(&abyssServer, FALSE);
+    ServerSetEventDriven(&abyssServer, TRUE);
+    ServerSetWorkerThreads(&abyssServer, 4);
+    ServerSetAcceptorThreads(&abyssServer, 2);
+    ServerSetReadBufferSize(&abyssServer, 65536);
+
+    testStats(&abyssServer);
 
     ServerFree(&abyssServer);
 
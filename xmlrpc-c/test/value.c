@@ -1843,6 +1843,110 @@ test_struct (void) {
 
 
 
+static void
+test_value_compiled(void) {
+
+    xmlrpc_env env;
+    xmlrpc_builder * builderP;
+    xmlrpc_decomposer * decomposerP;
+    xmlrpc_value * v;
+    xmlrpc_int32 i;
+    const char * str;
+    size_t len;
+    xmlrpc_bool b;
+    unsigned int n;
+
+    xmlrpc_env_init(&env);
+
+    xmlrpc_build_compile(&env, "({s:i,s:s#}b)", &builderP);
+    TEST_NO_FAULT(&env);
+    xmlrpc_decompose_compile(&env, "({s:i,s:s#,*}b)", &decomposerP);
+    TEST_NO_FAULT(&env);
+
+    /* A compiled format string is good for any number of values */
+    for (n = 0; n < 2; ++n) {
+        v = xmlrpc_build_compiled(&env, builderP,
+                                  "int", (xmlrpc_int32)n,
+                                  "str", "a\0b", (size_t)3,
+                                  (xmlrpc_bool)n);
+        TEST_NO_FAULT(&env);
+
+        xmlrpc_decompose_compiled(&env, v, decomposerP,
+                                  "int", &i, "str", &str, &len, &b);
+        TEST_NO_FAULT(&env);
+        TEST(i == (xmlrpc_int32)n);
+        TEST(len == 3 && memeq(str, "a\0b", 3));
+        TEST(!b == !n);
+        strfree(str);
+        xmlrpc_DECREF(v);
+    }
+    xmlrpc_builder_destroy(builderP);
+
+    /* Wrong type */
+    v = xmlrpc_build_value(&env, "(ib)", (xmlrpc_int32)1, (xmlrpc_bool)1);
+    TEST_NO_FAULT(&env);
+    xmlrpc_decompose_compiled(&env, v, decomposerP,
+                              "int", &i, "str", &str, &len, &b);
+    TEST_FAULT(&env, XMLRPC_TYPE_ERROR);
+    xmlrpc_DECREF(v);
+    xmlrpc_decomposer_destroy(decomposerP);
+
+    /* More arguments than fit in the decomposer's stack buffer */
+    xmlrpc_decompose_compile(&env, "((iiiiiiiiii)(iiiiiiiiii))",
+                             &decomposerP);
+    TEST_NO_FAULT(&env);
+    {
+        xmlrpc_int32 x[20];
+        unsigned int j;
+
+        v = xmlrpc_array_new(&env);
+        for (j = 0; j < 2; ++j) {
+            xmlrpc_value * const halfP = xmlrpc_array_new(&env);
+            unsigned int k;
+            for (k = 0; k < 10; ++k) {
+                xmlrpc_value * const itemP = xmlrpc_int_new(&env, j*10 + k);
+                xmlrpc_array_append_item(&env, halfP, itemP);
+                xmlrpc_DECREF(itemP);
+            }
+            xmlrpc_array_append_item(&env, v, halfP);
+            xmlrpc_DECREF(halfP);
+        }
+        TEST_NO_FAULT(&env);
+        xmlrpc_decompose_compiled(&env, v, decomposerP,
+                                  &x[0], &x[1], &x[2], &x[3], &x[4],
+                                  &x[5], &x[6], &x[7], &x[8], &x[9],
+                                  &x[10], &x[11], &x[12], &x[13], &x[14],
+                                  &x[15], &x[16], &x[17], &x[18], &x[19]);
+        TEST_NO_FAULT(&env);
+        for (j = 0; j < 20; ++j)
+            TEST(x[j] == (xmlrpc_int32)j);
+        xmlrpc_DECREF(v);
+    }
+    xmlrpc_decomposer_destroy(decomposerP);
+
+    /* Invalid format strings fail at compile time */
+    xmlrpc_build_compile(&env, "", &builderP);
+    TEST_FAULT(&env, XMLRPC_INTERNAL_ERROR);
+    xmlrpc_build_compile(&env, "(i", &builderP);
+    TEST_FAULT(&env, XMLRPC_INTERNAL_ERROR);
+    xmlrpc_build_compile(&env, "{s:i", &builderP);
+    TEST_FAULT(&env, XMLRPC_INTERNAL_ERROR);
+    xmlrpc_build_compile(&env, "{si}", &builderP);
+    TEST_FAULT(&env, XMLRPC_INTERNAL_ERROR);
+    xmlrpc_build_compile(&env, "ii", &builderP);
+    TEST_FAULT(&env, XMLRPC_INTERNAL_ERROR);
+    xmlrpc_build_compile(&env, "Q", &builderP);
+    TEST_FAULT(&env, XMLRPC_INTERNAL_ERROR);
+    xmlrpc_decompose_compile(&env, "{s:b,s:s,s:i}", &decomposerP);
+    TEST_FAULT(&env, XMLRPC_INTERNAL_ERROR);
+    xmlrpc_decompose_compile(&env, "(i", &decomposerP);
+    TEST_FAULT(&env, XMLRPC_INTERNAL_ERROR);
+
+    xmlrpc_env_clean(&env);
+}
+
+
+
 void 
 test_value(void) {
 
@@ -1874,6 +1978,7 @@ test_value(void) {
     test_value_missing_struct_delim();
     test_value_invalid_struct();
     test_value_parse_value();
+    test_value_compiled();
     test_struct();
 
     printf("\n");
@@ -2,6 +2,7 @@
 #define XML_DATA_H_INCLUDED
 
 #define XML_PROLOGUE "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\r\n"
+#define XML_PROLOGUE_COMPACT "<?xml version=\"1.0\" encoding=\"UTF-8\"?>"
 
 #define APACHE_URL "http://ws.apache.org/xmlrpc/namespaces/extensions"
 #define XMLNS_APACHE "xmlns:ex=\"" APACHE_URL "\""
@@ -156,6 +156,34 @@
 
 #define HAVE_PTHREAD 1
 
+/* Epoll is Linux's scalable alternative to poll(); Abyss uses it to watch
+   idle connections without tying up a thread for each.
+*/
+#if defined(__linux__)
+  #define HAVE_EPOLL 1
+#else
+  #define HAVE_EPOLL 0
+#endif
+
+/* Linux's sendfile() copies from a file to a socket inside the kernel;
+   Abyss uses it to serve static files.
+*/
+#if defined(__linux__)
+  #define HAVE_SENDFILE 1
+#else
+  #define HAVE_SENDFILE 0
+#endif
+
+/* GCC, and compilers that imitate it, have built-in atomic operations
+   such as __sync_fetch_and_add().  Abyss uses them to keep statistics
+   without locking.
+*/
+#if defined(__GNUC__)
+  #define HAVE_SYNC_FETCH_AND_ADD 1
+#else
+  #define HAVE_SYNC_FETCH_AND_ADD 0
+#endif
+
 /* Note that the return value of XMLRPC_VSNPRINTF is int on Windows,
    ssize_t on POSIX.
 */